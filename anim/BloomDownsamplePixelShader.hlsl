@@ -0,0 +1,56 @@
+Texture2D sourceTexture : register(t0);
+SamplerState samplerState : register(s0);
+
+// Mapping from destination pixels to the source level, see BloomPyramid on the CPU side
+cbuffer BloomConstantBuffer : register(b0)
+{
+    // Source pixels per destination pixel
+    float2 sourceScale;
+    // The source level covers the top left sourceSize pixels of its texture
+    float2 sourceSize;
+    float2 sourceTexelSize;
+    // Soft threshold applied when downsampling the scene
+    float threshold;
+    float knee;
+    uint prefilter;
+    float3 dummy;
+};
+
+// Per-pixel color data passed through the pixel shader.
+struct PixelShaderInput
+{
+    float4 pos : SV_POSITION;
+    float2 texcoord : TEXCOORD;
+};
+
+// Bilinear sample at a position in source pixels, kept inside the source level
+float3 sampleSource(float2 p)
+{
+    p = clamp(p, 0.5, sourceSize - 0.5);
+    return sourceTexture.SampleLevel(samplerState, p * sourceTexelSize, 0).rgb;
+}
+
+float3 thresholdColor(float3 c)
+{
+    float brightness = max(c.r, max(c.g, c.b));
+    float soft = clamp(brightness - threshold + knee, 0, 2 * knee);
+    soft = soft * soft / (4 * knee + 1e-5);
+    return c * max(soft, brightness - threshold) / max(brightness, 1e-5);
+}
+
+// Four bilinear taps on the pixel corners around the destination center
+// average a 4x4 block of the source, which keeps small highlights from
+// flickering as they move between pixels.
+float4 main(PixelShaderInput input) : SV_TARGET
+{
+    float2 center = input.pos.xy * sourceScale;
+    float3 color = 0.25 * (
+        sampleSource(center + float2(-1, -1)) +
+        sampleSource(center + float2(1, -1)) +
+        sampleSource(center + float2(-1, 1)) +
+        sampleSource(center + float2(1, 1)));
+
+    if (prefilter)
+        color = thresholdColor(color);
+    return float4(color, 1);
+}
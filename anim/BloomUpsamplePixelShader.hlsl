@@ -0,0 +1,49 @@
+// Coarser level, already holding everything below it
+Texture2D sourceTexture : register(t0);
+SamplerState samplerState : register(s0);
+
+// Same layout as in BloomDownsamplePixelShader
+cbuffer BloomConstantBuffer : register(b0)
+{
+    float2 sourceScale;
+    float2 sourceSize;
+    float2 sourceTexelSize;
+    float threshold;
+    float knee;
+    uint prefilter;
+    float3 dummy;
+};
+
+// Per-pixel color data passed through the pixel shader.
+struct PixelShaderInput
+{
+    float4 pos : SV_POSITION;
+    float2 texcoord : TEXCOORD;
+};
+
+// Bilinear sample at a position in source pixels, kept inside the source level
+float3 sampleSource(float2 p)
+{
+    p = clamp(p, 0.5, sourceSize - 0.5);
+    return sourceTexture.SampleLevel(samplerState, p * sourceTexelSize, 0).rgb;
+}
+
+// 3x3 tent filtered copy of the coarser level. It is blended additively
+// onto the downsampled level of the output size.
+float4 main(PixelShaderInput input) : SV_TARGET
+{
+    float2 center = input.pos.xy * sourceScale;
+    float3 color = 0;
+
+    [unroll]
+    for (int y = -1; y <= 1; y++)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; x++)
+        {
+            float weight = (2 - abs(x)) * (2 - abs(y)) / 16.0;
+            color += weight * sampleSource(center + float2(x, y));
+        }
+    }
+    return float4(color, 0);
+}
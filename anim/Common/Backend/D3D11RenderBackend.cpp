@@ -0,0 +1,166 @@
+#include "pch.h"
+
+#include <stdexcept>
+
+#include "D3D11RenderBackend.h"
+
+using namespace DX;
+
+D3D11RenderBackend::D3D11RenderBackend(ID3D11DeviceContext *context,
+    ID3DUserDefinedAnnotation *annotation) :
+    m_context(context),
+    m_annotation(annotation)
+{
+    m_context.As(&m_context1);
+}
+
+void D3D11RenderBackend::BeginEvent(const wchar_t *name)
+{
+    m_annotation->BeginEvent(name);
+}
+
+void D3D11RenderBackend::EndEvent()
+{
+    m_annotation->EndEvent();
+}
+
+void D3D11RenderBackend::UpdateBuffer(ID3D11Buffer *buffer, const void *data, uint32_t byteSize)
+{
+    // Default usage buffers are always replaced whole, the size is only for other backends
+    m_context->UpdateSubresource(buffer, 0, NULL, data, 0, 0);
+}
+
+void D3D11RenderBackend::UpdateBufferRange(ID3D11Buffer *buffer, uint32_t byteOffset, const void *data,
+    uint32_t byteSize)
+{
+    // Boxes are in bytes for buffers
+    D3D11_BOX box = { byteOffset, 0, 0, byteOffset + byteSize, 1, 1 };
+    m_context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+}
+
+void D3D11RenderBackend::IASetInputLayout(ID3D11InputLayout *inputLayout)
+{
+    m_context->IASetInputLayout(inputLayout);
+}
+
+void D3D11RenderBackend::IASetPrimitiveTopology(uint32_t topology)
+{
+    m_context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11RenderBackend::IASetIndexBuffer(ID3D11Buffer *buffer, uint32_t format, uint32_t offset)
+{
+    m_context->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset);
+}
+
+void D3D11RenderBackend::IASetVertexBuffers(uint32_t startSlot, uint32_t count,
+    ID3D11Buffer *const *buffers, const uint32_t *strides, const uint32_t *offsets)
+{
+    m_context->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+}
+
+void D3D11RenderBackend::VSSetShader(ID3D11VertexShader *shader)
+{
+    m_context->VSSetShader(shader, nullptr, 0);
+}
+
+void D3D11RenderBackend::PSSetShader(ID3D11PixelShader *shader)
+{
+    m_context->PSSetShader(shader, nullptr, 0);
+}
+
+void D3D11RenderBackend::VSSetConstantBuffers(uint32_t startSlot, uint32_t count,
+    ID3D11Buffer *const *buffers)
+{
+    m_context->VSSetConstantBuffers(startSlot, count, buffers);
+}
+
+void D3D11RenderBackend::PSSetConstantBuffers(uint32_t startSlot, uint32_t count,
+    ID3D11Buffer *const *buffers)
+{
+    m_context->PSSetConstantBuffers(startSlot, count, buffers);
+}
+
+void D3D11RenderBackend::VSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+    uint32_t constantCount)
+{
+    if (!m_context1)
+    {
+        // A range from the start binds the buffer, the shader reads no further
+        if (firstConstant != 0)
+            throw std::logic_error("D3D11RenderBackend: constant buffer ranges need D3D11.1");
+        m_context->VSSetConstantBuffers(slot, 1, &buffer);
+        return;
+    }
+    m_context1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+}
+
+void D3D11RenderBackend::PSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+    uint32_t constantCount)
+{
+    if (!m_context1)
+    {
+        if (firstConstant != 0)
+            throw std::logic_error("D3D11RenderBackend: constant buffer ranges need D3D11.1");
+        m_context->PSSetConstantBuffers(slot, 1, &buffer);
+        return;
+    }
+    m_context1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+}
+
+void D3D11RenderBackend::PSSetShaderResources(uint32_t startSlot, uint32_t count,
+    ID3D11ShaderResourceView *const *views)
+{
+    m_context->PSSetShaderResources(startSlot, count, views);
+}
+
+void D3D11RenderBackend::PSSetSamplers(uint32_t startSlot, uint32_t count,
+    ID3D11SamplerState *const *samplers)
+{
+    m_context->PSSetSamplers(startSlot, count, samplers);
+}
+
+void D3D11RenderBackend::OMSetRenderTargets(uint32_t count, ID3D11RenderTargetView *const *renderTargets,
+    ID3D11DepthStencilView *depthStencil)
+{
+    m_context->OMSetRenderTargets(count, renderTargets, depthStencil);
+}
+
+void D3D11RenderBackend::OMSetBlendState(ID3D11BlendState *state, const float *blendFactor,
+    uint32_t sampleMask)
+{
+    m_context->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void D3D11RenderBackend::RSSetViewports(uint32_t count, const D3D11_VIEWPORT *viewports)
+{
+    m_context->RSSetViewports(count, viewports);
+}
+
+void D3D11RenderBackend::ClearRenderTargetView(ID3D11RenderTargetView *renderTarget, const float *color)
+{
+    m_context->ClearRenderTargetView(renderTarget, color);
+}
+
+void D3D11RenderBackend::ClearDepthStencilView(ID3D11DepthStencilView *depthStencil, uint32_t flags,
+    float depth, uint8_t stencil)
+{
+    m_context->ClearDepthStencilView(depthStencil, flags, depth, stencil);
+}
+
+void D3D11RenderBackend::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+    m_context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderBackend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    m_context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderBackend::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount,
+    uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+    m_context->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndex, baseVertex,
+        startInstance);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "RenderBackend.h"
+
+namespace DX
+{
+    // Forwards every call to a D3D11 device context
+    class D3D11RenderBackend : public RenderBackend
+    {
+    public:
+        D3D11RenderBackend(ID3D11DeviceContext *context, ID3DUserDefinedAnnotation *annotation);
+
+        void BeginEvent(const wchar_t *name) override;
+        void EndEvent() override;
+
+        void UpdateBuffer(ID3D11Buffer *buffer, const void *data, uint32_t byteSize) override;
+        void UpdateBufferRange(ID3D11Buffer *buffer, uint32_t byteOffset, const void *data,
+            uint32_t byteSize) override;
+
+        void IASetInputLayout(ID3D11InputLayout *inputLayout) override;
+        void IASetPrimitiveTopology(uint32_t topology) override;
+        void IASetIndexBuffer(ID3D11Buffer *buffer, uint32_t format, uint32_t offset) override;
+        void IASetVertexBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers,
+            const uint32_t *strides, const uint32_t *offsets) override;
+
+        void VSSetShader(ID3D11VertexShader *shader) override;
+        void PSSetShader(ID3D11PixelShader *shader) override;
+        void VSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers) override;
+        void PSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers) override;
+        void VSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+            uint32_t constantCount) override;
+        void PSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+            uint32_t constantCount) override;
+        void PSSetShaderResources(uint32_t startSlot, uint32_t count,
+            ID3D11ShaderResourceView *const *views) override;
+        void PSSetSamplers(uint32_t startSlot, uint32_t count, ID3D11SamplerState *const *samplers) override;
+
+        void OMSetRenderTargets(uint32_t count, ID3D11RenderTargetView *const *renderTargets,
+            ID3D11DepthStencilView *depthStencil) override;
+        void OMSetBlendState(ID3D11BlendState *state, const float *blendFactor, uint32_t sampleMask) override;
+        void RSSetViewports(uint32_t count, const D3D11_VIEWPORT *viewports) override;
+
+        void ClearRenderTargetView(ID3D11RenderTargetView *renderTarget, const float *color) override;
+        void ClearDepthStencilView(ID3D11DepthStencilView *depthStencil, uint32_t flags,
+            float depth, uint8_t stencil) override;
+
+        void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+        void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+        void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount,
+            uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+        // Null on a D3D11.0 runtime, the range binds then throw
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_context1;
+        Microsoft::WRL::ComPtr<ID3DUserDefinedAnnotation> m_annotation;
+    };
+}
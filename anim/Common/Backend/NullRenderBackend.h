@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+
+#include "RenderBackend.h"
+
+namespace DX
+{
+    enum class RenderCall
+    {
+        BeginEvent,
+        EndEvent,
+        UpdateBuffer,
+        UpdateBufferRange,
+        IASetInputLayout,
+        IASetPrimitiveTopology,
+        IASetIndexBuffer,
+        IASetVertexBuffers,
+        VSSetShader,
+        PSSetShader,
+        VSSetConstantBuffers,
+        PSSetConstantBuffers,
+        VSSetConstantBufferRange,
+        PSSetConstantBufferRange,
+        PSSetShaderResources,
+        PSSetSamplers,
+        OMSetRenderTargets,
+        OMSetBlendState,
+        RSSetViewports,
+        ClearRenderTargetView,
+        ClearDepthStencilView,
+        Draw,
+        DrawIndexed,
+        DrawIndexedInstanced,
+        Count
+    };
+
+    struct RenderStatistics
+    {
+        // Device context calls, annotation events excluded
+        uint64_t apiCalls = 0;
+        // Binds of shaders, views, buffers, samplers and fixed function state
+        uint64_t stateChanges = 0;
+        uint64_t uploads = 0;
+        uint64_t uploadBytes = 0;
+        uint64_t clears = 0;
+        uint64_t draws = 0;
+        uint64_t instances = 0;
+        // Vertices or indices fed to the input assembler over every instance
+        uint64_t vertices = 0;
+    };
+
+    // Render backend without a GPU. Every call only updates counters, so a
+    // frame costs the renderer's own CPU time and nothing else.
+    class NullRenderBackend : public RenderBackend
+    {
+    public:
+        void BeginEvent(const wchar_t *) override { record(RenderCall::BeginEvent, 0); }
+        void EndEvent() override { record(RenderCall::EndEvent, 0); }
+
+        void UpdateBuffer(ID3D11Buffer *, const void *, uint32_t byteSize) override
+        {
+            m_statistics.uploads++;
+            m_statistics.uploadBytes += byteSize;
+            record(RenderCall::UpdateBuffer, byteSize);
+        }
+        void UpdateBufferRange(ID3D11Buffer *, uint32_t, const void *, uint32_t byteSize) override
+        {
+            m_statistics.uploads++;
+            m_statistics.uploadBytes += byteSize;
+            record(RenderCall::UpdateBufferRange, byteSize);
+        }
+
+        void IASetInputLayout(ID3D11InputLayout *) override { bind(RenderCall::IASetInputLayout, 1); }
+        void IASetPrimitiveTopology(uint32_t) override { bind(RenderCall::IASetPrimitiveTopology, 1); }
+        void IASetIndexBuffer(ID3D11Buffer *, uint32_t, uint32_t) override
+        {
+            bind(RenderCall::IASetIndexBuffer, 1);
+        }
+        void IASetVertexBuffers(uint32_t, uint32_t count, ID3D11Buffer *const *, const uint32_t *,
+            const uint32_t *) override
+        {
+            bind(RenderCall::IASetVertexBuffers, count);
+        }
+
+        void VSSetShader(ID3D11VertexShader *) override { bind(RenderCall::VSSetShader, 1); }
+        void PSSetShader(ID3D11PixelShader *) override { bind(RenderCall::PSSetShader, 1); }
+        void VSSetConstantBuffers(uint32_t, uint32_t count, ID3D11Buffer *const *) override
+        {
+            bind(RenderCall::VSSetConstantBuffers, count);
+        }
+        void PSSetConstantBuffers(uint32_t, uint32_t count, ID3D11Buffer *const *) override
+        {
+            bind(RenderCall::PSSetConstantBuffers, count);
+        }
+        void VSSetConstantBufferRange(uint32_t, ID3D11Buffer *, uint32_t, uint32_t) override
+        {
+            bind(RenderCall::VSSetConstantBufferRange, 1);
+        }
+        void PSSetConstantBufferRange(uint32_t, ID3D11Buffer *, uint32_t, uint32_t) override
+        {
+            bind(RenderCall::PSSetConstantBufferRange, 1);
+        }
+        void PSSetShaderResources(uint32_t, uint32_t count, ID3D11ShaderResourceView *const *) override
+        {
+            bind(RenderCall::PSSetShaderResources, count);
+        }
+        void PSSetSamplers(uint32_t, uint32_t count, ID3D11SamplerState *const *) override
+        {
+            bind(RenderCall::PSSetSamplers, count);
+        }
+
+        void OMSetRenderTargets(uint32_t count, ID3D11RenderTargetView *const *, ID3D11DepthStencilView *) override
+        {
+            bind(RenderCall::OMSetRenderTargets, count);
+        }
+        void OMSetBlendState(ID3D11BlendState *, const float *, uint32_t) override
+        {
+            bind(RenderCall::OMSetBlendState, 1);
+        }
+        void RSSetViewports(uint32_t count, const D3D11_VIEWPORT *) override
+        {
+            bind(RenderCall::RSSetViewports, count);
+        }
+
+        void ClearRenderTargetView(ID3D11RenderTargetView *, const float *) override
+        {
+            m_statistics.clears++;
+            record(RenderCall::ClearRenderTargetView, 1);
+        }
+        void ClearDepthStencilView(ID3D11DepthStencilView *, uint32_t, float, uint8_t) override
+        {
+            m_statistics.clears++;
+            record(RenderCall::ClearDepthStencilView, 1);
+        }
+
+        void Draw(uint32_t vertexCount, uint32_t) override
+        {
+            draw(RenderCall::Draw, vertexCount, 1);
+        }
+        void DrawIndexed(uint32_t indexCount, uint32_t, int32_t) override
+        {
+            draw(RenderCall::DrawIndexed, indexCount, 1);
+        }
+        void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount, uint32_t,
+            int32_t, uint32_t) override
+        {
+            draw(RenderCall::DrawIndexedInstanced, indexCountPerInstance, instanceCount);
+        }
+
+        const RenderStatistics &GetStatistics() const { return m_statistics; }
+        uint64_t GetCallCount(RenderCall type) const { return m_callCounts[(size_t)type]; }
+
+        // Start counting a new frame
+        virtual void Reset()
+        {
+            m_statistics = RenderStatistics();
+            for (auto &count : m_callCounts)
+                count = 0;
+        }
+
+    protected:
+        // count is the upload size for uploads, the instance count for
+        // draws and the number of bound objects otherwise
+        virtual void record(RenderCall type, uint32_t count)
+        {
+            m_callCounts[(size_t)type]++;
+            if (type != RenderCall::BeginEvent && type != RenderCall::EndEvent)
+                m_statistics.apiCalls++;
+        }
+
+    private:
+        void bind(RenderCall type, uint32_t count)
+        {
+            m_statistics.stateChanges++;
+            record(type, count);
+        }
+
+        void draw(RenderCall type, uint32_t vertexCount, uint32_t instanceCount)
+        {
+            m_statistics.draws++;
+            m_statistics.instances += instanceCount;
+            m_statistics.vertices += (uint64_t)vertexCount * instanceCount;
+            record(type, instanceCount);
+        }
+
+        RenderStatistics m_statistics;
+        uint64_t m_callCounts[(size_t)RenderCall::Count] = {};
+    };
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "NullRenderBackend.h"
+
+namespace DX
+{
+    // Null backend that also keeps the sequence of calls a real device
+    // context would have received, for tests on the call order.
+    class RecordingRenderBackend : public NullRenderBackend
+    {
+    public:
+        struct Call
+        {
+            RenderCall type;
+            // Bytes for uploads, instances for draws, bound objects for the rest
+            uint32_t count;
+        };
+
+        const std::vector<Call> &GetCalls() const { return m_calls; }
+
+        void Reset() override
+        {
+            NullRenderBackend::Reset();
+            m_calls.clear();
+        }
+
+    protected:
+        void record(RenderCall type, uint32_t count) override
+        {
+            NullRenderBackend::record(type, count);
+            m_calls.push_back({ type, count });
+        }
+
+    private:
+        std::vector<Call> m_calls;
+    };
+}
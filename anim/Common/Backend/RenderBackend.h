@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+struct ID3D11BlendState;
+struct ID3D11Buffer;
+struct ID3D11DepthStencilView;
+struct ID3D11InputLayout;
+struct ID3D11PixelShader;
+struct ID3D11RenderTargetView;
+struct ID3D11SamplerState;
+struct ID3D11ShaderResourceView;
+struct ID3D11VertexShader;
+struct D3D11_VIEWPORT;
+
+namespace DX
+{
+    // The device context calls a renderer issues, so a frame can run against
+    // D3D11 or be recorded without a GPU. Objects are the D3D11 ones, which
+    // other backends only compare; topology and format hold
+    // D3D11_PRIMITIVE_TOPOLOGY and DXGI_FORMAT values. Queries, maps and copies
+    // stay on the context, their users already sit behind ReadbackDevice.
+    class RenderBackend
+    {
+    public:
+        virtual ~RenderBackend() = default;
+
+        virtual void BeginEvent(const wchar_t *name) = 0;
+        virtual void EndEvent() = 0;
+
+        // Replace the whole contents of a default usage buffer
+        virtual void UpdateBuffer(ID3D11Buffer *buffer, const void *data, uint32_t byteSize) = 0;
+        // Replace byteSize bytes from byteOffset on of a default usage buffer
+        // that is not a constant buffer
+        virtual void UpdateBufferRange(ID3D11Buffer *buffer, uint32_t byteOffset, const void *data,
+            uint32_t byteSize) = 0;
+
+        virtual void IASetInputLayout(ID3D11InputLayout *inputLayout) = 0;
+        virtual void IASetPrimitiveTopology(uint32_t topology) = 0;
+        virtual void IASetIndexBuffer(ID3D11Buffer *buffer, uint32_t format, uint32_t offset) = 0;
+        virtual void IASetVertexBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers,
+            const uint32_t *strides, const uint32_t *offsets) = 0;
+
+        virtual void VSSetShader(ID3D11VertexShader *shader) = 0;
+        virtual void PSSetShader(ID3D11PixelShader *shader) = 0;
+        virtual void VSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers) = 0;
+        virtual void PSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers) = 0;
+        // Bind constantCount 16-byte constants from firstConstant on to one
+        // slot. Both are multiples of 16, D3D11.1 constant buffer offsetting
+        // unless firstConstant is 0.
+        virtual void VSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+            uint32_t constantCount) = 0;
+        virtual void PSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+            uint32_t constantCount) = 0;
+        virtual void PSSetShaderResources(uint32_t startSlot, uint32_t count,
+            ID3D11ShaderResourceView *const *views) = 0;
+        virtual void PSSetSamplers(uint32_t startSlot, uint32_t count, ID3D11SamplerState *const *samplers) = 0;
+
+        virtual void OMSetRenderTargets(uint32_t count, ID3D11RenderTargetView *const *renderTargets,
+            ID3D11DepthStencilView *depthStencil) = 0;
+        virtual void OMSetBlendState(ID3D11BlendState *state, const float *blendFactor, uint32_t sampleMask) = 0;
+        virtual void RSSetViewports(uint32_t count, const D3D11_VIEWPORT *viewports) = 0;
+
+        virtual void ClearRenderTargetView(ID3D11RenderTargetView *renderTarget, const float *color) = 0;
+        // flags holds D3D11_CLEAR_FLAG values
+        virtual void ClearDepthStencilView(ID3D11DepthStencilView *depthStencil, uint32_t flags,
+            float depth, uint8_t stencil) = 0;
+
+        virtual void Draw(uint32_t vertexCount, uint32_t startVertex) = 0;
+        virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+        virtual void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount,
+            uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) = 0;
+    };
+}
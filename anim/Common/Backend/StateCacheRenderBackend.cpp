@@ -0,0 +1,348 @@
+#include "pch.h"
+
+#include <algorithm>
+
+#include "StateCacheRenderBackend.h"
+
+using namespace DX;
+
+template <typename T>
+bool StateCacheRenderBackend::SlotCache<T>::Update(uint32_t startSlot, uint32_t count, T *const *values,
+    uint32_t &first, uint32_t &last)
+{
+    first = count;
+    last = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t slot = startSlot + i;
+        if (slot >= MAX_SLOTS)
+        {
+            // Not shadowed, always passed on
+            first = (std::min)(first, i);
+            last = count;
+            break;
+        }
+        uint32_t bit = 1u << slot;
+        if ((known & bit) && objects[slot] == values[i])
+            continue;
+        objects[slot] = values[i];
+        known |= bit;
+        first = (std::min)(first, i);
+        last = i + 1;
+    }
+    return first < last;
+}
+
+StateCacheRenderBackend::StateCacheRenderBackend(RenderBackend *backend) :
+    m_backend(backend)
+{
+}
+
+void StateCacheRenderBackend::BeginFrame()
+{
+    Invalidate();
+    m_statistics = StateCacheStatistics();
+}
+
+void StateCacheRenderBackend::Invalidate()
+{
+    m_inputLayoutKnown = false;
+    m_topologyKnown = false;
+    m_indexBufferKnown = false;
+    m_vertexBuffers.known = 0;
+    m_vertexShaderKnown = false;
+    m_pixelShaderKnown = false;
+    m_vsConstantBuffers.known = 0;
+    m_psConstantBuffers.known = 0;
+    m_psShaderResources.known = 0;
+    m_psSamplers.known = 0;
+    m_renderTargetsKnown = false;
+    m_blendStateKnown = false;
+    m_viewportsKnown = false;
+}
+
+void StateCacheRenderBackend::BeginEvent(const wchar_t *name)
+{
+    m_backend->BeginEvent(name);
+}
+
+void StateCacheRenderBackend::EndEvent()
+{
+    m_backend->EndEvent();
+}
+
+void StateCacheRenderBackend::UpdateBuffer(ID3D11Buffer *buffer, const void *data, uint32_t byteSize)
+{
+    // Bindings refer to the buffer, not its contents, so nothing goes stale
+    forward();
+    m_backend->UpdateBuffer(buffer, data, byteSize);
+}
+
+void StateCacheRenderBackend::UpdateBufferRange(ID3D11Buffer *buffer, uint32_t byteOffset, const void *data,
+    uint32_t byteSize)
+{
+    forward();
+    m_backend->UpdateBufferRange(buffer, byteOffset, data, byteSize);
+}
+
+void StateCacheRenderBackend::IASetInputLayout(ID3D11InputLayout *inputLayout)
+{
+    if (m_inputLayoutKnown && m_inputLayout == inputLayout)
+    {
+        filter();
+        return;
+    }
+    m_inputLayoutKnown = true;
+    m_inputLayout = inputLayout;
+    forward();
+    m_backend->IASetInputLayout(inputLayout);
+}
+
+void StateCacheRenderBackend::IASetPrimitiveTopology(uint32_t topology)
+{
+    if (m_topologyKnown && m_topology == topology)
+    {
+        filter();
+        return;
+    }
+    m_topologyKnown = true;
+    m_topology = topology;
+    forward();
+    m_backend->IASetPrimitiveTopology(topology);
+}
+
+void StateCacheRenderBackend::IASetIndexBuffer(ID3D11Buffer *buffer, uint32_t format, uint32_t offset)
+{
+    if (m_indexBufferKnown && m_indexBuffer == buffer && m_indexFormat == format && m_indexOffset == offset)
+    {
+        filter();
+        return;
+    }
+    m_indexBufferKnown = true;
+    m_indexBuffer = buffer;
+    m_indexFormat = format;
+    m_indexOffset = offset;
+    forward();
+    m_backend->IASetIndexBuffer(buffer, format, offset);
+}
+
+void StateCacheRenderBackend::IASetVertexBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers,
+    const uint32_t *strides, const uint32_t *offsets)
+{
+    // A slot also changes with its stride or offset, so those are compared first
+    // and the slot forgotten where they differ
+    for (uint32_t i = 0; i < count && startSlot + i < MAX_SLOTS; i++)
+    {
+        uint32_t slot = startSlot + i;
+        if (m_vertexStrides[slot] != strides[i] || m_vertexOffsets[slot] != offsets[i])
+        {
+            m_vertexBuffers.known &= ~(1u << slot);
+            m_vertexStrides[slot] = strides[i];
+            m_vertexOffsets[slot] = offsets[i];
+        }
+    }
+
+    uint32_t first, last;
+    if (!m_vertexBuffers.Update(startSlot, count, buffers, first, last))
+    {
+        filter();
+        return;
+    }
+    forward();
+    m_backend->IASetVertexBuffers(startSlot + first, last - first, buffers + first, strides + first, offsets + first);
+}
+
+void StateCacheRenderBackend::VSSetShader(ID3D11VertexShader *shader)
+{
+    if (m_vertexShaderKnown && m_vertexShader == shader)
+    {
+        filter();
+        return;
+    }
+    m_vertexShaderKnown = true;
+    m_vertexShader = shader;
+    forward();
+    m_backend->VSSetShader(shader);
+}
+
+void StateCacheRenderBackend::PSSetShader(ID3D11PixelShader *shader)
+{
+    if (m_pixelShaderKnown && m_pixelShader == shader)
+    {
+        filter();
+        return;
+    }
+    m_pixelShaderKnown = true;
+    m_pixelShader = shader;
+    forward();
+    m_backend->PSSetShader(shader);
+}
+
+void StateCacheRenderBackend::VSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers)
+{
+    uint32_t first, last;
+    if (!m_vsConstantBuffers.Update(startSlot, count, buffers, first, last))
+    {
+        filter();
+        return;
+    }
+    forward();
+    m_backend->VSSetConstantBuffers(startSlot + first, last - first, buffers + first);
+}
+
+void StateCacheRenderBackend::PSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers)
+{
+    uint32_t first, last;
+    if (!m_psConstantBuffers.Update(startSlot, count, buffers, first, last))
+    {
+        filter();
+        return;
+    }
+    forward();
+    m_backend->PSSetConstantBuffers(startSlot + first, last - first, buffers + first);
+}
+
+void StateCacheRenderBackend::VSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+    uint32_t constantCount)
+{
+    // Ranges of one buffer differ by offset only, so they are not shadowed.
+    // Forgetting the slot lets the next whole buffer bind through.
+    if (slot < MAX_SLOTS)
+        m_vsConstantBuffers.known &= ~(1u << slot);
+    forward();
+    m_backend->VSSetConstantBufferRange(slot, buffer, firstConstant, constantCount);
+}
+
+void StateCacheRenderBackend::PSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+    uint32_t constantCount)
+{
+    if (slot < MAX_SLOTS)
+        m_psConstantBuffers.known &= ~(1u << slot);
+    forward();
+    m_backend->PSSetConstantBufferRange(slot, buffer, firstConstant, constantCount);
+}
+
+void StateCacheRenderBackend::PSSetShaderResources(uint32_t startSlot, uint32_t count,
+    ID3D11ShaderResourceView *const *views)
+{
+    uint32_t first, last;
+    if (!m_psShaderResources.Update(startSlot, count, views, first, last))
+    {
+        filter();
+        return;
+    }
+    forward();
+    m_backend->PSSetShaderResources(startSlot + first, last - first, views + first);
+}
+
+void StateCacheRenderBackend::PSSetSamplers(uint32_t startSlot, uint32_t count, ID3D11SamplerState *const *samplers)
+{
+    uint32_t first, last;
+    if (!m_psSamplers.Update(startSlot, count, samplers, first, last))
+    {
+        filter();
+        return;
+    }
+    forward();
+    m_backend->PSSetSamplers(startSlot + first, last - first, samplers + first);
+}
+
+void StateCacheRenderBackend::OMSetRenderTargets(uint32_t count, ID3D11RenderTargetView *const *renderTargets,
+    ID3D11DepthStencilView *depthStencil)
+{
+    bool same = m_renderTargetsKnown && count == m_renderTargetCount && depthStencil == m_depthStencil;
+    for (uint32_t i = 0; same && i < count; i++)
+        same = renderTargets[i] == m_renderTargets[i];
+    if (same)
+    {
+        filter();
+        return;
+    }
+
+    m_renderTargetsKnown = count <= MAX_RENDER_TARGETS;
+    m_renderTargetCount = count;
+    for (uint32_t i = 0; i < count && i < MAX_RENDER_TARGETS; i++)
+        m_renderTargets[i] = renderTargets[i];
+    m_depthStencil = depthStencil;
+    // The runtime unbinds any shader resource whose texture just became an
+    // output, which the shadow cannot see without knowing the textures
+    m_psShaderResources.known = 0;
+    forward();
+    m_backend->OMSetRenderTargets(count, renderTargets, depthStencil);
+}
+
+void StateCacheRenderBackend::OMSetBlendState(ID3D11BlendState *state, const float *blendFactor, uint32_t sampleMask)
+{
+    // No factor means 1 for every channel
+    static const float DEFAULT_FACTOR[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const float *factor = blendFactor ? blendFactor : DEFAULT_FACTOR;
+    if (m_blendStateKnown && m_blendState == state && m_sampleMask == sampleMask &&
+        std::equal(factor, factor + 4, m_blendFactor))
+    {
+        filter();
+        return;
+    }
+    m_blendStateKnown = true;
+    m_blendState = state;
+    std::copy(factor, factor + 4, m_blendFactor);
+    m_sampleMask = sampleMask;
+    forward();
+    m_backend->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void StateCacheRenderBackend::RSSetViewports(uint32_t count, const D3D11_VIEWPORT *viewports)
+{
+    bool same = m_viewportsKnown && count == m_viewportCount;
+    for (uint32_t i = 0; same && i < count; i++)
+    {
+        const Viewport &v = m_viewports[i];
+        same = v.topLeftX == viewports[i].TopLeftX && v.topLeftY == viewports[i].TopLeftY &&
+            v.width == viewports[i].Width && v.height == viewports[i].Height &&
+            v.minDepth == viewports[i].MinDepth && v.maxDepth == viewports[i].MaxDepth;
+    }
+    if (same)
+    {
+        filter();
+        return;
+    }
+
+    m_viewportsKnown = count <= MAX_SLOTS;
+    m_viewportCount = count;
+    for (uint32_t i = 0; i < count && i < MAX_SLOTS; i++)
+        m_viewports[i] = { viewports[i].TopLeftX, viewports[i].TopLeftY, viewports[i].Width,
+            viewports[i].Height, viewports[i].MinDepth, viewports[i].MaxDepth };
+    forward();
+    m_backend->RSSetViewports(count, viewports);
+}
+
+void StateCacheRenderBackend::ClearRenderTargetView(ID3D11RenderTargetView *renderTarget, const float *color)
+{
+    forward();
+    m_backend->ClearRenderTargetView(renderTarget, color);
+}
+
+void StateCacheRenderBackend::ClearDepthStencilView(ID3D11DepthStencilView *depthStencil, uint32_t flags,
+    float depth, uint8_t stencil)
+{
+    forward();
+    m_backend->ClearDepthStencilView(depthStencil, flags, depth, stencil);
+}
+
+void StateCacheRenderBackend::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+    forward();
+    m_backend->Draw(vertexCount, startVertex);
+}
+
+void StateCacheRenderBackend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    forward();
+    m_backend->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateCacheRenderBackend::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount,
+    uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+    forward();
+    m_backend->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+
+#include "RenderBackend.h"
+
+namespace DX
+{
+    struct StateCacheStatistics
+    {
+        // Calls passed on to the backend, annotation events excluded
+        uint64_t forwarded = 0;
+        // Binds dropped because they would not change the bound state
+        uint64_t filtered = 0;
+    };
+
+    // Shadows the state bound through it and drops binds that change nothing.
+    // Range binds only pass on the slots that differ. Everything else goes
+    // straight to the backend behind it.
+    //
+    // The shadow is only valid as long as nobody binds past the cache: call
+    // Invalidate after using the device context directly, BeginFrame at the
+    // start of every frame. Object pointers are compared only, so the cache
+    // must also be invalidated before a released object's address can be
+    // reused by a new one.
+    class StateCacheRenderBackend : public RenderBackend
+    {
+    public:
+        explicit StateCacheRenderBackend(RenderBackend *backend);
+
+        // Forget the shadowed state and start counting a new frame
+        void BeginFrame();
+        // Forget the shadowed state, the next bind of everything is forwarded
+        void Invalidate();
+
+        const StateCacheStatistics &GetStatistics() const { return m_statistics; }
+
+        void BeginEvent(const wchar_t *name) override;
+        void EndEvent() override;
+
+        void UpdateBuffer(ID3D11Buffer *buffer, const void *data, uint32_t byteSize) override;
+        void UpdateBufferRange(ID3D11Buffer *buffer, uint32_t byteOffset, const void *data,
+            uint32_t byteSize) override;
+
+        void IASetInputLayout(ID3D11InputLayout *inputLayout) override;
+        void IASetPrimitiveTopology(uint32_t topology) override;
+        void IASetIndexBuffer(ID3D11Buffer *buffer, uint32_t format, uint32_t offset) override;
+        void IASetVertexBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers,
+            const uint32_t *strides, const uint32_t *offsets) override;
+
+        void VSSetShader(ID3D11VertexShader *shader) override;
+        void PSSetShader(ID3D11PixelShader *shader) override;
+        void VSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers) override;
+        void PSSetConstantBuffers(uint32_t startSlot, uint32_t count, ID3D11Buffer *const *buffers) override;
+        void VSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+            uint32_t constantCount) override;
+        void PSSetConstantBufferRange(uint32_t slot, ID3D11Buffer *buffer, uint32_t firstConstant,
+            uint32_t constantCount) override;
+        void PSSetShaderResources(uint32_t startSlot, uint32_t count,
+            ID3D11ShaderResourceView *const *views) override;
+        void PSSetSamplers(uint32_t startSlot, uint32_t count, ID3D11SamplerState *const *samplers) override;
+
+        void OMSetRenderTargets(uint32_t count, ID3D11RenderTargetView *const *renderTargets,
+            ID3D11DepthStencilView *depthStencil) override;
+        void OMSetBlendState(ID3D11BlendState *state, const float *blendFactor, uint32_t sampleMask) override;
+        void RSSetViewports(uint32_t count, const D3D11_VIEWPORT *viewports) override;
+
+        void ClearRenderTargetView(ID3D11RenderTargetView *renderTarget, const float *color) override;
+        void ClearDepthStencilView(ID3D11DepthStencilView *depthStencil, uint32_t flags,
+            float depth, uint8_t stencil) override;
+
+        void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+        void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+        void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount,
+            uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+
+    private:
+        // Slots shadowed per stage, binds reaching further are always forwarded
+        static const uint32_t MAX_SLOTS = 16;
+        static const uint32_t MAX_RENDER_TARGETS = 8;
+
+        // Bound objects of one range of slots, each slot either known or not
+        template <typename T>
+        struct SlotCache
+        {
+            T *objects[MAX_SLOTS];
+            uint32_t known = 0;
+
+            // Narrow [first, last) to the slots that change and remember the
+            // new objects. False when nothing changes.
+            bool Update(uint32_t startSlot, uint32_t count, T *const *values,
+                uint32_t &first, uint32_t &last);
+        };
+
+        struct Viewport
+        {
+            float topLeftX, topLeftY, width, height, minDepth, maxDepth;
+        };
+
+        void forward() { m_statistics.forwarded++; }
+        void filter() { m_statistics.filtered++; }
+
+        RenderBackend *m_backend;
+        StateCacheStatistics m_statistics;
+
+        // Every field below is only valid while its known flag is set
+        bool m_inputLayoutKnown = false;
+        ID3D11InputLayout *m_inputLayout = nullptr;
+        bool m_topologyKnown = false;
+        uint32_t m_topology = 0;
+        bool m_indexBufferKnown = false;
+        ID3D11Buffer *m_indexBuffer = nullptr;
+        uint32_t m_indexFormat = 0;
+        uint32_t m_indexOffset = 0;
+        SlotCache<ID3D11Buffer> m_vertexBuffers;
+        uint32_t m_vertexStrides[MAX_SLOTS] = {};
+        uint32_t m_vertexOffsets[MAX_SLOTS] = {};
+
+        bool m_vertexShaderKnown = false;
+        ID3D11VertexShader *m_vertexShader = nullptr;
+        bool m_pixelShaderKnown = false;
+        ID3D11PixelShader *m_pixelShader = nullptr;
+        SlotCache<ID3D11Buffer> m_vsConstantBuffers;
+        SlotCache<ID3D11Buffer> m_psConstantBuffers;
+        SlotCache<ID3D11ShaderResourceView> m_psShaderResources;
+        SlotCache<ID3D11SamplerState> m_psSamplers;
+
+        bool m_renderTargetsKnown = false;
+        uint32_t m_renderTargetCount = 0;
+        ID3D11RenderTargetView *m_renderTargets[MAX_RENDER_TARGETS];
+        ID3D11DepthStencilView *m_depthStencil = nullptr;
+        bool m_blendStateKnown = false;
+        ID3D11BlendState *m_blendState = nullptr;
+        float m_blendFactor[4];
+        uint32_t m_sampleMask = 0;
+        bool m_viewportsKnown = false;
+        uint32_t m_viewportCount = 0;
+        Viewport m_viewports[MAX_SLOTS];
+    };
+}
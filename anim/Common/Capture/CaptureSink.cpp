@@ -0,0 +1,26 @@
+#include "pch.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include "CaptureSink.h"
+
+using namespace DX;
+
+FileCaptureSink::FileCaptureSink(const std::string &directory) :
+    m_directory(directory)
+{
+    if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\')
+        m_directory += '/';
+}
+
+void FileCaptureSink::Write(const std::string &fileName, const std::vector<uint8_t> &data)
+{
+    std::ofstream file(m_directory + fileName, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("FileCaptureSink: cannot create " + m_directory + fileName);
+
+    file.write((const char *)data.data(), data.size());
+    if (!file)
+        throw std::runtime_error("FileCaptureSink: cannot write " + m_directory + fileName);
+}
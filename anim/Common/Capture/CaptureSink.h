@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    // Destination of encoded capture files. Write is called from the
+    // capture worker threads, implementations must be thread safe.
+    class CaptureSink
+    {
+    public:
+        virtual ~CaptureSink() = default;
+
+        // Store one encoded file, throws on failure
+        virtual void Write(const std::string &fileName, const std::vector<uint8_t> &data) = 0;
+    };
+
+    // Writes captures as files into an existing directory
+    class FileCaptureSink : public CaptureSink
+    {
+    public:
+        explicit FileCaptureSink(const std::string &directory);
+
+        void Write(const std::string &fileName, const std::vector<uint8_t> &data) override;
+
+    private:
+        std::string m_directory;
+    };
+}
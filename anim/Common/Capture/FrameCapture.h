@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "..\Readback\ReadbackDevice.h"
+#include "CaptureSink.h"
+#include "ImageEncoder.h"
+
+namespace DX
+{
+    struct FrameCaptureSettings
+    {
+        // Staging slots the GPU copies into. A capture is dropped while every
+        // slot is in flight.
+        size_t slotCount = 3;
+        unsigned workerCount = 2;
+        // Read back frames waiting for an encoder. Past this budget finished
+        // copies stay in their slots, so later captures are dropped instead
+        // of memory growing.
+        size_t maxPendingBytes = 256 << 20;
+    };
+
+    // Writes GPU textures to files without stalling the render thread.
+    // Capture() schedules a copy into a ring of staging slots, Poll() maps
+    // the copies the GPU has finished and hands them to encoder threads,
+    // which write PNG or PFM files through a sink. Every frame asked for is
+    // either written or counted as dropped.
+    template <typename Source>
+    class FrameCapture
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t requested = 0;
+            // Captures refused because every slot was in flight
+            uint64_t dropped = 0;
+            uint64_t written = 0;
+            uint64_t failed = 0;
+            uint64_t bytesWritten = 0;
+            // Polls that left copies in their slots because of the memory budget
+            uint64_t budgetStalls = 0;
+            size_t pendingBytes = 0;
+            size_t peakPendingBytes = 0;
+            // Render thread time spent in Capture and Poll
+            double frameSeconds = 0;
+            double lastFrameSeconds = 0;
+            double maxFrameSeconds = 0;
+            uint64_t frames = 0;
+            // Encoder thread time spent encoding and writing
+            double encodeSeconds = 0;
+        };
+
+        // Slots hold textureWidth x textureHeight tightly packed pixels of the given format
+        FrameCapture(const std::shared_ptr<ReadbackDevice<Source>> &device, uint32_t textureWidth,
+            uint32_t textureHeight, CapturePixelFormat format, const std::string &name,
+            const std::shared_ptr<CaptureSink> &sink,
+            const FrameCaptureSettings &settings = FrameCaptureSettings()) :
+            m_device(device),
+            m_textureWidth(textureWidth),
+            m_textureHeight(textureHeight),
+            m_format(format),
+            m_name(name),
+            m_sink(sink),
+            m_settings(settings)
+        {
+            m_rowPitch = textureWidth * ImageEncoder::GetBytesPerPixel(format);
+            m_slotByteSize = m_rowPitch * textureHeight;
+            if (m_slotByteSize == 0 || device->GetSlotByteSize() != m_slotByteSize)
+                throw std::invalid_argument("FrameCapture: slot size does not match the image");
+            if (settings.slotCount == 0 || settings.workerCount == 0)
+                throw std::invalid_argument("FrameCapture: no slots or workers");
+            if (settings.maxPendingBytes < m_slotByteSize)
+                throw std::invalid_argument("FrameCapture: memory budget below one frame");
+
+            m_slots.resize(settings.slotCount);
+            for (auto &slot : m_slots)
+                slot.index = m_device->CreateSlot();
+
+            for (unsigned i = 0; i < settings.workerCount; i++)
+                m_workers.emplace_back([this]() { workerLoop(); });
+        }
+
+        ~FrameCapture()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (auto &worker : m_workers)
+                worker.join();
+        }
+
+        FrameCapture(const FrameCapture &) = delete;
+        FrameCapture &operator=(const FrameCapture &) = delete;
+
+        // Copy the top left width x height pixels of source, tagged with the
+        // frame number. Returns false if the capture was dropped.
+        bool Capture(const Source &source, uint64_t frame, uint32_t width, uint32_t height)
+        {
+            Timer timer(*this);
+            if (width == 0 || height == 0 || width > m_textureWidth || height > m_textureHeight)
+                throw std::invalid_argument("FrameCapture: capture outside the texture");
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.requested++;
+
+            Slot &slot = m_slots[m_head];
+            if (slot.inFlight)
+            {
+                m_stats.dropped++;
+                return false;
+            }
+
+            m_device->CopyToSlot(slot.index, source);
+            slot.inFlight = true;
+            slot.frame = frame;
+            slot.width = width;
+            slot.height = height;
+            m_head = (m_head + 1) % m_slots.size();
+            return true;
+        }
+
+        // Hand every finished copy to the encoders, without blocking. Call
+        // once per frame, it also closes the frame's overhead measurement.
+        void Poll()
+        {
+            {
+                Timer timer(*this);
+                // Copies finish in submission order, the oldest slot is read first
+                while (m_slots[m_tail].inFlight && readSlot(m_slots[m_tail], false))
+                {
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.frames++;
+            m_stats.lastFrameSeconds = m_currentFrameSeconds;
+            m_stats.maxFrameSeconds = (std::max)(m_stats.maxFrameSeconds, m_currentFrameSeconds);
+            m_currentFrameSeconds = 0;
+        }
+
+        // Wait for every copy in flight and every queued file. Only meant for
+        // shutdown or tooling.
+        void Flush()
+        {
+            while (m_slots[m_tail].inFlight)
+            {
+                waitForBudget();
+                readSlot(m_slots[m_tail], true);
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]() { return m_jobs.empty() && m_busyWorkers == 0; });
+        }
+
+        Statistics GetStatistics() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_stats;
+        }
+
+        // Message of the last failed write, empty if none failed
+        std::string GetLastError() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_lastError;
+        }
+
+        const std::string &GetName() const { return m_name; }
+        uint32_t GetTextureWidth() const { return m_textureWidth; }
+        uint32_t GetTextureHeight() const { return m_textureHeight; }
+        CapturePixelFormat GetFormat() const { return m_format; }
+
+    private:
+        struct Slot
+        {
+            size_t index = 0;
+            uint64_t frame = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            bool inFlight = false;
+        };
+
+        struct Job
+        {
+            std::vector<uint8_t> pixels;
+            uint64_t frame;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        // Adds the render thread time of a call to the current frame
+        class Timer
+        {
+        public:
+            explicit Timer(FrameCapture &capture) :
+                m_capture(capture), m_start(std::chrono::steady_clock::now())
+            {
+            }
+
+            ~Timer()
+            {
+                double seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - m_start).count();
+                std::lock_guard<std::mutex> lock(m_capture.m_mutex);
+                m_capture.m_currentFrameSeconds += seconds;
+                m_capture.m_stats.frameSeconds += seconds;
+            }
+
+        private:
+            FrameCapture &m_capture;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        // Move a finished copy into a pending buffer and queue it. Returns
+        // false if the copy is not finished or the memory budget is used up.
+        bool readSlot(Slot &slot, bool wait)
+        {
+            std::vector<uint8_t> pixels;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stats.pendingBytes + m_slotByteSize > m_settings.maxPendingBytes)
+                {
+                    m_stats.budgetStalls++;
+                    return false;
+                }
+                if (!m_freeBuffers.empty())
+                {
+                    pixels.swap(m_freeBuffers.back());
+                    m_freeBuffers.pop_back();
+                }
+            }
+
+            pixels.resize(m_slotByteSize);
+            if (!m_device->ReadSlot(slot.index, pixels.data(), m_slotByteSize, wait))
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_freeBuffers.push_back(std::move(pixels));
+                return false;
+            }
+
+            slot.inFlight = false;
+            m_tail = (m_tail + 1) % m_slots.size();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.pendingBytes += m_slotByteSize;
+                m_stats.peakPendingBytes = (std::max)(m_stats.peakPendingBytes, m_stats.pendingBytes);
+                m_jobs.push_back({ std::move(pixels), slot.frame, slot.width, slot.height });
+            }
+            m_wake.notify_one();
+            return true;
+        }
+
+        void waitForBudget()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]()
+            {
+                return m_stats.pendingBytes + m_slotByteSize <= m_settings.maxPendingBytes;
+            });
+        }
+
+        void workerLoop()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (;;)
+            {
+                m_wake.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+                // Queued frames are still written on shutdown
+                if (m_jobs.empty())
+                    return;
+
+                Job job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                m_busyWorkers++;
+                lock.unlock();
+
+                auto start = std::chrono::steady_clock::now();
+                size_t written = 0;
+                std::string error;
+                try
+                {
+                    std::vector<uint8_t> file = ImageEncoder::Encode(job.pixels.data(), m_format,
+                        job.width, job.height, m_rowPitch);
+                    m_sink->Write(getFileName(job.frame), file);
+                    written = file.size();
+                }
+                catch (const std::exception &e)
+                {
+                    error = e.what();
+                }
+                double seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+
+                lock.lock();
+                m_busyWorkers--;
+                m_stats.encodeSeconds += seconds;
+                m_stats.pendingBytes -= m_slotByteSize;
+                if (error.empty())
+                {
+                    m_stats.written++;
+                    m_stats.bytesWritten += written;
+                }
+                else
+                {
+                    m_stats.failed++;
+                    m_lastError = error;
+                }
+                m_freeBuffers.push_back(std::move(job.pixels));
+                m_idle.notify_all();
+            }
+        }
+
+        std::string getFileName(uint64_t frame) const
+        {
+            char number[32];
+            snprintf(number, sizeof(number), "%06llu", (unsigned long long)frame);
+            return m_name + "_" + number + "." + ImageEncoder::GetExtension(m_format);
+        }
+
+        std::shared_ptr<ReadbackDevice<Source>> m_device;
+        uint32_t m_textureWidth;
+        uint32_t m_textureHeight;
+        CapturePixelFormat m_format;
+        std::string m_name;
+        std::shared_ptr<CaptureSink> m_sink;
+        FrameCaptureSettings m_settings;
+        size_t m_rowPitch;
+        size_t m_slotByteSize;
+
+        // Render thread only
+        std::vector<Slot> m_slots;
+        size_t m_head = 0;
+        size_t m_tail = 0;
+
+        // Shared with the encoder threads
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+        std::deque<Job> m_jobs;
+        std::vector<std::vector<uint8_t>> m_freeBuffers;
+        unsigned m_busyWorkers = 0;
+        bool m_stop = false;
+        double m_currentFrameSeconds = 0;
+        Statistics m_stats;
+        std::string m_lastError;
+
+        std::vector<std::thread> m_workers;
+    };
+}
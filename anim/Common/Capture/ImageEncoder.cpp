@@ -0,0 +1,372 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "ImageEncoder.h"
+
+using namespace DX;
+
+namespace
+{
+    const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    const size_t WINDOW_SIZE = 32768;
+    const size_t MIN_MATCH = 3;
+    const size_t MAX_MATCH = 258;
+    // Candidates tried per position, trades compression for speed
+    const int MAX_CHAIN = 8;
+    const int HASH_BITS = 15;
+
+    // Deflate packs bits starting from the least significant one
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<uint8_t> &out) : m_out(out) {}
+
+        void Write(uint32_t value, int count)
+        {
+            m_buffer |= (uint64_t)value << m_count;
+            m_count += count;
+            while (m_count >= 8)
+            {
+                m_out.push_back((uint8_t)m_buffer);
+                m_buffer >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        // Huffman codes are stored most significant bit first
+        void WriteCode(uint32_t code, int length)
+        {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; i++)
+                reversed |= ((code >> i) & 1) << (length - 1 - i);
+            Write(reversed, length);
+        }
+
+        void Flush()
+        {
+            if (m_count > 0)
+                m_out.push_back((uint8_t)m_buffer);
+            m_buffer = 0;
+            m_count = 0;
+        }
+
+    private:
+        std::vector<uint8_t> &m_out;
+        uint64_t m_buffer = 0;
+        int m_count = 0;
+    };
+
+    void writeLiteralLength(BitWriter &bits, uint32_t symbol)
+    {
+        if (symbol < 144)
+            bits.WriteCode(0x30 + symbol, 8);
+        else if (symbol < 256)
+            bits.WriteCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            bits.WriteCode(symbol - 256, 7);
+        else
+            bits.WriteCode(0xc0 + symbol - 280, 8);
+    }
+
+    void writeMatch(BitWriter &bits, size_t length, size_t distance)
+    {
+        int code = 28;
+        while (LENGTH_BASE[code] > length)
+            code--;
+        writeLiteralLength(bits, 257 + code);
+        bits.Write((uint32_t)(length - LENGTH_BASE[code]), LENGTH_EXTRA[code]);
+
+        code = 29;
+        while (DISTANCE_BASE[code] > distance)
+            code--;
+        bits.WriteCode(code, 5);
+        bits.Write((uint32_t)(distance - DISTANCE_BASE[code]), DISTANCE_EXTRA[code]);
+    }
+
+    uint32_t hash3(const uint8_t *p)
+    {
+        uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void appendBigEndian(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    void appendChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+    {
+        appendBigEndian(out, (uint32_t)data.size());
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        appendBigEndian(out, ImageEncoder::Crc32(&out[start], out.size() - start));
+    }
+
+    uint8_t paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return (uint8_t)a;
+        return (uint8_t)(pb <= pc ? b : c);
+    }
+}
+
+size_t ImageEncoder::GetBytesPerPixel(CapturePixelFormat format)
+{
+    return format == CapturePixelFormat::RGBA32Float ? 16 : 4;
+}
+
+const char *ImageEncoder::GetExtension(CapturePixelFormat format)
+{
+    return format == CapturePixelFormat::RGBA32Float ? "pfm" : "png";
+}
+
+std::vector<uint8_t> ImageEncoder::Encode(const void *pixels, CapturePixelFormat format,
+    uint32_t width, uint32_t height, size_t rowPitch)
+{
+    switch (format)
+    {
+    case CapturePixelFormat::RGBA32Float:
+        if (rowPitch % sizeof(float) != 0)
+            throw std::invalid_argument("ImageEncoder: unaligned float rows");
+        return EncodePFM((const float *)pixels, width, height, rowPitch / sizeof(float));
+    case CapturePixelFormat::BGRA8Unorm:
+        return EncodePNG((const uint8_t *)pixels, true, width, height, rowPitch);
+    case CapturePixelFormat::RGBA8Unorm:
+        return EncodePNG((const uint8_t *)pixels, false, width, height, rowPitch);
+    default:
+        throw std::invalid_argument("ImageEncoder: unknown pixel format");
+    }
+}
+
+std::vector<uint8_t> ImageEncoder::EncodePNG(const uint8_t *pixels, bool bgra,
+    uint32_t width, uint32_t height, size_t rowPitch)
+{
+    if (width == 0 || height == 0)
+        throw std::invalid_argument("ImageEncoder: empty image");
+
+    const size_t bpp = 3;
+    size_t rowSize = (size_t)width * bpp;
+    int red = bgra ? 2 : 0, blue = bgra ? 0 : 2;
+
+    // Each row is stored with the filter that leaves the smallest residuals
+    std::vector<uint8_t> filtered((rowSize + 1) * height);
+    std::vector<uint8_t> previous(rowSize, 0), current(rowSize);
+    std::vector<uint8_t> candidates[5];
+    for (auto &candidate : candidates)
+        candidate.resize(rowSize);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t *in = pixels + y * rowPitch;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            current[x * 3] = in[x * 4 + red];
+            current[x * 3 + 1] = in[x * 4 + 1];
+            current[x * 3 + 2] = in[x * 4 + blue];
+        }
+
+        int best = 0;
+        uint64_t bestScore = UINT64_MAX;
+        for (int type = 0; type < 5; type++)
+        {
+            uint8_t *out = candidates[type].data();
+            uint64_t score = 0;
+            for (size_t i = 0; i < rowSize; i++)
+            {
+                int a = i >= bpp ? current[i - bpp] : 0;
+                int b = previous[i];
+                int c = i >= bpp ? previous[i - bpp] : 0;
+                uint8_t predicted = 0;
+                switch (type)
+                {
+                case 1: predicted = (uint8_t)a; break;
+                case 2: predicted = (uint8_t)b; break;
+                case 3: predicted = (uint8_t)((a + b) / 2); break;
+                case 4: predicted = paeth(a, b, c); break;
+                }
+                out[i] = (uint8_t)(current[i] - predicted);
+                score += (uint64_t)std::abs((int)(int8_t)out[i]);
+            }
+            if (score < bestScore)
+            {
+                bestScore = score;
+                best = type;
+            }
+        }
+
+        uint8_t *row = &filtered[y * (rowSize + 1)];
+        row[0] = (uint8_t)best;
+        memcpy(row + 1, candidates[best].data(), rowSize);
+        previous.swap(current);
+    }
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    // 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", Deflate(filtered.data(), filtered.size()));
+    appendChunk(png, "IEND", std::vector<uint8_t>());
+    return png;
+}
+
+std::vector<uint8_t> ImageEncoder::EncodePFM(const float *rgba, uint32_t width, uint32_t height,
+    size_t rowPitch)
+{
+    if (width == 0 || height == 0)
+        throw std::invalid_argument("ImageEncoder: empty image");
+
+    // A negative scale marks little endian data
+    char header[64];
+    int headerSize = snprintf(header, sizeof(header), "PF\n%u %u\n-1.0\n", width, height);
+
+    std::vector<uint8_t> pfm(headerSize + (size_t)width * height * 3 * sizeof(float));
+    memcpy(pfm.data(), header, headerSize);
+    float *out = (float *)(pfm.data() + headerSize);
+    for (uint32_t y = height; y-- > 0;)
+    {
+        const float *row = rgba + y * rowPitch;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            // memcpy keeps the stores legal whatever the header length
+            memcpy(out, row + x * 4, 3 * sizeof(float));
+            out += 3;
+        }
+    }
+    return pfm;
+}
+
+uint32_t ImageEncoder::Crc32(const uint8_t *data, size_t size, uint32_t crc)
+{
+    static const struct Table
+    {
+        uint32_t entries[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t ImageEncoder::Adler32(const uint8_t *data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        // Largest run that cannot overflow before the modulo
+        size_t run = (std::min)(size, (size_t)5552);
+        for (size_t i = 0; i < run; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+std::vector<uint8_t> ImageEncoder::Deflate(const uint8_t *data, size_t size)
+{
+    std::vector<uint8_t> out;
+    out.reserve(size / 2 + 64);
+    // zlib header: deflate with a 32K window, fastest compression level
+    out.push_back(0x78);
+    out.push_back(0x01);
+
+    BitWriter bits(out);
+    // A single final block with fixed Huffman codes
+    bits.Write(1, 1);
+    bits.Write(1, 2);
+
+    std::vector<int32_t> head((size_t)1 << HASH_BITS, -1);
+    std::vector<int32_t> chain(WINDOW_SIZE, -1);
+    auto insert = [&](size_t pos)
+    {
+        uint32_t h = hash3(data + pos);
+        chain[pos % WINDOW_SIZE] = head[h];
+        head[h] = (int32_t)pos;
+    };
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        size_t bestLength = 0, bestDistance = 0;
+        if (pos + MIN_MATCH <= size)
+        {
+            size_t maxLength = (std::min)(MAX_MATCH, size - pos);
+            int32_t candidate = head[hash3(data + pos)];
+            for (int tries = 0; tries < MAX_CHAIN && candidate >= 0 &&
+                pos - (size_t)candidate <= WINDOW_SIZE; tries++)
+            {
+                size_t length = 0;
+                while (length < maxLength && data[candidate + length] == data[pos + length])
+                    length++;
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = pos - candidate;
+                    if (length == maxLength)
+                        break;
+                }
+                candidate = chain[candidate % WINDOW_SIZE];
+            }
+        }
+
+        if (bestLength >= MIN_MATCH)
+        {
+            writeMatch(bits, bestLength, bestDistance);
+            for (size_t i = 0; i < bestLength; i++, pos++)
+                if (pos + MIN_MATCH <= size)
+                    insert(pos);
+        }
+        else
+        {
+            writeLiteralLength(bits, data[pos]);
+            if (pos + MIN_MATCH <= size)
+                insert(pos);
+            pos++;
+        }
+    }
+
+    writeLiteralLength(bits, 256);
+    bits.Flush();
+
+    appendBigEndian(out, Adler32(data, size));
+    return out;
+}
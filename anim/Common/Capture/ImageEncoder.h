@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+    // Layout of the pixels handed to the capture pipeline
+    enum class CapturePixelFormat
+    {
+        // 16 bytes per pixel, HDR targets, written as PFM
+        RGBA32Float,
+        // 4 bytes per pixel, swap chain and LDR targets, written as PNG
+        BGRA8Unorm,
+        RGBA8Unorm
+    };
+
+    // Self-contained image file encoders for frame captures, safe to call
+    // from several threads at once.
+    class ImageEncoder
+    {
+    public:
+        static size_t GetBytesPerPixel(CapturePixelFormat format);
+        // File extension for captures of the format, without the dot
+        static const char *GetExtension(CapturePixelFormat format);
+
+        // Encode the top left width x height pixels of an image whose rows are
+        // rowPitch bytes apart, in the file format of the pixel format
+        static std::vector<uint8_t> Encode(const void *pixels, CapturePixelFormat format,
+            uint32_t width, uint32_t height, size_t rowPitch);
+
+        // 8-bit RGB PNG. Rows get the usual per-row filter heuristic and are
+        // compressed with fixed Huffman deflate, alpha is dropped.
+        static std::vector<uint8_t> EncodePNG(const uint8_t *pixels, bool bgra,
+            uint32_t width, uint32_t height, size_t rowPitch);
+
+        // Portable float map: RGB little endian floats, rows bottom to top
+        static std::vector<uint8_t> EncodePFM(const float *rgba, uint32_t width, uint32_t height,
+            size_t rowPitch);
+
+        static uint32_t Crc32(const uint8_t *data, size_t size, uint32_t crc = 0);
+        static uint32_t Adler32(const uint8_t *data, size_t size);
+
+        // zlib stream of data with fixed Huffman codes and greedy LZ77 matching
+        static std::vector<uint8_t> Deflate(const uint8_t *data, size_t size);
+    };
+}
@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include <stdexcept>
+
+#include "ConstantRingAllocator.h"
+
+using namespace DX;
+
+ConstantRingAllocator::ConstantRingAllocator(const std::shared_ptr<ConstantRingDevice> &device) :
+    m_device(device),
+    m_byteSize(device->GetByteSize())
+{
+    if (m_byteSize == 0 || m_byteSize % ALIGNMENT != 0)
+        throw std::invalid_argument("ConstantRingAllocator: size must be a non-zero multiple of 256");
+}
+
+void ConstantRingAllocator::BeginFrame()
+{
+    while (retireFrame(false))
+        ;
+    m_statistics = ConstantRingStatistics();
+}
+
+void ConstantRingAllocator::EndFrame()
+{
+    if (m_frameBytes == 0)
+        return;
+    m_frames.push_back({ m_device->InsertFence(), m_frameBytes });
+    m_frameBytes = 0;
+}
+
+ConstantAllocation ConstantRingAllocator::Allocate(const void *data, uint32_t byteSize)
+{
+    if (byteSize == 0)
+        throw std::invalid_argument("ConstantRingAllocator: empty allocation");
+    if (byteSize > m_byteSize)
+        throw std::length_error("ConstantRingAllocator: allocation larger than the ring");
+    uint32_t paddedSize = (byteSize + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    uint32_t offset;
+    while (!reserve(paddedSize, offset))
+    {
+        if (retireFrame(false))
+            continue;
+        if (m_frameBytes == 0)
+        {
+            // Nothing of this frame is in the ring yet, renaming loses nothing
+            m_frames.clear();
+            m_head = 0;
+            m_used = 0;
+            m_discard = true;
+            continue;
+        }
+        if (!retireFrame(true))
+            throw std::length_error("ConstantRingAllocator: the frame's constants do not fit into the ring");
+        m_statistics.waits++;
+    }
+
+    m_device->Write(offset, data, byteSize, m_discard);
+    if (m_discard)
+        m_statistics.discards++;
+    m_discard = false;
+
+    m_statistics.allocations++;
+    m_statistics.bytes += byteSize;
+    m_statistics.paddedBytes += paddedSize;
+    uint32_t bufferOffset;
+    ID3D11Buffer *buffer = m_device->GetBuffer(offset, bufferOffset);
+    return { buffer, bufferOffset, paddedSize };
+}
+
+bool ConstantRingAllocator::reserve(uint32_t byteSize, uint32_t &offset)
+{
+    // Everything before the head back to the tail is taken
+    if (m_used == 0)
+        m_head = 0;
+    uint32_t tail = (m_head + m_byteSize - m_used) % m_byteSize;
+    uint32_t skipped = 0;
+    if (m_used == m_byteSize)
+        return false;
+    if (tail > m_head)
+    {
+        if (byteSize > tail - m_head)
+            return false;
+    }
+    else if (byteSize > m_byteSize - m_head)
+    {
+        // The end is too short, the start up to the tail has to do
+        if (byteSize > tail)
+            return false;
+        skipped = m_byteSize - m_head;
+        m_head = 0;
+        m_statistics.wraps++;
+    }
+
+    offset = m_head;
+    m_head = (m_head + byteSize) % m_byteSize;
+    m_used += skipped + byteSize;
+    m_frameBytes += skipped + byteSize;
+    return true;
+}
+
+bool ConstantRingAllocator::retireFrame(bool wait)
+{
+    if (m_frames.empty() || !m_device->IsFenceComplete(m_frames.front().fence, wait))
+        return false;
+    m_used -= m_frames.front().byteSize;
+    m_frames.pop_front();
+    return true;
+}
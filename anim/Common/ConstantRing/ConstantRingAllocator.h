@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include "ConstantRingDevice.h"
+
+namespace DX
+{
+    // A slice of the ring, bound with the range binds of RenderBackend
+    struct ConstantAllocation
+    {
+        ID3D11Buffer *buffer;
+        uint32_t offset;
+        // Padded to a multiple of 256
+        uint32_t byteSize;
+
+        // Range bind arguments, in 16-byte constants
+        uint32_t GetFirstConstant() const { return offset / 16; }
+        uint32_t GetConstantCount() const { return byteSize / 16; }
+    };
+
+    struct ConstantRingStatistics
+    {
+        uint32_t allocations = 0;
+        // Bytes of constants written, and the bytes they took up with padding
+        uint64_t bytes = 0;
+        uint64_t paddedBytes = 0;
+        // Ends of the buffer skipped because an allocation did not fit there
+        uint32_t wraps = 0;
+        uint32_t discards = 0;
+        // Blocking waits for the GPU in a frame that ran out of space
+        uint32_t waits = 0;
+    };
+
+    // Per-frame constants sub-allocated from one buffer in a ring, instead
+    // of one default usage buffer per constant block rewritten with
+    // UpdateSubresource.
+    //
+    // Allocations are 256-byte aligned, written with no-overwrite and bound
+    // by offset. EndFrame fences the bytes a frame used; BeginFrame frees
+    // the frames whose fence completed. When the ring is full at the start
+    // of a frame it is discarded and starts over, the GPU keeps reading the
+    // renamed copy. Later in a frame a discard would also drop the frame's
+    // own constants before their draws, so the allocator waits for the
+    // oldest frame in flight instead.
+    class ConstantRingAllocator
+    {
+    public:
+        static const uint32_t ALIGNMENT = 256;
+
+        explicit ConstantRingAllocator(const std::shared_ptr<ConstantRingDevice> &device);
+
+        // Free the frames the GPU is done with and restart the statistics
+        void BeginFrame();
+        // Fence everything allocated since BeginFrame
+        void EndFrame();
+
+        // Copy byteSize bytes into a new slice. Throws std::invalid_argument
+        // for an empty allocation and std::length_error if the constants of
+        // the current frame do not fit into the ring.
+        ConstantAllocation Allocate(const void *data, uint32_t byteSize);
+
+        template <typename T>
+        ConstantAllocation Allocate(const T &constants)
+        {
+            return Allocate(&constants, (uint32_t)sizeof(T));
+        }
+
+        // Bytes held by frames in flight and the current one
+        uint32_t GetUsedByteSize() const { return m_used; }
+        const ConstantRingStatistics &GetStatistics() const { return m_statistics; }
+
+    private:
+        struct Frame
+        {
+            uint64_t fence;
+            // Allocations and skipped ends, the frames follow each other
+            uint32_t byteSize;
+        };
+
+        // Take byteSize bytes at the head, false if they are not free
+        bool reserve(uint32_t byteSize, uint32_t &offset);
+        // Free the oldest frame if the GPU is done with it
+        bool retireFrame(bool wait);
+
+        std::shared_ptr<ConstantRingDevice> m_device;
+        uint32_t m_byteSize;
+
+        std::deque<Frame> m_frames;
+        uint32_t m_head = 0;
+        uint32_t m_used = 0;
+        uint32_t m_frameBytes = 0;
+        // The buffer holds nothing yet, the first write discards
+        bool m_discard = true;
+
+        ConstantRingStatistics m_statistics;
+    };
+}
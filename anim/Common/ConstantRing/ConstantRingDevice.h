@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+struct ID3D11Buffer;
+
+namespace DX
+{
+    // Backend used by ConstantRingAllocator: a CPU writable range of
+    // constants and fences on the GPU timeline. Offsets are multiples of
+    // 256, the granularity constant buffer ranges are bound at.
+    class ConstantRingDevice
+    {
+    public:
+        virtual ~ConstantRingDevice() = default;
+
+        // Size in bytes of the buffer, a multiple of 256
+        virtual uint32_t GetByteSize() const = 0;
+        // Buffer the slice written at offset is bound from and where in it
+        // the slice starts. Null for the fake backend.
+        virtual ID3D11Buffer *GetBuffer(uint32_t offset, uint32_t &bufferOffset) const = 0;
+
+        // Copy data to the buffer at offset. With discard the whole buffer
+        // is renamed and everything in it dropped, the GPU keeps reading the
+        // old copy. Without it nothing is synchronized, the caller makes sure
+        // the GPU is done with the bytes written.
+        virtual void Write(uint32_t offset, const void *data, uint32_t byteSize, bool discard) = 0;
+
+        // Mark the end of the GPU work issued so far and return its fence.
+        // Fences count up from 1 and complete in order.
+        virtual uint64_t InsertFence() = 0;
+        // When wait is false the call never blocks and returns false if the
+        // GPU has not reached the fence yet
+        virtual bool IsFenceComplete(uint64_t fence, bool wait) = 0;
+    };
+}
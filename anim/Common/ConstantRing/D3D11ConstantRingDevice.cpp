@@ -0,0 +1,125 @@
+#include "pch.h"
+
+#include "D3D11ConstantRingDevice.h"
+
+using namespace DX;
+
+D3D11ConstantRingDevice::D3D11ConstantRingDevice(const std::shared_ptr<DeviceResources> &deviceResources,
+    uint32_t byteSize, const std::string &name) :
+    m_deviceResources(deviceResources),
+    m_byteSize(byteSize),
+    m_name(name)
+{
+    if (byteSize == 0 || byteSize % 256 != 0)
+        throw std::invalid_argument("D3D11ConstantRingDevice: size must be a non-zero multiple of 256");
+
+    auto device = m_deviceResources->GetD3DDevice();
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    DX::ThrowIfFailed(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)));
+    if (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+    {
+        // Created as blocks are first written
+        m_blockBuffers.resize(byteSize / 256);
+        m_blockBufferSizes.resize(byteSize / 256);
+        return;
+    }
+
+    CD3D11_BUFFER_DESC desc(byteSize, D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+    DX::ThrowIfFailed(device->CreateBuffer(&desc, nullptr, &m_buffer));
+    DX::SetName(m_buffer, name);
+}
+
+void D3D11ConstantRingDevice::Write(uint32_t offset, const void *data, uint32_t byteSize, bool discard)
+{
+    if (offset % 256 != 0)
+        throw std::invalid_argument("D3D11ConstantRingDevice: misaligned offset");
+    if (offset > m_byteSize || byteSize > m_byteSize - offset)
+        throw std::out_of_range("D3D11ConstantRingDevice: write past the buffer");
+
+    if (!IsOffsetting())
+    {
+        // The driver renames default buffers on update, nothing in flight is
+        // overwritten and discarding has nothing left to do
+        uint32_t block = offset / 256;
+        uint32_t paddedSize = (byteSize + 255) & ~255u;
+        if (m_blockBufferSizes[block] < paddedSize)
+        {
+            CD3D11_BUFFER_DESC desc(paddedSize, D3D11_BIND_CONSTANT_BUFFER);
+            DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&desc, nullptr,
+                &m_blockBuffers[block]));
+            DX::SetName(m_blockBuffers[block], m_name + std::to_string(block));
+            m_blockBufferSizes[block] = paddedSize;
+        }
+        m_staging.assign(m_blockBufferSizes[block], 0);
+        memcpy(m_staging.data(), data, byteSize);
+        m_deviceResources->GetRenderBackend()->UpdateBuffer(m_blockBuffers[block].Get(), m_staging.data(),
+            (uint32_t)m_staging.size());
+        return;
+    }
+
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    DX::ThrowIfFailed(context->Map(m_buffer.Get(), 0,
+        discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped));
+    memcpy((byte *)mapped.pData + offset, data, byteSize);
+    context->Unmap(m_buffer.Get(), 0);
+}
+
+ID3D11Buffer *D3D11ConstantRingDevice::GetBuffer(uint32_t offset, uint32_t &bufferOffset) const
+{
+    if (IsOffsetting())
+    {
+        bufferOffset = offset;
+        return m_buffer.Get();
+    }
+    bufferOffset = 0;
+    return m_blockBuffers[offset / 256].Get();
+}
+
+uint64_t D3D11ConstantRingDevice::InsertFence()
+{
+    Fence fence;
+    fence.value = m_nextFence++;
+    if (m_freeQueries.empty())
+    {
+        CD3D11_QUERY_DESC desc(D3D11_QUERY_EVENT);
+        DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateQuery(&desc, &fence.query));
+        DX::SetName(fence.query, "ConstantRingFence" + std::to_string(fence.value));
+    }
+    else
+    {
+        fence.query = m_freeQueries.back();
+        m_freeQueries.pop_back();
+    }
+
+    m_deviceResources->GetD3DDeviceContext()->End(fence.query.Get());
+    m_pending.push_back(fence);
+    return fence.value;
+}
+
+bool D3D11ConstantRingDevice::IsFenceComplete(uint64_t fence, bool wait)
+{
+    auto context = m_deviceResources->GetD3DDeviceContext();
+
+    // Queries finish in submission order, walk from the oldest one
+    while (m_completedFence < fence && !m_pending.empty())
+    {
+        Fence &oldest = m_pending.front();
+        // Waiting flushes, otherwise the GPU may never see the query
+        UINT flags = wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH;
+        HRESULT hr;
+        do
+            hr = context->GetData(oldest.query.Get(), nullptr, 0, flags);
+        while (hr == S_FALSE && wait);
+        DX::ThrowIfFailed(hr);
+        if (hr != S_OK)
+            break;
+
+        m_completedFence = oldest.value;
+        m_freeQueries.push_back(oldest.query);
+        m_pending.pop_front();
+    }
+
+    return m_completedFence >= fence;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <deque>
+
+#include "ConstantRingDevice.h"
+#include "..\DeviceResources.h"
+
+namespace DX
+{
+    // Ring backend over a dynamic constant buffer. Writes map it with
+    // D3D11_MAP_WRITE_DISCARD or D3D11_MAP_WRITE_NO_OVERWRITE, fences are
+    // event queries polled without flushing.
+    //
+    // No-overwrite maps of constant buffers and binding them by offset need
+    // a D3D11.1 driver. Without one every 256-byte block of the ring gets its
+    // own default usage constant buffer instead, rewritten whole with
+    // UpdateBuffer and bound from its start, as before the ring.
+    class D3D11ConstantRingDevice : public ConstantRingDevice
+    {
+    public:
+        D3D11ConstantRingDevice(const std::shared_ptr<DeviceResources> &deviceResources, uint32_t byteSize,
+            const std::string &name);
+
+        uint32_t GetByteSize() const override { return m_byteSize; }
+        ID3D11Buffer *GetBuffer(uint32_t offset, uint32_t &bufferOffset) const override;
+        // False when falling back to a buffer per block
+        bool IsOffsetting() const { return m_buffer != nullptr; }
+
+        void Write(uint32_t offset, const void *data, uint32_t byteSize, bool discard) override;
+
+        uint64_t InsertFence() override;
+        bool IsFenceComplete(uint64_t fence, bool wait) override;
+
+    private:
+        struct Fence
+        {
+            uint64_t value;
+            Microsoft::WRL::ComPtr<ID3D11Query> query;
+        };
+
+        std::shared_ptr<DeviceResources> m_deviceResources;
+        uint32_t m_byteSize;
+        Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
+
+        // Fallback buffers by block, each at least as big as the last slice
+        // written at its block
+        std::string m_name;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>> m_blockBuffers;
+        std::vector<uint32_t> m_blockBufferSizes;
+        // A slice padded to its buffer's size, UpdateBuffer replaces it all
+        std::vector<uint8_t> m_staging;
+
+        // Fences in flight, oldest first, and queries ready for reuse
+        std::deque<Fence> m_pending;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> m_freeQueries;
+        uint64_t m_nextFence = 1;
+        uint64_t m_completedFence = 0;
+    };
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "ConstantRingDevice.h"
+
+namespace DX
+{
+    // Ring backend without a GPU. A fence inserted on frame f completes on
+    // frame f + latency, which simulates a GPU running 'latency' frames
+    // behind the CPU. Every 256-byte block remembers the fence following
+    // its last write; writing it again without a discard before that fence
+    // completes would corrupt constants a draw in flight still reads, and
+    // is counted as an overwrite.
+    class FakeConstantRingDevice : public ConstantRingDevice
+    {
+    public:
+        FakeConstantRingDevice(uint32_t byteSize, uint32_t latencyFrames) :
+            m_data(byteSize),
+            m_blockFences(byteSize / BLOCK_SIZE),
+            m_latencyFrames(latencyFrames)
+        {
+            if (byteSize == 0 || byteSize % BLOCK_SIZE != 0)
+                throw std::invalid_argument("FakeConstantRingDevice: size must be a non-zero multiple of 256");
+        }
+
+        uint32_t GetByteSize() const override { return (uint32_t)m_data.size(); }
+        ID3D11Buffer *GetBuffer(uint32_t offset, uint32_t &bufferOffset) const override
+        {
+            bufferOffset = offset;
+            return nullptr;
+        }
+
+        void Write(uint32_t offset, const void *data, uint32_t byteSize, bool discard) override
+        {
+            if (offset % BLOCK_SIZE != 0)
+                throw std::invalid_argument("FakeConstantRingDevice: misaligned offset");
+            if (offset > m_data.size() || byteSize > m_data.size() - offset)
+                throw std::out_of_range("FakeConstantRingDevice: write past the buffer");
+
+            if (discard)
+            {
+                // Renamed, the GPU keeps the old copy
+                for (auto &fence : m_blockFences)
+                    fence = 0;
+                m_discarded = true;
+                m_discards++;
+            }
+            else if (!m_discarded)
+            {
+                // D3D11 leaves the contents undefined until the first discard
+                throw std::logic_error("FakeConstantRingDevice: no-overwrite write before the first discard");
+            }
+
+            bool overwrite = false;
+            for (uint32_t block = offset / BLOCK_SIZE; block * BLOCK_SIZE < offset + byteSize; block++)
+            {
+                uint64_t &fence = m_blockFences[block];
+                if (fence != 0 && !isComplete(fence))
+                    overwrite = true;
+                fence = m_nextFence;
+            }
+            if (overwrite)
+                m_overwrites++;
+
+            memcpy(&m_data[offset], data, byteSize);
+            m_writes++;
+            m_writtenBytes += byteSize;
+        }
+
+        uint64_t InsertFence() override
+        {
+            m_fenceFrames.push_back(m_frame);
+            return m_nextFence++;
+        }
+
+        bool IsFenceComplete(uint64_t fence, bool wait) override
+        {
+            if (isComplete(fence))
+                return true;
+            if (!wait || fence >= m_nextFence)
+            {
+                m_notReadyPolls++;
+                return false;
+            }
+            // A blocking wait would stall the CPU until the GPU catches up
+            m_blockingWaits++;
+            m_stalledFrames += m_fenceFrames[fence - 1] + m_latencyFrames - m_frame;
+            m_waitedFence = fence;
+            return true;
+        }
+
+        // Simulates the end of a frame on the GPU timeline
+        void AdvanceFrame() { m_frame++; }
+
+        void SetLatency(uint32_t latencyFrames) { m_latencyFrames = latencyFrames; }
+
+        const std::vector<uint8_t> &GetData() const { return m_data; }
+        uint64_t GetFrame() const { return m_frame; }
+        uint64_t GetWriteCount() const { return m_writes; }
+        uint64_t GetWrittenByteCount() const { return m_writtenBytes; }
+        uint64_t GetDiscardCount() const { return m_discards; }
+        uint64_t GetBlockingWaitCount() const { return m_blockingWaits; }
+        uint64_t GetStalledFrameCount() const { return m_stalledFrames; }
+        uint64_t GetNotReadyPollCount() const { return m_notReadyPolls; }
+        uint64_t GetOverwriteCount() const { return m_overwrites; }
+
+    private:
+        static const uint32_t BLOCK_SIZE = 256;
+
+        bool isComplete(uint64_t fence) const
+        {
+            // Fences not inserted yet cover work that has not even been issued
+            if (fence >= m_nextFence)
+                return false;
+            return fence <= m_waitedFence || m_fenceFrames[fence - 1] + m_latencyFrames <= m_frame;
+        }
+
+        std::vector<uint8_t> m_data;
+        // Fence following the last write of each block, 0 for none
+        std::vector<uint64_t> m_blockFences;
+        // Frame each fence was inserted on, by fence - 1
+        std::vector<uint64_t> m_fenceFrames;
+        uint32_t m_latencyFrames;
+        uint64_t m_frame = 0;
+        uint64_t m_nextFence = 1;
+        uint64_t m_waitedFence = 0;
+        bool m_discarded = false;
+
+        uint64_t m_writes = 0;
+        uint64_t m_writtenBytes = 0;
+        uint64_t m_discards = 0;
+        uint64_t m_blockingWaits = 0;
+        uint64_t m_stalledFrames = 0;
+        uint64_t m_notReadyPolls = 0;
+        uint64_t m_overwrites = 0;
+    };
+}
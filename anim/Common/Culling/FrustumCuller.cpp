@@ -0,0 +1,161 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+#include "FrustumCuller.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    const size_t GROUP_SIZE = 8;
+
+    // Four spheres against the planes, a lane is all ones if its sphere
+    // reaches the inside of every plane
+    __m128 testSpheres(const __m128 (&planes)[6][4], __m128 x, __m128 y, __m128 z, __m128 negRadius)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, planes[p][0]), _mm_mul_ps(y, planes[p][1])),
+                _mm_add_ps(_mm_mul_ps(z, planes[p][2]), planes[p][3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+        }
+        return inside;
+    }
+
+    // Write the indices of spheres [first, last) that pass to output,
+    // returns how many were written
+    size_t cullRange(const BoundingSphereSet &spheres, const Frustum &frustum, size_t first, size_t last,
+        uint32_t *output)
+    {
+        __m128 planes[6][4];
+        for (int p = 0; p < 6; p++)
+        {
+            planes[p][0] = _mm_set1_ps(frustum.planes[p].x);
+            planes[p][1] = _mm_set1_ps(frustum.planes[p].y);
+            planes[p][2] = _mm_set1_ps(frustum.planes[p].z);
+            planes[p][3] = _mm_set1_ps(frustum.planes[p].w);
+        }
+
+        const float *xs = spheres.GetX();
+        const float *ys = spheres.GetY();
+        const float *zs = spheres.GetZ();
+        const float *radii = spheres.GetRadius();
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+
+        size_t count = 0;
+        // The padding makes the last group safe to load, its extra lanes are
+        // masked off below
+        for (size_t i = first; i < last; i += GROUP_SIZE)
+        {
+            __m128 low = testSpheres(planes, _mm_loadu_ps(xs + i), _mm_loadu_ps(ys + i), _mm_loadu_ps(zs + i),
+                _mm_xor_ps(_mm_loadu_ps(radii + i), signBit));
+            __m128 high = testSpheres(planes, _mm_loadu_ps(xs + i + 4), _mm_loadu_ps(ys + i + 4),
+                _mm_loadu_ps(zs + i + 4), _mm_xor_ps(_mm_loadu_ps(radii + i + 4), signBit));
+            unsigned mask = (unsigned)_mm_movemask_ps(low) | ((unsigned)_mm_movemask_ps(high) << 4);
+            if (last - i < GROUP_SIZE)
+                mask &= (1u << (last - i)) - 1;
+
+            // Branchless compaction, every lane writes and only survivors advance
+            for (unsigned k = 0; k < GROUP_SIZE; k++)
+            {
+                output[count] = (uint32_t)(i + k);
+                count += (mask >> k) & 1;
+            }
+        }
+        return count;
+    }
+}
+
+Frustum DX::ExtractFrustum(FXMMATRIX viewProjection)
+{
+    // With clip = (x, y, z, 1) * M every clip component is a dot product
+    // with a column of M, the rows of the transpose
+    XMMATRIX columns = XMMatrixTranspose(viewProjection);
+    XMVECTOR planes[6] =
+    {
+        XMVectorAdd(columns.r[3], columns.r[0]),
+        XMVectorSubtract(columns.r[3], columns.r[0]),
+        XMVectorAdd(columns.r[3], columns.r[1]),
+        XMVectorSubtract(columns.r[3], columns.r[1]),
+        columns.r[2],
+        XMVectorSubtract(columns.r[3], columns.r[2]),
+    };
+
+    Frustum frustum;
+    for (int p = 0; p < 6; p++)
+        XMStoreFloat4(&frustum.planes[p], XMPlaneNormalize(planes[p]));
+    return frustum;
+}
+
+bool DX::IsSphereVisible(const Frustum &frustum, float x, float y, float z, float radius)
+{
+    for (const XMFLOAT4 &plane : frustum.planes)
+    {
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+void BoundingSphereSet::Resize(size_t count)
+{
+    size_t padded = (count + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+    m_count = count;
+    m_x.resize(padded, 0.0f);
+    m_y.resize(padded, 0.0f);
+    m_z.resize(padded, 0.0f);
+    m_radius.resize(padded, 0.0f);
+}
+
+void BoundingSphereSet::Set(size_t i, float x, float y, float z, float radius)
+{
+    m_x[i] = x;
+    m_y[i] = y;
+    m_z[i] = z;
+    m_radius[i] = radius;
+}
+
+FrustumCuller::FrustumCuller(ThreadPool &pool) :
+    m_pool(pool)
+{
+}
+
+const std::vector<uint32_t> &FrustumCuller::Cull(const BoundingSphereSet &spheres, const Frustum &frustum)
+{
+    size_t count = spheres.GetCount();
+    size_t chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (m_chunkVisible.size() < chunkCount)
+        m_chunkVisible.resize(chunkCount);
+    m_chunkCounts.assign(chunkCount, 0);
+
+    m_pool.ParallelFor(chunkCount, [&](size_t chunk, unsigned)
+    {
+        size_t first = chunk * CHUNK_SIZE;
+        size_t last = (std::min)(first + CHUNK_SIZE, count);
+        // Room for the stores of the last group's masked lanes too
+        size_t capacity = (last - first + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+        std::vector<uint32_t> &visible = m_chunkVisible[chunk];
+        if (visible.size() < capacity)
+            visible.resize(capacity);
+        m_chunkCounts[chunk] = cullRange(spheres, frustum, first, last, visible.data());
+    });
+
+    size_t total = 0;
+    for (size_t chunkVisible : m_chunkCounts)
+        total += chunkVisible;
+    m_visible.resize(total);
+    size_t offset = 0;
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        std::copy(m_chunkVisible[chunk].begin(), m_chunkVisible[chunk].begin() + m_chunkCounts[chunk],
+            m_visible.begin() + offset);
+        offset += m_chunkCounts[chunk];
+    }
+    return m_visible;
+}
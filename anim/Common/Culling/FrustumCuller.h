@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "..\ThreadPool.h"
+
+namespace DX
+{
+    // Planes of a view frustum in world space, a x + b y + c z + d >= 0 on
+    // the inside. The normals are unit length, so a plane's value at a point
+    // is the signed distance to compare against a radius.
+    struct Frustum
+    {
+        // Left, right, bottom, top, near, far
+        DirectX::XMFLOAT4 planes[6];
+    };
+
+    // Planes of the clip volume -w <= x, y <= w, 0 <= z <= w of a
+    // view-projection matrix in DirectXMath's row vector convention
+    Frustum ExtractFrustum(DirectX::FXMMATRIX viewProjection);
+
+    // Scalar reference of the test FrustumCuller runs: true if the sphere
+    // reaches the inside of every plane
+    bool IsSphereVisible(const Frustum &frustum, float x, float y, float z, float radius);
+
+    // Bounding spheres as structure of arrays, one array per component, so
+    // the culler loads every component of four spheres in one go. The arrays
+    // are padded to whole groups of eight.
+    class BoundingSphereSet
+    {
+    public:
+        void Resize(size_t count);
+        void Set(size_t i, float x, float y, float z, float radius);
+
+        size_t GetCount() const { return m_count; }
+        const float *GetX() const { return m_x.data(); }
+        const float *GetY() const { return m_y.data(); }
+        const float *GetZ() const { return m_z.data(); }
+        const float *GetRadius() const { return m_radius.data(); }
+
+    private:
+        size_t m_count = 0;
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_z;
+        std::vector<float> m_radius;
+    };
+
+    // Lists the spheres of a BoundingSphereSet that touch a frustum. Eight
+    // spheres are tested per step against all six planes without branches.
+    // Sets larger than one chunk are split across the thread pool, each
+    // chunk compacts its own survivors and the lists are joined in chunk
+    // order, so the result does not depend on the thread count.
+    class FrustumCuller
+    {
+    public:
+        // Spheres per thread pool task, whole groups of eight
+        static const size_t CHUNK_SIZE = 16384;
+
+        explicit FrustumCuller(ThreadPool &pool = ThreadPool::Default());
+
+        // Indices of the visible spheres in ascending order
+        const std::vector<uint32_t> &Cull(const BoundingSphereSet &spheres, const Frustum &frustum);
+
+        const std::vector<uint32_t> &GetVisible() const { return m_visible; }
+
+    private:
+        ThreadPool &m_pool;
+
+        // Survivors of every chunk, each list as long as the chunk
+        std::vector<std::vector<uint32_t>> m_chunkVisible;
+        std::vector<size_t> m_chunkCounts;
+        std::vector<uint32_t> m_visible;
+    };
+}
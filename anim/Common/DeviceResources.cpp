@@ -1,6 +1,8 @@
 ﻿#include "pch.h"
 
 #include "DeviceResources.h"
+#include "Backend\D3D11RenderBackend.h"
+#include "Mesh\MeshOptimizer.h"
 #include "roapi.h"
 
 using namespace D2D1;
@@ -132,6 +134,11 @@ void DX::DeviceResources::CreateDeviceResources()
         m_d3dContext->QueryInterface(__uuidof(m_annotation.Get()),
             reinterpret_cast<void**>(m_annotation.GetAddressOf()))
         );
+    // A backend installed by SetRenderBackend outlives the device, the new
+    // context starts without any state the cache may remember
+    if (!m_renderBackendInjected)
+        m_renderBackend.reset(new D3D11RenderBackend(m_d3dContext.Get(), m_annotation.Get()));
+    m_stateCache.reset(new StateCacheRenderBackend(m_renderBackend.get()));
 
     // Create the Direct2D device object and a corresponding context.
     ComPtr<IDXGIDevice3> dxgiDevice;
@@ -335,6 +342,18 @@ void DX::DeviceResources::SetWindow(HWND hwnd)
     CreateWindowSizeDependentResources();
 }
 
+void DX::DeviceResources::SetRenderBackend(std::unique_ptr<RenderBackend> renderBackend)
+{
+    m_renderBackendInjected = renderBackend != nullptr;
+    if (m_renderBackendInjected)
+        m_renderBackend = std::move(renderBackend);
+    else if (m_d3dContext)
+        m_renderBackend.reset(new D3D11RenderBackend(m_d3dContext.Get(), m_annotation.Get()));
+    else
+        m_renderBackend.reset();
+    m_stateCache.reset(new StateCacheRenderBackend(m_renderBackend.get()));
+}
+
 // Present the contents of the swap chain to the screen.
 void DX::DeviceResources::Present() 
 {
@@ -382,7 +401,7 @@ ComPtr<ID3D11PixelShader> DX::DeviceResources::createPixelShader(
 }
 
 ComPtr<ID3D11VertexShader> DX::DeviceResources::createVertexShader(
-    const std::string &namePrefix) const
+    const std::string &namePrefix, std::vector<byte> *bytecode) const
 {
     ComPtr<ID3D11VertexShader> output;
 
@@ -413,11 +432,13 @@ ComPtr<ID3D11VertexShader> DX::DeviceResources::createVertexShader(
     );
     DX::SetName(output, namePrefix + "VertexShader");
 
+    if (bytecode)
+        bytecode->swap(data);
     return output;
 }
 
 ComPtr<ID3D11ShaderResourceView> DX::DeviceResources::createShaderResourceView(
-    ComPtr<ID3D11Texture2D> texture, const std::string &namePrefix,
+    ComPtr<ID3D11Resource> texture, const std::string &namePrefix,
     const D3D11_SHADER_RESOURCE_VIEW_DESC *desc) const
 {
     ComPtr<ID3D11ShaderResourceView> shaderResource;
@@ -459,24 +480,48 @@ ComPtr<ID3D11Texture2D> DX::DeviceResources::createTexture2D(
     return texture;
 }
 
-Microsoft::WRL::ComPtr<ID3D11Buffer> DX::DeviceResources::createIndexBuffer(
-    const std::vector<unsigned short> &indices,
-    const std::string &namePrefix) const
+ComPtr<ID3D11Texture3D> DX::DeviceResources::createTexture3D(
+    const D3D11_TEXTURE3D_DESC &desc, const std::string &namePrefix,
+    const D3D11_SUBRESOURCE_DATA *initData) const
 {
-    Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+    ComPtr<ID3D11Texture3D> texture;
 
-    CD3D11_BUFFER_DESC indexBufferDesc(
-        (UINT)indices.size() * sizeof(UINT),
-        D3D11_BIND_INDEX_BUFFER
-    );
+    DX::ThrowIfFailed(m_d3dDevice->CreateTexture3D(&desc, initData, &texture));
+    DX::SetName(texture, namePrefix + "Texture");
+
+    return texture;
+}
+
+DX::IndexBuffer DX::DeviceResources::createIndexBuffer(
+    const std::vector<uint32_t> &indices, uint32_t vertexCount,
+    const std::string &namePrefix) const
+{
+    IndexBuffer indexBuffer;
 
+    std::vector<uint16_t> shortIndices;
     D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-    indexBufferData.pSysMem = indices.data();
+    UINT byteWidth;
+    if (FitsShortIndices(vertexCount))
+    {
+        shortIndices.reserve(indices.size());
+        for (uint32_t index : indices)
+            shortIndices.push_back((uint16_t)index);
+        indexBuffer.format = DXGI_FORMAT_R16_UINT;
+        indexBufferData.pSysMem = shortIndices.data();
+        byteWidth = (UINT)shortIndices.size() * sizeof(uint16_t);
+    }
+    else
+    {
+        indexBuffer.format = DXGI_FORMAT_R32_UINT;
+        indexBufferData.pSysMem = indices.data();
+        byteWidth = (UINT)indices.size() * sizeof(uint32_t);
+    }
 
+    CD3D11_BUFFER_DESC indexBufferDesc(byteWidth, D3D11_BIND_INDEX_BUFFER);
     ThrowIfFailed(
-        m_d3dDevice->CreateBuffer(&indexBufferDesc, &indexBufferData, &indexBuffer)
+        m_d3dDevice->CreateBuffer(&indexBufferDesc, &indexBufferData, &indexBuffer.buffer)
     );
-    SetName(indexBuffer, namePrefix + "IndexBuffer");
+    SetName(indexBuffer.buffer, namePrefix + "IndexBuffer");
 
     return indexBuffer;
 }
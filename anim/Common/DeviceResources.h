@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "DirectXHelper.h"
+#include "Backend\StateCacheRenderBackend.h"
 
 namespace DX
 {
@@ -42,10 +43,19 @@ namespace DX
         Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
         Microsoft::WRL::ComPtr<ID3D11RenderTargetView> renderTargetView;
         Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView;
+        // Only set for depth targets
+        Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthStencilView;
         D3D11_VIEWPORT viewport;
         CD3D11_TEXTURE2D_DESC textureDesc;
     };
 
+    struct IndexBuffer
+    {
+        Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+        // DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+        DXGI_FORMAT format;
+    };
+
     // Controls all the DirectX device resources.
     class DeviceResources
     {
@@ -55,28 +65,40 @@ namespace DX
         void SetLogicalSize(Size logicalSize);
         void Present();
 
+        // Replace the backend the renderers issue their draw calls through,
+        // e.g. with a NullRenderBackend to measure their CPU cost alone.
+        // The state cache stays in front of it. The backend is kept when the
+        // device is recreated; null goes back to the D3D11 backend.
+        void SetRenderBackend(std::unique_ptr<RenderBackend> renderBackend);
+
         // Create texture of given size and bind it as render target and shader resource
         RenderTargetTexture createRenderTargetTexture(const Size &size,
             const std::string &namePrefix, UINT mipLevels = 1) const;
 
         Microsoft::WRL::ComPtr<ID3D11PixelShader> createPixelShader(
             const std::string &namePrefix) const;
+        // bytecode receives the compiled shader, for creating input layouts
         Microsoft::WRL::ComPtr<ID3D11VertexShader> createVertexShader(
-            const std::string &namePrefix) const;
+            const std::string &namePrefix, std::vector<byte> *bytecode = nullptr) const;
 
         Microsoft::WRL::ComPtr<ID3D11Texture2D> createTexture2D(
             const D3D11_TEXTURE2D_DESC &desc, const std::string &namePrefix,
             const D3D11_SUBRESOURCE_DATA *initData = nullptr) const;
+        Microsoft::WRL::ComPtr<ID3D11Texture3D> createTexture3D(
+            const D3D11_TEXTURE3D_DESC &desc, const std::string &namePrefix,
+            const D3D11_SUBRESOURCE_DATA *initData = nullptr) const;
         Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> createShaderResourceView(
-            Microsoft::WRL::ComPtr<ID3D11Texture2D> texture,
+            Microsoft::WRL::ComPtr<ID3D11Resource> texture,
             const std::string &namePrefix,
             const D3D11_SHADER_RESOURCE_VIEW_DESC *desc = nullptr) const;
         Microsoft::WRL::ComPtr<ID3D11RenderTargetView> createRenderTargetView(
             Microsoft::WRL::ComPtr<ID3D11Texture2D> texture,
             const std::string &namePrefix) const;
 
-        Microsoft::WRL::ComPtr<ID3D11Buffer> createIndexBuffer(
-            const std::vector<unsigned short> &indices,
+        // Packs the indices in 16 bits when vertexCount, the vertices a
+        // single draw addresses from its base vertex, allows it
+        IndexBuffer createIndexBuffer(
+            const std::vector<uint32_t> &indices, uint32_t vertexCount,
             const std::string &namePrefix) const;
 
         template <typename Vertex>
@@ -114,6 +136,8 @@ namespace DX
         ID3D11DepthStencilView*    GetDepthStencilView() const { return m_d3dDepthStencilView.Get(); }
         D3D11_VIEWPORT             GetScreenViewport() const { return m_screenViewport; }
         ID3DUserDefinedAnnotation* GetAnnotation() const { return m_annotation.Get(); }
+        RenderBackend*             GetRenderBackend() const { return m_stateCache.get(); }
+        StateCacheRenderBackend*   GetStateCache() const { return m_stateCache.get(); }
         ID3D11SamplerState * const * GetSamplerStateWrap() const { return m_samplerStateWrap.GetAddressOf(); }
         ID3D11SamplerState *const *GetSamplerStateClamp() const { return m_samplerStateClamp.GetAddressOf(); }
 
@@ -135,6 +159,12 @@ namespace DX
         Microsoft::WRL::ComPtr<ID3D11DeviceContext>       m_d3dContext;
         Microsoft::WRL::ComPtr<IDXGISwapChain>            m_swapChain;
         Microsoft::WRL::ComPtr<ID3DUserDefinedAnnotation> m_annotation;
+        // Context calls of the renderers that can also run without a GPU
+        std::unique_ptr<RenderBackend>                    m_renderBackend;
+        // Drops redundant binds before they reach m_renderBackend
+        std::unique_ptr<StateCacheRenderBackend>          m_stateCache;
+        // Set while m_renderBackend came from SetRenderBackend
+        bool                                              m_renderBackendInjected = false;
 
         // Direct3D rendering objects. Required for 3D.
         Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_d3dRenderTargetView;
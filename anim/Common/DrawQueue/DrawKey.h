@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace DX
+{
+    // 64-bit sort key of a draw, most significant field first:
+    //
+    //     pass 4 | shader 12 | material 16 | depth 24 | unused 8
+    //
+    // Sorting the keys orders draws by pass, within a pass groups them by
+    // shader and then by material, so the fewest state changes happen, and
+    // orders each group by depth. The unused bits stay zero, which the
+    // radix sort skips over for free.
+    namespace DrawKey
+    {
+        const uint32_t PASS_BITS = 4;
+        const uint32_t SHADER_BITS = 12;
+        const uint32_t MATERIAL_BITS = 16;
+        const uint32_t DEPTH_BITS = 24;
+
+        const uint32_t DEPTH_SHIFT = 8;
+        const uint32_t MATERIAL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+        const uint32_t SHADER_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+        const uint32_t PASS_SHIFT = SHADER_SHIFT + SHADER_BITS;
+
+        // Fields past their width are cut off
+        inline uint64_t Make(uint32_t pass, uint32_t shader, uint32_t material, uint32_t depth)
+        {
+            return ((uint64_t)(pass & ((1u << PASS_BITS) - 1)) << PASS_SHIFT) |
+                ((uint64_t)(shader & ((1u << SHADER_BITS) - 1)) << SHADER_SHIFT) |
+                ((uint64_t)(material & ((1u << MATERIAL_BITS) - 1)) << MATERIAL_SHIFT) |
+                ((uint64_t)(depth & ((1u << DEPTH_BITS) - 1)) << DEPTH_SHIFT);
+        }
+
+        inline uint32_t GetPass(uint64_t key) { return (uint32_t)(key >> PASS_SHIFT) & ((1u << PASS_BITS) - 1); }
+        inline uint32_t GetShader(uint64_t key) { return (uint32_t)(key >> SHADER_SHIFT) & ((1u << SHADER_BITS) - 1); }
+        inline uint32_t GetMaterial(uint64_t key)
+        {
+            return (uint32_t)(key >> MATERIAL_SHIFT) & ((1u << MATERIAL_BITS) - 1);
+        }
+        inline uint32_t GetDepth(uint64_t key) { return (uint32_t)(key >> DEPTH_SHIFT) & ((1u << DEPTH_BITS) - 1); }
+
+        // Depth field drawing near to far. For depth >= 0 the bits of a float
+        // order like its value, the top 24 keep 15 bits of mantissa.
+        inline uint32_t FrontToBack(float depth)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &depth, sizeof(bits));
+            return depth > 0 ? bits >> (32 - DEPTH_BITS) : 0;
+        }
+
+        // Depth field drawing far to near, for blending
+        inline uint32_t BackToFront(float depth)
+        {
+            return ((1u << DEPTH_BITS) - 1) - FrontToBack(depth);
+        }
+    }
+}
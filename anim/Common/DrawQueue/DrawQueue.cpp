@@ -0,0 +1,157 @@
+#include "pch.h"
+
+#include <stdexcept>
+
+#include "DrawQueue.h"
+
+using namespace DX;
+
+DrawQueue::DrawQueue(ThreadPool &pool) :
+    m_sorter(pool)
+{
+}
+
+void DrawQueue::SetPass(uint32_t pass, const PassCallback &begin)
+{
+    if (pass >= MAX_PASSES)
+        throw std::invalid_argument("DrawQueue: pass out of range");
+    if (m_passes.size() <= pass)
+        m_passes.resize(pass + 1);
+    m_passes[pass] = begin;
+}
+
+uint32_t DrawQueue::AddShader(const DrawShader &shader)
+{
+    if (m_shaders.size() >= MAX_SHADERS)
+        throw std::length_error("DrawQueue: too many shaders");
+    m_shaders.push_back(shader);
+    return (uint32_t)m_shaders.size() - 1;
+}
+
+uint32_t DrawQueue::AddMaterial(const DrawMaterial &material)
+{
+    if (m_materials.size() >= MAX_MATERIALS)
+        throw std::length_error("DrawQueue: too many materials");
+    if (material.viewCount > DrawMaterial::MAX_VIEWS)
+        throw std::invalid_argument("DrawQueue: too many material views");
+    m_materials.push_back(material);
+    return (uint32_t)m_materials.size() - 1;
+}
+
+uint32_t DrawQueue::AddGeometry(const DrawGeometry &geometry)
+{
+    if (geometry.streamCount > DrawGeometry::MAX_STREAMS)
+        throw std::invalid_argument("DrawQueue: too many vertex streams");
+    m_geometries.push_back(geometry);
+    return (uint32_t)m_geometries.size() - 1;
+}
+
+void DrawQueue::Add(uint64_t key, uint32_t geometry, const DrawArguments &arguments)
+{
+    Add(key, geometry, arguments, 0, { nullptr, 0, 0 });
+}
+
+void DrawQueue::Add(uint64_t key, uint32_t geometry, const DrawArguments &arguments,
+    uint32_t slot, const ConstantAllocation &constants)
+{
+    if (geometry >= m_geometries.size())
+        throw std::invalid_argument("DrawQueue: unknown geometry");
+
+    Packet packet;
+    packet.geometry = geometry;
+    packet.arguments = arguments;
+    packet.constantSlot = slot;
+    packet.constants = constants;
+
+    m_keys.push_back(key);
+    m_order.push_back((uint32_t)m_packets.size());
+    m_packets.push_back(packet);
+}
+
+void DrawQueue::Submit(RenderBackend &backend)
+{
+    m_statistics = DrawQueueStatistics();
+    m_sorter.Sort(m_keys, m_order);
+    m_statistics.sortPasses = m_sorter.GetPassCount();
+
+    uint32_t pass = NONE, shader = NONE, material = NONE, geometry = NONE;
+    for (size_t i = 0; i < m_keys.size(); i++)
+    {
+        uint64_t key = m_keys[i];
+        const Packet &packet = m_packets[m_order[i]];
+
+        if (DrawKey::GetPass(key) != pass)
+        {
+            pass = DrawKey::GetPass(key);
+            if (pass < m_passes.size() && m_passes[pass])
+                m_passes[pass](backend);
+            // The callback may have bound anything
+            shader = material = geometry = NONE;
+            m_statistics.passChanges++;
+        }
+
+        if (DrawKey::GetShader(key) != shader)
+        {
+            shader = DrawKey::GetShader(key);
+            const DrawShader &state = m_shaders.at(shader);
+            backend.IASetInputLayout(state.inputLayout);
+            backend.VSSetShader(state.vertexShader);
+            backend.PSSetShader(state.pixelShader);
+            m_statistics.shaderChanges++;
+        }
+
+        if (DrawKey::GetMaterial(key) != material)
+        {
+            material = DrawKey::GetMaterial(key);
+            const DrawMaterial &state = m_materials.at(material);
+            if (state.viewCount > 0)
+                backend.PSSetShaderResources(0, state.viewCount, state.views);
+            if (state.sampler)
+                backend.PSSetSamplers(0, 1, &state.sampler);
+            m_statistics.materialChanges++;
+        }
+
+        if (packet.geometry != geometry)
+        {
+            geometry = packet.geometry;
+            const DrawGeometry &state = m_geometries[geometry];
+            backend.IASetVertexBuffers(0, state.streamCount, state.vertexBuffers, state.strides, state.offsets);
+            backend.IASetIndexBuffer(state.indexBuffer, state.indexFormat, 0);
+            backend.IASetPrimitiveTopology(state.topology);
+            m_statistics.geometryChanges++;
+        }
+
+        if (packet.constants.byteSize > 0)
+        {
+            backend.VSSetConstantBufferRange(packet.constantSlot, packet.constants.buffer,
+                packet.constants.GetFirstConstant(), packet.constants.GetConstantCount());
+            m_statistics.constantBinds++;
+        }
+
+        const DrawArguments &arguments = packet.arguments;
+        if (arguments.instanceCount == 0)
+            backend.DrawIndexed(arguments.indexCount, arguments.startIndex, arguments.baseVertex);
+        else
+            backend.DrawIndexedInstanced(arguments.indexCount, arguments.instanceCount, arguments.startIndex,
+                arguments.baseVertex, arguments.startInstance);
+        m_statistics.draws++;
+    }
+
+    Clear();
+}
+
+void DrawQueue::Clear()
+{
+    m_packets.clear();
+    m_keys.clear();
+    m_order.clear();
+}
+
+void DrawQueue::Reset()
+{
+    Clear();
+    m_passes.clear();
+    m_shaders.clear();
+    m_materials.clear();
+    m_geometries.clear();
+}
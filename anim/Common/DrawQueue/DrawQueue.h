@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "..\Backend\RenderBackend.h"
+#include "..\ConstantRing\ConstantRingAllocator.h"
+#include "..\ThreadPool.h"
+#include "DrawKey.h"
+#include "RadixSort.h"
+
+namespace DX
+{
+    // State selected by the shader field of a DrawKey
+    struct DrawShader
+    {
+        ID3D11InputLayout *inputLayout;
+        ID3D11VertexShader *vertexShader;
+        ID3D11PixelShader *pixelShader;
+    };
+
+    // State selected by the material field: pixel shader resources from t0
+    // and a sampler at s0
+    struct DrawMaterial
+    {
+        static const uint32_t MAX_VIEWS = 4;
+
+        ID3D11ShaderResourceView *views[MAX_VIEWS];
+        uint32_t viewCount;
+        ID3D11SamplerState *sampler;
+    };
+
+    // Input assembler state of a draw, vertex streams from slot 0
+    struct DrawGeometry
+    {
+        static const uint32_t MAX_STREAMS = 2;
+
+        ID3D11Buffer *vertexBuffers[MAX_STREAMS];
+        uint32_t strides[MAX_STREAMS];
+        uint32_t offsets[MAX_STREAMS];
+        uint32_t streamCount;
+        ID3D11Buffer *indexBuffer;
+        // DXGI_FORMAT and D3D11_PRIMITIVE_TOPOLOGY
+        uint32_t indexFormat;
+        uint32_t topology;
+    };
+
+    // DrawIndexedInstanced arguments, DrawIndexed for an instance count of 0
+    struct DrawArguments
+    {
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t startIndex;
+        int32_t baseVertex;
+        uint32_t startInstance;
+    };
+
+    struct DrawQueueStatistics
+    {
+        uint32_t draws = 0;
+        uint32_t passChanges = 0;
+        uint32_t shaderChanges = 0;
+        uint32_t materialChanges = 0;
+        uint32_t geometryChanges = 0;
+        uint32_t constantBinds = 0;
+        // Radix sort passes, at most eight
+        uint32_t sortPasses = 0;
+    };
+
+    // Draw packets submitted in DrawKey order instead of the order they were
+    // added in. Shaders, materials and geometry are registered once into
+    // tables; a packet is its key, a geometry, the draw arguments and
+    // optionally a slice of constants for one vertex shader slot.
+    //
+    // Submit radix sorts the keys and walks the packets, binding a pass,
+    // shader, material or geometry only where it differs from the packet
+    // before. A pass starts with its callback, which binds render targets and
+    // whatever else the pass shares, and forgets the state bound so far.
+    class DrawQueue
+    {
+    public:
+        static const uint32_t MAX_PASSES = 1u << DrawKey::PASS_BITS;
+        static const uint32_t MAX_SHADERS = 1u << DrawKey::SHADER_BITS;
+        static const uint32_t MAX_MATERIALS = 1u << DrawKey::MATERIAL_BITS;
+
+        typedef std::function<void(RenderBackend &)> PassCallback;
+
+        explicit DrawQueue(ThreadPool &pool = ThreadPool::Default());
+
+        // Throws std::invalid_argument for a pass of MAX_PASSES or more
+        void SetPass(uint32_t pass, const PassCallback &begin);
+        // Ids for the keys and Add, std::length_error when a table is full
+        uint32_t AddShader(const DrawShader &shader);
+        uint32_t AddMaterial(const DrawMaterial &material);
+        uint32_t AddGeometry(const DrawGeometry &geometry);
+
+        void Add(uint64_t key, uint32_t geometry, const DrawArguments &arguments);
+        // The constants are bound to vertex shader slot right before the
+        // draw. They stay in the ring until Submit, so the queue has to be
+        // submitted before the ring's EndFrame.
+        void Add(uint64_t key, uint32_t geometry, const DrawArguments &arguments,
+            uint32_t slot, const ConstantAllocation &constants);
+
+        uint32_t GetPacketCount() const { return (uint32_t)m_packets.size(); }
+
+        // Sort and draw every packet, then drop them
+        void Submit(RenderBackend &backend);
+        // Drop the packets, the tables stay
+        void Clear();
+        // Drop packets, tables and passes
+        void Reset();
+
+        const DrawQueueStatistics &GetStatistics() const { return m_statistics; }
+
+    private:
+        static const uint32_t NONE = 0xffffffff;
+
+        struct Packet
+        {
+            uint32_t geometry;
+            DrawArguments arguments;
+            uint32_t constantSlot;
+            // No constants for a byte size of 0
+            ConstantAllocation constants;
+        };
+
+        RadixSorter m_sorter;
+        std::vector<PassCallback> m_passes;
+        std::vector<DrawShader> m_shaders;
+        std::vector<DrawMaterial> m_materials;
+        std::vector<DrawGeometry> m_geometries;
+
+        std::vector<Packet> m_packets;
+        // Sort input, key and packet index of every packet
+        std::vector<uint64_t> m_keys;
+        std::vector<uint32_t> m_order;
+
+        DrawQueueStatistics m_statistics;
+    };
+}
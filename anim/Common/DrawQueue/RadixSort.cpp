@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "RadixSort.h"
+
+using namespace DX;
+
+RadixSorter::RadixSorter(ThreadPool &pool) :
+    m_pool(pool)
+{
+}
+
+void RadixSorter::Sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values)
+{
+    if (keys.size() != values.size())
+        throw std::invalid_argument("RadixSorter: keys and values differ in size");
+
+    m_passCount = 0;
+    size_t count = keys.size();
+    if (count < 2)
+        return;
+
+    size_t chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    auto chunkCounts = [&](size_t chunk, uint32_t digit)
+    {
+        return &m_counts[(chunk * DIGITS + digit) * RADIX];
+    };
+
+    // Every byte of every key at once, for the skip test and the first pass
+    m_counts.assign(chunkCount * DIGITS * RADIX, 0);
+    m_pool.ParallelFor(chunkCount, [&](size_t chunk, unsigned)
+    {
+        uint32_t *counts = chunkCounts(chunk, 0);
+        size_t last = (std::min)((chunk + 1) * CHUNK_SIZE, count);
+        for (size_t i = chunk * CHUNK_SIZE; i < last; i++)
+        {
+            uint64_t key = keys[i];
+            for (uint32_t digit = 0; digit < DIGITS; digit++)
+                counts[digit * RADIX + ((key >> (digit * 8)) & (RADIX - 1))]++;
+        }
+    });
+
+    m_keys.resize(count);
+    m_values.resize(count);
+    std::vector<uint64_t> *sourceKeys = &keys, *targetKeys = &m_keys;
+    std::vector<uint32_t> *sourceValues = &values, *targetValues = &m_values;
+    std::vector<uint32_t> offsets(chunkCount * RADIX);
+
+    for (uint32_t digit = 0; digit < DIGITS; digit++)
+    {
+        // A byte shared by all keys lands everything in one bucket
+        size_t firstBucket = 0;
+        for (size_t chunk = 0; chunk < chunkCount; chunk++)
+            firstBucket += chunkCounts(chunk, digit)[(keys[0] >> (digit * 8)) & (RADIX - 1)];
+        if (firstBucket == count)
+            continue;
+
+        if (m_passCount > 0)
+        {
+            // Earlier passes moved the keys between chunks
+            const std::vector<uint64_t> &source = *sourceKeys;
+            m_pool.ParallelFor(chunkCount, [&](size_t chunk, unsigned)
+            {
+                uint32_t *counts = chunkCounts(chunk, digit);
+                std::fill(counts, counts + RADIX, 0);
+                size_t last = (std::min)((chunk + 1) * CHUNK_SIZE, count);
+                for (size_t i = chunk * CHUNK_SIZE; i < last; i++)
+                    counts[(source[i] >> (digit * 8)) & (RADIX - 1)]++;
+            });
+        }
+
+        // Bucket by bucket, and chunk by chunk within one
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < RADIX; bucket++)
+            for (size_t chunk = 0; chunk < chunkCount; chunk++)
+            {
+                offsets[chunk * RADIX + bucket] = offset;
+                offset += chunkCounts(chunk, digit)[bucket];
+            }
+
+        const std::vector<uint64_t> &sourceKey = *sourceKeys;
+        const std::vector<uint32_t> &sourceValue = *sourceValues;
+        std::vector<uint64_t> &targetKey = *targetKeys;
+        std::vector<uint32_t> &targetValue = *targetValues;
+        m_pool.ParallelFor(chunkCount, [&](size_t chunk, unsigned)
+        {
+            uint32_t *next = &offsets[chunk * RADIX];
+            size_t last = (std::min)((chunk + 1) * CHUNK_SIZE, count);
+            for (size_t i = chunk * CHUNK_SIZE; i < last; i++)
+            {
+                uint32_t target = next[(sourceKey[i] >> (digit * 8)) & (RADIX - 1)]++;
+                targetKey[target] = sourceKey[i];
+                targetValue[target] = sourceValue[i];
+            }
+        });
+
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourceValues, targetValues);
+        m_passCount++;
+    }
+
+    // After an odd number of passes the result is in the scratch storage
+    if (sourceKeys != &keys)
+    {
+        keys.swap(m_keys);
+        values.swap(m_values);
+    }
+}
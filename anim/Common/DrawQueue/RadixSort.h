@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "..\ThreadPool.h"
+
+namespace DX
+{
+    // Stable least significant digit radix sort of 64-bit keys carrying a
+    // 32-bit value each, one byte per pass.
+    //
+    // One read over the keys counts all eight bytes per chunk. Bytes that
+    // are the same in every key leave the order as it is and are skipped.
+    // Every other byte is a pass: the chunks count it in parallel, a prefix
+    // sum over byte value, then chunk, gives every chunk its own place in
+    // each bucket, and the chunks scatter in parallel. Stability makes the
+    // result independent of the thread count.
+    class RadixSorter
+    {
+    public:
+        // Keys per thread pool task
+        static const size_t CHUNK_SIZE = 65536;
+
+        explicit RadixSorter(ThreadPool &pool = ThreadPool::Default());
+
+        // Sort keys ascending, values moved along. The vectors may come
+        // back with the sorter's scratch storage swapped in, same sizes.
+        // Throws std::invalid_argument if the sizes differ.
+        void Sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values);
+
+        // Passes run by the last Sort, at most eight
+        uint32_t GetPassCount() const { return m_passCount; }
+
+    private:
+        static const uint32_t RADIX = 256;
+        static const uint32_t DIGITS = 8;
+
+        ThreadPool &m_pool;
+        std::vector<uint64_t> m_keys;
+        std::vector<uint32_t> m_values;
+        // Per chunk, per digit and byte value
+        std::vector<uint32_t> m_counts;
+        uint32_t m_passCount = 0;
+    };
+}
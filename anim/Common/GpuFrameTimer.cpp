@@ -0,0 +1,91 @@
+#include "pch.h"
+
+#include "GpuFrameTimer.h"
+
+using namespace DX;
+
+GpuFrameTimer::GpuFrameTimer(const std::shared_ptr<DeviceResources> &deviceResources, size_t depth) :
+    m_deviceResources(deviceResources),
+    m_slots(depth)
+{
+    auto device = m_deviceResources->GetD3DDevice();
+
+    CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+    CD3D11_QUERY_DESC timestampDesc(D3D11_QUERY_TIMESTAMP);
+    for (size_t i = 0; i < m_slots.size(); i++)
+    {
+        Slot &slot = m_slots[i];
+        DX::ThrowIfFailed(device->CreateQuery(&disjointDesc, &slot.disjoint));
+        DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, &slot.begin));
+        DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, &slot.end));
+        DX::SetName(slot.disjoint, "FrameTimerDisjoint" + std::to_string(i));
+        DX::SetName(slot.begin, "FrameTimerBegin" + std::to_string(i));
+        DX::SetName(slot.end, "FrameTimerEnd" + std::to_string(i));
+    }
+}
+
+void GpuFrameTimer::BeginFrame(float renderScale)
+{
+    Slot &slot = m_slots[m_head];
+    m_skipFrame = slot.inFlight;
+    if (m_skipFrame)
+        return;
+
+    slot.renderScale = renderScale;
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    context->Begin(slot.disjoint.Get());
+    context->End(slot.begin.Get());
+}
+
+void GpuFrameTimer::EndFrame()
+{
+    if (m_skipFrame)
+        return;
+
+    Slot &slot = m_slots[m_head];
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    context->End(slot.end.Get());
+    context->End(slot.disjoint.Get());
+
+    slot.inFlight = true;
+    slot.order = m_nextOrder++;
+    m_head = (m_head + 1) % m_slots.size();
+}
+
+bool GpuFrameTimer::Poll(float renderScale)
+{
+    auto context = m_deviceResources->GetD3DDeviceContext();
+
+    // Queries finish in submission order, walk from the oldest one
+    bool updated = false;
+    for (size_t i = 0; i < m_slots.size(); i++)
+    {
+        Slot &slot = m_slots[(m_head + i) % m_slots.size()];
+        if (!slot.inFlight)
+            continue;
+
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+        UINT64 begin, end;
+        if (context->GetData(slot.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+            context->GetData(slot.begin.Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+            context->GetData(slot.end.Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            break;
+
+        slot.inFlight = false;
+        // A frame drawn at another scale says nothing about the current one
+        if (slot.renderScale != renderScale)
+        {
+            m_staleCount++;
+            continue;
+        }
+        // Timestamps are meaningless if the GPU clock changed in between
+        if (disjoint.Disjoint || disjoint.Frequency == 0)
+            continue;
+
+        m_frameTime = (float)((double)(end - begin) / disjoint.Frequency);
+        m_hasValue = true;
+        updated = true;
+    }
+
+    return updated;
+}
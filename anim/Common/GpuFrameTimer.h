@@ -0,0 +1,53 @@
+#pragma once
+
+#include "DeviceResources.h"
+
+namespace DX
+{
+    // Measures GPU time between BeginFrame and EndFrame with timestamp
+    // queries. Results are polled without flushing or waiting, so the
+    // latest frame time is a few frames old. Each measurement is tagged with
+    // the render scale of its frame and only kept if the scale still matches
+    // when it arrives.
+    class GpuFrameTimer
+    {
+    public:
+        GpuFrameTimer(const std::shared_ptr<DeviceResources> &deviceResources, size_t depth = 4);
+
+        void BeginFrame(float renderScale);
+        void EndFrame();
+
+        // Collect finished measurements, dropping those taken at another
+        // render scale. Returns true if a newer frame time arrived.
+        bool Poll(float renderScale);
+
+        bool HasValue() const { return m_hasValue; }
+        // GPU time of the latest measured frame, in seconds
+        float GetFrameTime() const { return m_frameTime; }
+        // Measurements dropped because the render scale changed meanwhile
+        uint64_t GetStaleCount() const { return m_staleCount; }
+
+    private:
+        struct Slot
+        {
+            Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+            Microsoft::WRL::ComPtr<ID3D11Query> begin;
+            Microsoft::WRL::ComPtr<ID3D11Query> end;
+            uint64_t order = 0;
+            float renderScale = 0;
+            bool inFlight = false;
+        };
+
+        std::shared_ptr<DeviceResources> m_deviceResources;
+
+        std::vector<Slot> m_slots;
+        size_t m_head = 0;
+        uint64_t m_nextOrder = 0;
+        // Set when the current frame found every slot in flight and is not measured
+        bool m_skipFrame = false;
+
+        float m_frameTime = 0;
+        bool m_hasValue = false;
+        uint64_t m_staleCount = 0;
+    };
+}
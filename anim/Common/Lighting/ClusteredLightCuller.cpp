@@ -0,0 +1,225 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "ClusteredLightCuller.h"
+
+using namespace DX;
+using namespace DirectX;
+
+ClusteredLightCuller::ClusteredLightCuller(ThreadPool &pool) :
+    m_pool(pool)
+{
+    SetGrid(ClusterGridDesc());
+}
+
+void ClusteredLightCuller::SetGrid(const ClusterGridDesc &grid)
+{
+    if (grid.tilesX == 0 || grid.tilesY == 0 || grid.slices == 0)
+        throw std::invalid_argument("ClusteredLightCuller: empty grid");
+    if (!(grid.nearZ > 0 && grid.farZ > grid.nearZ && grid.fovY > 0 && grid.aspectRatio > 0))
+        throw std::invalid_argument("ClusteredLightCuller: bad projection");
+
+    m_grid = grid;
+    m_tanHalfY = std::tan(grid.fovY / 2);
+    m_tanHalfX = m_tanHalfY * grid.aspectRatio;
+    // slice = log(depth / near) / log(far / near) * slices
+    m_sliceScale = grid.slices / std::log(grid.farZ / grid.nearZ);
+    m_sliceBias = -std::log(grid.nearZ) * m_sliceScale;
+
+    m_sliceDepths.resize(grid.slices + 1);
+    for (uint32_t k = 0; k <= grid.slices; k++)
+        m_sliceDepths[k] = grid.nearZ * std::pow(grid.farZ / grid.nearZ, (float)k / grid.slices);
+    m_slices.resize(grid.slices);
+}
+
+uint32_t ClusteredLightCuller::sliceOf(float depth) const
+{
+    // Against the boundaries the cluster boxes are built from rather than
+    // the logarithm, so a depth always falls into a box that contains it
+    auto inner = m_sliceDepths.begin() + 1;
+    return (uint32_t)(std::upper_bound(inner, m_sliceDepths.end() - 1, depth) - inner);
+}
+
+bool ClusteredLightCuller::FindCluster(float x, float y, float z, uint32_t &cluster) const
+{
+    float depth = -z;
+    if (depth < m_grid.nearZ || depth > m_grid.farZ)
+        return false;
+    float ndcX = x / (depth * m_tanHalfX);
+    float ndcY = y / (depth * m_tanHalfY);
+    if (std::fabs(ndcX) > 1 || std::fabs(ndcY) > 1)
+        return false;
+
+    uint32_t tileX = (std::min)((uint32_t)((ndcX + 1) / 2 * m_grid.tilesX), m_grid.tilesX - 1);
+    uint32_t tileY = (std::min)((uint32_t)((1 - ndcY) / 2 * m_grid.tilesY), m_grid.tilesY - 1);
+    cluster = GetClusterIndex(tileX, tileY, sliceOf(depth));
+    return true;
+}
+
+void ClusteredLightCuller::boundLight(const BoundingSphereSet &lights, size_t i, const XMFLOAT4X4 &view,
+    LightBounds &bounds) const
+{
+    float x = lights.GetX()[i], y = lights.GetY()[i], z = lights.GetZ()[i];
+    bounds.x = x * view._11 + y * view._21 + z * view._31 + view._41;
+    bounds.y = x * view._12 + y * view._22 + z * view._32 + view._42;
+    bounds.z = x * view._13 + y * view._23 + z * view._33 + view._43;
+    bounds.radius = lights.GetRadius()[i];
+    bounds.firstSlice = 1;
+    bounds.lastSlice = 0;
+    // A light cut off everywhere, e.g. one turned down to zero
+    if (!(bounds.radius > 0))
+        return;
+
+    // Depth range inside the grid, the camera looks down -z
+    float depth = -bounds.z;
+    float minDepth = (std::max)(depth - bounds.radius, m_grid.nearZ);
+    float maxDepth = (std::min)(depth + bounds.radius, m_grid.farZ);
+    if (minDepth > maxDepth)
+        return;
+
+    // Normalized device extent of the light's box over that range: each side
+    // is furthest out at the depth that divides it the least
+    auto extent = [&](float centre, float tanHalf, float &low, float &high)
+    {
+        float lowSide = centre - bounds.radius, highSide = centre + bounds.radius;
+        low = lowSide / ((lowSide >= 0 ? maxDepth : minDepth) * tanHalf);
+        high = highSide / ((highSide >= 0 ? minDepth : maxDepth) * tanHalf);
+    };
+    float lowX, highX, lowY, highY;
+    extent(bounds.x, m_tanHalfX, lowX, highX);
+    extent(bounds.y, m_tanHalfY, lowY, highY);
+    if (highX < -1 || lowX > 1 || highY < -1 || lowY > 1)
+        return;
+
+    auto tile = [](float position, uint32_t count)
+    {
+        return (uint32_t)(std::min)((std::max)(position * count, 0.0f), (float)(count - 1));
+    };
+    bounds.firstTileX = tile((lowX + 1) / 2, m_grid.tilesX);
+    bounds.lastTileX = tile((highX + 1) / 2, m_grid.tilesX);
+    // Tile rows count from the top of the screen
+    bounds.firstTileY = tile((1 - highY) / 2, m_grid.tilesY);
+    bounds.lastTileY = tile((1 - lowY) / 2, m_grid.tilesY);
+    bounds.firstSlice = sliceOf(minDepth);
+    bounds.lastSlice = sliceOf(maxDepth);
+}
+
+void ClusteredLightCuller::Build(const BoundingSphereSet &lights, FXMMATRIX view)
+{
+    XMFLOAT4X4 view4x4;
+    XMStoreFloat4x4(&view4x4, view);
+
+    size_t lightCount = lights.GetCount();
+    m_bounds.resize(lightCount);
+    m_pool.ParallelFor((lightCount + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](size_t chunk, unsigned)
+    {
+        size_t last = (std::min)((chunk + 1) * CHUNK_SIZE, lightCount);
+        for (size_t i = chunk * CHUNK_SIZE; i < last; i++)
+            boundLight(lights, i, view4x4, m_bounds[i]);
+    });
+
+    // Hand every slice the lights reaching it, in light order
+    for (SliceBins &slice : m_slices)
+        slice.lights.clear();
+    for (size_t i = 0; i < lightCount; i++)
+        for (uint32_t k = m_bounds[i].firstSlice; k <= m_bounds[i].lastSlice; k++)
+            m_slices[k].lights.push_back((uint32_t)i);
+
+    m_pool.ParallelFor(m_grid.slices, [&](size_t slice, unsigned)
+    {
+        binSlice((uint32_t)slice);
+    });
+
+    // Join the slices' lists, slices are contiguous in cluster order
+    uint32_t tilesPerSlice = m_grid.tilesX * m_grid.tilesY;
+    std::vector<uint32_t> sliceOffsets(m_grid.slices + 1, 0);
+    for (uint32_t k = 0; k < m_grid.slices; k++)
+        sliceOffsets[k + 1] = sliceOffsets[k] + (uint32_t)m_slices[k].indices.size();
+    m_ranges.resize(GetClusterCount());
+    m_lightIndices.resize(sliceOffsets.back());
+    m_pool.ParallelFor(m_grid.slices, [&](size_t k, unsigned)
+    {
+        const SliceBins &slice = m_slices[k];
+        std::copy(slice.indices.begin(), slice.indices.end(), m_lightIndices.begin() + sliceOffsets[k]);
+        uint32_t offset = sliceOffsets[k];
+        for (uint32_t tile = 0; tile < tilesPerSlice; tile++)
+        {
+            m_ranges[k * tilesPerSlice + tile] = { offset, slice.tileCounts[tile] };
+            offset += slice.tileCounts[tile];
+        }
+    });
+}
+
+void ClusteredLightCuller::binSlice(uint32_t slice)
+{
+    SliceBins &bins = m_slices[slice];
+    uint32_t tilesPerSlice = m_grid.tilesX * m_grid.tilesY;
+    float nearDepth = m_sliceDepths[slice];
+    float farDepth = m_sliceDepths[slice + 1];
+
+    // Sphere against the view space box of every cluster in the light's range
+    bins.pairs.clear();
+    for (uint32_t light : bins.lights)
+    {
+        const LightBounds &bounds = m_bounds[light];
+        float radiusSquared = bounds.radius * bounds.radius;
+        float dz = (std::max)((std::max)(-farDepth - bounds.z, bounds.z + nearDepth), 0.0f);
+
+        for (uint32_t ty = bounds.firstTileY; ty <= bounds.lastTileY; ty++)
+        {
+            float top = 1 - 2.0f * ty / m_grid.tilesY;
+            float bottom = 1 - 2.0f * (ty + 1) / m_grid.tilesY;
+            float minY = (std::min)(bottom * nearDepth, bottom * farDepth) * m_tanHalfY;
+            float maxY = (std::max)(top * nearDepth, top * farDepth) * m_tanHalfY;
+            float dy = (std::max)((std::max)(minY - bounds.y, bounds.y - maxY), 0.0f);
+            if (dy * dy + dz * dz > radiusSquared)
+                continue;
+
+            for (uint32_t tx = bounds.firstTileX; tx <= bounds.lastTileX; tx++)
+            {
+                float left = -1 + 2.0f * tx / m_grid.tilesX;
+                float right = -1 + 2.0f * (tx + 1) / m_grid.tilesX;
+                float minX = (std::min)(left * nearDepth, left * farDepth) * m_tanHalfX;
+                float maxX = (std::max)(right * nearDepth, right * farDepth) * m_tanHalfX;
+                float dx = (std::max)((std::max)(minX - bounds.x, bounds.x - maxX), 0.0f);
+                if (dx * dx + dy * dy + dz * dz > radiusSquared)
+                    continue;
+
+                bins.pairs.push_back(ty * m_grid.tilesX + tx);
+                bins.pairs.push_back(light);
+            }
+        }
+    }
+
+    // Counting sort by tile, stable so every list stays in light order
+    bins.tileCounts.assign(tilesPerSlice, 0);
+    for (size_t p = 0; p < bins.pairs.size(); p += 2)
+        bins.tileCounts[bins.pairs[p]]++;
+    std::vector<uint32_t> next(tilesPerSlice);
+    uint32_t offset = 0;
+    for (uint32_t tile = 0; tile < tilesPerSlice; tile++)
+    {
+        next[tile] = offset;
+        offset += bins.tileCounts[tile];
+    }
+    bins.indices.resize(offset);
+    for (size_t p = 0; p < bins.pairs.size(); p += 2)
+        bins.indices[next[bins.pairs[p]]++] = bins.pairs[p + 1];
+}
+
+ClusterShaderConstants ClusteredLightCuller::GetShaderConstants(float viewportWidth, float viewportHeight) const
+{
+    ClusterShaderConstants constants;
+    constants.tilesX = m_grid.tilesX;
+    constants.tilesY = m_grid.tilesY;
+    constants.slices = m_grid.slices;
+    constants.padding = 0;
+    constants.tileScaleX = m_grid.tilesX / viewportWidth;
+    constants.tileScaleY = m_grid.tilesY / viewportHeight;
+    constants.sliceScale = m_sliceScale;
+    constants.sliceBias = m_sliceBias;
+    return constants;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "..\Culling\FrustumCuller.h"
+#include "..\ThreadPool.h"
+
+namespace DX
+{
+    // Froxel grid of a perspective camera: screen tiles by depth slices
+    // spaced exponentially between the near and far plane
+    struct ClusterGridDesc
+    {
+        uint32_t tilesX = 16;
+        uint32_t tilesY = 9;
+        uint32_t slices = 24;
+        // As for XMMatrixPerspectiveFovRH
+        float fovY = 1.0f;
+        float aspectRatio = 16.0f / 9.0f;
+        float nearZ = 0.1f;
+        float farZ = 100.0f;
+    };
+
+    // Layout of ClusterConstantBuffer in ClusteredLighting.cginc
+    struct ClusterShaderConstants
+    {
+        uint32_t tilesX;
+        uint32_t tilesY;
+        uint32_t slices;
+        uint32_t padding;
+        // Pixel position to tile
+        float tileScaleX;
+        float tileScaleY;
+        // log(view depth) to slice
+        float sliceScale;
+        float sliceBias;
+    };
+
+    // Bins light spheres into the clusters of a ClusterGridDesc, for
+    // clustered forward shading: a pixel finds its cluster from its tile
+    // and depth and only loops over that cluster's lights.
+    //
+    // Lights are first bounded by a range of slices and tiles, in parallel
+    // chunks. Every slice then tests its lights against the view space box
+    // of each cluster in their range, slices in parallel, and sorts the hits
+    // by cluster. The per-cluster lists end up back to back in one index
+    // array, each in ascending light order, whatever the thread count.
+    class ClusteredLightCuller
+    {
+    public:
+        // Lights per thread pool task when bounding
+        static const size_t CHUNK_SIZE = 1024;
+
+        // Where a cluster's lights are in GetLightIndices
+        struct ClusterRange
+        {
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        explicit ClusteredLightCuller(ThreadPool &pool = ThreadPool::Default());
+
+        // Throws std::invalid_argument for an empty grid or bad planes
+        void SetGrid(const ClusterGridDesc &grid);
+        const ClusterGridDesc &GetGrid() const { return m_grid; }
+        uint32_t GetClusterCount() const { return m_grid.tilesX * m_grid.tilesY * m_grid.slices; }
+        uint32_t GetClusterIndex(uint32_t tileX, uint32_t tileY, uint32_t slice) const
+        {
+            return (slice * m_grid.tilesY + tileY) * m_grid.tilesX + tileX;
+        }
+        // Cluster of a view space position, false outside the grid
+        bool FindCluster(float x, float y, float z, uint32_t &cluster) const;
+
+        // Lights are spheres in world space
+        void Build(const BoundingSphereSet &lights, DirectX::FXMMATRIX view);
+
+        const std::vector<ClusterRange> &GetRanges() const { return m_ranges; }
+        const std::vector<uint32_t> &GetLightIndices() const { return m_lightIndices; }
+
+        ClusterShaderConstants GetShaderConstants(float viewportWidth, float viewportHeight) const;
+
+    private:
+        // A light in view space and the clusters its box may touch,
+        // firstSlice > lastSlice when it misses the grid
+        struct LightBounds
+        {
+            float x, y, z, radius;
+            uint32_t firstSlice, lastSlice;
+            uint32_t firstTileX, lastTileX;
+            uint32_t firstTileY, lastTileY;
+        };
+
+        // Hits of one slice, as (tile, light) pairs and then sorted by tile
+        struct SliceBins
+        {
+            std::vector<uint32_t> lights;
+            std::vector<uint32_t> pairs;
+            std::vector<uint32_t> tileCounts;
+            std::vector<uint32_t> indices;
+        };
+
+        void boundLight(const BoundingSphereSet &lights, size_t i, const DirectX::XMFLOAT4X4 &view,
+            LightBounds &bounds) const;
+        void binSlice(uint32_t slice);
+        uint32_t sliceOf(float depth) const;
+
+        ThreadPool &m_pool;
+        ClusterGridDesc m_grid;
+        float m_tanHalfX;
+        float m_tanHalfY;
+        float m_sliceScale;
+        float m_sliceBias;
+        // Depth of every slice boundary, slices + 1 of them
+        std::vector<float> m_sliceDepths;
+
+        std::vector<LightBounds> m_bounds;
+        std::vector<SliceBins> m_slices;
+        std::vector<ClusterRange> m_ranges;
+        std::vector<uint32_t> m_lightIndices;
+    };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cmath>
+
+// Point light falloff shared by the CPU side and ClusteredLighting.cginc.
+// The shaders' 1 / (1 + 0.3 d^2) never reaches zero, so it is multiplied by
+// a window that does at the light's radius, (1 - (d / r)^4)^2 as in Karis,
+// "Real Shading in Unreal Engine 4". Inside a radius well past where the
+// light fades the window leaves the curve nearly unchanged.
+namespace DX
+{
+    inline float WindowedAttenuation(float distanceSquared, float radius)
+    {
+        float ratio = distanceSquared / (radius * radius);
+        float window = 1.0f - ratio * ratio;
+        window = window > 0.0f ? window * window : 0.0f;
+        return window / (1.0f + 0.30f * distanceSquared);
+    }
+
+    // Radius past which a light of the given intensity adds less than
+    // threshold without the window
+    inline float LightRadius(float intensity, float threshold)
+    {
+        float ratio = intensity / threshold;
+        return ratio > 1.0f ? std::sqrt((ratio - 1.0f) / 0.30f) : 0.0f;
+    }
+}
@@ -0,0 +1,222 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+
+#include "LightManager.h"
+#include "LightAttenuation.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    // First element from index on whose bit is set, or clear, or count
+    uint32_t findBit(const std::vector<uint64_t> &bits, uint32_t index, uint32_t count, bool set)
+    {
+        while (index < count)
+        {
+            uint64_t word = set ? bits[index / 64] : ~bits[index / 64];
+            word >>= index % 64;
+            if (word == 0)
+            {
+                // Nothing in the rest of this word
+                index = (index / 64 + 1) * 64;
+                continue;
+            }
+            while (!(word & 1))
+            {
+                word >>= 1;
+                index++;
+            }
+            return index < count ? index : count;
+        }
+        return count;
+    }
+}
+
+LightManager::LightManager(uint32_t capacity, float threshold) :
+    m_threshold(threshold),
+    m_slots(capacity),
+    m_dirty((capacity + 63) / 64, 0),
+    m_staging(capacity)
+{
+    if (!(threshold > 0))
+        throw std::invalid_argument("LightManager: threshold must be positive");
+
+    for (std::vector<float> *values : { &m_x, &m_y, &m_z, &m_red, &m_green, &m_blue, &m_intensity, &m_radius })
+        values->reserve(capacity);
+    m_slotOf.reserve(capacity);
+    // Hand out low slots first
+    m_freeSlots.reserve(capacity);
+    for (uint32_t slot = capacity; slot > 0; slot--)
+    {
+        m_slots[slot - 1] = { LightHandle::INVALID_SLOT, 0 };
+        m_freeSlots.push_back(slot - 1);
+    }
+}
+
+LightHandle LightManager::Add(const XMFLOAT3 &position, const XMFLOAT3 &color, float intensity)
+{
+    if (m_freeSlots.empty())
+        throw std::length_error("LightManager: no free light");
+
+    uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    uint32_t index = GetCount();
+    m_slots[slot].index = index;
+    m_slotOf.push_back(slot);
+
+    m_x.push_back(position.x);
+    m_y.push_back(position.y);
+    m_z.push_back(position.z);
+    m_red.push_back(color.x);
+    m_green.push_back(color.y);
+    m_blue.push_back(color.z);
+    m_intensity.push_back(intensity);
+    m_radius.push_back(LightRadius(intensity, m_threshold));
+    markDirty(index);
+
+    LightHandle light;
+    light.slot = slot;
+    light.generation = m_slots[slot].generation;
+    return light;
+}
+
+void LightManager::Remove(LightHandle light)
+{
+    uint32_t index = indexOf(light);
+    uint32_t last = GetCount() - 1;
+
+    // The last light fills the hole
+    for (std::vector<float> *values : { &m_x, &m_y, &m_z, &m_red, &m_green, &m_blue, &m_intensity, &m_radius })
+    {
+        (*values)[index] = (*values)[last];
+        values->pop_back();
+    }
+    m_slotOf[index] = m_slotOf[last];
+    m_slotOf.pop_back();
+    if (index != last)
+    {
+        m_slots[m_slotOf[index]].index = index;
+        markDirty(index);
+    }
+    // Past the count nothing is uploaded
+    m_dirty[last / 64] &= ~(1ull << (last % 64));
+
+    Slot &slot = m_slots[light.slot];
+    slot.index = LightHandle::INVALID_SLOT;
+    slot.generation++;
+    m_freeSlots.push_back(light.slot);
+}
+
+bool LightManager::IsValid(LightHandle light) const
+{
+    return light.slot < m_slots.size() && m_slots[light.slot].generation == light.generation &&
+        m_slots[light.slot].index != LightHandle::INVALID_SLOT;
+}
+
+uint32_t LightManager::indexOf(LightHandle light) const
+{
+    if (!IsValid(light))
+        throw std::invalid_argument("LightManager: stale light handle");
+    return m_slots[light.slot].index;
+}
+
+uint32_t LightManager::GetIndex(LightHandle light) const
+{
+    return indexOf(light);
+}
+
+void LightManager::SetPosition(LightHandle light, const XMFLOAT3 &position)
+{
+    uint32_t index = indexOf(light);
+    m_x[index] = position.x;
+    m_y[index] = position.y;
+    m_z[index] = position.z;
+    markDirty(index);
+}
+
+void LightManager::SetColor(LightHandle light, const XMFLOAT3 &color)
+{
+    uint32_t index = indexOf(light);
+    m_red[index] = color.x;
+    m_green[index] = color.y;
+    m_blue[index] = color.z;
+    markDirty(index);
+}
+
+void LightManager::SetIntensity(LightHandle light, float intensity)
+{
+    uint32_t index = indexOf(light);
+    m_intensity[index] = intensity;
+    m_radius[index] = LightRadius(intensity, m_threshold);
+    markDirty(index);
+}
+
+void LightManager::GetBounds(BoundingSphereSet &bounds) const
+{
+    bounds.Resize(GetCount());
+    for (uint32_t i = 0; i < GetCount(); i++)
+        bounds.Set(i, m_x[i], m_y[i], m_z[i], m_radius[i]);
+}
+
+void LightManager::GetLights(std::vector<GpuPointLight> &lights) const
+{
+    lights.resize(GetCount());
+    for (uint32_t i = 0; i < GetCount(); i++)
+    {
+        lights[i].position = XMFLOAT3(m_x[i], m_y[i], m_z[i]);
+        lights[i].radius = m_radius[i];
+        lights[i].color = XMFLOAT3(m_red[i], m_green[i], m_blue[i]);
+        lights[i].intensity = m_intensity[i];
+    }
+}
+
+void LightManager::pack(uint32_t first, uint32_t last)
+{
+    for (uint32_t i = first; i < last; i++)
+    {
+        GpuPointLight &light = m_staging[i];
+        light.position = XMFLOAT3(m_x[i], m_y[i], m_z[i]);
+        light.radius = m_radius[i];
+        light.color = XMFLOAT3(m_red[i], m_green[i], m_blue[i]);
+        light.intensity = m_intensity[i];
+    }
+}
+
+void LightManager::Upload(RenderBackend &backend, ID3D11Buffer *buffer)
+{
+    m_statistics = LightUploadStatistics();
+    uint32_t count = GetCount();
+
+    uint32_t first = findBit(m_dirty, 0, count, true);
+    while (first < count)
+    {
+        // Grow the run over dirty elements and over short clean gaps
+        uint32_t last = findBit(m_dirty, first, count, false);
+        uint32_t next = findBit(m_dirty, last, count, true);
+        while (next < count && next - last < MERGE_GAP)
+        {
+            last = findBit(m_dirty, next, count, false);
+            next = findBit(m_dirty, last, count, true);
+        }
+
+        pack(first, last);
+        uint32_t bytes = (last - first) * (uint32_t)sizeof(GpuPointLight);
+        backend.UpdateBufferRange(buffer, first * (uint32_t)sizeof(GpuPointLight), &m_staging[first], bytes);
+        m_statistics.ranges++;
+        m_statistics.lights += last - first;
+        m_statistics.bytes += bytes;
+        first = next;
+    }
+
+    m_totalBytes += m_statistics.bytes;
+    std::fill(m_dirty.begin(), m_dirty.end(), 0);
+}
+
+void LightManager::InvalidateBuffer()
+{
+    std::fill(m_dirty.begin(), m_dirty.end(), ~0ull);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "..\Backend\RenderBackend.h"
+#include "..\Culling\FrustumCuller.h"
+
+namespace DX
+{
+    // Element of the light structured buffer, PointLight in
+    // ClusteredLighting.cginc
+    struct GpuPointLight
+    {
+        DirectX::XMFLOAT3 position;
+        float radius;
+        DirectX::XMFLOAT3 color;
+        float intensity;
+    };
+
+    // Refers to one light for as long as it lives. A handle outlives its
+    // light as a stale one, which the manager recognizes by the generation.
+    struct LightHandle
+    {
+        static const uint32_t INVALID_SLOT = 0xffffffff;
+
+        uint32_t slot = INVALID_SLOT;
+        uint32_t generation = 0;
+    };
+
+    struct LightUploadStatistics
+    {
+        // Buffer updates issued, one per dirty range
+        uint32_t ranges = 0;
+        uint32_t lights = 0;
+        uint64_t bytes = 0;
+    };
+
+    // Point lights in structure of arrays form, kept densely packed so the
+    // first GetCount elements of every array are the live lights. Adding
+    // appends, removing moves the last light into the hole, both in constant
+    // time; handles go through a slot table and so stay valid across moves.
+    //
+    // Every change marks the light's element dirty. Upload copies only the
+    // dirty elements into a structured buffer of GpuPointLight, runs closer
+    // than MERGE_GAP apart joined into one update.
+    //
+    // The radius follows the intensity, it is where the light falls below
+    // the threshold given at construction, see LightRadius.
+    class LightManager
+    {
+    public:
+        // Clean elements between two dirty runs below which they are
+        // uploaded as one, trading bytes for buffer updates
+        static const uint32_t MERGE_GAP = 8;
+
+        LightManager(uint32_t capacity, float threshold);
+
+        // Throws std::length_error when all capacity lights exist
+        LightHandle Add(const DirectX::XMFLOAT3 &position, const DirectX::XMFLOAT3 &color, float intensity);
+        // Throws std::invalid_argument for a stale handle, as do all setters
+        void Remove(LightHandle light);
+        bool IsValid(LightHandle light) const;
+
+        void SetPosition(LightHandle light, const DirectX::XMFLOAT3 &position);
+        void SetColor(LightHandle light, const DirectX::XMFLOAT3 &color);
+        void SetIntensity(LightHandle light, float intensity);
+
+        uint32_t GetCapacity() const { return (uint32_t)m_slots.size(); }
+        uint32_t GetCount() const { return (uint32_t)m_slotOf.size(); }
+        // Element of a light in the arrays and the buffer, until the next Remove
+        uint32_t GetIndex(LightHandle light) const;
+
+        const float *GetX() const { return m_x.data(); }
+        const float *GetY() const { return m_y.data(); }
+        const float *GetZ() const { return m_z.data(); }
+        const float *GetRed() const { return m_red.data(); }
+        const float *GetGreen() const { return m_green.data(); }
+        const float *GetBlue() const { return m_blue.data(); }
+        const float *GetIntensity() const { return m_intensity.data(); }
+        const float *GetRadius() const { return m_radius.data(); }
+
+        // Light spheres in element order, for the culling classes
+        void GetBounds(BoundingSphereSet &bounds) const;
+        // Lights in element order as the buffer holds them, for the CPU shading
+        void GetLights(std::vector<GpuPointLight> &lights) const;
+
+        // Copy the dirty elements into buffer, a default usage structured
+        // buffer of at least GetCapacity GpuPointLights. Statistics are
+        // those of this upload.
+        void Upload(RenderBackend &backend, ID3D11Buffer *buffer);
+        // Mark every light dirty, for a recreated buffer
+        void InvalidateBuffer();
+
+        const LightUploadStatistics &GetStatistics() const { return m_statistics; }
+        uint64_t GetTotalUploadedBytes() const { return m_totalBytes; }
+
+    private:
+        struct Slot
+        {
+            uint32_t index;
+            uint32_t generation;
+        };
+
+        uint32_t indexOf(LightHandle light) const;
+        void markDirty(uint32_t index) { m_dirty[index / 64] |= 1ull << (index % 64); }
+        void pack(uint32_t first, uint32_t last);
+
+        float m_threshold;
+
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_z;
+        std::vector<float> m_red;
+        std::vector<float> m_green;
+        std::vector<float> m_blue;
+        std::vector<float> m_intensity;
+        std::vector<float> m_radius;
+
+        // Handle slot to element and back
+        std::vector<Slot> m_slots;
+        std::vector<uint32_t> m_slotOf;
+        std::vector<uint32_t> m_freeSlots;
+
+        // One bit per element
+        std::vector<uint64_t> m_dirty;
+        std::vector<GpuPointLight> m_staging;
+
+        LightUploadStatistics m_statistics;
+        uint64_t m_totalBytes = 0;
+    };
+}
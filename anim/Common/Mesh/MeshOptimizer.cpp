@@ -0,0 +1,182 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+
+using namespace DX;
+
+namespace
+{
+    // Modelled LRU cache, larger than any real one so the order also suits
+    // the smaller ones
+    const uint32_t CACHE_SIZE = 32;
+    // Forsyth's constants
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    float vertexScore(int cachePosition, uint32_t remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0;
+        if (cachePosition >= 0)
+        {
+            // The three vertices of the last triangle get a fixed score, so
+            // the next triangle does not simply reuse its newest edge
+            if (cachePosition < 3)
+                score = LAST_TRIANGLE_SCORE;
+            else
+                score = std::pow(1.0f - (float)(cachePosition - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        // Finish off vertices with few triangles left before they drop out
+        score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+        return score;
+    }
+}
+
+void DX::OptimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles of every vertex, the first remaining[v] of them not emitted yet
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices)
+        remaining[index]++;
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    std::vector<uint32_t> triangles(indices.size());
+    {
+        std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    uint32_t cache[CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    size_t nextUnemitted = 0;
+    int64_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+
+    while (output.size() < indices.size())
+    {
+        if (best < 0)
+        {
+            // Nothing in the cache touches a triangle left, continue in input order
+            while (emitted[nextUnemitted])
+                nextUnemitted++;
+            best = (int64_t)nextUnemitted;
+        }
+
+        const uint32_t *triangle = &indices[3 * best];
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = triangle[k];
+            uint32_t *begin = &triangles[firstTriangle[v]];
+            uint32_t *end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, (uint32_t)best), end - 1);
+            remaining[v]--;
+        }
+
+        // The triangle's vertices move to the front, the rest shift back
+        uint32_t newCache[CACHE_SIZE + 3];
+        uint32_t newCount = 0;
+        for (int k = 0; k < 3; k++)
+            if (std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount)
+                newCache[newCount++] = triangle[k];
+        for (uint32_t i = 0; i < cacheCount; i++)
+            if (std::find(newCache, newCache + newCount, cache[i]) == newCache + newCount)
+                newCache[newCount++] = cache[i];
+
+        // Rescore everything that moved, including the evicted vertices,
+        // then the triangles around them
+        for (uint32_t i = 0; i < newCount; i++)
+        {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < newCount; i++)
+        {
+            uint32_t v = newCache[i];
+            for (uint32_t j = 0; j < remaining[v]; j++)
+            {
+                uint32_t t = triangles[firstTriangle[v] + j];
+                triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = (std::min)(newCount, CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+
+    indices.swap(output);
+}
+
+std::vector<uint32_t> DX::OptimizeVertexFetch(std::vector<uint32_t> &indices, uint32_t &vertexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, ~0u);
+    uint32_t next = 0;
+    for (uint32_t &index : indices)
+    {
+        if (remap[index] == ~0u)
+            remap[index] = next++;
+        index = remap[index];
+    }
+    vertexCount = next;
+    return remap;
+}
+
+VertexCacheStatistics DX::AnalyzeVertexCache(const std::vector<uint32_t> &indices, uint32_t vertexCount,
+    uint32_t cacheSize)
+{
+    // A vertex is still cached while fewer than cacheSize others entered after it
+    std::vector<uint32_t> entered(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t transforms = 0;
+    uint32_t referencedCount = 0;
+    for (uint32_t index : indices)
+    {
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            referencedCount++;
+        }
+        else if (transforms - entered[index] < cacheSize)
+            continue;
+        transforms++;
+        entered[index] = transforms;
+    }
+
+    VertexCacheStatistics statistics;
+    statistics.transforms = transforms;
+    statistics.acmr = indices.empty() ? 0 : (float)transforms / (indices.size() / 3);
+    statistics.atvr = referencedCount == 0 ? 0 : (float)transforms / referencedCount;
+    return statistics;
+}
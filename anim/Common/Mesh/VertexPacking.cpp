@@ -0,0 +1,377 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <emmintrin.h>
+
+#include "VertexPacking.h"
+
+using namespace DX;
+
+namespace
+{
+    const float SNORM16_MAX = 32767.0f;
+
+    const float *attribute(const float *base, size_t stride, size_t i)
+    {
+        return (const float *)((const char *)base + stride * i);
+    }
+
+    float *attribute(float *base, size_t stride, size_t i)
+    {
+        return (float *)((char *)base + stride * i);
+    }
+
+    __m128 select(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    __m128 absolute(__m128 x)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    }
+
+    // 1 with the sign of x, so zero counts as positive
+    __m128 signNotZero(__m128 x)
+    {
+        return _mm_or_ps(_mm_and_ps(x, _mm_set1_ps(-0.0f)), _mm_set1_ps(1.0f));
+    }
+
+    // Rounded to nearest, as the GPU's SNORM conversion expects
+    __m128i toSnorm16(__m128 x)
+    {
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+        return _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(SNORM16_MAX)));
+    }
+
+    __m128 fromSnorm16(__m128i x)
+    {
+        return _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / SNORM16_MAX)), _mm_set1_ps(-1.0f));
+    }
+
+    // Project onto the octahedron |x| + |y| + |z| = 1 and unfold the lower
+    // half over the diagonals of the upper one
+    void encodeOctahedral(__m128 x, __m128 y, __m128 z, __m128 &u, __m128 &v)
+    {
+        __m128 invL1 = _mm_div_ps(_mm_set1_ps(1.0f),
+            _mm_add_ps(_mm_add_ps(absolute(x), absolute(y)), absolute(z)));
+        u = _mm_mul_ps(x, invL1);
+        v = _mm_mul_ps(y, invL1);
+
+        __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        __m128 foldedU = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), absolute(v)), signNotZero(u));
+        __m128 foldedV = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), absolute(u)), signNotZero(v));
+        u = select(lower, foldedU, u);
+        v = select(lower, foldedV, v);
+    }
+
+    void decodeOctahedral(__m128 u, __m128 v, __m128 &x, __m128 &y, __m128 &z)
+    {
+        z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), absolute(u)), absolute(v));
+        __m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+        x = _mm_sub_ps(u, _mm_mul_ps(signNotZero(u), t));
+        y = _mm_sub_ps(v, _mm_mul_ps(signNotZero(v), t));
+
+        __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+        x = _mm_mul_ps(x, invLength);
+        y = _mm_mul_ps(y, invLength);
+        z = _mm_mul_ps(z, invLength);
+    }
+
+    // Half floats in the low 16 bits of each lane, rounded to nearest even.
+    // Fabian Giesen's branchless conversion.
+    __m128i toHalf(__m128 f)
+    {
+        const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);
+        const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+        const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+        const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+        __m128 sign = _mm_and_ps(f, _mm_set1_ps(-0.0f));
+        __m128 absF = _mm_xor_ps(f, sign);
+        __m128i absBits = _mm_castps_si128(absF);
+
+        // Infinity, or a quiet NaN for NaNs
+        __m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00),
+            _mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(absF, absF)), _mm_set1_epi32(0x200)));
+        __m128i isRegular = _mm_cmpgt_epi32(f16Max, absBits);
+        __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absBits);
+
+        // Float addition rounds the subnormal mantissa
+        __m128i subnormal = _mm_sub_epi32(
+            _mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+        // Rebias the exponent and round the mantissa, up on ties when it is odd
+        __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+        __m128i normal = _mm_srli_epi32(
+            _mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantissaOdd), 13);
+
+        __m128i regular = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+        __m128i result = _mm_or_si128(_mm_and_si128(isRegular, regular), _mm_andnot_si128(isRegular, special));
+        return _mm_or_si128(result, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+    }
+
+    __m128 fromHalf(__m128i h)
+    {
+        __m128i exponentMantissa = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+        __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, exponentMantissa), 16);
+        // Scaling by 2^112 rebiases the exponent and normalizes subnormals
+        __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)),
+            _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+        __m128i infNaN = _mm_and_si128(_mm_cmpgt_epi32(exponentMantissa, _mm_set1_epi32(0x7bff)),
+            _mm_set1_epi32(255 << 23));
+        return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNaN)));
+    }
+}
+
+PositionQuantization DX::ComputePositionQuantization(const float *positions, size_t stride, size_t count)
+{
+    float lower[3] = { INFINITY, INFINITY, INFINITY };
+    float upper[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (size_t i = 0; i < count; i++)
+    {
+        const float *p = attribute(positions, stride, i);
+        for (int c = 0; c < 3; c++)
+        {
+            lower[c] = (std::min)(lower[c], p[c]);
+            upper[c] = (std::max)(upper[c], p[c]);
+        }
+    }
+
+    PositionQuantization quantization = { 0, { 0, 0, 0 } };
+    for (int c = 0; c < 3 && count > 0; c++)
+    {
+        quantization.offset[c] = (lower[c] + upper[c]) / 2;
+        quantization.scale = (std::max)(quantization.scale, (upper[c] - lower[c]) / 2);
+    }
+    // A single point still needs a usable scale
+    if (quantization.scale == 0)
+        quantization.scale = 1;
+    return quantization;
+}
+
+void DX::PackVertices(const float *positions, const float *normals, const float *texcoords, size_t stride,
+    size_t count, const PositionQuantization &quantization, PackedVertex *output)
+{
+    const __m128 invScale = _mm_set1_ps(1.0f / quantization.scale);
+    const __m128 offsetX = _mm_set1_ps(quantization.offset[0]);
+    const __m128 offsetY = _mm_set1_ps(quantization.offset[1]);
+    const __m128 offsetZ = _mm_set1_ps(quantization.offset[2]);
+
+    alignas(16) int32_t lanes[7][4];
+    for (size_t i = 0; i < count; i += 4)
+    {
+        // Gather four vertices into one register per component, the last
+        // vertex fills in for missing ones at the end
+        size_t v[4];
+        for (int k = 0; k < 4; k++)
+            v[k] = (std::min)(i + k, count - 1);
+        const float *p[4], *n[4], *t[4];
+        for (int k = 0; k < 4; k++)
+        {
+            p[k] = attribute(positions, stride, v[k]);
+            n[k] = attribute(normals, stride, v[k]);
+            t[k] = attribute(texcoords, stride, v[k]);
+        }
+
+        __m128 x = _mm_setr_ps(p[0][0], p[1][0], p[2][0], p[3][0]);
+        __m128 y = _mm_setr_ps(p[0][1], p[1][1], p[2][1], p[3][1]);
+        __m128 z = _mm_setr_ps(p[0][2], p[1][2], p[2][2], p[3][2]);
+        _mm_store_si128((__m128i *)lanes[0], toSnorm16(_mm_mul_ps(_mm_sub_ps(x, offsetX), invScale)));
+        _mm_store_si128((__m128i *)lanes[1], toSnorm16(_mm_mul_ps(_mm_sub_ps(y, offsetY), invScale)));
+        _mm_store_si128((__m128i *)lanes[2], toSnorm16(_mm_mul_ps(_mm_sub_ps(z, offsetZ), invScale)));
+
+        __m128 u, w;
+        encodeOctahedral(
+            _mm_setr_ps(n[0][0], n[1][0], n[2][0], n[3][0]),
+            _mm_setr_ps(n[0][1], n[1][1], n[2][1], n[3][1]),
+            _mm_setr_ps(n[0][2], n[1][2], n[2][2], n[3][2]), u, w);
+        _mm_store_si128((__m128i *)lanes[3], toSnorm16(u));
+        _mm_store_si128((__m128i *)lanes[4], toSnorm16(w));
+
+        _mm_store_si128((__m128i *)lanes[5], toHalf(_mm_setr_ps(t[0][0], t[1][0], t[2][0], t[3][0])));
+        _mm_store_si128((__m128i *)lanes[6], toHalf(_mm_setr_ps(t[0][1], t[1][1], t[2][1], t[3][1])));
+
+        for (size_t k = 0; k < 4 && i + k < count; k++)
+        {
+            PackedVertex &out = output[i + k];
+            out.position[0] = (int16_t)lanes[0][k];
+            out.position[1] = (int16_t)lanes[1][k];
+            out.position[2] = (int16_t)lanes[2][k];
+            out.position[3] = (int16_t)SNORM16_MAX;
+            out.normal[0] = (int16_t)lanes[3][k];
+            out.normal[1] = (int16_t)lanes[4][k];
+            out.texcoord[0] = (uint16_t)lanes[5][k];
+            out.texcoord[1] = (uint16_t)lanes[6][k];
+        }
+    }
+}
+
+void DX::UnpackVertices(const PackedVertex *input, size_t count, const PositionQuantization &quantization,
+    float *positions, float *normals, float *texcoords, size_t stride)
+{
+    const __m128 scale = _mm_set1_ps(quantization.scale);
+    const __m128 offsetX = _mm_set1_ps(quantization.offset[0]);
+    const __m128 offsetY = _mm_set1_ps(quantization.offset[1]);
+    const __m128 offsetZ = _mm_set1_ps(quantization.offset[2]);
+
+    alignas(16) float lanes[8][4];
+    for (size_t i = 0; i < count; i += 4)
+    {
+        const PackedVertex *in[4];
+        for (int k = 0; k < 4; k++)
+            in[k] = &input[(std::min)(i + k, count - 1)];
+
+        auto load = [&](auto member)
+        {
+            return _mm_setr_epi32(member(*in[0]), member(*in[1]), member(*in[2]), member(*in[3]));
+        };
+        __m128 x = fromSnorm16(load([](const PackedVertex &p) { return (int)p.position[0]; }));
+        __m128 y = fromSnorm16(load([](const PackedVertex &p) { return (int)p.position[1]; }));
+        __m128 z = fromSnorm16(load([](const PackedVertex &p) { return (int)p.position[2]; }));
+        _mm_store_ps(lanes[0], _mm_add_ps(_mm_mul_ps(x, scale), offsetX));
+        _mm_store_ps(lanes[1], _mm_add_ps(_mm_mul_ps(y, scale), offsetY));
+        _mm_store_ps(lanes[2], _mm_add_ps(_mm_mul_ps(z, scale), offsetZ));
+
+        __m128 nx, ny, nz;
+        decodeOctahedral(
+            fromSnorm16(load([](const PackedVertex &p) { return (int)p.normal[0]; })),
+            fromSnorm16(load([](const PackedVertex &p) { return (int)p.normal[1]; })), nx, ny, nz);
+        _mm_store_ps(lanes[3], nx);
+        _mm_store_ps(lanes[4], ny);
+        _mm_store_ps(lanes[5], nz);
+
+        _mm_store_ps(lanes[6], fromHalf(load([](const PackedVertex &p) { return (int)p.texcoord[0]; })));
+        _mm_store_ps(lanes[7], fromHalf(load([](const PackedVertex &p) { return (int)p.texcoord[1]; })));
+
+        for (size_t k = 0; k < 4 && i + k < count; k++)
+        {
+            float *p = attribute(positions, stride, i + k);
+            float *n = attribute(normals, stride, i + k);
+            float *t = attribute(texcoords, stride, i + k);
+            for (int c = 0; c < 3; c++)
+            {
+                p[c] = lanes[c][k];
+                n[c] = lanes[3 + c][k];
+            }
+            t[0] = lanes[6][k];
+            t[1] = lanes[7][k];
+        }
+    }
+}
+
+VertexPackingError DX::MeasurePackingError(const float *positions, const float *normals, const float *texcoords,
+    size_t stride, size_t count, const PositionQuantization &quantization, const PackedVertex *packed)
+{
+    // Position, normal and texture coordinate of each vertex in a row
+    std::vector<float> unpacked(count * 8);
+    UnpackVertices(packed, count, quantization, &unpacked[0], &unpacked[3], &unpacked[6], 8 * sizeof(float));
+
+    VertexPackingError error = { 0, 0, 0 };
+    for (size_t i = 0; i < count; i++)
+    {
+        const float *p = attribute(positions, stride, i);
+        const float *n = attribute(normals, stride, i);
+        const float *t = attribute(texcoords, stride, i);
+        const float *u = &unpacked[8 * i];
+
+        float distance = std::sqrt((p[0] - u[0]) * (p[0] - u[0]) + (p[1] - u[1]) * (p[1] - u[1]) +
+            (p[2] - u[2]) * (p[2] - u[2]));
+        // The cross product keeps small angles accurate where acos would not
+        float cosine = n[0] * u[3] + n[1] * u[4] + n[2] * u[5];
+        float cross[3] = { n[1] * u[5] - n[2] * u[4], n[2] * u[3] - n[0] * u[5], n[0] * u[4] - n[1] * u[3] };
+        float sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+        error.position = (std::max)(error.position, distance);
+        error.normalDegrees = (std::max)(error.normalDegrees, std::atan2(sine, cosine) * 57.29577951f);
+        error.texcoord = (std::max)(error.texcoord, (std::max)(std::abs(t[0] - u[6]), std::abs(t[1] - u[7])));
+    }
+    return error;
+}
+
+void DX::EncodeOctahedral(const float *normal, int16_t *output)
+{
+    float invL1 = 1.0f / (std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]));
+    float u = normal[0] * invL1;
+    float v = normal[1] * invL1;
+    if (normal[2] < 0)
+    {
+        float foldedU = (1 - std::abs(v)) * (u >= 0 ? 1.0f : -1.0f);
+        v = (1 - std::abs(u)) * (v >= 0 ? 1.0f : -1.0f);
+        u = foldedU;
+    }
+    output[0] = (int16_t)std::nearbyint((std::min)((std::max)(u, -1.0f), 1.0f) * SNORM16_MAX);
+    output[1] = (int16_t)std::nearbyint((std::min)((std::max)(v, -1.0f), 1.0f) * SNORM16_MAX);
+}
+
+void DX::DecodeOctahedral(const int16_t *encoded, float *normal)
+{
+    float u = (std::max)(encoded[0] / SNORM16_MAX, -1.0f);
+    float v = (std::max)(encoded[1] / SNORM16_MAX, -1.0f);
+    float z = 1 - std::abs(u) - std::abs(v);
+    float t = (std::max)(-z, 0.0f);
+    float x = u + (u >= 0 ? -t : t);
+    float y = v + (v >= 0 ? -t : t);
+    float invLength = 1.0f / std::sqrt(x * x + y * y + z * z);
+    normal[0] = x * invLength;
+    normal[1] = y * invLength;
+    normal[2] = z * invLength;
+}
+
+uint16_t DX::FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    bits &= 0x7fffffff;
+
+    if (bits > 0x7f800000)
+        return sign | 0x7e00;
+    if (bits >= 0x477ff000)
+        return sign | 0x7c00;
+    if (bits < 0x38800000)
+    {
+        // Subnormal or zero, shift the mantissa with its implicit one into place
+        if (bits < 0x33000000)
+            return sign;
+        uint32_t shift = 126 - (bits >> 23);
+        uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t tie = 1u << (shift - 1);
+        if (rest > tie || (rest == tie && (half & 1)))
+            half++;
+        return sign | (uint16_t)half;
+    }
+
+    uint32_t half = (bits - (112u << 23)) >> 13;
+    uint32_t rest = bits & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | (uint16_t)half;
+}
+
+float DX::HalfToFloat(uint16_t value)
+{
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else
+    {
+        float magnitude = mantissa * (1.0f / 16777216.0f);
+        std::memcpy(&bits, &magnitude, sizeof(bits));
+        bits |= sign;
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
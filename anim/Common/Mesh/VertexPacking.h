@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DX
+{
+    // 16 bytes in place of three float3s: the position as SNORM16 relative
+    // to the mesh bounds with w = 1, the unit normal octahedron-mapped to two
+    // SNORM16 and the texture coordinate as two halves. The input layout is
+    // R16G16B16A16_SNORM, R16G16_SNORM, R16G16_FLOAT, see PackedVertex.cginc.
+    struct PackedVertex
+    {
+        int16_t position[4];
+        int16_t normal[2];
+        uint16_t texcoord[2];
+    };
+
+    // Maps the packed position back with position * scale + offset. The
+    // scale is the same on every axis, so folded into a model matrix it
+    // leaves the normal transform alone.
+    struct PositionQuantization
+    {
+        float scale;
+        float offset[3];
+    };
+
+    struct VertexPackingError
+    {
+        // Largest distance between a position and its packed one, in mesh units
+        float position;
+        // Largest angle between a normal and its packed one, in degrees
+        float normalDegrees;
+        // Largest difference of a texture coordinate component
+        float texcoord;
+    };
+
+    // Vertex attributes are read from or written to three float arrays,
+    // positions and normals with three components, texture coordinates with
+    // two, the same stride bytes from one vertex to the next.
+
+    // Centre and half the largest extent of the positions' bounding box
+    PositionQuantization ComputePositionQuantization(const float *positions, size_t stride, size_t count);
+
+    // Four vertices per SSE2 step. Normals have to be unit length.
+    void PackVertices(const float *positions, const float *normals, const float *texcoords, size_t stride,
+        size_t count, const PositionQuantization &quantization, PackedVertex *output);
+    void UnpackVertices(const PackedVertex *input, size_t count, const PositionQuantization &quantization,
+        float *positions, float *normals, float *texcoords, size_t stride);
+
+    // Compare the packed vertices with the ones they came from
+    VertexPackingError MeasurePackingError(const float *positions, const float *normals, const float *texcoords,
+        size_t stride, size_t count, const PositionQuantization &quantization, const PackedVertex *packed);
+
+    // Scalar references of the SIMD conversions
+    void EncodeOctahedral(const float *normal, int16_t *output);
+    void DecodeOctahedral(const int16_t *encoded, float *normal);
+    uint16_t FloatToHalf(float value);
+    float HalfToFloat(uint16_t value);
+}
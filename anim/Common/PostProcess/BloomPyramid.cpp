@@ -0,0 +1,185 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "BloomPyramid.h"
+
+using namespace DX;
+
+namespace
+{
+    // Downsample taps sit on pixel corners one pixel from the destination
+    // center, four bilinear taps average a 4x4 block of the source
+    const float DOWNSAMPLE_OFFSETS[4][2] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+
+    // 3x3 tent over the coarser level, weights 1 2 1 along each axis
+    const float TENT_WEIGHTS[3] = { 0.25f, 0.5f, 0.25f };
+
+    BloomLevel makeLevel(uint32_t width, uint32_t height)
+    {
+        BloomLevel level;
+        level.width = width;
+        level.height = height;
+        level.rgba.assign((size_t)width * height * 4, 0.0f);
+        return level;
+    }
+}
+
+BloomPyramid::BloomPyramid(const BloomSettings &settings) :
+    m_settings(settings)
+{
+    if (settings.maxLevelCount == 0)
+        throw std::invalid_argument("BloomPyramid: no levels");
+    if (!(settings.knee > 0))
+        throw std::invalid_argument("BloomPyramid: knee must be positive");
+}
+
+uint32_t BloomPyramid::GetLevelCount(uint32_t width, uint32_t height, uint32_t maxLevelCount)
+{
+    // Stop once the shorter side would be a single pixel
+    uint32_t count = 0;
+    for (uint32_t side = (std::min)(width, height); side > 1 && count < maxLevelCount; side = (side + 1) / 2)
+        count++;
+    return (std::max)(count, 1u);
+}
+
+void BloomPyramid::GetLevelSize(uint32_t width, uint32_t height, uint32_t level,
+    uint32_t &levelWidth, uint32_t &levelHeight)
+{
+    levelWidth = (std::max)(width, 1u);
+    levelHeight = (std::max)(height, 1u);
+    for (uint32_t i = 0; i <= level; i++)
+    {
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+}
+
+void BloomPyramid::Prefilter(const float *rgb, float threshold, float knee, float *out)
+{
+    float brightness = (std::max)((std::max)(rgb[0], rgb[1]), rgb[2]);
+    float soft = (std::min)((std::max)(brightness - threshold + knee, 0.0f), 2 * knee);
+    soft = soft * soft / (4 * knee + 1e-5f);
+    float contribution = (std::max)(soft, brightness - threshold) / (std::max)(brightness, 1e-5f);
+    for (int c = 0; c < 3; c++)
+        out[c] = rgb[c] * contribution;
+}
+
+void BloomPyramid::Sample(const float *rgba, uint32_t width, uint32_t height, size_t rowPitch,
+    float x, float y, float *out)
+{
+    x = (std::min)((std::max)(x, 0.5f), width - 0.5f) - 0.5f;
+    y = (std::min)((std::max)(y, 0.5f), height - 0.5f) - 0.5f;
+
+    uint32_t x0 = (uint32_t)x, y0 = (uint32_t)y;
+    uint32_t x1 = (std::min)(x0 + 1, width - 1), y1 = (std::min)(y0 + 1, height - 1);
+    float fx = x - x0, fy = y - y0;
+
+    const float *p00 = rgba + y0 * rowPitch + 4 * x0;
+    const float *p10 = rgba + y0 * rowPitch + 4 * x1;
+    const float *p01 = rgba + y1 * rowPitch + 4 * x0;
+    const float *p11 = rgba + y1 * rowPitch + 4 * x1;
+    for (int c = 0; c < 4; c++)
+    {
+        float top = p00[c] + (p10[c] - p00[c]) * fx;
+        float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+        out[c] = top + (bottom - top) * fy;
+    }
+}
+
+void BloomPyramid::Build(const float *rgba, uint32_t width, uint32_t height, size_t rowPitch)
+{
+    uint32_t levelCount = GetLevelCount(width, height, m_settings.maxLevelCount);
+    m_down.resize(levelCount);
+    m_up.resize(levelCount);
+
+    // Downsample chain, thresholding on the way out of the scene
+    const float *source = rgba;
+    uint32_t sourceWidth = width, sourceHeight = height;
+    size_t sourcePitch = rowPitch;
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        uint32_t levelWidth, levelHeight;
+        GetLevelSize(width, height, level, levelWidth, levelHeight);
+        BloomLevel &dest = m_down[level] = makeLevel(levelWidth, levelHeight);
+
+        float scaleX = (float)sourceWidth / levelWidth;
+        float scaleY = (float)sourceHeight / levelHeight;
+        for (uint32_t y = 0; y < levelHeight; y++)
+            for (uint32_t x = 0; x < levelWidth; x++)
+            {
+                float cx = (x + 0.5f) * scaleX, cy = (y + 0.5f) * scaleY;
+                float sum[4] = {}, tap[4];
+                for (auto &offset : DOWNSAMPLE_OFFSETS)
+                {
+                    Sample(source, sourceWidth, sourceHeight, sourcePitch,
+                        cx + offset[0], cy + offset[1], tap);
+                    for (int c = 0; c < 4; c++)
+                        sum[c] += tap[c] * 0.25f;
+                }
+
+                float *out = &dest.rgba[((size_t)y * levelWidth + x) * 4];
+                if (level == 0)
+                    Prefilter(sum, m_settings.threshold, m_settings.knee, out);
+                else
+                    std::copy(sum, sum + 3, out);
+                out[3] = 1;
+            }
+
+        source = dest.rgba.data();
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+        sourcePitch = (size_t)levelWidth * 4;
+    }
+
+    // Upsample chain, each level adds the tent filtered coarser result
+    m_up[levelCount - 1] = m_down[levelCount - 1];
+    for (uint32_t level = levelCount - 1; level-- > 0;)
+    {
+        const BloomLevel &coarse = m_up[level + 1];
+        const BloomLevel &down = m_down[level];
+        BloomLevel &dest = m_up[level] = makeLevel(down.width, down.height);
+
+        float scaleX = (float)coarse.width / down.width;
+        float scaleY = (float)coarse.height / down.height;
+        for (uint32_t y = 0; y < down.height; y++)
+            for (uint32_t x = 0; x < down.width; x++)
+            {
+                float cx = (x + 0.5f) * scaleX, cy = (y + 0.5f) * scaleY;
+                size_t index = ((size_t)y * down.width + x) * 4;
+                float sum[4] = { down.rgba[index], down.rgba[index + 1], down.rgba[index + 2], 0 };
+                float tap[4];
+                for (int j = 0; j < 3; j++)
+                    for (int i = 0; i < 3; i++)
+                    {
+                        Sample(coarse.rgba.data(), coarse.width, coarse.height, (size_t)coarse.width * 4,
+                            cx + i - 1, cy + j - 1, tap);
+                        float weight = TENT_WEIGHTS[i] * TENT_WEIGHTS[j];
+                        for (int c = 0; c < 3; c++)
+                            sum[c] += tap[c] * weight;
+                    }
+
+                std::copy(sum, sum + 3, &dest.rgba[index]);
+                dest.rgba[index + 3] = 1;
+            }
+    }
+}
+
+void BloomPyramid::Composite(const float *rgba, uint32_t width, uint32_t height, size_t rowPitch,
+    uint32_t x, uint32_t y, float *out) const
+{
+    if (m_up.empty())
+        throw std::logic_error("BloomPyramid: Composite before Build");
+
+    const BloomLevel &bloom = m_up[0];
+    float bloomColor[4];
+    Sample(bloom.rgba.data(), bloom.width, bloom.height, (size_t)bloom.width * 4,
+        (x + 0.5f) * bloom.width / width, (y + 0.5f) * bloom.height / height, bloomColor);
+
+    const float *scene = rgba + y * rowPitch + 4 * x;
+    for (int c = 0; c < 3; c++)
+        out[c] = scene[c] + m_settings.intensity * bloomColor[c];
+    out[3] = scene[3];
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+    struct BloomSettings
+    {
+        // Scene brightness where bloom starts, before exposure
+        float threshold = 1.0f;
+        // Width of the soft transition below the threshold
+        float knee = 0.5f;
+        // Weight of the bloom added to the scene
+        float intensity = 0.05f;
+        uint32_t maxLevelCount = 6;
+    };
+
+    struct BloomLevel
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<float> rgba;
+    };
+
+    // CPU reference of the bloom passes. The first downsample thresholds the
+    // scene while halving it, every further one halves the previous level.
+    // The upsample chain then walks back up, adding a tent filtered copy of
+    // the coarser result to each level. Level 0 is half the scene size.
+    //
+    // BloomDownsamplePixelShader and BloomUpsamplePixelShader sample in the
+    // same pixel coordinates, so the GPU result matches up to texture
+    // filtering precision.
+    class BloomPyramid
+    {
+    public:
+        explicit BloomPyramid(const BloomSettings &settings = BloomSettings());
+
+        static uint32_t GetLevelCount(uint32_t width, uint32_t height, uint32_t maxLevelCount);
+        static void GetLevelSize(uint32_t width, uint32_t height, uint32_t level,
+            uint32_t &levelWidth, uint32_t &levelHeight);
+
+        // Keep the part of an RGB colour above the threshold, with a quadratic knee
+        static void Prefilter(const float *rgb, float threshold, float knee, float *out);
+
+        // Bilinear sample of width x height RGBA pixels at a position in
+        // pixels, clamped to the pixel centers at the edges
+        static void Sample(const float *rgba, uint32_t width, uint32_t height, size_t rowPitch,
+            float x, float y, float *out);
+
+        // Run both chains on width x height RGBA float pixels whose rows are rowPitch floats apart
+        void Build(const float *rgba, uint32_t width, uint32_t height, size_t rowPitch);
+
+        // Scene plus the weighted bloom of the last Build call, at scene pixel (x, y)
+        void Composite(const float *rgba, uint32_t width, uint32_t height, size_t rowPitch,
+            uint32_t x, uint32_t y, float *out) const;
+
+        const std::vector<BloomLevel> &GetDownsampled() const { return m_down; }
+        const std::vector<BloomLevel> &GetUpsampled() const { return m_up; }
+        const BloomSettings &GetSettings() const { return m_settings; }
+
+    private:
+        BloomSettings m_settings;
+
+        std::vector<BloomLevel> m_down;
+        // Same sizes as m_down; the coarsest level is a copy of the coarsest downsampled one
+        std::vector<BloomLevel> m_up;
+    };
+}
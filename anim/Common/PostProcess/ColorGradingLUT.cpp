@@ -0,0 +1,178 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "ColorGradingLUT.h"
+#include "..\SimdMath.h"
+
+using namespace DX;
+
+ColorGradingLUT::ColorGradingLUT(const TonemapLUT &tonemap, const CubeLUT &grade, uint32_t size,
+    float minLog2, float maxLog2) :
+    m_size(size),
+    m_minLog2(minLog2)
+{
+    if (size < 2 || size > 256 || !(maxLog2 > minLog2))
+        throw std::invalid_argument("ColorGradingLUT: invalid table parameters");
+
+    m_bias = std::exp2(minLog2);
+    m_step = (size - 1) / (maxLog2 - minLog2);
+
+    // Tonemapped value of every entry position, shared by the three axes
+    std::vector<float> axis(size);
+    for (uint32_t i = 0; i < size; i++)
+        axis[i] = tonemap.EvaluateDirect(std::exp2(minLog2 + i / m_step) - m_bias);
+
+    m_table.resize((size_t)size * size * size * 4);
+    float *out = m_table.data();
+    for (uint32_t b = 0; b < size; b++)
+        for (uint32_t g = 0; g < size; g++)
+            for (uint32_t r = 0; r < size; r++)
+            {
+                const float tonemapped[3] = { axis[r], axis[g], axis[b] };
+                grade.Sample(tonemapped, out);
+                out[3] = 1;
+                out += 4;
+            }
+}
+
+void ColorGradingLUT::ApplySequential(const TonemapLUT &tonemap, const CubeLUT &grade,
+    const float *rgb, float exposure, float *out)
+{
+    float tonemapped[3];
+    for (int c = 0; c < 3; c++)
+        tonemapped[c] = tonemap.EvaluateDirect((std::max)(rgb[c] * exposure, 0.0f));
+    grade.Sample(tonemapped, out);
+}
+
+void ColorGradingLUT::Apply(const float *rgb, float exposure, float *out) const
+{
+    const uint32_t strides[3] = { 1, m_size, m_size * m_size };
+    uint32_t cell[3];
+    float f[3];
+    for (int c = 0; c < 3; c++)
+    {
+        float x = (std::max)(rgb[c] * exposure, 0.0f) + m_bias;
+        float t = (std::log2(x) - m_minLog2) * m_step;
+        t = (std::min)((std::max)(t, 0.0f), (float)(m_size - 1));
+        cell[c] = (std::min)((uint32_t)t, m_size - 2);
+        f[c] = t - cell[c];
+    }
+
+    size_t origin = cell[0] + (size_t)cell[1] * strides[1] + (size_t)cell[2] * strides[2];
+    float rgba[4];
+    InterpolateTetrahedral(&m_table[origin * 4], strides, f, 4, rgba);
+    std::copy(rgba, rgba + 3, out);
+}
+
+void ColorGradingLUT::Apply(const float *rgbaIn, float *rgbaOut, size_t pixelCount, float exposure) const
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 exposureScale = _mm_set1_ps(exposure);
+    const __m128 bias = _mm_set1_ps(m_bias);
+    const __m128 step = _mm_set1_ps(m_step);
+    const __m128 offset = _mm_set1_ps(-m_minLog2 * m_step);
+    const __m128 last = _mm_set1_ps((float)(m_size - 1));
+    const __m128 lastCell = _mm_set1_ps((float)(m_size - 2));
+    const __m128 size = _mm_set1_ps((float)m_size);
+    const __m128i strideR = _mm_set1_epi32(1);
+    const __m128i strideG = _mm_set1_epi32((int)m_size);
+    const __m128i strideB = _mm_set1_epi32((int)(m_size * m_size));
+    const float *table = m_table.data();
+
+    alignas(16) int origins[4];
+    alignas(16) int corners1[4];
+    alignas(16) int corners2[4];
+    alignas(16) float weights[4][4];
+    const int corner3 = (int)(1 + m_size + m_size * m_size);
+
+    size_t p = 0;
+    for (; p + 4 <= pixelCount; p += 4)
+    {
+        // Four pixels at a time, one per lane
+        __m128 f[3];
+        __m128 cell[3];
+        {
+            __m128 r = _mm_loadu_ps(rgbaIn + 4 * p);
+            __m128 g = _mm_loadu_ps(rgbaIn + 4 * p + 4);
+            __m128 b = _mm_loadu_ps(rgbaIn + 4 * p + 8);
+            __m128 a = _mm_loadu_ps(rgbaIn + 4 * p + 12);
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+            __m128 channels[3] = { r, g, b };
+            for (int c = 0; c < 3; c++)
+            {
+                __m128 x = _mm_add_ps(_mm_max_ps(_mm_mul_ps(channels[c], exposureScale), zero), bias);
+                __m128 t = _mm_add_ps(_mm_mul_ps(Simd::Log2(x), step), offset);
+                t = _mm_min_ps(_mm_max_ps(t, zero), last);
+                // t is never negative, truncation is floor
+                cell[c] = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(t)), lastCell);
+                f[c] = _mm_sub_ps(t, cell[c]);
+            }
+        }
+
+        // Origin entry, exact in float for any supported size
+        __m128i origin = _mm_cvttps_epi32(_mm_add_ps(
+            _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cell[2], size), cell[1]), size), cell[0]));
+
+        // Tetrahedron corners without sorting: the first adds the axes with
+        // the largest fraction, the second every axis above the smallest one.
+        // On ties the extra axes only get zero weight.
+        __m128 fMax = _mm_max_ps(f[0], _mm_max_ps(f[1], f[2]));
+        __m128 fMin = _mm_min_ps(f[0], _mm_min_ps(f[1], f[2]));
+        __m128 fMid = _mm_sub_ps(_mm_add_ps(f[0], _mm_add_ps(f[1], f[2])), _mm_add_ps(fMax, fMin));
+
+        __m128i corner1 = _mm_add_epi32(_mm_add_epi32(
+            _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(f[0], fMax)), strideR),
+            _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(f[1], fMax)), strideG)),
+            _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(f[2], fMax)), strideB));
+        __m128i corner2 = _mm_add_epi32(_mm_add_epi32(
+            _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(f[0], fMin)), strideR),
+            _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(f[1], fMin)), strideG)),
+            _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(f[2], fMin)), strideB));
+
+        __m128 w0 = _mm_sub_ps(one, fMax);
+        __m128 w1 = _mm_sub_ps(fMax, fMid);
+        __m128 w2 = _mm_sub_ps(fMid, fMin);
+        __m128 w3 = fMin;
+        _MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+
+        _mm_store_si128((__m128i *)origins, origin);
+        _mm_store_si128((__m128i *)corners1, corner1);
+        _mm_store_si128((__m128i *)corners2, corner2);
+        _mm_store_ps(weights[0], w0);
+        _mm_store_ps(weights[1], w1);
+        _mm_store_ps(weights[2], w2);
+        _mm_store_ps(weights[3], w3);
+
+        // SSE2 has no gather, each pixel blends its four RGBA entries
+        for (int k = 0; k < 4; k++)
+        {
+            const float *c = table + 4 * (size_t)origins[k];
+            __m128 w = _mm_load_ps(weights[k]);
+            __m128 sum = _mm_mul_ps(_mm_loadu_ps(c), _mm_shuffle_ps(w, w, _MM_SHUFFLE(0, 0, 0, 0)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c + 4 * corners1[k]),
+                _mm_shuffle_ps(w, w, _MM_SHUFFLE(1, 1, 1, 1))));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c + 4 * corners2[k]),
+                _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 2, 2, 2))));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c + 4 * corner3),
+                _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(rgbaOut + 4 * (p + k), sum);
+        }
+    }
+
+    for (; p < pixelCount; p++)
+    {
+        Apply(rgbaIn + 4 * p, exposure, rgbaOut + 4 * p);
+        rgbaOut[4 * p + 3] = 1;
+    }
+}
+
+void ColorGradingLUT::GetShaper(float &bias, float &scale, float &offset) const
+{
+    bias = m_bias;
+    scale = m_step;
+    offset = -m_minLog2 * m_step;
+}
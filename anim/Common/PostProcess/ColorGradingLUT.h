@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CubeLUT.h"
+#include "TonemapLUT.h"
+
+namespace DX
+{
+    // Filmic tonemapping, gamma and a .cube grade baked into one 3D table,
+    // so grading costs no pass of its own. The table is indexed per channel
+    // by a log shaper of the exposed colour,
+    //     t = (log2(x * exposure + bias) - minLog2) * step,  bias = 2^minLog2,
+    // which keeps black at the first entry and spreads the entries evenly
+    // over the stops the filmic curve distinguishes. Entries are RGBA floats,
+    // red changing fastest, and are interpolated tetrahedrally.
+    class ColorGradingLUT
+    {
+    public:
+        ColorGradingLUT(const TonemapLUT &tonemap, const CubeLUT &grade, uint32_t size = 33,
+            float minLog2 = -12.0f, float maxLog2 = 4.0f);
+
+        // Tonemap with the exact curve, then grade: the two steps the table replaces
+        static void ApplySequential(const TonemapLUT &tonemap, const CubeLUT &grade,
+            const float *rgb, float exposure, float *out);
+
+        // Table look up of one RGB colour
+        void Apply(const float *rgb, float exposure, float *out) const;
+
+        // Grade pixelCount RGBA pixels with the given exposure, alpha is set to 1.
+        // in and out may alias.
+        void Apply(const float *rgbaIn, float *rgbaOut, size_t pixelCount, float exposure) const;
+
+        // Shader constants for t = log2(x * exposure + bias) * scale + offset,
+        // in entries from the first one
+        void GetShaper(float &bias, float &scale, float &offset) const;
+
+        const std::vector<float> &GetTable() const { return m_table; }
+        uint32_t GetSize() const { return m_size; }
+
+    private:
+        uint32_t m_size;
+        float m_minLog2;
+        float m_bias;
+        // Table entries per log2 unit
+        float m_step;
+
+        std::vector<float> m_table;
+    };
+}
@@ -0,0 +1,137 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "CubeLUT.h"
+
+using namespace DX;
+
+namespace
+{
+    // Large enough for any grading table in use, small enough to reject garbage sizes
+    const uint32_t MAX_CUBE_SIZE = 256;
+
+    std::runtime_error parseError(size_t line, const std::string &message)
+    {
+        return std::runtime_error("CubeLUT: line " + std::to_string(line) + ": " + message);
+    }
+}
+
+CubeLUT CubeLUT::Identity(uint32_t size)
+{
+    if (size < 2 || size > MAX_CUBE_SIZE)
+        throw std::invalid_argument("CubeLUT: invalid size");
+
+    CubeLUT lut;
+    lut.m_size = size;
+    lut.m_table.resize((size_t)size * size * size * 3);
+    float *out = lut.m_table.data();
+    for (uint32_t b = 0; b < size; b++)
+        for (uint32_t g = 0; g < size; g++)
+            for (uint32_t r = 0; r < size; r++)
+            {
+                *out++ = (float)r / (size - 1);
+                *out++ = (float)g / (size - 1);
+                *out++ = (float)b / (size - 1);
+            }
+    return lut;
+}
+
+CubeLUT CubeLUT::Parse(std::istream &in)
+{
+    CubeLUT lut;
+    std::string text;
+    size_t lineNumber = 0;
+    while (std::getline(in, text))
+    {
+        lineNumber++;
+        if (!text.empty() && text.back() == '\r')
+            text.pop_back();
+
+        std::istringstream line(text);
+        std::string keyword;
+        if (!(line >> keyword) || keyword[0] == '#')
+            continue;
+
+        if (keyword == "TITLE")
+        {
+            size_t open = text.find('"'), close = text.rfind('"');
+            if (open != std::string::npos && close > open)
+                lut.m_title = text.substr(open + 1, close - open - 1);
+        }
+        else if (keyword == "LUT_3D_SIZE")
+        {
+            if (!(line >> lut.m_size) || lut.m_size < 2 || lut.m_size > MAX_CUBE_SIZE)
+                throw parseError(lineNumber, "invalid LUT_3D_SIZE");
+            lut.m_table.reserve((size_t)lut.m_size * lut.m_size * lut.m_size * 3);
+        }
+        else if (keyword == "LUT_1D_SIZE")
+        {
+            throw parseError(lineNumber, "1D tables are not supported");
+        }
+        else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX")
+        {
+            float *domain = keyword == "DOMAIN_MIN" ? lut.m_domainMin : lut.m_domainMax;
+            if (!(line >> domain[0] >> domain[1] >> domain[2]))
+                throw parseError(lineNumber, "invalid " + keyword);
+        }
+        else if (keyword == "LUT_3D_INPUT_RANGE")
+        {
+            float lo, hi;
+            if (!(line >> lo >> hi))
+                throw parseError(lineNumber, "invalid LUT_3D_INPUT_RANGE");
+            std::fill(lut.m_domainMin, lut.m_domainMin + 3, lo);
+            std::fill(lut.m_domainMax, lut.m_domainMax + 3, hi);
+        }
+        else
+        {
+            // Anything else has to be a data row
+            std::istringstream row(text);
+            float rgb[3];
+            if (!(row >> rgb[0] >> rgb[1] >> rgb[2]))
+                throw parseError(lineNumber, "unknown keyword " + keyword);
+            if (lut.m_size == 0)
+                throw parseError(lineNumber, "data before LUT_3D_SIZE");
+            lut.m_table.insert(lut.m_table.end(), rgb, rgb + 3);
+        }
+    }
+
+    if (lut.m_size == 0)
+        throw std::runtime_error("CubeLUT: missing LUT_3D_SIZE");
+    if (lut.m_table.size() != (size_t)lut.m_size * lut.m_size * lut.m_size * 3)
+        throw std::runtime_error("CubeLUT: expected " +
+            std::to_string((size_t)lut.m_size * lut.m_size * lut.m_size) + " entries, got " +
+            std::to_string(lut.m_table.size() / 3));
+    for (int c = 0; c < 3; c++)
+        if (!(lut.m_domainMax[c] > lut.m_domainMin[c]))
+            throw std::runtime_error("CubeLUT: empty domain");
+    return lut;
+}
+
+CubeLUT CubeLUT::Load(const std::string &fileName)
+{
+    std::ifstream file(fileName);
+    if (!file)
+        throw std::runtime_error("CubeLUT: cannot open " + fileName);
+    return Parse(file);
+}
+
+void CubeLUT::Sample(const float *rgb, float *out) const
+{
+    const uint32_t strides[3] = { 1, m_size, m_size * m_size };
+    uint32_t cell[3];
+    float f[3];
+    for (int c = 0; c < 3; c++)
+    {
+        float t = (rgb[c] - m_domainMin[c]) / (m_domainMax[c] - m_domainMin[c]) * (m_size - 1);
+        t = (std::min)((std::max)(t, 0.0f), (float)(m_size - 1));
+        cell[c] = (std::min)((uint32_t)t, m_size - 2);
+        f[c] = t - cell[c];
+    }
+
+    size_t origin = cell[0] + (size_t)cell[1] * strides[1] + (size_t)cell[2] * strides[2];
+    InterpolateTetrahedral(&m_table[origin * 3], strides, f, 3, out);
+}
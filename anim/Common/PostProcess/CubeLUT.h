@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace DX
+{
+    // 3D colour lookup table in the Adobe/Resolve .cube format. Entries are
+    // RGB triplets with red changing fastest, as in the file.
+    class CubeLUT
+    {
+    public:
+        // size^3 entries mapping the identity
+        static CubeLUT Identity(uint32_t size);
+
+        // Throws std::runtime_error on malformed input or a 1D table
+        static CubeLUT Parse(std::istream &in);
+        static CubeLUT Load(const std::string &fileName);
+
+        // Tetrahedral interpolation of an RGB colour, clamped to the domain
+        void Sample(const float *rgb, float *out) const;
+
+        uint32_t GetSize() const { return m_size; }
+        const std::vector<float> &GetTable() const { return m_table; }
+        const std::string &GetTitle() const { return m_title; }
+        const float *GetDomainMin() const { return m_domainMin; }
+        const float *GetDomainMax() const { return m_domainMax; }
+
+    private:
+        CubeLUT() = default;
+
+        uint32_t m_size = 0;
+        std::string m_title;
+        float m_domainMin[3] = { 0, 0, 0 };
+        float m_domainMax[3] = { 1, 1, 1 };
+        std::vector<float> m_table;
+    };
+
+    // Tetrahedral interpolation inside one cell of a 3D table. c is the
+    // cell origin entry, strides the entry distance along r, g and b, f the
+    // position inside the cell in [0, 1]^3 and channels the floats per entry.
+    inline void InterpolateTetrahedral(const float *c, const uint32_t *strides, const float *f,
+        uint32_t channels, float *out)
+    {
+        // The cell splits into six tetrahedra along its main diagonal; the
+        // one holding f goes through the corners that add the axes in order
+        // of decreasing fraction.
+        uint32_t order[3] = { 0, 1, 2 };
+        if (f[order[0]] < f[order[1]]) std::swap(order[0], order[1]);
+        if (f[order[1]] < f[order[2]]) std::swap(order[1], order[2]);
+        if (f[order[0]] < f[order[1]]) std::swap(order[0], order[1]);
+
+        uint32_t corner1 = strides[order[0]];
+        uint32_t corner2 = corner1 + strides[order[1]];
+        uint32_t corner3 = corner2 + strides[order[2]];
+        float w0 = 1 - f[order[0]];
+        float w1 = f[order[0]] - f[order[1]];
+        float w2 = f[order[1]] - f[order[2]];
+        float w3 = f[order[2]];
+        for (uint32_t k = 0; k < channels; k++)
+            out[k] = w0 * c[k] + w1 * c[corner1 * channels + k] +
+                w2 * c[corner2 * channels + k] + w3 * c[corner3 * channels + k];
+    }
+}
@@ -0,0 +1,242 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#include "ExposureHistogram.h"
+#include "..\SimdMath.h"
+
+using namespace DX;
+
+namespace
+{
+    // Samples handed to one task; small inputs run on the calling thread only
+    const size_t SAMPLES_PER_TASK = 16384;
+
+    // Two point distribution with the mean, variance and skewness of a tile:
+    // weights p and 1 - p above and below the mean. A tile of background
+    // pixels and a few highlights is reproduced exactly.
+    void splitTile(const float *tile, float minVariance, float values[2], float weights[2])
+    {
+        float mean = tile[0], count = tile[1], variance = tile[2];
+        values[0] = values[1] = mean;
+        weights[0] = count;
+        weights[1] = 0;
+        // A spread within a fraction of a bin moves nothing
+        if (!(count > 1) || !(variance > minVariance && variance <= FLT_MAX))
+            return;
+
+        float deviation = std::sqrt(variance);
+        float skewness = tile[3] / (variance * deviation);
+        if (!(std::fabs(skewness) <= FLT_MAX))
+            skewness = 0;
+        // Skewness of the two points is (1 - 2p) / sqrt(p (1 - p)), and
+        // neither side holds less than one pixel
+        float p = 0.5f * (1 - skewness / std::sqrt(4 + skewness * skewness));
+        p = (std::min)((std::max)(p, 1 / count), 1 - 1 / count);
+
+        values[0] = mean + deviation * std::sqrt((1 - p) / p);
+        values[1] = mean - deviation * std::sqrt(p / (1 - p));
+        weights[0] = count * p;
+        weights[1] = count * (1 - p);
+    }
+}
+
+ExposureHistogram::ExposureHistogram(const ExposureHistogramSettings &settings, ThreadPool &pool) :
+    m_settings(settings),
+    m_pool(pool)
+{
+    if (settings.binCount < 64 || settings.binCount > 256)
+        throw std::invalid_argument("ExposureHistogram: bin count must be in [64, 256]");
+    if (!(settings.maxLogBrightness > 0) ||
+        !(settings.lowPercentile >= 0 && settings.lowPercentile < settings.highPercentile &&
+            settings.highPercentile <= 1))
+        throw std::invalid_argument("ExposureHistogram: invalid range or percentiles");
+
+    m_binScale = settings.binCount / settings.maxLogBrightness;
+    m_partials.resize(m_pool.GetConcurrency());
+}
+
+void ExposureHistogram::resetPartials()
+{
+    for (auto &partial : m_partials)
+    {
+        partial.weights.assign(m_settings.binCount, 0.0);
+        partial.sums.assign(m_settings.binCount, 0.0);
+    }
+}
+
+void ExposureHistogram::accumulate(PartialHistogram &partial, const float *values,
+    const int *bins, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        partial.weights[bins[i]] += 1.0;
+        partial.sums[bins[i]] += values[i];
+    }
+}
+
+ExposureResult ExposureHistogram::MeasureColor(const float *rgba, size_t width,
+    size_t height, size_t rowPitch)
+{
+    resetPartials();
+
+    const __m128 binScale = _mm_set1_ps(m_binScale);
+    const __m128 maxValue = _mm_set1_ps(FLT_MAX);
+    const __m128i lastBin = _mm_set1_epi32((int)m_settings.binCount - 1);
+
+    size_t rowsPerTask = (std::max)(SAMPLES_PER_TASK / (std::max)(width, (size_t)1), (size_t)1);
+    size_t taskCount = (height + rowsPerTask - 1) / rowsPerTask;
+
+    m_pool.ParallelFor(taskCount, [&](size_t task, unsigned participant)
+    {
+        PartialHistogram &partial = m_partials[participant];
+        alignas(16) float values[4];
+        alignas(16) int bins[4];
+
+        size_t rowEnd = (std::min)((task + 1) * rowsPerTask, height);
+        for (size_t y = task * rowsPerTask; y < rowEnd; y++)
+        {
+            const float *row = rgba + y * rowPitch;
+            size_t x = 0;
+            for (; x + 4 <= width; x += 4)
+            {
+                // NaN and infinity convert to INT_MIN, they count as black
+                __m128 v = Simd::LogBrightness(row + 4 * x);
+                v = _mm_and_ps(v, _mm_cmple_ps(v, maxValue));
+                __m128i bin = _mm_cvttps_epi32(_mm_mul_ps(v, binScale));
+                // Clamp to the last bin without SSE4.1 min
+                __m128i over = _mm_cmpgt_epi32(bin, lastBin);
+                bin = _mm_or_si128(_mm_and_si128(over, lastBin), _mm_andnot_si128(over, bin));
+
+                _mm_store_ps(values, v);
+                _mm_store_si128((__m128i *)bins, bin);
+                accumulate(partial, values, bins, 4);
+            }
+            for (; x < width; x++)
+            {
+                const float *p = row + 4 * x;
+                float l = 0.2126f * p[0] + 0.7151f * p[1] + 0.0722f * p[2];
+                if (!(l > 0 && l <= FLT_MAX))
+                    l = 0;
+                values[0] = std::log(l + 1);
+                bins[0] = (std::min)((int)(values[0] * m_binScale), (int)m_settings.binCount - 1);
+                accumulate(partial, values, bins, 1);
+            }
+        }
+    });
+
+    return resolve();
+}
+
+ExposureResult ExposureHistogram::MeasureLogBrightness(const float *values, size_t count,
+    size_t stride, const float *weights)
+{
+    resetPartials();
+
+    size_t taskCount = (count + SAMPLES_PER_TASK - 1) / SAMPLES_PER_TASK;
+    m_pool.ParallelFor(taskCount, [&](size_t task, unsigned participant)
+    {
+        PartialHistogram &partial = m_partials[participant];
+
+        size_t end = (std::min)((task + 1) * SAMPLES_PER_TASK, count);
+        for (size_t i = task * SAMPLES_PER_TASK; i < end; i++)
+            addSample(partial, values[i * stride], weights != nullptr ? weights[i * stride] : 1.0f);
+    });
+
+    return resolve();
+}
+
+ExposureResult ExposureHistogram::MeasureTiles(const float *tiles, size_t count, size_t stride)
+{
+    resetPartials();
+
+    float binWidth = 1 / m_binScale;
+    float minVariance = binWidth * binWidth / 16;
+    size_t taskCount = (count + SAMPLES_PER_TASK - 1) / SAMPLES_PER_TASK;
+    m_pool.ParallelFor(taskCount, [&](size_t task, unsigned participant)
+    {
+        PartialHistogram &partial = m_partials[participant];
+
+        size_t end = (std::min)((task + 1) * SAMPLES_PER_TASK, count);
+        for (size_t i = task * SAMPLES_PER_TASK; i < end; i++)
+        {
+            float values[2], weights[2];
+            splitTile(tiles + i * stride, minVariance, values, weights);
+            addSample(partial, values[0], weights[0]);
+            if (weights[1] > 0)
+                addSample(partial, values[1], weights[1]);
+        }
+    });
+
+    return resolve();
+}
+
+void ExposureHistogram::addSample(PartialHistogram &partial, float value, float weight) const
+{
+    // Negative, NaN and infinite values count as black, a broken
+    // weight drops the sample
+    if (!(value > 0 && value <= FLT_MAX))
+        value = 0;
+    if (!(weight >= 0 && weight <= FLT_MAX))
+        return;
+    // Clamped before the conversion, which is undefined out of range
+    int bin = (int)(std::min)(value * m_binScale, (float)(m_settings.binCount - 1));
+    partial.weights[bin] += weight;
+    partial.sums[bin] += (double)value * weight;
+}
+
+ExposureResult ExposureHistogram::resolve()
+{
+    m_weights.assign(m_settings.binCount, 0.0);
+    m_sums.assign(m_settings.binCount, 0.0);
+    for (auto &partial : m_partials)
+        for (uint32_t i = 0; i < m_settings.binCount; i++)
+        {
+            m_weights[i] += partial.weights[i];
+            m_sums[i] += partial.sums[i];
+        }
+
+    double total = 0;
+    for (double w : m_weights)
+        total += w;
+
+    ExposureResult &result = m_lastResult;
+    result = {};
+    if (total <= 0)
+        return result;
+
+    // Keep the weight between the two percentiles, cutting boundary bins proportionally
+    double lowCut = total * m_settings.lowPercentile;
+    double highCut = total * m_settings.highPercentile;
+    double binWidth = 1.0 / m_binScale;
+
+    double cumulative = 0, keptWeight = 0, keptSum = 0;
+    result.minLogBrightness = 0;
+    result.maxLogBrightness = m_settings.maxLogBrightness;
+    for (uint32_t i = 0; i < m_settings.binCount; i++)
+    {
+        double w = m_weights[i];
+        if (w <= 0)
+            continue;
+
+        double begin = cumulative, end = cumulative + w;
+        cumulative = end;
+
+        if (begin <= lowCut && lowCut < end)
+            result.minLogBrightness = (float)((i + (lowCut - begin) / w) * binWidth);
+        if (begin < highCut && highCut <= end)
+            result.maxLogBrightness = (float)((i + (highCut - begin) / w) * binWidth);
+
+        double kept = (std::min)(end, highCut) - (std::max)(begin, lowCut);
+        if (kept <= 0)
+            continue;
+        keptWeight += kept;
+        keptSum += m_sums[i] / w * kept;
+    }
+
+    result.averageLogBrightness = keptWeight > 0 ? (float)(keptSum / keptWeight) : 0.0f;
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "..\ThreadPool.h"
+
+namespace DX
+{
+    // Exposure measurement in the layout of the HDR shader constant buffer.
+    // Log brightness is ln(1 + luminance), as written by LuminanceTilesPixelShader.
+    struct ExposureResult
+    {
+        // Mean log brightness of the pixels kept after percentile rejection
+        float averageLogBrightness;
+        // Log brightness at the low and high rejection percentiles
+        float minLogBrightness;
+        float maxLogBrightness;
+        float dummy;
+    };
+
+    struct ExposureHistogramSettings
+    {
+        // Number of histogram bins, 64 to 256
+        uint32_t binCount = 128;
+        // Upper end of the histogram range, brighter samples go to the last bin
+        float maxLogBrightness = 12.0f;
+        // Darkest fraction of the samples to ignore
+        float lowPercentile = 0.1f;
+        // Fraction of the samples below the bright cut, the rest is ignored
+        float highPercentile = 0.95f;
+    };
+
+    // Log brightness histogram with percentile rejection, so a few very bright
+    // or very dark pixels do not drag the exposure. Input is split into chunks
+    // processed on the thread pool, each participant fills its own histogram
+    // and the histograms are merged at the end.
+    class ExposureHistogram
+    {
+    public:
+        explicit ExposureHistogram(const ExposureHistogramSettings &settings = ExposureHistogramSettings(),
+            ThreadPool &pool = ThreadPool::Default());
+
+        // Measure linear HDR colour: width x height RGBA float pixels, rows rowPitch floats apart
+        ExposureResult MeasureColor(const float *rgba, size_t width, size_t height, size_t rowPitch);
+
+        // Measure values that already hold log brightness, stride floats apart.
+        // Optional weights use the same stride, e.g. pixel counts of reduced texels.
+        ExposureResult MeasureLogBrightness(const float *values, size_t count, size_t stride,
+            const float *weights = nullptr);
+
+        // Measure LuminanceReduction tiles stride floats apart: mean, pixel count,
+        // variance and third central moment. Each tile counts as two values that
+        // match its moments, so a few bright pixels in a tile still fall above
+        // the high percentile instead of raising the tile mean.
+        ExposureResult MeasureTiles(const float *tiles, size_t count, size_t stride);
+
+        const ExposureResult &GetLastResult() const { return m_lastResult; }
+        // Merged histogram of the last measurement: total sample weight per bin
+        const std::vector<double> &GetBins() const { return m_weights; }
+        const ExposureHistogramSettings &GetSettings() const { return m_settings; }
+
+    private:
+        struct PartialHistogram
+        {
+            std::vector<double> weights;
+            std::vector<double> sums;
+        };
+
+        void resetPartials();
+        void accumulate(PartialHistogram &partial, const float *values, const int *bins, size_t count);
+        void addSample(PartialHistogram &partial, float value, float weight) const;
+        ExposureResult resolve();
+
+        ExposureHistogramSettings m_settings;
+        ThreadPool &m_pool;
+        float m_binScale;
+
+        std::vector<PartialHistogram> m_partials;
+        std::vector<double> m_weights;
+        std::vector<double> m_sums;
+        ExposureResult m_lastResult = {};
+    };
+}
@@ -0,0 +1,30 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "LuminanceAdaptation.h"
+
+using namespace DX;
+
+float LuminanceAdaptation::Update(float target, double elapsedSeconds, double sampleAgeSeconds)
+{
+    if (!m_initialized)
+    {
+        Reset(target);
+        return m_adapted;
+    }
+
+    // Never let the lag compensation make adaptation instantaneous
+    double minTime = m_adaptationTime * 0.25;
+    double time = (std::max)(m_adaptationTime - (std::max)(sampleAgeSeconds, 0.0), minTime);
+
+    m_adapted += (target - m_adapted) * (float)(1 - std::exp(-elapsedSeconds / time));
+    return m_adapted;
+}
+
+void LuminanceAdaptation::Reset(float value)
+{
+    m_adapted = value;
+    m_initialized = true;
+}
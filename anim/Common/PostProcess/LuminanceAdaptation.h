@@ -0,0 +1,35 @@
+#pragma once
+
+namespace DX
+{
+    // Exponential eye adaptation towards a measured average log brightness.
+    // Measurements come from GPU readbacks that are a few frames old, so the
+    // time constant is shortened by the sample age: the response to a step in
+    // scene brightness then reaches 63% after adaptationTime seconds of wall
+    // clock time no matter how far the GPU runs behind.
+    class LuminanceAdaptation
+    {
+    public:
+        explicit LuminanceAdaptation(float adaptationTime = 2) :
+            m_adaptationTime(adaptationTime)
+        {
+        }
+
+        // Advance adaptation by elapsedSeconds towards target, which was
+        // measured sampleAgeSeconds ago. Returns the adapted value.
+        float Update(float target, double elapsedSeconds, double sampleAgeSeconds);
+
+        // Jump straight to value, e.g. for the first measurement
+        void Reset(float value);
+
+        bool IsInitialized() const { return m_initialized; }
+        float GetAdapted() const { return m_adapted; }
+        float GetAdaptationTime() const { return m_adaptationTime; }
+        void SetAdaptationTime(float adaptationTime) { m_adaptationTime = adaptationTime; }
+
+    private:
+        float m_adaptationTime;
+        float m_adapted = 0;
+        bool m_initialized = false;
+    };
+}
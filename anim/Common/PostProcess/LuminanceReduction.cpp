@@ -0,0 +1,126 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "LuminanceReduction.h"
+#include "..\SimdMath.h"
+
+using namespace DX;
+
+namespace
+{
+    float scalarLogBrightness(const float *p)
+    {
+        float l = (std::max)(0.2126f * p[0] + 0.7151f * p[1] + 0.0722f * p[2], 0.0f);
+        return std::log(l + 1.0f);
+    }
+}
+
+LuminanceReduction::LuminanceReduction(uint32_t maxGridSize, ThreadPool &pool) :
+    m_maxGridSize(maxGridSize),
+    m_pool(pool)
+{
+    if (maxGridSize == 0)
+        throw std::invalid_argument("LuminanceReduction: empty grid");
+}
+
+uint32_t LuminanceReduction::ComputeTileSize(uint32_t width, uint32_t height,
+    uint32_t maxGridSize)
+{
+    uint32_t maxDim = (std::max)((std::max)(width, height), 1u);
+    return (maxDim + maxGridSize - 1) / maxGridSize;
+}
+
+LuminanceReductionResult LuminanceReduction::Reduce(const float *rgba, uint32_t width,
+    uint32_t height, size_t rowPitch)
+{
+    m_tileSize = ComputeTileSize(width, height, m_maxGridSize);
+    m_gridWidth = (width + m_tileSize - 1) / m_tileSize;
+    m_gridHeight = (height + m_tileSize - 1) / m_tileSize;
+
+    size_t tileCount = (size_t)m_gridWidth * m_gridHeight;
+    m_tileSums.assign(tileCount, 0.0);
+    m_tiles.assign(tileCount * 4, 0.0f);
+
+    // One task per tile row keeps every task's reads in the same rows of the image
+    m_pool.ParallelFor(m_gridHeight, [&](size_t tileY, unsigned)
+    {
+        uint32_t y0 = (uint32_t)tileY * m_tileSize;
+        uint32_t y1 = (std::min)(y0 + m_tileSize, height);
+
+        for (uint32_t tileX = 0; tileX < m_gridWidth; tileX++)
+        {
+            uint32_t x0 = tileX * m_tileSize;
+            uint32_t x1 = (std::min)(x0 + m_tileSize, width);
+
+            // Moments are summed around the first pixel of the tile, which keeps
+            // the central moments accurate when the tile is nearly uniform
+            float shift = scalarLogBrightness(rgba + y0 * rowPitch + 4 * x0);
+            const __m128 shift4 = _mm_set1_ps(shift);
+            double moments[3] = {};
+            for (uint32_t y = y0; y < y1; y++)
+            {
+                const float *row = rgba + y * rowPitch;
+                __m128 sum1 = _mm_setzero_ps(), sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+                uint32_t x = x0;
+                for (; x + 4 <= x1; x += 4)
+                {
+                    __m128 d = _mm_sub_ps(Simd::LogBrightness(row + 4 * x), shift4);
+                    __m128 d2 = _mm_mul_ps(d, d);
+                    sum1 = _mm_add_ps(sum1, d);
+                    sum2 = _mm_add_ps(sum2, d2);
+                    sum3 = _mm_add_ps(sum3, _mm_mul_ps(d2, d));
+                }
+
+                alignas(16) float lanes[3][4];
+                _mm_store_ps(lanes[0], sum1);
+                _mm_store_ps(lanes[1], sum2);
+                _mm_store_ps(lanes[2], sum3);
+                for (int k = 0; k < 3; k++)
+                    moments[k] += (double)lanes[k][0] + lanes[k][1] + lanes[k][2] + lanes[k][3];
+                for (; x < x1; x++)
+                {
+                    double d = scalarLogBrightness(row + 4 * x) - shift;
+                    moments[0] += d;
+                    moments[1] += d * d;
+                    moments[2] += d * d * d;
+                }
+            }
+
+            size_t tile = tileY * m_gridWidth + tileX;
+            uint32_t count = (x1 - x0) * (y1 - y0);
+            double m1 = moments[0] / count, m2 = moments[1] / count, m3 = moments[2] / count;
+            m_tileSums[tile] = (double)shift * count + moments[0];
+            m_tiles[4 * tile] = (float)(shift + m1);
+            m_tiles[4 * tile + 1] = (float)count;
+            m_tiles[4 * tile + 2] = (float)(std::max)(m2 - m1 * m1, 0.0);
+            m_tiles[4 * tile + 3] = (float)(m3 - 3 * m1 * m2 + 2 * m1 * m1 * m1);
+        }
+    });
+
+    // Combine in grid order so the result does not depend on the thread count
+    LuminanceReductionResult result = {};
+    for (double sum : m_tileSums)
+        result.logBrightnessSum += sum;
+    result.pixelCount = (uint64_t)width * height;
+    result.averageLogBrightness = result.pixelCount > 0 ?
+        (float)(result.logBrightnessSum / result.pixelCount) : 0.0f;
+    return result;
+}
+
+LuminanceReductionResult LuminanceReduction::Combine(const float *tiles, size_t count,
+    size_t stride)
+{
+    LuminanceReductionResult result = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        const float *tile = tiles + i * stride;
+        result.logBrightnessSum += (double)tile[0] * tile[1];
+        result.pixelCount += (uint64_t)tile[1];
+    }
+    result.averageLogBrightness = result.pixelCount > 0 ?
+        (float)(result.logBrightnessSum / result.pixelCount) : 0.0f;
+    return result;
+}
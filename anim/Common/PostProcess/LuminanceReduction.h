@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "..\ThreadPool.h"
+
+namespace DX
+{
+    struct LuminanceReductionResult
+    {
+        // Sum of ln(1 + luminance) over every pixel
+        double logBrightnessSum;
+        uint64_t pixelCount;
+        float averageLogBrightness;
+    };
+
+    // Exact mean log brightness of an image in a single pass. The image is
+    // split into a grid of at most maxGridSize x maxGridSize square tiles,
+    // each tile is summed independently and the partial sums are combined in
+    // grid order. Edge tiles simply cover fewer pixels, so every pixel has the
+    // same weight whatever the resolution.
+    //
+    // Every tile also keeps the variance and third central moment of its
+    // pixels, so the exposure histogram can tell a few bright pixels from a
+    // uniformly brighter tile.
+    //
+    // LuminanceTilesPixelShader performs the same tiling on the GPU and writes
+    // one (mean, pixel count, variance, third moment) texel per tile;
+    // GetTiles() has the same layout.
+    class LuminanceReduction
+    {
+    public:
+        explicit LuminanceReduction(uint32_t maxGridSize = 64,
+            ThreadPool &pool = ThreadPool::Default());
+
+        // Smallest tile side that fits the image into a maxGridSize grid
+        static uint32_t ComputeTileSize(uint32_t width, uint32_t height, uint32_t maxGridSize);
+
+        // Reduce width x height RGBA float pixels whose rows are rowPitch floats apart
+        LuminanceReductionResult Reduce(const float *rgba, uint32_t width, uint32_t height,
+            size_t rowPitch);
+
+        // Final combine of (mean, pixel count) tiles, stride floats apart
+        static LuminanceReductionResult Combine(const float *tiles, size_t count, size_t stride);
+
+        // Tiles of the last Reduce call, four floats per tile: mean, pixel count,
+        // variance and third central moment of the log brightness
+        const std::vector<float> &GetTiles() const { return m_tiles; }
+        uint32_t GetTileSize() const { return m_tileSize; }
+        uint32_t GetGridWidth() const { return m_gridWidth; }
+        uint32_t GetGridHeight() const { return m_gridHeight; }
+
+    private:
+        uint32_t m_maxGridSize;
+        ThreadPool &m_pool;
+
+        uint32_t m_tileSize = 0;
+        uint32_t m_gridWidth = 0;
+        uint32_t m_gridHeight = 0;
+        std::vector<double> m_tileSums;
+        std::vector<float> m_tiles;
+    };
+}
@@ -0,0 +1,131 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "SparseLuminanceEstimator.h"
+#include "..\SimdMath.h"
+
+using namespace DX;
+
+namespace
+{
+    // Candidates tried per point by the best candidate algorithm
+    const uint32_t CANDIDATES_PER_POINT = 16;
+
+    // Squared distance on the unit torus, so the pattern tiles and can be shifted
+    float ToroidalDistance2(float ax, float ay, float bx, float by)
+    {
+        float dx = std::fabs(ax - bx), dy = std::fabs(ay - by);
+        dx = (std::min)(dx, 1 - dx);
+        dy = (std::min)(dy, 1 - dy);
+        return dx * dx + dy * dy;
+    }
+}
+
+SparseLuminanceEstimator::SparseLuminanceEstimator(uint32_t sampleCount, uint32_t seed)
+{
+    if (sampleCount == 0)
+        throw std::invalid_argument("SparseLuminanceEstimator: no samples");
+
+    // Mitchell's best candidate: every new point is the one of a few random
+    // candidates farthest from the points placed so far, which gives a blue
+    // noise distribution. Deterministic for a given seed.
+    uint32_t state = seed;
+    auto random = [&state]()
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    };
+
+    m_points.reserve(sampleCount * 2);
+    for (uint32_t i = 0; i < sampleCount; i++)
+    {
+        float bestX = 0, bestY = 0, bestDistance = -1;
+        for (uint32_t c = 0; c < CANDIDATES_PER_POINT; c++)
+        {
+            float x = random(), y = random();
+            float nearest = 2;
+            for (size_t p = 0; p < m_points.size(); p += 2)
+                nearest = (std::min)(nearest, ToroidalDistance2(x, y, m_points[p], m_points[p + 1]));
+            if (nearest > bestDistance)
+            {
+                bestDistance = nearest;
+                bestX = x;
+                bestY = y;
+            }
+        }
+        m_points.push_back(bestX);
+        m_points.push_back(bestY);
+    }
+}
+
+void SparseLuminanceEstimator::GetFrameOffset(uint64_t frame, float &x, float &y)
+{
+    // R2 sequence, 1 / g and 1 / g^2 with g the plastic number
+    const double a1 = 0.7548776662466927, a2 = 0.5698402909980532;
+    x = (float)std::fmod(frame * a1, 1.0);
+    y = (float)std::fmod(frame * a2, 1.0);
+}
+
+void SparseLuminanceEstimator::GetSamplePixel(uint32_t sample, uint64_t frame,
+    uint32_t width, uint32_t height, uint32_t &x, uint32_t &y) const
+{
+    float offsetX, offsetY;
+    GetFrameOffset(frame, offsetX, offsetY);
+
+    float u = m_points[sample * 2] + offsetX, v = m_points[sample * 2 + 1] + offsetY;
+    u -= std::floor(u);
+    v -= std::floor(v);
+    x = (std::min)((uint32_t)(u * width), width - 1);
+    y = (std::min)((uint32_t)(v * height), height - 1);
+}
+
+SparseLuminanceEstimate SparseLuminanceEstimator::Estimate(const float *rgba,
+    uint32_t width, uint32_t height, size_t rowPitch, uint64_t frame) const
+{
+    uint32_t count = GetSampleCount();
+    std::vector<float> values((count + 3) & ~3u);
+
+    // Gather four pixels at a time and convert them like the full reduction does
+    alignas(16) float gathered[16];
+    for (uint32_t i = 0; i < count; i += 4)
+    {
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            uint32_t x = 0, y = 0;
+            if (i + k < count)
+                GetSamplePixel(i + k, frame, width, height, x, y);
+            const float *pixel = rgba + y * rowPitch + x * 4;
+            std::copy(pixel, pixel + 4, gathered + k * 4);
+        }
+        _mm_storeu_ps(values.data() + i, Simd::LogBrightness(gathered));
+    }
+
+    SparseLuminanceEstimate result = Summarize(values.data(), count, 1);
+    result.bytesRead = (uint64_t)count * 4 * sizeof(float);
+    return result;
+}
+
+SparseLuminanceEstimate SparseLuminanceEstimator::Summarize(const float *values, size_t count, size_t stride)
+{
+    SparseLuminanceEstimate result;
+    result.sampleCount = (uint32_t)count;
+    if (count == 0)
+        return result;
+
+    double sum = 0, sumSquares = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        double v = values[i * stride];
+        sum += v;
+        sumSquares += v * v;
+    }
+
+    double mean = sum / count;
+    double variance = count > 1 ? (std::max)((sumSquares - sum * mean) / (count - 1), 0.0) : 0.0;
+    result.averageLogBrightness = (float)mean;
+    result.standardError = (float)std::sqrt(variance / count);
+    return result;
+}
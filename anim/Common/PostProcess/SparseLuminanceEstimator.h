@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+    struct SparseLuminanceEstimate
+    {
+        // Mean ln(1 + luminance) over the samples
+        float averageLogBrightness = 0;
+        // Standard error of that mean for independent samples. Blue noise
+        // samples are stratified, so the actual error is usually smaller.
+        float standardError = 0;
+        uint32_t sampleCount = 0;
+        // Scene bytes read to produce the estimate
+        uint64_t bytesRead = 0;
+
+        // Half width of the confidence interval around the full resolution mean,
+        // z = 1.96 for 95%
+        float GetErrorBound(float z = 1.96f) const { return standardError * z; }
+    };
+
+    // Estimates the mean log brightness from a fixed set of K blue noise
+    // sample positions instead of every pixel. The point set is shifted
+    // toroidally by an R2 sequence every frame, so over time the samples
+    // cover the whole image while each frame keeps its blue noise spacing.
+    //
+    // LuminanceSamplesPixelShader reads the same positions on the GPU and
+    // writes one (log brightness, 1) texel per sample, the layout of the
+    // luminance tiles.
+    class SparseLuminanceEstimator
+    {
+    public:
+        explicit SparseLuminanceEstimator(uint32_t sampleCount = 1024, uint32_t seed = 1);
+
+        // Sample positions in [0, 1)^2, two floats per sample
+        const std::vector<float> &GetPoints() const { return m_points; }
+        uint32_t GetSampleCount() const { return (uint32_t)(m_points.size() / 2); }
+
+        // Toroidal shift of the point set for a frame
+        static void GetFrameOffset(uint64_t frame, float &x, float &y);
+
+        // Pixel a sample falls on for the given frame
+        void GetSamplePixel(uint32_t sample, uint64_t frame, uint32_t width, uint32_t height,
+            uint32_t &x, uint32_t &y) const;
+
+        // Estimate over width x height RGBA float pixels whose rows are rowPitch floats apart
+        SparseLuminanceEstimate Estimate(const float *rgba, uint32_t width, uint32_t height,
+            size_t rowPitch, uint64_t frame) const;
+
+        // Mean and standard error of log brightness samples stride floats apart
+        static SparseLuminanceEstimate Summarize(const float *values, size_t count, size_t stride);
+
+        // Scene bytes the full resolution reduction reads for one frame
+        static uint64_t GetFullResolutionBytesRead(uint32_t width, uint32_t height)
+        {
+            return (uint64_t)width * height * 4 * sizeof(float);
+        }
+
+    private:
+        std::vector<float> m_points;
+    };
+}
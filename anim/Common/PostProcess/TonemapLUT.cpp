@@ -0,0 +1,126 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "TonemapLUT.h"
+#include "..\SimdMath.h"
+
+using namespace DX;
+
+TonemapLUT::TonemapLUT(uint32_t size, float minLog2, float maxLog2, float gamma,
+    const FilmicCurve &curve) :
+    m_curve(curve),
+    m_minLog2(minLog2),
+    m_maxLog2(maxLog2),
+    m_invGamma(1 / gamma)
+{
+    if (size < 2 || !(maxLog2 > minLog2) || !(gamma > 0))
+        throw std::invalid_argument("TonemapLUT: invalid table parameters");
+
+    // Constant part of the curve, evaluated once instead of per pixel
+    m_whiteScale = 1 / m_curve.Evaluate(m_curve.W);
+    m_step = (size - 1) / (maxLog2 - minLog2);
+
+    m_table.resize(size);
+    for (uint32_t i = 0; i < size; i++)
+        m_table[i] = EvaluateDirect(std::exp2(minLog2 + i / m_step));
+}
+
+float TonemapLUT::EvaluateDirect(float x) const
+{
+    float mapped = (std::max)(m_curve.Evaluate(x) * m_whiteScale, 0.0f);
+    return std::pow(mapped, m_invGamma);
+}
+
+float TonemapLUT::ComputeExposure(float averageLogBrightness)
+{
+    float l = std::exp(averageLogBrightness) - 1;
+    float keyValue = 1.03f - 2 / (2 + std::log10(l + 1));
+    // The shader divided by zero on a black frame, keep the exposure finite instead
+    return keyValue / (std::min)((std::max)(l, 1e-4f), 9999.0f);
+}
+
+float TonemapLUT::Apply(float x) const
+{
+    float t = (std::log2((std::max)(x, 1e-30f)) - m_minLog2) * m_step;
+    t = (std::min)((std::max)(t, 0.0f), (float)(m_table.size() - 1));
+
+    uint32_t i = (std::min)((uint32_t)t, (uint32_t)m_table.size() - 2);
+    float frac = t - i;
+    return m_table[i] + (m_table[i + 1] - m_table[i]) * frac;
+}
+
+void TonemapLUT::Apply(const float *rgbaIn, float *rgbaOut, size_t pixelCount, float exposure) const
+{
+    const __m128 tiny = _mm_set1_ps(1e-30f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 step = _mm_set1_ps(m_step);
+    // Exposure folded into the log space offset
+    const __m128 offset = _mm_set1_ps((std::log2(exposure) - m_minLog2) * m_step);
+    const __m128 last = _mm_set1_ps((float)(m_table.size() - 1));
+    const __m128 lastEntry = _mm_set1_ps((float)(m_table.size() - 2));
+    const float *table = m_table.data();
+
+    alignas(16) int indices[4];
+    alignas(16) float lo[4];
+    alignas(16) float hi[4];
+
+    size_t p = 0;
+    for (; p + 4 <= pixelCount; p += 4)
+    {
+        // Four pixels at a time, one per lane
+        __m128 r = _mm_loadu_ps(rgbaIn + 4 * p);
+        __m128 g = _mm_loadu_ps(rgbaIn + 4 * p + 4);
+        __m128 b = _mm_loadu_ps(rgbaIn + 4 * p + 8);
+        __m128 a = _mm_loadu_ps(rgbaIn + 4 * p + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        __m128 channels[3] = { r, g, b };
+
+        for (int c = 0; c < 3; c++)
+        {
+            __m128 t = _mm_add_ps(_mm_mul_ps(Simd::Log2(_mm_max_ps(channels[c], tiny)), step), offset);
+            t = _mm_min_ps(_mm_max_ps(t, zero), last);
+            // t is never negative, truncation is floor
+            __m128 entry = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(t)), lastEntry);
+            __m128 frac = _mm_sub_ps(t, entry);
+
+            // SSE2 has no gather, fetch the two neighbours per lane
+            _mm_store_si128((__m128i *)indices, _mm_cvttps_epi32(entry));
+            for (int k = 0; k < 4; k++)
+            {
+                lo[k] = table[indices[k]];
+                hi[k] = table[indices[k] + 1];
+            }
+
+            __m128 l = _mm_load_ps(lo);
+            channels[c] = _mm_add_ps(l, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(hi), l), frac));
+        }
+
+        r = channels[0];
+        g = channels[1];
+        b = channels[2];
+        a = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        _mm_storeu_ps(rgbaOut + 4 * p, r);
+        _mm_storeu_ps(rgbaOut + 4 * p + 4, g);
+        _mm_storeu_ps(rgbaOut + 4 * p + 8, b);
+        _mm_storeu_ps(rgbaOut + 4 * p + 12, a);
+    }
+
+    for (; p < pixelCount; p++)
+    {
+        for (int c = 0; c < 3; c++)
+            rgbaOut[4 * p + c] = Apply(rgbaIn[4 * p + c] * exposure);
+        rgbaOut[4 * p + 3] = 1;
+    }
+}
+
+void TonemapLUT::GetTextureMapping(float exposure, float &scale, float &offset) const
+{
+    // Texel centers sit at (i + 0.5) / size, entry i is at log2 value minLog2 + i / step
+    float size = (float)m_table.size();
+    scale = m_step / size;
+    offset = ((std::log2(exposure) - m_minLog2) * m_step + 0.5f) / size;
+}
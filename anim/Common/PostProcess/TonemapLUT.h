@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+    // Uncharted 2 filmic curve as used by the HDR pass
+    struct FilmicCurve
+    {
+        float A = 0.1f;  // Shoulder Strength
+        float B = 0.50f; // Linear Strength
+        float C = 0.1f;  // Linear Angle
+        float D = 0.20f; // Toe Strength
+        float E = 0.02f; // Toe Numerator
+        float F = 0.30f; // Toe Denominator
+                         // Note: E/F = Toe Angle
+        float W = 11.2f; // Linear White Point Value
+
+        float Evaluate(float x) const
+        {
+            return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+        }
+    };
+
+    // Filmic tonemapping with white point scale and display gamma baked into
+    // a 1D table over log2 of the exposed colour. Exposure is a multiplication
+    // in linear space, so in log space it only shifts the lookup and the table
+    // never has to be rebuilt when the exposure changes.
+    class TonemapLUT
+    {
+    public:
+        explicit TonemapLUT(uint32_t size = 256, float minLog2 = -20.0f, float maxLog2 = 8.0f,
+            float gamma = 2.2f, const FilmicCurve &curve = FilmicCurve());
+
+        // Reference evaluation of the baked curve for an exposed colour channel
+        float EvaluateDirect(float x) const;
+
+        // Exposure from the adapted average log brightness, same as the HDR shader used to compute per pixel
+        static float ComputeExposure(float averageLogBrightness);
+
+        // Table look up of one exposed colour channel
+        float Apply(float x) const;
+
+        // Tonemap pixelCount RGBA pixels with the given exposure, alpha is set to 1.
+        // in and out may alias.
+        void Apply(const float *rgbaIn, float *rgbaOut, size_t pixelCount, float exposure) const;
+
+        // Texture coordinate mapping for sampling the table as a texture of
+        // GetSize() texels: u = log2(colour) * scale + offset, exposure included
+        void GetTextureMapping(float exposure, float &scale, float &offset) const;
+
+        const std::vector<float> &GetTable() const { return m_table; }
+        uint32_t GetSize() const { return (uint32_t)m_table.size(); }
+
+    private:
+        FilmicCurve m_curve;
+        float m_minLog2;
+        float m_maxLog2;
+        float m_invGamma;
+        float m_whiteScale;
+        // Table entries per log2 unit
+        float m_step;
+
+        std::vector<float> m_table;
+    };
+}
@@ -0,0 +1,64 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "RasterTarget.h"
+
+using namespace DX;
+
+RasterTarget::RasterTarget(uint32_t width, uint32_t height) :
+    m_width(width),
+    m_height(height),
+    m_pitch((width + 3) & ~3u),
+    m_color((size_t)m_pitch * height * 4, 0.0f),
+    m_depth((size_t)m_pitch * height, 1.0f)
+{
+}
+
+void RasterTarget::Clear(const float *color, float depth)
+{
+    for (size_t i = 0; i < m_color.size(); i += 4)
+        std::copy(color, color + 4, &m_color[i]);
+    std::fill(m_depth.begin(), m_depth.end(), depth);
+}
+
+void RasterTarget::Sample(float u, float v, bool wrapU, float *rgba) const
+{
+    // Texel centres sit at half coordinates
+    float x = u * m_width - 0.5f;
+    float y = v * m_height - 0.5f;
+    float x0f = std::floor(x);
+    float y0f = std::floor(y);
+    float fx = x - x0f;
+    float fy = y - y0f;
+
+    auto column = [&](int32_t c)
+    {
+        if (wrapU)
+        {
+            c %= (int32_t)m_width;
+            return (uint32_t)(c < 0 ? c + (int32_t)m_width : c);
+        }
+        return (uint32_t)(std::min)((std::max)(c, 0), (int32_t)m_width - 1);
+    };
+    auto row = [&](int32_t r)
+    {
+        return (uint32_t)(std::min)((std::max)(r, 0), (int32_t)m_height - 1);
+    };
+
+    uint32_t c0 = column((int32_t)x0f);
+    uint32_t c1 = column((int32_t)x0f + 1);
+    uint32_t r0 = row((int32_t)y0f);
+    uint32_t r1 = row((int32_t)y0f + 1);
+    const float *p00 = &m_color[((size_t)r0 * m_pitch + c0) * 4];
+    const float *p01 = &m_color[((size_t)r0 * m_pitch + c1) * 4];
+    const float *p10 = &m_color[((size_t)r1 * m_pitch + c0) * 4];
+    const float *p11 = &m_color[((size_t)r1 * m_pitch + c1) * 4];
+    for (int c = 0; c < 4; c++)
+    {
+        float top = p00[c] + (p01[c] - p00[c]) * fx;
+        float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+        rgba[c] = top + (bottom - top) * fy;
+    }
+}
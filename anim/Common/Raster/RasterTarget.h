@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+    // Color and depth planes a SoftwareRasterizer draws into, the CPU side
+    // of a render target and its depth buffer. Color is RGBA float like the
+    // HDR scene target. Rows are padded to whole groups of four pixels, so
+    // the rasterizer can load four depths at a time anywhere in a row.
+    //
+    // Targets double as textures: once drawn, Sample reads them back for
+    // the shaders of a later pass.
+    class RasterTarget
+    {
+    public:
+        RasterTarget(uint32_t width, uint32_t height);
+
+        void Clear(const float *color, float depth = 1.0f);
+
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        // Pixels from one row to the next, in both planes
+        uint32_t GetPitch() const { return m_pitch; }
+
+        float *GetColor() { return m_color.data(); }
+        const float *GetColor() const { return m_color.data(); }
+        float *GetDepth() { return m_depth.data(); }
+        const float *GetDepth() const { return m_depth.data(); }
+
+        // Bilinear lookup with (0, 0) the top left corner and (1, 1) the
+        // bottom right one. Rows clamp at the edges; columns wrap when wrapU
+        // is set, for longitude-latitude maps, and clamp otherwise.
+        void Sample(float u, float v, bool wrapU, float *rgba) const;
+
+    private:
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_pitch;
+        std::vector<float> m_color;
+        std::vector<float> m_depth;
+    };
+}
@@ -0,0 +1,520 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <emmintrin.h>
+
+#include "SoftwareRasterizer.h"
+
+using namespace DX;
+
+namespace
+{
+    const int32_t SUBPIXEL_BITS = 4;
+    const float SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+    // Screen positions stay this many pixels around the origin, which keeps
+    // an edge function in 32 bits anywhere in a tile, see rasterize
+    const float GUARD_BAND = 16384.0f;
+    const int64_t EDGE_LIMIT = (int64_t)1 << 30;
+    // Vertices or triangles per thread pool task
+    const uint32_t CHUNK_SIZE = 1024;
+    // Homogeneous clipping against six planes adds at most one vertex each
+    const int MAX_CLIP_VERTICES = 9;
+
+    typedef SoftwareRasterizer::Vertex Vertex;
+
+    // Signed distance of a clip space position to the inside of a plane:
+    // near, far, then the guard band on both sides in x and y
+    float planeDistance(const float *p, int plane, float guardX, float guardY)
+    {
+        switch (plane)
+        {
+        case 0: return p[2];
+        case 1: return p[3] - p[2];
+        case 2: return guardX * p[3] + p[0];
+        case 3: return guardX * p[3] - p[0];
+        case 4: return guardY * p[3] + p[1];
+        default: return guardY * p[3] - p[1];
+        }
+    }
+
+    void lerpVertex(const Vertex &a, const Vertex &b, float t, uint32_t varyingCount, Vertex &output)
+    {
+        for (int c = 0; c < 4; c++)
+            output.position[c] = a.position[c] + (b.position[c] - a.position[c]) * t;
+        for (uint32_t v = 0; v < varyingCount; v++)
+            output.varyings[v] = a.varyings[v] + (b.varyings[v] - a.varyings[v]) * t;
+    }
+
+    // Sutherland-Hodgman against every plane some vertex is outside of,
+    // returns the number of polygon vertices left in polygon
+    int clipPolygon(Vertex (&polygon)[MAX_CLIP_VERTICES], int count, uint32_t planes, float guardX,
+        float guardY, uint32_t varyingCount)
+    {
+        Vertex scratch[MAX_CLIP_VERTICES];
+        for (int plane = 0; plane < 6 && count > 0; plane++)
+        {
+            if (!(planes & (1u << plane)))
+                continue;
+
+            int written = 0;
+            for (int i = 0; i < count; i++)
+            {
+                const Vertex &current = polygon[i];
+                const Vertex &next = polygon[(i + 1) % count];
+                float d0 = planeDistance(current.position, plane, guardX, guardY);
+                float d1 = planeDistance(next.position, plane, guardX, guardY);
+                if (d0 >= 0)
+                    scratch[written++] = current;
+                if ((d0 >= 0) != (d1 >= 0))
+                    lerpVertex(current, next, d0 / (d0 - d1), varyingCount, scratch[written++]);
+            }
+            count = written;
+            std::copy(scratch, scratch + count, polygon);
+        }
+        return count;
+    }
+}
+
+struct SoftwareRasterizer::Draw
+{
+    PixelShader pixelShader;
+    bool depthTest;
+    bool depthWrite;
+    uint32_t varyingCount;
+};
+
+struct SoftwareRasterizer::Triangle
+{
+    const Draw *draw;
+    uint32_t instance;
+    uint32_t batch;
+    uint32_t varyingOffset;
+    // Clockwise on screen, in 1/16 pixels
+    int32_t x[3];
+    int32_t y[3];
+    // Pixels whose centres may be covered, inclusive and inside the target
+    int32_t minX, minY, maxX, maxY;
+    // Screen-linear values as value at vertex 0 plus gradients per pixel:
+    // the barycentric weights of vertex 1 and 2, depth and 1 / w
+    float originX, originY;
+    float b1dx, b1dy, b2dx, b2dy;
+    float z, zdx, zdy;
+    float invW, invWdx, invWdy;
+};
+
+struct SoftwareRasterizer::Batch
+{
+    std::vector<Triangle> triangles;
+    // Per triangle and varying: value / w at vertex 0, then the differences
+    // of vertex 1 and 2 to it
+    std::vector<float> varyings;
+    uint64_t assembled = 0;
+    uint64_t culled = 0;
+    uint64_t clipped = 0;
+};
+
+SoftwareRasterizer::SoftwareRasterizer(ThreadPool &pool) :
+    m_pool(pool)
+{
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+}
+
+void SoftwareRasterizer::SetRenderTarget(RasterTarget *target)
+{
+    Flush();
+    if (target && (target->GetWidth() > GUARD_BAND / 2 || target->GetHeight() > GUARD_BAND / 2))
+        throw std::invalid_argument("SoftwareRasterizer: render target too large");
+    m_target = target;
+}
+
+void SoftwareRasterizer::SetDepthState(bool test, bool write)
+{
+    m_depthTest = test;
+    m_depthWrite = write;
+}
+
+void SoftwareRasterizer::SetShaders(const VertexShader &vertexShader, const PixelShader &pixelShader,
+    uint32_t varyingCount)
+{
+    if (varyingCount > MAX_VARYINGS)
+        throw std::invalid_argument("SoftwareRasterizer: too many varyings");
+    m_vertexShader = vertexShader;
+    m_pixelShader = pixelShader;
+    m_varyingCount = varyingCount;
+}
+
+void SoftwareRasterizer::DrawIndexedInstanced(const uint32_t *indices, uint32_t indexCount,
+    uint32_t instanceCount, int32_t baseVertex, uint32_t startInstance)
+{
+    if (!m_target)
+        throw std::logic_error("SoftwareRasterizer: no render target");
+    uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || instanceCount == 0)
+        return;
+
+    m_draws.push_back(std::unique_ptr<Draw>(new Draw{ m_pixelShader, m_depthTest, m_depthWrite, m_varyingCount }));
+    const Draw *draw = m_draws.back().get();
+
+    // Shade every vertex the indices reach once per instance
+    uint32_t minIndex = *std::min_element(indices, indices + triangleCount * 3);
+    uint32_t maxIndex = *std::max_element(indices, indices + triangleCount * 3);
+    uint32_t vertexCount = maxIndex - minIndex + 1;
+    uint32_t vertexChunks = (vertexCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    // Only ever grows, every element is written before it is read
+    if (m_vertices.size() < (size_t)vertexCount * instanceCount)
+        m_vertices.resize((size_t)vertexCount * instanceCount);
+    m_pool.ParallelFor((size_t)vertexChunks * instanceCount, [&](size_t task, unsigned)
+    {
+        uint32_t instance = (uint32_t)(task / vertexChunks);
+        uint32_t first = (uint32_t)(task % vertexChunks) * CHUNK_SIZE;
+        uint32_t last = (std::min)(first + CHUNK_SIZE, vertexCount);
+        Vertex *vertices = &m_vertices[(size_t)instance * vertexCount];
+        for (uint32_t v = first; v < last; v++)
+            m_vertexShader((uint32_t)((int64_t)minIndex + v + baseVertex), startInstance + instance, vertices[v]);
+    });
+
+    // Assemble, clip and set up triangles, one batch per task
+    uint32_t triangleChunks = (triangleCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    size_t firstBatch = m_batchCount;
+    m_batchCount += (size_t)triangleChunks * instanceCount;
+    while (m_batches.size() < m_batchCount)
+        m_batches.emplace_back(new Batch());
+
+    m_pool.ParallelFor((size_t)triangleChunks * instanceCount, [&](size_t task, unsigned)
+    {
+        uint32_t batchIndex = (uint32_t)(firstBatch + task);
+        Batch &batch = *m_batches[batchIndex];
+        batch.triangles.clear();
+        batch.varyings.clear();
+        batch.assembled = batch.culled = batch.clipped = 0;
+
+        uint32_t instance = (uint32_t)(task / triangleChunks);
+        uint32_t first = (uint32_t)(task % triangleChunks) * CHUNK_SIZE;
+        uint32_t last = (std::min)(first + CHUNK_SIZE, triangleCount);
+        const Vertex *vertices = &m_vertices[(size_t)instance * vertexCount];
+        float guardX = 2 * GUARD_BAND / m_target->GetWidth() - 1;
+        float guardY = 2 * GUARD_BAND / m_target->GetHeight() - 1;
+
+        for (uint32_t t = first; t < last; t++)
+        {
+            const Vertex *corners[3] =
+            {
+                &vertices[indices[3 * t] - minIndex],
+                &vertices[indices[3 * t + 1] - minIndex],
+                &vertices[indices[3 * t + 2] - minIndex],
+            };
+            batch.assembled++;
+
+            // Planes any corner is outside of, and those all are
+            uint32_t anyOutside = 0, allOutside = 0x3f;
+            for (const Vertex *corner : corners)
+            {
+                uint32_t outside = 0;
+                for (int plane = 0; plane < 6; plane++)
+                    if (planeDistance(corner->position, plane, guardX, guardY) < 0)
+                        outside |= 1u << plane;
+                anyOutside |= outside;
+                allOutside &= outside;
+            }
+            if (allOutside)
+            {
+                batch.culled++;
+                continue;
+            }
+            if (!anyOutside)
+            {
+                setupTriangle(batch, batchIndex, draw, startInstance + instance, *corners[0], *corners[1],
+                    *corners[2]);
+                continue;
+            }
+
+            batch.clipped++;
+            Vertex polygon[MAX_CLIP_VERTICES] = { *corners[0], *corners[1], *corners[2] };
+            int count = clipPolygon(polygon, 3, anyOutside, guardX, guardY, draw->varyingCount);
+            if (count < 3)
+                batch.culled++;
+            for (int i = 1; i + 1 < count; i++)
+                setupTriangle(batch, batchIndex, draw, startInstance + instance, polygon[0], polygon[i],
+                    polygon[i + 1]);
+        }
+    });
+}
+
+void SoftwareRasterizer::setupTriangle(Batch &batch, uint32_t batchIndex, const Draw *draw, uint32_t instance,
+    const Vertex &a, const Vertex &b, const Vertex &c) const
+{
+    const Vertex *corners[3] = { &a, &b, &c };
+    float width = (float)m_target->GetWidth();
+    float height = (float)m_target->GetHeight();
+
+    float invW[3], z[3];
+    int32_t x[3], y[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const float *p = corners[i]->position;
+        if (!(p[3] > 0))
+        {
+            batch.culled++;
+            return;
+        }
+        invW[i] = 1 / p[3];
+        z[i] = p[2] * invW[i];
+        x[i] = (int32_t)std::floor((p[0] * invW[i] * 0.5f + 0.5f) * width * SUBPIXEL_SCALE + 0.5f);
+        y[i] = (int32_t)std::floor((0.5f - p[1] * invW[i] * 0.5f) * height * SUBPIXEL_SCALE + 0.5f);
+    }
+
+    // Positive for clockwise on screen, where y points down
+    int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(x[2] - x[0]) * (y[1] - y[0]);
+    bool culled = area == 0 ||
+        (m_cullMode == RasterCullMode::Back && area < 0) ||
+        (m_cullMode == RasterCullMode::Front && area > 0);
+    if (culled)
+    {
+        batch.culled++;
+        return;
+    }
+    // Rasterization expects clockwise order
+    int order[3] = { 0, 1, 2 };
+    if (area < 0)
+    {
+        std::swap(order[1], order[2]);
+        area = -area;
+    }
+
+    Triangle triangle;
+    for (int i = 0; i < 3; i++)
+    {
+        triangle.x[i] = x[order[i]];
+        triangle.y[i] = y[order[i]];
+    }
+
+    // Pixels whose centre, at half coordinates, lies in the bounding box
+    const int32_t half = 1 << (SUBPIXEL_BITS - 1);
+    int32_t minX = (std::min)({ x[0], x[1], x[2] });
+    int32_t maxX = (std::max)({ x[0], x[1], x[2] });
+    int32_t minY = (std::min)({ y[0], y[1], y[2] });
+    int32_t maxY = (std::max)({ y[0], y[1], y[2] });
+    triangle.minX = (std::max)((minX - half + (1 << SUBPIXEL_BITS) - 1) >> SUBPIXEL_BITS, 0);
+    triangle.minY = (std::max)((minY - half + (1 << SUBPIXEL_BITS) - 1) >> SUBPIXEL_BITS, 0);
+    triangle.maxX = (std::min)((maxX - half) >> SUBPIXEL_BITS, (int32_t)m_target->GetWidth() - 1);
+    triangle.maxY = (std::min)((maxY - half) >> SUBPIXEL_BITS, (int32_t)m_target->GetHeight() - 1);
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+    {
+        batch.culled++;
+        return;
+    }
+
+    // Barycentric weights of vertex 1 and 2 relative to vertex 0, in pixels
+    triangle.originX = triangle.x[0] / SUBPIXEL_SCALE;
+    triangle.originY = triangle.y[0] / SUBPIXEL_SCALE;
+    float x1 = (triangle.x[1] - triangle.x[0]) / SUBPIXEL_SCALE;
+    float y1 = (triangle.y[1] - triangle.y[0]) / SUBPIXEL_SCALE;
+    float x2 = (triangle.x[2] - triangle.x[0]) / SUBPIXEL_SCALE;
+    float y2 = (triangle.y[2] - triangle.y[0]) / SUBPIXEL_SCALE;
+    float invArea = (SUBPIXEL_SCALE * SUBPIXEL_SCALE) / (float)area;
+    triangle.b1dx = y2 * invArea;
+    triangle.b1dy = -x2 * invArea;
+    triangle.b2dx = -y1 * invArea;
+    triangle.b2dy = x1 * invArea;
+
+    const int i0 = order[0], i1 = order[1], i2 = order[2];
+    triangle.z = z[i0];
+    triangle.zdx = triangle.b1dx * (z[i1] - z[i0]) + triangle.b2dx * (z[i2] - z[i0]);
+    triangle.zdy = triangle.b1dy * (z[i1] - z[i0]) + triangle.b2dy * (z[i2] - z[i0]);
+    triangle.invW = invW[i0];
+    triangle.invWdx = triangle.b1dx * (invW[i1] - invW[i0]) + triangle.b2dx * (invW[i2] - invW[i0]);
+    triangle.invWdy = triangle.b1dy * (invW[i1] - invW[i0]) + triangle.b2dy * (invW[i2] - invW[i0]);
+
+    triangle.draw = draw;
+    triangle.instance = instance;
+    triangle.batch = batchIndex;
+    triangle.varyingOffset = (uint32_t)batch.varyings.size();
+    for (uint32_t v = 0; v < draw->varyingCount; v++)
+    {
+        float v0 = corners[i0]->varyings[v] * invW[i0];
+        batch.varyings.push_back(v0);
+        batch.varyings.push_back(corners[i1]->varyings[v] * invW[i1] - v0);
+        batch.varyings.push_back(corners[i2]->varyings[v] * invW[i2] - v0);
+    }
+    batch.triangles.push_back(triangle);
+}
+
+void SoftwareRasterizer::Flush()
+{
+    if (!m_target || m_batchCount == 0)
+    {
+        m_draws.clear();
+        m_batchCount = 0;
+        return;
+    }
+
+    uint32_t tilesX = (m_target->GetWidth() + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tilesY = (m_target->GetHeight() + TILE_SIZE - 1) / TILE_SIZE;
+    size_t tileCount = (size_t)tilesX * tilesY;
+    m_tiles.resize(tileCount);
+    for (auto &tile : m_tiles)
+        tile.clear();
+
+    // Binning in submission order keeps every tile's list in that order
+    for (size_t b = 0; b < m_batchCount; b++)
+    {
+        const Batch &batch = *m_batches[b];
+        m_statistics.triangles += batch.assembled;
+        m_statistics.culled += batch.culled;
+        m_statistics.clipped += batch.clipped;
+        for (const Triangle &triangle : batch.triangles)
+        {
+            for (uint32_t ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++)
+                for (uint32_t tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++)
+                    m_tiles[(size_t)ty * tilesX + tx].push_back(&triangle);
+            m_statistics.binned += (triangle.maxY / TILE_SIZE - triangle.minY / TILE_SIZE + 1) *
+                (triangle.maxX / TILE_SIZE - triangle.minX / TILE_SIZE + 1);
+        }
+    }
+
+    std::vector<uint64_t> tested(tileCount, 0), written(tileCount, 0);
+    m_pool.ParallelFor(tileCount, [&](size_t tile, unsigned)
+    {
+        uint32_t tileX = (uint32_t)(tile % tilesX);
+        uint32_t tileY = (uint32_t)(tile / tilesX);
+        for (const Triangle *triangle : m_tiles[tile])
+            rasterize(*triangle, tileX, tileY, tested[tile], written[tile]);
+    });
+    for (size_t tile = 0; tile < tileCount; tile++)
+    {
+        m_statistics.pixelsTested += tested[tile];
+        m_statistics.pixelsWritten += written[tile];
+    }
+
+    m_draws.clear();
+    m_batchCount = 0;
+}
+
+void SoftwareRasterizer::rasterize(const Triangle &triangle, uint32_t tileX, uint32_t tileY, uint64_t &tested,
+    uint64_t &written)
+{
+    int32_t x0 = (std::max)((int32_t)(tileX * TILE_SIZE), triangle.minX);
+    int32_t x1 = (std::min)((int32_t)(tileX * TILE_SIZE + TILE_SIZE - 1), triangle.maxX);
+    int32_t y0 = (std::max)((int32_t)(tileY * TILE_SIZE), triangle.minY);
+    int32_t y1 = (std::min)((int32_t)(tileY * TILE_SIZE + TILE_SIZE - 1), triangle.maxY);
+    if (x0 > x1 || y0 > y1)
+        return;
+    // Whole groups of four from an aligned start, so depth loads stay in the padded row
+    int32_t xStart = x0 & ~3;
+
+    // Edge functions E(p) = A p.x + B p.y + C, non-negative inside. Edges
+    // that are not top or left edges lose one unit, so pixel centres on them
+    // count as outside. Over the at most 35 x 32 pixels visited, A and B
+    // change E by less than 2^30 with positions inside the guard band.
+    const int32_t one = 1 << SUBPIXEL_BITS;
+    const int32_t half = one / 2;
+    __m128i rowE[3], stepX[3], stepY[3];
+    for (int e = 0; e < 3; e++)
+    {
+        int i = e, j = (e + 1) % 3;
+        int64_t a = (int64_t)triangle.y[i] - triangle.y[j];
+        int64_t b = (int64_t)triangle.x[j] - triangle.x[i];
+        int64_t c = -(a * triangle.x[i] + b * triangle.y[i]);
+        bool topLeft = a > 0 || (a == 0 && b > 0);
+        if (!topLeft)
+            c -= 1;
+
+        // Nothing to do when the region's corner furthest inside is outside,
+        // which keeps the large triangles of a close mesh to the tiles they touch
+        int64_t cornerX = (int64_t)(a > 0 ? x1 : xStart) * one + half;
+        int64_t cornerY = (int64_t)(b > 0 ? y1 : y0) * one + half;
+        if (a * cornerX + b * cornerY + c < 0)
+            return;
+
+        int64_t base = a * ((int64_t)xStart * one + half) + b * ((int64_t)y0 * one + half) + c;
+        if (base >= EDGE_LIMIT)
+        {
+            // Inside this edge everywhere the tile visits
+            rowE[e] = _mm_set1_epi32((int32_t)EDGE_LIMIT);
+            stepX[e] = stepY[e] = _mm_setzero_si128();
+            continue;
+        }
+        int32_t dx = (int32_t)(a * one);
+        rowE[e] = _mm_add_epi32(_mm_set1_epi32((int32_t)base), _mm_setr_epi32(0, dx, 2 * dx, 3 * dx));
+        stepX[e] = _mm_set1_epi32(4 * dx);
+        stepY[e] = _mm_set1_epi32((int32_t)(b * one));
+    }
+
+    const Draw &draw = *triangle.draw;
+    const float *varyings = m_batches[triangle.batch]->varyings.data() + triangle.varyingOffset;
+    float *color = m_target->GetColor();
+    float *depth = m_target->GetDepth();
+    uint32_t pitch = m_target->GetPitch();
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    float interpolated[MAX_VARYINGS];
+
+    for (int32_t y = y0; y <= y1; y++)
+    {
+        __m128i e0 = rowE[0], e1 = rowE[1], e2 = rowE[2];
+        float py = y + 0.5f - triangle.originY;
+        float *depthRow = depth + (size_t)y * pitch;
+
+        for (int32_t x = xStart; x <= x1; x += 4)
+        {
+            // Inside where no edge function has its sign bit set
+            __m128i signs = _mm_or_si128(_mm_or_si128(e0, e1), e2);
+            uint32_t mask = ~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(signs)) & 0xf;
+            if (x < x0)
+                mask &= 0xfu << (x0 - x);
+            if (x1 - x < 3)
+                mask &= 0xfu >> (3 - (x1 - x));
+
+            e0 = _mm_add_epi32(e0, stepX[0]);
+            e1 = _mm_add_epi32(e1, stepX[1]);
+            e2 = _mm_add_epi32(e2, stepX[2]);
+            if (!mask)
+                continue;
+
+            __m128 px = _mm_add_ps(_mm_set1_ps(x - triangle.originX), laneOffsets);
+            __m128 z = _mm_add_ps(_mm_set1_ps(triangle.z + py * triangle.zdy),
+                _mm_mul_ps(px, _mm_set1_ps(triangle.zdx)));
+            if (draw.depthTest)
+                mask &= (uint32_t)_mm_movemask_ps(_mm_cmplt_ps(z, _mm_loadu_ps(depthRow + x)));
+            if (!mask)
+                continue;
+
+            // Barycentrics and w of the four pixels, the varyings follow per pixel
+            alignas(16) float depths[4], b1[4], b2[4], w[4];
+            _mm_store_ps(depths, z);
+            _mm_store_ps(b1, _mm_add_ps(_mm_set1_ps(py * triangle.b1dy), _mm_mul_ps(px, _mm_set1_ps(triangle.b1dx))));
+            _mm_store_ps(b2, _mm_add_ps(_mm_set1_ps(py * triangle.b2dy), _mm_mul_ps(px, _mm_set1_ps(triangle.b2dx))));
+            _mm_store_ps(w, _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(
+                _mm_set1_ps(triangle.invW + py * triangle.invWdy), _mm_mul_ps(px, _mm_set1_ps(triangle.invWdx)))));
+            for (uint32_t lane = 0; lane < 4; lane++)
+            {
+                if (!(mask & (1u << lane)))
+                    continue;
+                tested++;
+
+                for (uint32_t v = 0; v < draw.varyingCount; v++)
+                {
+                    const float *plane = varyings + 3 * v;
+                    interpolated[v] = (plane[0] + b1[lane] * plane[1] + b2[lane] * plane[2]) * w[lane];
+                }
+
+                float *pixel = color + ((size_t)y * pitch + x + lane) * 4;
+                float shaded[4];
+                if (!draw.pixelShader(interpolated, triangle.instance, x + lane, y, shaded))
+                    continue;
+                std::copy(shaded, shaded + 4, pixel);
+                if (draw.depthWrite)
+                    depthRow[x + lane] = depths[lane];
+                written++;
+            }
+        }
+
+        rowE[0] = _mm_add_epi32(rowE[0], stepY[0]);
+        rowE[1] = _mm_add_epi32(rowE[1], stepY[1]);
+        rowE[2] = _mm_add_epi32(rowE[2], stepY[2]);
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "..\ThreadPool.h"
+#include "RasterTarget.h"
+
+namespace DX
+{
+    // Triangles facing the given way are dropped. As in D3D11 by default,
+    // clockwise on screen is the front.
+    enum class RasterCullMode
+    {
+        None,
+        Front,
+        Back
+    };
+
+    struct RasterStatistics
+    {
+        // Triangles assembled, every instance counted
+        uint64_t triangles = 0;
+        // Dropped for their facing, for covering no pixel centre or for
+        // lying outside the clip volume
+        uint64_t culled = 0;
+        // Cut by the near or far plane or the guard band
+        uint64_t clipped = 0;
+        // Triangle and tile pairs the binning produced
+        uint64_t binned = 0;
+        // Covered pixels that passed the depth test, and the ones the pixel
+        // shader did not discard
+        uint64_t pixelsTested = 0;
+        uint64_t pixelsWritten = 0;
+    };
+
+    // CPU implementation of the part of the D3D11 pipeline the scene uses:
+    // indexed, instanced triangle lists, a vertex and a pixel callback with
+    // perspective-correct varyings, back face culling, a less-than depth test
+    // and render-to-texture through RasterTarget. Rules follow D3D11: clip
+    // depth 0 <= z <= w, pixel centres at half coordinates, top-left fill.
+    //
+    // Draws run their vertex stage and triangle setup right away, split
+    // across the thread pool, and queue the triangles. Flush bins them into
+    // TILE_SIZE square tiles, then rasterizes the tiles in parallel, each
+    // tile's triangles in submission order, so images do not depend on the
+    // thread count. Coverage uses exact SSE2 integer edge functions on four
+    // pixels at a time with positions snapped to 1/16 pixel.
+    //
+    // Both callbacks run on several threads at once.
+    class SoftwareRasterizer
+    {
+    public:
+        static const uint32_t MAX_VARYINGS = 16;
+        static const uint32_t TILE_SIZE = 32;
+
+        struct Vertex
+        {
+            // Clip space
+            float position[4];
+            float varyings[MAX_VARYINGS];
+        };
+
+        // Fill in output for the vertex of the given index and instance
+        typedef std::function<void(uint32_t vertex, uint32_t instance, Vertex &output)> VertexShader;
+        // Color of pixel x, y from its interpolated varyings, false discards it
+        typedef std::function<bool(const float *varyings, uint32_t instance, uint32_t x, uint32_t y, float *color)>
+            PixelShader;
+
+        explicit SoftwareRasterizer(ThreadPool &pool = ThreadPool::Default());
+        ~SoftwareRasterizer();
+
+        // Flushes the work queued for the previous target
+        void SetRenderTarget(RasterTarget *target);
+        void SetCullMode(RasterCullMode mode) { m_cullMode = mode; }
+        void SetDepthState(bool test, bool write);
+        // varyingCount of the varyings the vertex shader writes are interpolated
+        void SetShaders(const VertexShader &vertexShader, const PixelShader &pixelShader, uint32_t varyingCount);
+
+        // Vertex indices are indices[i] + baseVertex, instances count from startInstance
+        void DrawIndexedInstanced(const uint32_t *indices, uint32_t indexCount, uint32_t instanceCount,
+            int32_t baseVertex, uint32_t startInstance);
+        void DrawIndexed(const uint32_t *indices, uint32_t indexCount, int32_t baseVertex)
+        {
+            DrawIndexedInstanced(indices, indexCount, 1, baseVertex, 0);
+        }
+
+        // Rasterize everything queued into the render target
+        void Flush();
+
+        const RasterStatistics &GetStatistics() const { return m_statistics; }
+        void ResetStatistics() { m_statistics = RasterStatistics(); }
+
+    private:
+        struct Draw;
+        struct Triangle;
+        struct Batch;
+
+        // Project, cull and queue one clipped triangle
+        void setupTriangle(Batch &batch, uint32_t batchIndex, const Draw *draw, uint32_t instance,
+            const Vertex &a, const Vertex &b, const Vertex &c) const;
+        void rasterize(const Triangle &triangle, uint32_t tileX, uint32_t tileY, uint64_t &tested,
+            uint64_t &written);
+
+        ThreadPool &m_pool;
+        RasterTarget *m_target = nullptr;
+        RasterCullMode m_cullMode = RasterCullMode::Back;
+        bool m_depthTest = true;
+        bool m_depthWrite = true;
+        VertexShader m_vertexShader;
+        PixelShader m_pixelShader;
+        uint32_t m_varyingCount = 0;
+
+        // Queued until Flush, batches in submission order
+        std::vector<std::unique_ptr<Draw>> m_draws;
+        std::vector<std::unique_ptr<Batch>> m_batches;
+        size_t m_batchCount = 0;
+        std::vector<Vertex> m_vertices;
+        std::vector<std::vector<const Triangle *>> m_tiles;
+
+        RasterStatistics m_statistics;
+    };
+}
@@ -0,0 +1,89 @@
+#include "pch.h"
+
+#include "D3D11ReadbackDevice.h"
+
+using namespace DX;
+
+namespace
+{
+    UINT BytesPerTexel(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return 16;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:
+            return 8;
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+            return 4;
+        default:
+            throw std::invalid_argument("D3D11ReadbackDevice: unsupported texture format");
+        }
+    }
+}
+
+D3D11ReadbackDevice::D3D11ReadbackDevice(
+    const std::shared_ptr<DeviceResources> &deviceResources,
+    const D3D11_TEXTURE2D_DESC &sourceDesc, const std::string &namePrefix) :
+    m_deviceResources(deviceResources),
+    m_stagingDesc(sourceDesc),
+    m_namePrefix(namePrefix),
+    m_bytesPerTexel(BytesPerTexel(sourceDesc.Format))
+{
+    // CopyResource needs matching dimensions and mip count, everything else
+    // is what makes the texture CPU readable.
+    m_stagingDesc.Usage = D3D11_USAGE_STAGING;
+    m_stagingDesc.BindFlags = 0;
+    m_stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    m_stagingDesc.MiscFlags = 0;
+}
+
+size_t D3D11ReadbackDevice::CreateSlot()
+{
+    m_stagingTextures.push_back(m_deviceResources->createTexture2D(m_stagingDesc,
+        m_namePrefix + "CPUAcc" + std::to_string(m_stagingTextures.size())));
+    return m_stagingTextures.size() - 1;
+}
+
+void D3D11ReadbackDevice::CopyToSlot(size_t slot, ID3D11Resource *const &source)
+{
+    m_deviceResources->GetD3DDeviceContext()->CopyResource(
+        m_stagingTextures.at(slot).Get(), source);
+}
+
+bool D3D11ReadbackDevice::ReadSlot(size_t slot, void *dest, size_t byteSize, bool wait)
+{
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    ID3D11Texture2D *texture = m_stagingTextures.at(slot).Get();
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = context->Map(texture, 0, D3D11_MAP_READ,
+        wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        return false;
+    DX::ThrowIfFailed(hr);
+
+    // Staging rows may be padded, copy the tightly packed part of each row
+    size_t rowSize = (size_t)m_stagingDesc.Width * m_bytesPerTexel;
+    byte *out = (byte *)dest;
+    const byte *in = (const byte *)mapped.pData;
+    for (UINT row = 0; row < m_stagingDesc.Height && byteSize > 0; row++)
+    {
+        size_t n = min(rowSize, byteSize);
+        memcpy(out, in, n);
+        out += n;
+        in += mapped.RowPitch;
+        byteSize -= n;
+    }
+
+    context->Unmap(texture, 0);
+    return true;
+}
+
+size_t D3D11ReadbackDevice::GetSlotByteSize() const
+{
+    return (size_t)m_stagingDesc.Width * m_stagingDesc.Height * m_bytesPerTexel;
+}
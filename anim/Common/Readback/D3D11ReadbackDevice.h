@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ReadbackDevice.h"
+#include "..\DeviceResources.h"
+
+namespace DX
+{
+    // Readback backend over D3D11 staging textures. Every slot is a staging
+    // copy of a texture described by sourceDesc; reads use D3D11_MAP_FLAG_DO_NOT_WAIT
+    // so polling a slot the GPU has not reached yet returns immediately.
+    class D3D11ReadbackDevice : public ReadbackDevice<ID3D11Resource *>
+    {
+    public:
+        D3D11ReadbackDevice(const std::shared_ptr<DeviceResources> &deviceResources,
+            const D3D11_TEXTURE2D_DESC &sourceDesc, const std::string &namePrefix);
+
+        size_t CreateSlot() override;
+        void CopyToSlot(size_t slot, ID3D11Resource *const &source) override;
+        bool ReadSlot(size_t slot, void *dest, size_t byteSize, bool wait) override;
+        size_t GetSlotByteSize() const override;
+
+    private:
+        std::shared_ptr<DeviceResources> m_deviceResources;
+
+        CD3D11_TEXTURE2D_DESC m_stagingDesc;
+        std::string m_namePrefix;
+        UINT m_bytesPerTexel;
+
+        std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> m_stagingTextures;
+    };
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "ReadbackDevice.h"
+
+namespace DX
+{
+    // Readback backend without a GPU. A copy issued on frame f becomes
+    // readable on frame f + latency, which simulates a GPU running
+    // 'latency' frames behind the CPU.
+    template <typename T>
+    class FakeReadbackDevice : public ReadbackDevice<T>
+    {
+    public:
+        explicit FakeReadbackDevice(uint32_t latencyFrames) :
+            m_latencyFrames(latencyFrames)
+        {
+        }
+
+        size_t CreateSlot() override
+        {
+            m_slots.push_back({});
+            return m_slots.size() - 1;
+        }
+
+        void CopyToSlot(size_t slot, const T &source) override
+        {
+            Slot &s = m_slots.at(slot);
+            // Overwriting a copy nobody has read yet means the caller lost a sample
+            if (s.pending)
+                m_overwrites++;
+            s.value = source;
+            s.readyFrame = m_frame + m_latencyFrames;
+            s.pending = true;
+        }
+
+        bool ReadSlot(size_t slot, void *dest, size_t byteSize, bool wait) override
+        {
+            Slot &s = m_slots.at(slot);
+            if (byteSize > sizeof(T))
+                throw std::out_of_range("FakeReadbackDevice: read past the slot");
+
+            if (m_frame < s.readyFrame)
+            {
+                if (!wait)
+                {
+                    m_notReadyPolls++;
+                    return false;
+                }
+                // A blocking map would stall the CPU until the GPU catches up
+                m_blockingWaits++;
+                m_stalledFrames += s.readyFrame - m_frame;
+            }
+
+            memcpy(dest, &s.value, byteSize);
+            s.pending = false;
+            return true;
+        }
+
+        size_t GetSlotByteSize() const override { return sizeof(T); }
+
+        // Simulates the end of a frame on the GPU timeline
+        void AdvanceFrame() { m_frame++; }
+
+        void SetLatency(uint32_t latencyFrames) { m_latencyFrames = latencyFrames; }
+
+        uint64_t GetFrame() const { return m_frame; }
+        uint64_t GetBlockingWaitCount() const { return m_blockingWaits; }
+        uint64_t GetStalledFrameCount() const { return m_stalledFrames; }
+        uint64_t GetNotReadyPollCount() const { return m_notReadyPolls; }
+        uint64_t GetOverwriteCount() const { return m_overwrites; }
+
+    private:
+        struct Slot
+        {
+            T value{};
+            uint64_t readyFrame = 0;
+            bool pending = false;
+        };
+
+        std::vector<Slot> m_slots;
+        uint32_t m_latencyFrames;
+        uint64_t m_frame = 0;
+
+        uint64_t m_blockingWaits = 0;
+        uint64_t m_stalledFrames = 0;
+        uint64_t m_notReadyPolls = 0;
+        uint64_t m_overwrites = 0;
+    };
+}
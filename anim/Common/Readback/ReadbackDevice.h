@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+namespace DX
+{
+    // Backend used by ReadbackQueue to move GPU results into CPU memory.
+    // Each slot is one staging resource. Source is whatever the backend
+    // copies from: a GPU resource for D3D11 or a plain value for the fake backend.
+    template <typename Source>
+    class ReadbackDevice
+    {
+    public:
+        virtual ~ReadbackDevice() = default;
+
+        // Allocate a new staging slot and return its index
+        virtual size_t CreateSlot() = 0;
+
+        // Schedule a copy of source into the slot on the GPU timeline
+        virtual void CopyToSlot(size_t slot, const Source &source) = 0;
+
+        // Copy slot contents into dest. When wait is false the call never
+        // blocks and returns false if the GPU has not finished the copy yet.
+        virtual bool ReadSlot(size_t slot, void *dest, size_t byteSize, bool wait) = 0;
+
+        // Size in bytes of the data held by one slot
+        virtual size_t GetSlotByteSize() const = 0;
+    };
+}
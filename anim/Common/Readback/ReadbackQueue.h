@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "ReadbackDevice.h"
+
+namespace DX
+{
+    // N-deep ring of staging slots used to read GPU results back without
+    // stalling. Each frame enqueues a copy into a free slot and polls the
+    // slots in flight; the newest completed copy becomes the latest value.
+    // The latest value is therefore a few frames old, see GetLatestFrame().
+    template <typename T, typename Source>
+    class ReadbackQueue
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t enqueued = 0;
+            uint64_t completed = 0;
+            // Copies that were never read because a newer one finished first
+            uint64_t skipped = 0;
+            // Frames whose copy was not issued because all slots were in flight
+            uint64_t dropped = 0;
+            // Polls that found no finished copy
+            uint64_t misses = 0;
+        };
+
+        ReadbackQueue(const std::shared_ptr<ReadbackDevice<Source>> &device, size_t depth) :
+            m_device(device),
+            m_elementCount(device->GetSlotByteSize() / sizeof(T))
+        {
+            if (depth == 0 || m_elementCount == 0)
+                throw std::invalid_argument("ReadbackQueue: empty queue");
+
+            m_latest.resize(m_elementCount);
+            m_slots.resize(depth);
+            for (auto &slot : m_slots)
+                slot.index = m_device->CreateSlot();
+        }
+
+        // Issue a copy of source tagged with the given frame number.
+        // Returns false if every slot is still in flight, the frame is dropped then.
+        bool Enqueue(const Source &source, uint64_t frame)
+        {
+            Slot &slot = m_slots[m_head];
+            if (slot.inFlight)
+            {
+                m_stats.dropped++;
+                return false;
+            }
+
+            m_device->CopyToSlot(slot.index, source);
+            slot.inFlight = true;
+            slot.frame = frame;
+            slot.order = m_nextOrder++;
+            m_head = (m_head + 1) % m_slots.size();
+            m_stats.enqueued++;
+            return true;
+        }
+
+        // Check slots in flight without blocking. Returns true if a newer value arrived.
+        bool Poll()
+        {
+            // Copies complete in submission order, so the newest finished slot
+            // makes every older one obsolete.
+            for (size_t i = 0; i < m_slots.size(); i++)
+            {
+                Slot &slot = m_slots[(m_head + m_slots.size() - 1 - i) % m_slots.size()];
+                if (!slot.inFlight)
+                    continue;
+
+                if (!readSlot(slot))
+                    continue;
+
+                for (auto &older : m_slots)
+                    if (older.inFlight && older.order < slot.order)
+                    {
+                        older.inFlight = false;
+                        m_stats.skipped++;
+                    }
+                return true;
+            }
+
+            m_stats.misses++;
+            return false;
+        }
+
+        // Wait for the newest copy in flight, older ones are skipped. False if
+        // nothing was in flight or the device still could not read it. Only
+        // meant for shutdown or tooling.
+        bool Flush()
+        {
+            Slot *newest = nullptr;
+            for (auto &slot : m_slots)
+                if (slot.inFlight && (newest == nullptr || slot.order > newest->order))
+                    newest = &slot;
+            if (newest == nullptr)
+                return false;
+
+            // A device that still refuses leaves the slots in flight for the next poll
+            m_scratch.resize(m_elementCount);
+            if (!m_device->ReadSlot(newest->index, m_scratch.data(), m_elementCount * sizeof(T), true))
+                return false;
+
+            m_latest.swap(m_scratch);
+            acceptSlot(*newest);
+            for (auto &slot : m_slots)
+                if (slot.inFlight)
+                {
+                    slot.inFlight = false;
+                    m_stats.skipped++;
+                }
+            return true;
+        }
+
+        // Forget the copies in flight and the latest value, e.g. when the
+        // queue was idle for a while and its results are out of date
+        void Reset()
+        {
+            for (auto &slot : m_slots)
+                if (slot.inFlight)
+                {
+                    slot.inFlight = false;
+                    m_stats.skipped++;
+                }
+            m_hasValue = false;
+            m_latestFrame = 0;
+        }
+
+        // False if the next Enqueue would be dropped
+        bool CanEnqueue() const { return !m_slots[m_head].inFlight; }
+        bool HasValue() const { return m_hasValue; }
+        const std::vector<T> &GetLatest() const { return m_latest; }
+        // Frame number the latest value was enqueued on
+        uint64_t GetLatestFrame() const { return m_latestFrame; }
+        size_t GetDepth() const { return m_slots.size(); }
+        size_t GetElementCount() const { return m_elementCount; }
+        const Statistics &GetStatistics() const { return m_stats; }
+
+    private:
+        struct Slot
+        {
+            size_t index = 0;
+            uint64_t frame = 0;
+            uint64_t order = 0;
+            bool inFlight = false;
+        };
+
+        bool readSlot(Slot &slot)
+        {
+            m_scratch.resize(m_elementCount);
+            if (!m_device->ReadSlot(slot.index, m_scratch.data(), m_elementCount * sizeof(T), false))
+                return false;
+
+            m_latest.swap(m_scratch);
+            acceptSlot(slot);
+            return true;
+        }
+
+        void acceptSlot(Slot &slot)
+        {
+            slot.inFlight = false;
+            m_latestFrame = slot.frame;
+            m_hasValue = true;
+            m_stats.completed++;
+        }
+
+        std::shared_ptr<ReadbackDevice<Source>> m_device;
+        size_t m_elementCount;
+
+        std::vector<Slot> m_slots;
+        size_t m_head = 0;
+        uint64_t m_nextOrder = 0;
+
+        std::vector<T> m_latest;
+        std::vector<T> m_scratch;
+        uint64_t m_latestFrame = 0;
+        bool m_hasValue = false;
+
+        Statistics m_stats;
+    };
+}
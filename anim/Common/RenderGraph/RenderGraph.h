@@ -0,0 +1,413 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "..\RenderTarget\RenderTargetPool.h"
+
+namespace DX
+{
+    // What a pass needs in a texture it writes
+    enum class LoadAction
+    {
+        // Keep the current contents
+        Load,
+        // The pass overwrites everything that is read later
+        DontCare
+    };
+
+    struct ClearValue
+    {
+        float color[4] = { 0, 0, 0, 0 };
+        float depth = 1;
+        uint8_t stencil = 0;
+    };
+
+    // Frame graph rebuilt every frame. Passes declare the textures they read
+    // and write and run in the order they were added. Compile() walks back
+    // from the results that are observed: imported textures at the end of
+    // the frame and passes with side effects. Passes and clears nobody
+    // observes are dropped, and transient textures with disjoint lifetimes
+    // share one pooled texture.
+    template <typename Texture>
+    class RenderGraph
+    {
+    public:
+        typedef uint32_t Resource;
+        typedef std::function<void(const Texture &, const ClearValue &)> ClearFunction;
+
+        struct Report
+        {
+            size_t passCount = 0;
+            std::vector<std::string> culledPasses;
+            size_t clearsRequested = 0;
+            size_t clearsExecuted = 0;
+            size_t transientTextureCount = 0;
+            size_t physicalTextureCount = 0;
+            // Peak over the passes of the memory of the transient textures in
+            // use, the least any aliasing could reach
+            uint64_t transientBytes = 0;
+            // Peak over the passes of the memory of the pooled textures in
+            // use, a pooled texture counts from its first user to its last
+            uint64_t aliasedBytes = 0;
+            // Memory of every pooled texture, held for all of Execute()
+            uint64_t pooledBytes = 0;
+        };
+
+    private:
+        struct Access
+        {
+            Resource resource;
+            bool write;
+            LoadAction load;
+        };
+
+        struct Pass
+        {
+            std::string name;
+            std::vector<Access> accesses;
+            std::function<void(const RenderGraph &)> execute;
+            bool sideEffect = false;
+            bool isClear = false;
+            ClearValue clear;
+            bool culled = false;
+        };
+
+    public:
+        class PassBuilder
+        {
+        public:
+            void Read(Resource resource)
+            {
+                m_graph.checkResource(resource);
+                m_pass.accesses.push_back({ resource, false, LoadAction::Load });
+            }
+
+            void Write(Resource resource, LoadAction load = LoadAction::Load)
+            {
+                m_graph.checkResource(resource);
+                m_pass.accesses.push_back({ resource, true, load });
+            }
+
+            // The pass does something outside the graph, e.g. a readback, and is never culled
+            void SideEffect()
+            {
+                m_pass.sideEffect = true;
+            }
+
+        private:
+            friend class RenderGraph;
+
+            PassBuilder(RenderGraph &graph, Pass &pass) :
+                m_graph(graph), m_pass(pass)
+            {
+            }
+
+            RenderGraph &m_graph;
+            Pass &m_pass;
+        };
+
+        RenderGraph(RenderTargetPool<Texture> &pool, const ClearFunction &clear) :
+            m_pool(pool), m_clear(clear)
+        {
+        }
+
+        // Texture owned by the graph, only valid while the passes using it run
+        Resource CreateTexture(const std::string &name, const RenderTargetDesc &desc)
+        {
+            ResourceInfo info;
+            info.name = name;
+            info.desc = RenderTargetPool<Texture>::GetSizeClass(desc, m_pool.GetSizeGranularity());
+            m_resources.push_back(info);
+            m_compiled = false;
+            return (Resource)(m_resources.size() - 1);
+        }
+
+        // Texture owned by the caller. Unless observedAfterFrame is false its
+        // final contents count as used, e.g. the back buffer.
+        Resource ImportTexture(const std::string &name, const Texture &texture,
+            bool observedAfterFrame = true)
+        {
+            ResourceInfo info;
+            info.name = name;
+            info.imported = true;
+            info.observedAfterFrame = observedAfterFrame;
+            info.texture = std::make_shared<Texture>(texture);
+            m_resources.push_back(info);
+            m_compiled = false;
+            return (Resource)(m_resources.size() - 1);
+        }
+
+        void AddPass(const std::string &name, const std::function<void(PassBuilder &)> &setup,
+            const std::function<void(const RenderGraph &)> &execute)
+        {
+            m_passes.push_back(Pass());
+            Pass &pass = m_passes.back();
+            pass.name = name;
+            pass.execute = execute;
+
+            PassBuilder builder(*this, pass);
+            setup(builder);
+            m_compiled = false;
+        }
+
+        // Clear a texture; dropped if nothing observes the cleared contents
+        void AddClear(Resource resource, const ClearValue &value)
+        {
+            checkResource(resource);
+
+            m_passes.push_back(Pass());
+            Pass &pass = m_passes.back();
+            pass.name = "Clear" + m_resources[resource].name;
+            pass.accesses.push_back({ resource, true, LoadAction::DontCare });
+            pass.isClear = true;
+            pass.clear = value;
+            m_compiled = false;
+        }
+
+        const Report &Compile()
+        {
+            m_report = Report();
+
+            validate();
+            cull();
+            alias();
+
+            m_compiled = true;
+            return m_report;
+        }
+
+        // Run the surviving passes, transient textures go back to the pool afterwards
+        void Execute()
+        {
+            if (!m_compiled)
+                Compile();
+
+            std::vector<std::shared_ptr<const Texture>> physical(m_physicalDescs.size());
+            for (size_t i = 0; i < physical.size(); i++)
+                physical[i] = m_pool.Acquire(m_physicalDescs[i]);
+            for (auto &resource : m_resources)
+                if (!resource.imported && resource.physical >= 0)
+                    resource.texture = physical[resource.physical];
+
+            for (auto &pass : m_passes)
+            {
+                if (pass.culled)
+                    continue;
+
+                if (pass.isClear)
+                    m_clear(GetTexture(pass.accesses[0].resource), pass.clear);
+                else if (pass.execute)
+                    pass.execute(*this);
+            }
+
+            for (auto &resource : m_resources)
+                if (!resource.imported)
+                    resource.texture.reset();
+        }
+
+        // Texture behind a resource, only valid inside Execute()
+        const Texture &GetTexture(Resource resource) const
+        {
+            const auto &texture = m_resources.at(resource).texture;
+            if (!texture)
+                throw std::logic_error("RenderGraph: " + m_resources[resource].name + " is not allocated");
+            return *texture;
+        }
+
+        // Forget all passes and resources to build the next frame
+        void Reset()
+        {
+            m_passes.clear();
+            m_resources.clear();
+            m_physicalDescs.clear();
+            m_compiled = false;
+        }
+
+        const Report &GetReport() const { return m_report; }
+
+        bool IsCulled(const std::string &passName) const
+        {
+            for (auto &pass : m_passes)
+                if (pass.name == passName)
+                    return pass.culled;
+            throw std::invalid_argument("RenderGraph: no pass " + passName);
+        }
+
+    private:
+        struct ResourceInfo
+        {
+            std::string name;
+            RenderTargetDesc desc;
+            bool imported = false;
+            bool observedAfterFrame = false;
+            std::shared_ptr<const Texture> texture;
+            // Index into m_physicalDescs, -1 if unused
+            int physical = -1;
+        };
+
+        void checkResource(Resource resource) const
+        {
+            if (resource >= m_resources.size())
+                throw std::out_of_range("RenderGraph: unknown resource");
+        }
+
+        // Transient textures start undefined, their first use must not depend on old contents
+        void validate() const
+        {
+            std::vector<bool> written(m_resources.size(), false);
+            for (auto &pass : m_passes)
+            {
+                for (auto &access : pass.accesses)
+                {
+                    const ResourceInfo &resource = m_resources[access.resource];
+                    bool observes = !access.write || access.load == LoadAction::Load;
+                    if (!resource.imported && !written[access.resource] && observes)
+                        throw std::logic_error("RenderGraph: " + pass.name + " uses undefined contents of " + resource.name);
+                }
+                for (auto &access : pass.accesses)
+                    if (access.write)
+                        written[access.resource] = true;
+            }
+        }
+
+        void cull()
+        {
+            // Whether the current contents of a resource are observed later
+            std::vector<bool> observed(m_resources.size(), false);
+            for (size_t r = 0; r < m_resources.size(); r++)
+                observed[r] = m_resources[r].observedAfterFrame;
+
+            for (size_t i = m_passes.size(); i-- > 0;)
+            {
+                Pass &pass = m_passes[i];
+
+                bool keep = pass.sideEffect;
+                for (auto &access : pass.accesses)
+                    if (access.write && observed[access.resource])
+                        keep = true;
+                pass.culled = !keep;
+                if (!keep)
+                    continue;
+
+                // Contents overwritten here are not observed before this pass
+                for (auto &access : pass.accesses)
+                    if (access.write && access.load == LoadAction::DontCare)
+                        observed[access.resource] = false;
+                for (auto &access : pass.accesses)
+                    if (!access.write || access.load == LoadAction::Load)
+                        observed[access.resource] = true;
+            }
+
+            for (auto &pass : m_passes)
+            {
+                if (pass.isClear)
+                {
+                    m_report.clearsRequested++;
+                    if (!pass.culled)
+                        m_report.clearsExecuted++;
+                    continue;
+                }
+
+                m_report.passCount++;
+                if (pass.culled)
+                    m_report.culledPasses.push_back(pass.name);
+            }
+        }
+
+        // Greedy interval assignment: a transient texture takes a pooled
+        // texture of the same size class whose last user already ran
+        void alias()
+        {
+            const size_t unused = (size_t)-1;
+            std::vector<size_t> first(m_resources.size(), unused), last(m_resources.size(), unused);
+            for (size_t p = 0; p < m_passes.size(); p++)
+            {
+                if (m_passes[p].culled)
+                    continue;
+                for (auto &access : m_passes[p].accesses)
+                {
+                    if (first[access.resource] == unused)
+                        first[access.resource] = p;
+                    last[access.resource] = p;
+                }
+            }
+
+            m_physicalDescs.clear();
+            for (auto &resource : m_resources)
+                resource.physical = -1;
+            // Last pass using each physical texture so far
+            std::vector<size_t> busyUntil;
+            for (size_t p = 0; p < m_passes.size(); p++)
+            {
+                for (size_t r = 0; r < m_resources.size(); r++)
+                {
+                    ResourceInfo &resource = m_resources[r];
+                    if (resource.imported || first[r] != p)
+                        continue;
+
+                    for (size_t i = 0; i < m_physicalDescs.size(); i++)
+                        if (busyUntil[i] < p && m_physicalDescs[i] == resource.desc)
+                        {
+                            resource.physical = (int)i;
+                            break;
+                        }
+                    if (resource.physical < 0)
+                    {
+                        resource.physical = (int)m_physicalDescs.size();
+                        m_physicalDescs.push_back(resource.desc);
+                        busyUntil.push_back(0);
+                    }
+                    busyUntil[resource.physical] = last[r];
+                    m_report.transientTextureCount++;
+                }
+            }
+
+            // Lifetime of each pooled texture over all the resources sharing it
+            std::vector<size_t> physicalFirst(m_physicalDescs.size(), unused), physicalLast(m_physicalDescs.size(), 0);
+            for (size_t r = 0; r < m_resources.size(); r++)
+            {
+                int i = m_resources[r].physical;
+                if (i < 0)
+                    continue;
+                physicalFirst[i] = (std::min)(physicalFirst[i], first[r]);
+                physicalLast[i] = (std::max)(physicalLast[i], last[r]);
+            }
+
+            for (size_t p = 0; p < m_passes.size(); p++)
+            {
+                uint64_t transient = 0;
+                for (size_t r = 0; r < m_resources.size(); r++)
+                    if (m_resources[r].physical >= 0 && first[r] <= p && p <= last[r])
+                        transient += m_pool.GetByteSize(m_resources[r].desc);
+
+                uint64_t aliased = 0;
+                for (size_t i = 0; i < m_physicalDescs.size(); i++)
+                    if (physicalFirst[i] <= p && p <= physicalLast[i])
+                        aliased += m_pool.GetByteSize(m_physicalDescs[i]);
+
+                m_report.transientBytes = (std::max)(m_report.transientBytes, transient);
+                m_report.aliasedBytes = (std::max)(m_report.aliasedBytes, aliased);
+            }
+
+            m_report.physicalTextureCount = m_physicalDescs.size();
+            for (auto &desc : m_physicalDescs)
+                m_report.pooledBytes += m_pool.GetByteSize(desc);
+        }
+
+        RenderTargetPool<Texture> &m_pool;
+        ClearFunction m_clear;
+
+        std::vector<Pass> m_passes;
+        std::vector<ResourceInfo> m_resources;
+        std::vector<RenderTargetDesc> m_physicalDescs;
+        bool m_compiled = false;
+
+        Report m_report;
+    };
+}
@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include "D3D11RenderTargetAllocator.h"
+
+using namespace DX;
+
+namespace
+{
+    UINT BytesPerTexel(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return 16;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:
+            return 8;
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_R11G11B10_FLOAT:
+        case DXGI_FORMAT_D24_UNORM_S8_UINT:
+        case DXGI_FORMAT_D32_FLOAT:
+            return 4;
+        default:
+            throw std::invalid_argument("D3D11RenderTargetAllocator: unsupported texture format");
+        }
+    }
+}
+
+D3D11RenderTargetAllocator::D3D11RenderTargetAllocator(
+    const std::shared_ptr<DeviceResources> &deviceResources, const std::string &namePrefix) :
+    m_deviceResources(deviceResources),
+    m_namePrefix(namePrefix)
+{
+}
+
+RenderTargetTexture D3D11RenderTargetAllocator::Allocate(const RenderTargetDesc &desc)
+{
+    RenderTargetTexture output;
+    std::string name = m_namePrefix + std::to_string(m_allocationCount++);
+
+    bool isDepth = (desc.bindFlags & D3D11_BIND_DEPTH_STENCIL) != 0;
+    bool generateMips = desc.mipLevels != 1 && !isDepth &&
+        (desc.bindFlags & (D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE)) ==
+        (D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+
+    output.viewport = CD3D11_VIEWPORT(
+        0.0f,
+        0.0f,
+        (float)desc.width,
+        (float)desc.height
+    );
+
+    output.textureDesc = CD3D11_TEXTURE2D_DESC(
+        (DXGI_FORMAT)desc.format,
+        desc.width,
+        desc.height,
+        1, // Only one texture.
+        desc.mipLevels,
+        desc.bindFlags,
+        D3D11_USAGE_DEFAULT, 0, 1, 0,
+        generateMips ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0
+    );
+
+    output.texture = m_deviceResources->createTexture2D(output.textureDesc, name);
+    if (desc.bindFlags & D3D11_BIND_SHADER_RESOURCE)
+        output.shaderResourceView = m_deviceResources->createShaderResourceView(
+            output.texture, name);
+    if (desc.bindFlags & D3D11_BIND_RENDER_TARGET)
+        output.renderTargetView = m_deviceResources->createRenderTargetView(
+            output.texture, name);
+    if (isDepth)
+    {
+        CD3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc(D3D11_DSV_DIMENSION_TEXTURE2D);
+        DX::ThrowIfFailed(
+            m_deviceResources->GetD3DDevice()->CreateDepthStencilView(
+                output.texture.Get(),
+                &depthStencilViewDesc,
+                &output.depthStencilView
+            )
+        );
+        DX::SetName(output.depthStencilView, name + "DepthStencilView");
+    }
+
+    return output;
+}
+
+void D3D11RenderTargetAllocator::Free(RenderTargetTexture &texture)
+{
+    // The texture is released with its last reference
+    texture.depthStencilView = nullptr;
+    texture.renderTargetView = nullptr;
+    texture.shaderResourceView = nullptr;
+    texture.texture = nullptr;
+}
+
+uint64_t D3D11RenderTargetAllocator::GetByteSize(const RenderTargetDesc &desc) const
+{
+    uint64_t bytes = 0;
+    UINT bytesPerTexel = BytesPerTexel((DXGI_FORMAT)desc.format);
+    UINT width = desc.width, height = desc.height;
+    for (UINT mip = 0; mip < desc.mipLevels; mip++)
+    {
+        bytes += (uint64_t)width * height * bytesPerTexel;
+        width = (std::max)(width / 2, 1u);
+        height = (std::max)(height / 2, 1u);
+    }
+    return bytes;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "RenderTargetAllocator.h"
+#include "..\DeviceResources.h"
+
+namespace DX
+{
+    // Render target backend over D3D11 textures. Views are created from
+    // the bind flags: render target and shader resource views, or a depth
+    // stencil view for depth formats. The viewport covers the whole texture.
+    class D3D11RenderTargetAllocator : public RenderTargetAllocator<RenderTargetTexture>
+    {
+    public:
+        D3D11RenderTargetAllocator(const std::shared_ptr<DeviceResources> &deviceResources,
+            const std::string &namePrefix);
+
+        RenderTargetTexture Allocate(const RenderTargetDesc &desc) override;
+        void Free(RenderTargetTexture &texture) override;
+        uint64_t GetByteSize(const RenderTargetDesc &desc) const override;
+
+    private:
+        std::shared_ptr<DeviceResources> m_deviceResources;
+        std::string m_namePrefix;
+        uint64_t m_allocationCount = 0;
+    };
+}
@@ -0,0 +1,164 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+
+#include "DynamicResolutionController.h"
+
+using namespace DX;
+
+DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings &settings) :
+    m_settings(settings)
+{
+    if (!(settings.minScale > 0) || settings.minScale > settings.maxScale || !(settings.targetFrameTime > 0))
+        throw std::invalid_argument("DynamicResolutionController: invalid settings");
+
+    Reset();
+}
+
+void DynamicResolutionController::Reset()
+{
+    m_scale = m_controlScale = m_settings.maxScale;
+    m_smoothedFrameTime = 0;
+    m_hasFrameTime = false;
+    m_overFrames = m_underFrames = 0;
+    m_previousError = m_olderError = 0;
+}
+
+float DynamicResolutionController::Update(float frameTime)
+{
+    if (!(frameTime > 0))
+        return m_scale;
+
+    if (!m_hasFrameTime)
+    {
+        m_smoothedFrameTime = frameTime;
+        m_hasFrameTime = true;
+    }
+    else
+        m_smoothedFrameTime += (frameTime - m_smoothedFrameTime) * m_settings.smoothing;
+
+    if (m_settings.mode == DynamicResolutionMode::PID)
+        return updatePID();
+    return updateHeuristic();
+}
+
+float DynamicResolutionController::updateHeuristic()
+{
+    float target = m_settings.targetFrameTime;
+
+    m_overFrames = m_smoothedFrameTime > target ? m_overFrames + 1 : 0;
+    m_underFrames = m_smoothedFrameTime < target * m_settings.upThreshold ? m_underFrames + 1 : 0;
+
+    if (m_overFrames >= m_settings.downFrames && m_scale > m_settings.minScale)
+    {
+        // GPU cost goes with the pixel count, jump to the scale that should fit
+        float fit = m_scale * std::sqrt(target * m_settings.upThreshold / m_smoothedFrameTime);
+        m_scale = clampScale((std::min)(fit, m_scale - m_settings.scaleStep));
+        m_overFrames = 0;
+        // The smoothed time still holds the slow frames, start over at the new scale
+        m_hasFrameTime = false;
+    }
+    else if (m_underFrames >= m_settings.upFrames && m_scale < m_settings.maxScale)
+    {
+        m_scale = clampScale(m_scale + m_settings.scaleStep);
+        m_underFrames = 0;
+        m_hasFrameTime = false;
+    }
+
+    m_controlScale = m_scale;
+    return m_scale;
+}
+
+float DynamicResolutionController::updatePID()
+{
+    float target = m_settings.targetFrameTime;
+    float error = (target * m_settings.headroom - m_smoothedFrameTime) / target;
+    if (std::fabs(error) < m_settings.deadband)
+        error = 0;
+
+    // Velocity form: the output is integrated, so clamping it cannot wind up
+    float delta = m_settings.kp * (error - m_previousError) +
+        m_settings.ki * error +
+        m_settings.kd * (error - 2 * m_previousError + m_olderError);
+    m_olderError = m_previousError;
+    m_previousError = error;
+
+    m_controlScale = clampScale(m_controlScale + delta);
+
+    // Hysteresis: every applied change resizes the viewport, ignore small ones
+    if (std::fabs(m_controlScale - m_scale) >= m_settings.scaleStep ||
+        (m_controlScale != m_scale && (m_controlScale == m_settings.minScale || m_controlScale == m_settings.maxScale)))
+        m_scale = m_controlScale;
+
+    return m_scale;
+}
+
+float DynamicResolutionController::clampScale(float scale) const
+{
+    return (std::min)((std::max)(scale, m_settings.minScale), m_settings.maxScale);
+}
+
+DynamicResolutionController::ReplayResult DynamicResolutionController::Replay(
+    const DynamicResolutionSettings &settings, const std::vector<float> &fullResolutionFrameTimes,
+    float resolutionDependentFraction, uint32_t latencyFrames)
+{
+    DynamicResolutionController controller(settings);
+    ReplayResult result;
+    result.scales.reserve(fullResolutionFrameTimes.size());
+    result.frameTimes.reserve(fullResolutionFrameTimes.size());
+
+    // Measurements in flight: frame time and the scale it ran at
+    std::deque<std::pair<float, float>> inFlight;
+
+    double scaleSum = 0;
+    for (float fullTime : fullResolutionFrameTimes)
+    {
+        float scale = controller.GetScale();
+        float frameTime = fullTime *
+            (1 - resolutionDependentFraction + resolutionDependentFraction * scale * scale);
+
+        result.scales.push_back(scale);
+        result.frameTimes.push_back(frameTime);
+        scaleSum += scale;
+        if (frameTime > settings.targetFrameTime)
+            result.framesOverBudget++;
+
+        inFlight.push_back(std::make_pair(frameTime, scale));
+        if (inFlight.size() <= latencyFrames)
+            continue;
+
+        std::pair<float, float> measured = inFlight.front();
+        inFlight.pop_front();
+        if (measured.second != controller.GetScale())
+        {
+            result.staleFrames++;
+            continue;
+        }
+        if (controller.Update(measured.first) != measured.second)
+            result.scaleChanges++;
+    }
+
+    if (!fullResolutionFrameTimes.empty())
+        result.averageScale = (float)(scaleSum / fullResolutionFrameTimes.size());
+    return result;
+}
+
+std::vector<float> DynamicResolutionController::LoadFrameTimeTrace(const std::string &fileName)
+{
+    std::ifstream file(fileName);
+    if (!file)
+        throw std::runtime_error("DynamicResolutionController: cannot open " + fileName);
+
+    std::vector<float> frameTimes;
+    float milliseconds;
+    while (file >> milliseconds)
+        frameTimes.push_back(milliseconds / 1000);
+
+    if (!file.eof())
+        throw std::runtime_error("DynamicResolutionController: bad frame time in " + fileName);
+    return frameTimes;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace DX
+{
+    enum class DynamicResolutionMode
+    {
+        // Step down quickly when over budget, step up slowly when well under it
+        Heuristic,
+        // Incremental PID on the relative frame time error
+        PID
+    };
+
+    struct DynamicResolutionSettings
+    {
+        DynamicResolutionMode mode = DynamicResolutionMode::Heuristic;
+
+        // Frame time budget in seconds
+        float targetFrameTime = 1.0f / 60;
+        // Render scale bounds, per axis
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        // Smallest scale change that is applied, smaller ones are held back
+        float scaleStep = 0.05f;
+        // Weight of the newest frame in the smoothed frame time
+        float smoothing = 0.2f;
+
+        // Heuristic mode: frames over targetFrameTime before scaling down and
+        // frames under upThreshold * targetFrameTime before scaling up
+        uint32_t downFrames = 2;
+        uint32_t upFrames = 30;
+        float upThreshold = 0.85f;
+
+        // PID mode gains on (headroom * target - frameTime) / target
+        float headroom = 0.9f;
+        float kp = 0.3f;
+        float ki = 0.05f;
+        float kd = 0.0f;
+        // Relative errors smaller than this are treated as zero
+        float deadband = 0.03f;
+    };
+
+    // Picks the scene render scale from measured GPU frame times. Holds no
+    // GPU state, so recorded frame time traces can be replayed through it.
+    class DynamicResolutionController
+    {
+    public:
+        struct ReplayResult
+        {
+            std::vector<float> scales;
+            // Simulated frame times at the chosen scales
+            std::vector<float> frameTimes;
+            uint32_t scaleChanges = 0;
+            uint32_t framesOverBudget = 0;
+            // Measurements that arrived after the scale they ran at changed
+            uint32_t staleFrames = 0;
+            float averageScale = 0;
+        };
+
+        explicit DynamicResolutionController(const DynamicResolutionSettings &settings = DynamicResolutionSettings());
+
+        // Feed the frame time measured at the current scale, returns the scale for the next frame
+        float Update(float frameTime);
+
+        void Reset();
+
+        float GetScale() const { return m_scale; }
+        float GetSmoothedFrameTime() const { return m_smoothedFrameTime; }
+        const DynamicResolutionSettings &GetSettings() const { return m_settings; }
+
+        // Replay frame times recorded at full resolution. The frame time at
+        // scale s is modelled as t * (1 - f + f * s^2) with f the
+        // resolution dependent fraction of the frame. Each measurement
+        // reaches the controller latencyFrames frames later, and is dropped
+        // if the scale changed meanwhile, as GpuFrameTimer does.
+        static ReplayResult Replay(const DynamicResolutionSettings &settings,
+            const std::vector<float> &fullResolutionFrameTimes,
+            float resolutionDependentFraction = 0.8f, uint32_t latencyFrames = 0);
+
+        // Read a trace with one frame time in milliseconds per line, returns seconds
+        static std::vector<float> LoadFrameTimeTrace(const std::string &fileName);
+
+    private:
+        float updateHeuristic();
+        float updatePID();
+        float clampScale(float scale) const;
+
+        DynamicResolutionSettings m_settings;
+
+        float m_scale;
+        // Unquantized PID output
+        float m_controlScale;
+        float m_smoothedFrameTime = 0;
+        bool m_hasFrameTime = false;
+
+        uint32_t m_overFrames = 0;
+        uint32_t m_underFrames = 0;
+
+        float m_previousError = 0;
+        float m_olderError = 0;
+    };
+}
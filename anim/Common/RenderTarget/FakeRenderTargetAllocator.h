@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "RenderTargetAllocator.h"
+
+namespace DX
+{
+    struct FakeRenderTarget
+    {
+        uint64_t id = 0;
+        RenderTargetDesc desc;
+    };
+
+    // Render target backend without a GPU, counts the allocations a real
+    // device would have performed.
+    class FakeRenderTargetAllocator : public RenderTargetAllocator<FakeRenderTarget>
+    {
+    public:
+        explicit FakeRenderTargetAllocator(uint32_t bytesPerTexel = 16) :
+            m_bytesPerTexel(bytesPerTexel)
+        {
+        }
+
+        FakeRenderTarget Allocate(const RenderTargetDesc &desc) override
+        {
+            if (desc.width == 0 || desc.height == 0)
+                throw std::invalid_argument("FakeRenderTargetAllocator: empty texture");
+
+            m_allocations++;
+            m_live++;
+            return { ++m_lastId, desc };
+        }
+
+        void Free(FakeRenderTarget &texture) override
+        {
+            if (texture.id == 0)
+                throw std::logic_error("FakeRenderTargetAllocator: texture freed twice");
+
+            texture.id = 0;
+            m_frees++;
+            m_live--;
+        }
+
+        uint64_t GetByteSize(const RenderTargetDesc &desc) const override
+        {
+            uint64_t bytes = 0;
+            uint32_t width = desc.width, height = desc.height;
+            for (uint32_t mip = 0; mip < desc.mipLevels; mip++)
+            {
+                bytes += (uint64_t)width * height * m_bytesPerTexel;
+                width = width > 1 ? width / 2 : 1;
+                height = height > 1 ? height / 2 : 1;
+            }
+            return bytes;
+        }
+
+        uint64_t GetAllocationCount() const { return m_allocations; }
+        uint64_t GetFreeCount() const { return m_frees; }
+        uint64_t GetLiveCount() const { return m_live; }
+
+    private:
+        uint32_t m_bytesPerTexel;
+        uint64_t m_lastId = 0;
+
+        uint64_t m_allocations = 0;
+        uint64_t m_frees = 0;
+        uint64_t m_live = 0;
+    };
+}
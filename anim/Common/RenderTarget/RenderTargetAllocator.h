@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+namespace DX
+{
+    // Everything that makes two render targets interchangeable. Format and
+    // bind flags hold DXGI_FORMAT and D3D11_BIND_FLAG values for the D3D11
+    // backend, the pool only compares them.
+    struct RenderTargetDesc
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t format = 0;
+        uint32_t mipLevels = 1;
+        uint32_t bindFlags = 0;
+
+        bool operator==(const RenderTargetDesc &other) const
+        {
+            return width == other.width && height == other.height &&
+                format == other.format && mipLevels == other.mipLevels &&
+                bindFlags == other.bindFlags;
+        }
+
+        bool operator!=(const RenderTargetDesc &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    // Backend used by RenderTargetPool to create and destroy the actual
+    // textures: D3D11 resources or plain records for the fake backend.
+    template <typename Texture>
+    class RenderTargetAllocator
+    {
+    public:
+        virtual ~RenderTargetAllocator() = default;
+
+        virtual Texture Allocate(const RenderTargetDesc &desc) = 0;
+        virtual void Free(Texture &texture) = 0;
+
+        // Memory held by a texture of the given description
+        virtual uint64_t GetByteSize(const RenderTargetDesc &desc) const = 0;
+    };
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "RenderTargetAllocator.h"
+
+namespace DX
+{
+    // Pool of transient render targets keyed by size class, format, mip
+    // count and bind flags. Sizes are rounded up to a multiple of the size
+    // granularity, so resizing the window only allocates when it crosses
+    // into a new size class; users render into the requested sub-rectangle.
+    // Textures that stay unused for maxIdleFrames frames are freed.
+    template <typename Texture>
+    class RenderTargetPool
+    {
+    public:
+        struct Statistics
+        {
+            // Textures created by the allocator
+            uint64_t allocations = 0;
+            // Acquires served by a pooled texture
+            uint64_t reuses = 0;
+            // Textures freed by trimming
+            uint64_t trimmed = 0;
+            size_t inUse = 0;
+            size_t idle = 0;
+            uint64_t allocatedBytes = 0;
+            uint64_t peakBytes = 0;
+        };
+
+        RenderTargetPool(const std::shared_ptr<RenderTargetAllocator<Texture>> &allocator,
+            uint32_t sizeGranularity = 64, uint32_t maxIdleFrames = 120) :
+            m_state(std::make_shared<State>())
+        {
+            if (sizeGranularity == 0)
+                throw std::invalid_argument("RenderTargetPool: zero size granularity");
+
+            m_state->allocator = allocator;
+            m_state->sizeGranularity = sizeGranularity;
+            m_state->maxIdleFrames = maxIdleFrames;
+        }
+
+        ~RenderTargetPool()
+        {
+            Trim();
+        }
+
+        RenderTargetPool(const RenderTargetPool &) = delete;
+        RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+        // Description of the texture actually allocated for a request
+        static RenderTargetDesc GetSizeClass(const RenderTargetDesc &desc, uint32_t granularity)
+        {
+            RenderTargetDesc sizeClass = desc;
+            sizeClass.width = (std::max)((desc.width + granularity - 1) / granularity, 1u) * granularity;
+            sizeClass.height = (std::max)((desc.height + granularity - 1) / granularity, 1u) * granularity;
+            return sizeClass;
+        }
+
+        // Take a texture of at least the requested size out of the pool. It
+        // returns to the pool when the last reference is dropped; references
+        // must not outlive the pool.
+        std::shared_ptr<const Texture> Acquire(const RenderTargetDesc &desc)
+        {
+            State &state = *m_state;
+            RenderTargetDesc key = GetSizeClass(desc, state.sizeGranularity);
+
+            Entry *entry = nullptr;
+            for (auto &candidate : state.entries)
+                if (!candidate->inUse && candidate->key == key &&
+                    (entry == nullptr || candidate->lastUsedFrame > entry->lastUsedFrame))
+                    entry = candidate.get();
+
+            if (entry != nullptr)
+            {
+                state.stats.reuses++;
+                state.stats.idle--;
+            }
+            else
+            {
+                std::unique_ptr<Entry> created(new Entry());
+                created->key = key;
+                created->texture = state.allocator->Allocate(key);
+                created->byteSize = state.allocator->GetByteSize(key);
+                entry = created.get();
+                state.entries.push_back(std::move(created));
+
+                state.stats.allocations++;
+                state.stats.allocatedBytes += entry->byteSize;
+                state.stats.peakBytes = (std::max)(state.stats.peakBytes, state.stats.allocatedBytes);
+            }
+
+            entry->inUse = true;
+            state.stats.inUse++;
+
+            std::weak_ptr<State> weakState = m_state;
+            return std::shared_ptr<const Texture>(&entry->texture, [weakState, entry](const Texture *)
+            {
+                if (auto owner = weakState.lock())
+                {
+                    entry->inUse = false;
+                    entry->lastUsedFrame = owner->frame;
+                    owner->stats.inUse--;
+                    owner->stats.idle++;
+                }
+            });
+        }
+
+        // Advance the frame counter and free textures idle for too long
+        void EndFrame()
+        {
+            m_state->frame++;
+            trim(m_state->maxIdleFrames);
+        }
+
+        // Free every idle texture
+        void Trim()
+        {
+            trim(0);
+        }
+
+        // Memory held by a pooled texture for the given request
+        uint64_t GetByteSize(const RenderTargetDesc &desc) const
+        {
+            return m_state->allocator->GetByteSize(GetSizeClass(desc, m_state->sizeGranularity));
+        }
+
+        uint32_t GetSizeGranularity() const { return m_state->sizeGranularity; }
+        const Statistics &GetStatistics() const { return m_state->stats; }
+
+    private:
+        struct Entry
+        {
+            RenderTargetDesc key;
+            Texture texture;
+            uint64_t byteSize = 0;
+            uint64_t lastUsedFrame = 0;
+            bool inUse = false;
+        };
+
+        // Shared with the references handed out, so a reference dropped
+        // after the pool is gone does not touch freed memory
+        struct State
+        {
+            std::shared_ptr<RenderTargetAllocator<Texture>> allocator;
+            uint32_t sizeGranularity = 1;
+            uint32_t maxIdleFrames = 0;
+
+            std::vector<std::unique_ptr<Entry>> entries;
+            uint64_t frame = 0;
+            Statistics stats;
+        };
+
+        void trim(uint32_t maxIdleFrames)
+        {
+            State &state = *m_state;
+            auto expired = [&](const std::unique_ptr<Entry> &entry)
+            {
+                return !entry->inUse && state.frame - entry->lastUsedFrame >= maxIdleFrames;
+            };
+
+            for (auto &entry : state.entries)
+                if (expired(entry))
+                {
+                    state.allocator->Free(entry->texture);
+                    state.stats.trimmed++;
+                    state.stats.idle--;
+                    state.stats.allocatedBytes -= entry->byteSize;
+                }
+
+            state.entries.erase(std::remove_if(state.entries.begin(), state.entries.end(), expired),
+                state.entries.end());
+        }
+
+        std::shared_ptr<State> m_state;
+    };
+}
@@ -0,0 +1,232 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <emmintrin.h>
+
+#include "TransformHierarchy.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    const size_t GROUP_SIZE = 4;
+    // Nodes per thread pool task
+    const size_t CHUNK_SIZE = 4096;
+
+    size_t chunkCount(size_t count)
+    {
+        return (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+}
+
+TransformHierarchy::TransformHierarchy(ThreadPool &pool) :
+    m_pool(pool)
+{
+}
+
+uint32_t TransformHierarchy::Add(uint32_t parent, const XMFLOAT3 &position, const XMFLOAT4 &rotation,
+    const XMFLOAT3 &scale)
+{
+    if (parent != NO_PARENT && parent >= GetCount())
+        throw std::invalid_argument("TransformHierarchy: parent does not exist");
+
+    uint32_t node = GetCount();
+    size_t padded = (node + GROUP_SIZE) / GROUP_SIZE * GROUP_SIZE;
+    for (auto array : { &m_positionX, &m_positionY, &m_positionZ, &m_rotationX, &m_rotationY, &m_rotationZ,
+        &m_rotationW, &m_scaleX, &m_scaleY, &m_scaleZ })
+        array->resize(padded, 0.0f);
+    m_local.resize(padded);
+
+    m_parents.push_back(parent);
+    m_dirty.push_back(0);
+    m_world.emplace_back();
+
+    uint32_t depth = 0;
+    for (uint32_t p = parent; p != NO_PARENT; p = m_parents[p])
+        depth++;
+    if (m_levels.size() <= depth)
+        m_levels.resize(depth + 1);
+    m_levels[depth].push_back(node);
+
+    m_positionX[node] = position.x;
+    m_positionY[node] = position.y;
+    m_positionZ[node] = position.z;
+    m_rotationX[node] = rotation.x;
+    m_rotationY[node] = rotation.y;
+    m_rotationZ[node] = rotation.z;
+    m_rotationW[node] = rotation.w;
+    m_scaleX[node] = scale.x;
+    m_scaleY[node] = scale.y;
+    m_scaleZ[node] = scale.z;
+    markDirty(node);
+    return node;
+}
+
+void TransformHierarchy::SetPosition(uint32_t node, const XMFLOAT3 &position)
+{
+    m_positionX[node] = position.x;
+    m_positionY[node] = position.y;
+    m_positionZ[node] = position.z;
+    markDirty(node);
+}
+
+void TransformHierarchy::SetRotation(uint32_t node, const XMFLOAT4 &rotation)
+{
+    m_rotationX[node] = rotation.x;
+    m_rotationY[node] = rotation.y;
+    m_rotationZ[node] = rotation.z;
+    m_rotationW[node] = rotation.w;
+    markDirty(node);
+}
+
+void TransformHierarchy::SetScale(uint32_t node, const XMFLOAT3 &scale)
+{
+    m_scaleX[node] = scale.x;
+    m_scaleY[node] = scale.y;
+    m_scaleZ[node] = scale.z;
+    markDirty(node);
+}
+
+void TransformHierarchy::markDirty(uint32_t node)
+{
+    m_dirty[node] = 1;
+    m_anyDirty = true;
+}
+
+uint32_t TransformHierarchy::Update()
+{
+    if (!m_anyDirty)
+        return 0;
+
+    // Parents come first, so one pass carries the flags down every chain
+    uint32_t count = GetCount();
+    uint32_t updated = 0;
+    for (uint32_t node = 0; node < count; node++)
+    {
+        uint32_t parent = m_parents[node];
+        if (parent != NO_PARENT)
+            m_dirty[node] |= m_dirty[parent];
+        updated += m_dirty[node];
+    }
+
+    m_pool.ParallelFor(chunkCount(count), [&](size_t chunk, unsigned)
+    {
+        updateLocal(chunk * CHUNK_SIZE, (std::min)((chunk + 1) * CHUNK_SIZE, (size_t)count));
+    });
+
+    // A level only reads the world matrices of the one before
+    for (const std::vector<uint32_t> &level : m_levels)
+    {
+        m_pool.ParallelFor(chunkCount(level.size()), [&](size_t chunk, unsigned)
+        {
+            updateWorld(level, chunk * CHUNK_SIZE, (std::min)((chunk + 1) * CHUNK_SIZE, level.size()));
+        });
+    }
+
+    std::fill(m_dirty.begin(), m_dirty.end(), (uint8_t)0);
+    m_anyDirty = false;
+    return updated;
+}
+
+void TransformHierarchy::updateLocal(size_t first, size_t last)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    // Chunks start on whole groups, the padding covers the last one
+    for (size_t i = first; i < last; i += GROUP_SIZE)
+    {
+        size_t end = (std::min)(i + GROUP_SIZE, last);
+        if (std::find(m_dirty.begin() + i, m_dirty.begin() + end, (uint8_t)1) == m_dirty.begin() + end)
+            continue;
+
+        __m128 x = _mm_loadu_ps(&m_rotationX[i]);
+        __m128 y = _mm_loadu_ps(&m_rotationY[i]);
+        __m128 z = _mm_loadu_ps(&m_rotationZ[i]);
+        __m128 w = _mm_loadu_ps(&m_rotationW[i]);
+        __m128 x2 = _mm_mul_ps(x, two);
+        __m128 y2 = _mm_mul_ps(y, two);
+        __m128 z2 = _mm_mul_ps(z, two);
+        __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+        // Scale * rotation * translation as XMMatrixAffineTransformation
+        // builds it, one register per matrix element
+        __m128 sx = _mm_loadu_ps(&m_scaleX[i]);
+        __m128 sy = _mm_loadu_ps(&m_scaleY[i]);
+        __m128 sz = _mm_loadu_ps(&m_scaleZ[i]);
+        __m128 rows[4][4] =
+        {
+            {
+                _mm_mul_ps(sx, _mm_sub_ps(one, _mm_add_ps(yy, zz))),
+                _mm_mul_ps(sx, _mm_add_ps(xy, wz)),
+                _mm_mul_ps(sx, _mm_sub_ps(xz, wy)),
+                _mm_setzero_ps(),
+            },
+            {
+                _mm_mul_ps(sy, _mm_sub_ps(xy, wz)),
+                _mm_mul_ps(sy, _mm_sub_ps(one, _mm_add_ps(xx, zz))),
+                _mm_mul_ps(sy, _mm_add_ps(yz, wx)),
+                _mm_setzero_ps(),
+            },
+            {
+                _mm_mul_ps(sz, _mm_add_ps(xz, wy)),
+                _mm_mul_ps(sz, _mm_sub_ps(yz, wx)),
+                _mm_mul_ps(sz, _mm_sub_ps(one, _mm_add_ps(xx, yy))),
+                _mm_setzero_ps(),
+            },
+            {
+                _mm_loadu_ps(&m_positionX[i]),
+                _mm_loadu_ps(&m_positionY[i]),
+                _mm_loadu_ps(&m_positionZ[i]),
+                one,
+            },
+        };
+
+        // Each transpose turns one row of four matrices into the row of each
+        for (int r = 0; r < 4; r++)
+        {
+            _MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+            for (size_t k = 0; k < GROUP_SIZE; k++)
+                _mm_storeu_ps(m_local[i + k].m[r], rows[r][k]);
+        }
+    }
+}
+
+void TransformHierarchy::updateWorld(const std::vector<uint32_t> &nodes, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++)
+    {
+        uint32_t node = nodes[i];
+        if (!m_dirty[node])
+            continue;
+
+        uint32_t parent = m_parents[node];
+        if (parent == NO_PARENT)
+            m_world[node] = m_local[node];
+        else
+            XMStoreFloat4x4(&m_world[node],
+                XMMatrixMultiply(XMLoadFloat4x4(&m_local[node]), XMLoadFloat4x4(&m_world[parent])));
+    }
+}
+
+void TransformHierarchy::WriteWorldMatrices(uint32_t first, uint32_t count, void *output, size_t stride,
+    bool transpose) const
+{
+    m_pool.ParallelFor(chunkCount(count), [&](size_t chunk, unsigned)
+    {
+        size_t last = (std::min)((chunk + 1) * CHUNK_SIZE, (size_t)count);
+        for (size_t i = chunk * CHUNK_SIZE; i < last; i++)
+        {
+            XMFLOAT4X4 *destination = (XMFLOAT4X4 *)((char *)output + stride * i);
+            const XMFLOAT4X4 &world = m_world[first + i];
+            if (transpose)
+                XMStoreFloat4x4(destination, XMMatrixTranspose(XMLoadFloat4x4(&world)));
+            else
+                *destination = world;
+        }
+    });
+}
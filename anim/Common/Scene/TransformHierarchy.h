@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "..\ThreadPool.h"
+
+namespace DX
+{
+    // Scene object transforms as structure of arrays: position, rotation
+    // quaternion and scale each one array per component, and the parent of
+    // every node. A parent is always added before its children, so the
+    // arrays stay in topological order.
+    //
+    // Setting a transform marks the node dirty; Update recomputes the local
+    // matrices of dirty nodes four at a time with SSE2 and then the world
+    // matrices of them and all their descendants, one depth level after the
+    // other, each level split across the thread pool.
+    class TransformHierarchy
+    {
+    public:
+        static const uint32_t NO_PARENT = ~0u;
+
+        explicit TransformHierarchy(ThreadPool &pool = ThreadPool::Default());
+
+        // New node, dirty until the next Update. parent is NO_PARENT or an
+        // existing node.
+        uint32_t Add(uint32_t parent, const DirectX::XMFLOAT3 &position,
+            const DirectX::XMFLOAT4 &rotation = DirectX::XMFLOAT4(0, 0, 0, 1),
+            const DirectX::XMFLOAT3 &scale = DirectX::XMFLOAT3(1, 1, 1));
+
+        void SetPosition(uint32_t node, const DirectX::XMFLOAT3 &position);
+        // Unit quaternion
+        void SetRotation(uint32_t node, const DirectX::XMFLOAT4 &rotation);
+        void SetScale(uint32_t node, const DirectX::XMFLOAT3 &scale);
+
+        // Recompute the world matrices that are out of date, returns how many
+        uint32_t Update();
+
+        uint32_t GetCount() const { return (uint32_t)m_parents.size(); }
+        uint32_t GetParent(uint32_t node) const { return m_parents[node]; }
+        // Valid after Update, world = local * parent world in DirectXMath's
+        // row vector convention
+        const DirectX::XMFLOAT4X4 &GetWorld(uint32_t node) const { return m_world[node]; }
+
+        // Copy the world matrices of nodes [first, first + count) into
+        // output, stride bytes apart, transposed for constant buffers or as
+        // is for instance streams
+        void WriteWorldMatrices(uint32_t first, uint32_t count, void *output, size_t stride,
+            bool transpose) const;
+
+    private:
+        void markDirty(uint32_t node);
+        void updateLocal(size_t first, size_t last);
+        void updateWorld(const std::vector<uint32_t> &nodes, size_t first, size_t last);
+
+        ThreadPool &m_pool;
+
+        // Padded to whole groups of four
+        std::vector<float> m_positionX, m_positionY, m_positionZ;
+        std::vector<float> m_rotationX, m_rotationY, m_rotationZ, m_rotationW;
+        std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+        std::vector<DirectX::XMFLOAT4X4> m_local;
+
+        std::vector<uint32_t> m_parents;
+        std::vector<uint8_t> m_dirty;
+        // Nodes of every depth in ascending order, roots first
+        std::vector<std::vector<uint32_t>> m_levels;
+        std::vector<DirectX::XMFLOAT4X4> m_world;
+        bool m_anyDirty = false;
+    };
+}
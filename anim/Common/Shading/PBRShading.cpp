@@ -0,0 +1,308 @@
+#include "pch.h"
+
+#include <emmintrin.h>
+
+#include "..\SimdMath.h"
+#include "PBRShading.h"
+
+using namespace DX;
+
+namespace
+{
+    const float PI = 3.14159265359f;
+    // Reflection mip levels over the roughness range, MAX_REFLECTION_LOD in ambient
+    const float MAX_REFLECTION_LOD = 4.0f;
+
+    struct Float3
+    {
+        __m128 x, y, z;
+    };
+
+    Float3 load3(const float *x, const float *y, const float *z)
+    {
+        return { _mm_load_ps(x), _mm_load_ps(y), _mm_load_ps(z) };
+    }
+
+    Float3 splat3(const float *v)
+    {
+        return { _mm_set1_ps(v[0]), _mm_set1_ps(v[1]), _mm_set1_ps(v[2]) };
+    }
+
+    Float3 sub3(const Float3 &a, const Float3 &b)
+    {
+        return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+    }
+
+    __m128 dot3(const Float3 &a, const Float3 &b)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+    }
+
+    Float3 normalize3(const Float3 &a)
+    {
+        __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot3(a, a)));
+        return { _mm_mul_ps(a.x, inverse), _mm_mul_ps(a.y, inverse), _mm_mul_ps(a.z, inverse) };
+    }
+
+    // myDot in PBRInclude.cginc
+    __m128 clampedDot(const Float3 &a, const Float3 &b)
+    {
+        return _mm_max_ps(dot3(a, b), _mm_setzero_ps());
+    }
+
+    __m128 pow5(__m128 x)
+    {
+        __m128 x2 = _mm_mul_ps(x, x);
+        return _mm_mul_ps(_mm_mul_ps(x2, x2), x);
+    }
+
+    // lerp(0.04, albedo, metalness) for one channel
+    __m128 f0(float albedo, __m128 metalness)
+    {
+        return _mm_add_ps(_mm_set1_ps(0.04f), _mm_mul_ps(_mm_set1_ps(albedo - 0.04f), metalness));
+    }
+
+    // normalDistributionH with n.h given
+    __m128 normalDistribution(__m128 nDotH, __m128 roughness)
+    {
+        __m128 r = _mm_max_ps(roughness, _mm_set1_ps(0.01f));
+        __m128 roughSqr = _mm_mul_ps(r, r);
+        __m128 d = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(nDotH, nDotH), _mm_sub_ps(roughSqr, _mm_set1_ps(1.0f))),
+            _mm_set1_ps(1.0f));
+        return _mm_div_ps(roughSqr, _mm_mul_ps(_mm_set1_ps(PI), _mm_mul_ps(d, d)));
+    }
+
+    __m128 schlickGGX(__m128 nDotV, __m128 k)
+    {
+        return _mm_div_ps(nDotV, _mm_add_ps(_mm_mul_ps(nDotV, _mm_sub_ps(_mm_set1_ps(1.0f), k)), k));
+    }
+
+    // geometry with n.wi and n.wo given
+    __m128 geometry(__m128 nDotWi, __m128 nDotWo, __m128 roughness)
+    {
+        __m128 r1 = _mm_add_ps(roughness, _mm_set1_ps(1.0f));
+        __m128 k = _mm_mul_ps(_mm_mul_ps(r1, r1), _mm_set1_ps(1.0f / 8));
+        return _mm_mul_ps(schlickGGX(nDotWi, k), schlickGGX(nDotWo, k));
+    }
+
+    // fresnel for one channel from pow(1 - h.wo, 5) and sign(n.wi)
+    __m128 fresnel(__m128 F0, __m128 weight, __m128 facing)
+    {
+        return _mm_and_ps(_mm_add_ps(F0, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), F0), weight)), facing);
+    }
+
+    // Everything Lo, NORMAL_DISTRIBUTION, GEOMETRY and FRESNEL need about one light
+    struct LightTerms
+    {
+        Float3 wi;
+        __m128 nDotWi;
+        __m128 fresnelWeight;
+        // All ones where sign(myDot(wi, n)) is 1
+        __m128 facing;
+        __m128 nDotH;
+        __m128 attenuation;
+    };
+
+    LightTerms lightTerms(const GpuPointLight &light, const Float3 &n, const Float3 &p, const Float3 &wo)
+    {
+        LightTerms terms;
+        Float3 toLight = sub3({ _mm_set1_ps(light.position.x), _mm_set1_ps(light.position.y),
+            _mm_set1_ps(light.position.z) }, p);
+        terms.wi = normalize3(toLight);
+        terms.nDotWi = clampedDot(terms.wi, n);
+        terms.facing = _mm_cmpgt_ps(terms.nDotWi, _mm_setzero_ps());
+
+        Float3 h = normalize3({ _mm_add_ps(terms.wi.x, wo.x), _mm_add_ps(terms.wi.y, wo.y),
+            _mm_add_ps(terms.wi.z, wo.z) });
+        terms.nDotH = clampedDot(n, h);
+        terms.fresnelWeight = pow5(_mm_sub_ps(_mm_set1_ps(1.0f), clampedDot(h, wo)));
+        // WindowedAttenuation
+        __m128 distanceSqr = dot3(toLight, toLight);
+        __m128 ratio = _mm_mul_ps(distanceSqr, _mm_set1_ps(1.0f / (light.radius * light.radius)));
+        __m128 window = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(ratio, ratio)), _mm_setzero_ps());
+        terms.attenuation = _mm_div_ps(_mm_mul_ps(window, window),
+            _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.30f), distanceSqr)));
+        return terms;
+    }
+}
+
+ConstantPBREnvironment::ConstantPBREnvironment(float r, float g, float b) :
+    m_color{ r, g, b }
+{
+}
+
+void ConstantPBREnvironment::SampleIrradiance(const float *, const float *, const float *,
+    float *r, float *g, float *b) const
+{
+    for (uint32_t i = 0; i < PBR_BATCH_SIZE; i++)
+    {
+        r[i] = m_color[0];
+        g[i] = m_color[1];
+        b[i] = m_color[2];
+    }
+}
+
+void ConstantPBREnvironment::SamplePrefiltered(const float *x, const float *y, const float *z, const float *,
+    float *r, float *g, float *b) const
+{
+    SampleIrradiance(x, y, z, r, g, b);
+}
+
+void ConstantPBREnvironment::SampleBRDF(const float *nDotV, const float *roughness, float *scale,
+    float *bias) const
+{
+    // EnvBRDFApprox from Karis, "Physically Based Shading on Mobile"
+    for (uint32_t i = 0; i < PBR_BATCH_SIZE; i += 4)
+    {
+        __m128 nv = _mm_min_ps(_mm_max_ps(_mm_load_ps(nDotV + i), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        __m128 roughnessValue = _mm_load_ps(roughness + i);
+        __m128 rx = _mm_add_ps(_mm_mul_ps(roughnessValue, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(roughnessValue, _mm_set1_ps(-0.0275f)), _mm_set1_ps(0.0425f));
+        __m128 rz = _mm_add_ps(_mm_mul_ps(roughnessValue, _mm_set1_ps(-0.572f)), _mm_set1_ps(1.04f));
+        __m128 rw = _mm_add_ps(_mm_mul_ps(roughnessValue, _mm_set1_ps(0.022f)), _mm_set1_ps(-0.04f));
+        __m128 a004 = _mm_add_ps(_mm_mul_ps(
+            _mm_min_ps(_mm_mul_ps(rx, rx), Simd::Exp2(_mm_mul_ps(nv, _mm_set1_ps(-9.28f)))), rx), ry);
+        _mm_store_ps(scale + i, _mm_add_ps(_mm_mul_ps(a004, _mm_set1_ps(-1.04f)), rz));
+        _mm_store_ps(bias + i, _mm_add_ps(_mm_mul_ps(a004, _mm_set1_ps(1.04f)), rw));
+    }
+}
+
+template <PBRShaderMode Mode>
+void DX::ShadePBR(const PBRShadingConstants &constants, const PBREnvironment &environment,
+    const PBRSurfaceBatch &surfaces, PBRColorBatch &colors)
+{
+    const Float3 cameraPos = splat3(constants.cameraPos);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    // ambient samples the environment for the whole batch in between
+    alignas(16) float reflectionX[PBR_BATCH_SIZE], reflectionY[PBR_BATCH_SIZE], reflectionZ[PBR_BATCH_SIZE];
+    alignas(16) float levels[PBR_BATCH_SIZE], nDotV[PBR_BATCH_SIZE];
+    alignas(16) float irradiance[3][PBR_BATCH_SIZE], prefiltered[3][PBR_BATCH_SIZE];
+    alignas(16) float brdfScale[PBR_BATCH_SIZE], brdfBias[PBR_BATCH_SIZE];
+    if (Mode == PBRShaderMode::REGULAR)
+    {
+        for (uint32_t i = 0; i < PBR_BATCH_SIZE; i += 4)
+        {
+            Float3 n = normalize3(load3(surfaces.normalX + i, surfaces.normalY + i, surfaces.normalZ + i));
+            Float3 p = load3(surfaces.positionX + i, surfaces.positionY + i, surfaces.positionZ + i);
+            Float3 wo = normalize3(sub3(cameraPos, p));
+
+            __m128 twoNDotWo = _mm_add_ps(clampedDot(n, wo), clampedDot(n, wo));
+            _mm_store_ps(reflectionX + i, _mm_sub_ps(_mm_mul_ps(twoNDotWo, n.x), wo.x));
+            _mm_store_ps(reflectionY + i, _mm_sub_ps(_mm_mul_ps(twoNDotWo, n.y), wo.y));
+            _mm_store_ps(reflectionZ + i, _mm_sub_ps(_mm_mul_ps(twoNDotWo, n.z), wo.z));
+            _mm_store_ps(levels + i, _mm_mul_ps(_mm_load_ps(surfaces.roughness + i),
+                _mm_set1_ps(MAX_REFLECTION_LOD)));
+            // Unclamped, as the shader passes it to the sampler
+            _mm_store_ps(nDotV + i, dot3(n, wo));
+        }
+        environment.SampleIrradiance(surfaces.normalX, surfaces.normalY, surfaces.normalZ,
+            irradiance[0], irradiance[1], irradiance[2]);
+        environment.SamplePrefiltered(reflectionX, reflectionY, reflectionZ, levels,
+            prefiltered[0], prefiltered[1], prefiltered[2]);
+        environment.SampleBRDF(nDotV, surfaces.roughness, brdfScale, brdfBias);
+    }
+
+    float *outputs[3] = { colors.r, colors.g, colors.b };
+    for (uint32_t i = 0; i < PBR_BATCH_SIZE; i += 4)
+    {
+        Float3 n = normalize3(load3(surfaces.normalX + i, surfaces.normalY + i, surfaces.normalZ + i));
+        Float3 p = load3(surfaces.positionX + i, surfaces.positionY + i, surfaces.positionZ + i);
+        Float3 wo = normalize3(sub3(cameraPos, p));
+        __m128 roughness = _mm_load_ps(surfaces.roughness + i);
+        __m128 metalness = _mm_load_ps(surfaces.metalness + i);
+
+        if (Mode != PBRShaderMode::REGULAR)
+        {
+            // The single term views show light 0 only
+            LightTerms light = lightTerms(constants.lights[0], n, p, wo);
+            for (int c = 0; c < 3; c++)
+            {
+                __m128 value;
+                if (Mode == PBRShaderMode::NORMAL_DISTRIBUTION)
+                    value = normalDistribution(light.nDotH, roughness);
+                else if (Mode == PBRShaderMode::GEOMETRY)
+                    value = geometry(light.nDotWi, clampedDot(n, wo), roughness);
+                else
+                    value = fresnel(f0(constants.albedo[c], metalness), light.fresnelWeight, light.facing);
+                _mm_store_ps(outputs[c] + i, value);
+            }
+            continue;
+        }
+
+        // ambient: split sum specular plus the irradiance weighted by 1 - fresnelEnvironment
+        __m128 nDotWo = clampedDot(n, wo);
+        __m128 environmentWeight = pow5(_mm_sub_ps(one, nDotWo));
+        __m128 diffuseWeight = _mm_sub_ps(one, metalness);
+        __m128 color[3];
+        for (int c = 0; c < 3; c++)
+        {
+            __m128 F0 = f0(constants.albedo[c], metalness);
+            __m128 specular = _mm_mul_ps(_mm_load_ps(prefiltered[c] + i),
+                _mm_add_ps(_mm_mul_ps(F0, _mm_load_ps(brdfScale + i)), _mm_load_ps(brdfBias + i)));
+            __m128 F = _mm_add_ps(F0,
+                _mm_mul_ps(_mm_sub_ps(_mm_max_ps(_mm_sub_ps(one, roughness), F0), F0), environmentWeight));
+            __m128 kD = _mm_mul_ps(_mm_sub_ps(one, F), diffuseWeight);
+            __m128 diffuse = _mm_mul_ps(_mm_load_ps(irradiance[c] + i), _mm_set1_ps(constants.albedo[c]));
+            color[c] = _mm_add_ps(_mm_mul_ps(kD, diffuse), specular);
+        }
+
+        // Lo per light: cookTorranceBRDF * Li * myDot(wi, n). Lights cut off
+        // everywhere are in no cluster on the GPU.
+        for (uint32_t l = 0; l < constants.lightCount; l++)
+        {
+            const GpuPointLight &source = constants.lights[l];
+            if (!(source.radius > 0))
+                continue;
+            LightTerms light = lightTerms(source, n, p, wo);
+            __m128 D = normalDistribution(light.nDotH, roughness);
+            __m128 G = geometry(light.nDotWi, nDotWo, roughness);
+            __m128 specularScale = _mm_div_ps(_mm_mul_ps(D, G), _mm_add_ps(_mm_set1_ps(0.001f),
+                _mm_mul_ps(_mm_set1_ps(4.0f), _mm_mul_ps(light.nDotWi, nDotWo))));
+            __m128 incoming = _mm_mul_ps(_mm_mul_ps(light.attenuation, light.nDotWi),
+                _mm_set1_ps(source.intensity));
+            const float lightColor[3] = { source.color.x, source.color.y, source.color.z };
+            for (int c = 0; c < 3; c++)
+            {
+                __m128 F = fresnel(f0(constants.albedo[c], metalness), light.fresnelWeight, light.facing);
+                __m128 diffuse = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, F),
+                    _mm_set1_ps(constants.albedo[c] / PI)), diffuseWeight);
+                __m128 brdf = _mm_add_ps(diffuse, _mm_mul_ps(F, specularScale));
+                color[c] = _mm_add_ps(color[c], _mm_mul_ps(_mm_mul_ps(brdf, incoming),
+                    _mm_set1_ps(lightColor[c])));
+            }
+        }
+
+        for (int c = 0; c < 3; c++)
+            _mm_store_ps(outputs[c] + i, color[c]);
+    }
+}
+
+template void DX::ShadePBR<PBRShaderMode::REGULAR>(const PBRShadingConstants &, const PBREnvironment &,
+    const PBRSurfaceBatch &, PBRColorBatch &);
+template void DX::ShadePBR<PBRShaderMode::NORMAL_DISTRIBUTION>(const PBRShadingConstants &,
+    const PBREnvironment &, const PBRSurfaceBatch &, PBRColorBatch &);
+template void DX::ShadePBR<PBRShaderMode::GEOMETRY>(const PBRShadingConstants &, const PBREnvironment &,
+    const PBRSurfaceBatch &, PBRColorBatch &);
+template void DX::ShadePBR<PBRShaderMode::FRESNEL>(const PBRShadingConstants &, const PBREnvironment &,
+    const PBRSurfaceBatch &, PBRColorBatch &);
+
+void DX::ShadePBR(PBRShaderMode mode, const PBRShadingConstants &constants, const PBREnvironment &environment,
+    const PBRSurfaceBatch &surfaces, PBRColorBatch &colors)
+{
+    switch (mode)
+    {
+    case PBRShaderMode::REGULAR:
+        ShadePBR<PBRShaderMode::REGULAR>(constants, environment, surfaces, colors);
+        break;
+    case PBRShaderMode::NORMAL_DISTRIBUTION:
+        ShadePBR<PBRShaderMode::NORMAL_DISTRIBUTION>(constants, environment, surfaces, colors);
+        break;
+    case PBRShaderMode::GEOMETRY:
+        ShadePBR<PBRShaderMode::GEOMETRY>(constants, environment, surfaces, colors);
+        break;
+    case PBRShaderMode::FRESNEL:
+        ShadePBR<PBRShaderMode::FRESNEL>(constants, environment, surfaces, colors);
+        break;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+#include "..\Lighting\LightManager.h"
+
+namespace DX
+{
+    // What the sphere grid shows, one pixel shader each on the GPU:
+    // PBRPixelShader, NormalDistributionPixelShader, GeometryPixelShader
+    // and FresnelPixelShader
+    enum class PBRShaderMode
+    {
+        REGULAR,
+        NORMAL_DISTRIBUTION,
+        GEOMETRY,
+        FRESNEL
+    };
+
+    // Pixels shaded per call, as structure of arrays
+    const uint32_t PBR_BATCH_SIZE = 8;
+
+    // Per-draw inputs, the constant buffers of PBRInclude.cginc
+    struct PBRShadingConstants
+    {
+        float cameraPos[3] = { 0.0f, 0.0f, 0.0f };
+        float albedo[3] = { 1.0f, 1.0f, 1.0f };
+        // The light buffer, see DX::LightManager::GetLights. PBRPixelShader
+        // lights with all of them, falling off by DX::WindowedAttenuation,
+        // the single term modes with the first, which they need.
+        const GpuPointLight *lights = nullptr;
+        uint32_t lightCount = 0;
+    };
+
+    // Surfaces of PBR_BATCH_SIZE pixels. Normals do not need to be unit
+    // length, the shaders normalize them like the interpolated ones.
+    struct alignas(16) PBRSurfaceBatch
+    {
+        float normalX[PBR_BATCH_SIZE];
+        float normalY[PBR_BATCH_SIZE];
+        float normalZ[PBR_BATCH_SIZE];
+        float positionX[PBR_BATCH_SIZE];
+        float positionY[PBR_BATCH_SIZE];
+        float positionZ[PBR_BATCH_SIZE];
+        float roughness[PBR_BATCH_SIZE];
+        float metalness[PBR_BATCH_SIZE];
+    };
+
+    struct alignas(16) PBRColorBatch
+    {
+        float r[PBR_BATCH_SIZE];
+        float g[PBR_BATCH_SIZE];
+        float b[PBR_BATCH_SIZE];
+    };
+
+    // The three textures of the split sum image based lighting, sampled
+    // PBR_BATCH_SIZE lookups at a time
+    class PBREnvironment
+    {
+    public:
+        virtual ~PBREnvironment() {}
+
+        // Irradiance map along the directions
+        virtual void SampleIrradiance(const float *x, const float *y, const float *z,
+            float *r, float *g, float *b) const = 0;
+        // Prefiltered color map along the directions at the given mip levels
+        virtual void SamplePrefiltered(const float *x, const float *y, const float *z, const float *level,
+            float *r, float *g, float *b) const = 0;
+        // Preintegrated BRDF table, the scale and bias applied to F0
+        virtual void SampleBRDF(const float *nDotV, const float *roughness, float *scale, float *bias) const = 0;
+    };
+
+    // Environment of one color all around, with the analytic fit by Karis
+    // in place of the preintegrated BRDF table
+    class ConstantPBREnvironment : public PBREnvironment
+    {
+    public:
+        ConstantPBREnvironment(float r, float g, float b);
+
+        void SampleIrradiance(const float *x, const float *y, const float *z,
+            float *r, float *g, float *b) const override;
+        void SamplePrefiltered(const float *x, const float *y, const float *z, const float *level,
+            float *r, float *g, float *b) const override;
+        void SampleBRDF(const float *nDotV, const float *roughness, float *scale, float *bias) const override;
+
+    private:
+        float m_color[3];
+    };
+
+    // CPU version of the pixel shaders built on PBRInclude.cginc, same
+    // functions and constants, evaluated with SSE2 on a batch at a time.
+    // Every mode is its own instantiation, so the terms a mode does not show
+    // are not computed at all. Only REGULAR samples the environment.
+    template <PBRShaderMode Mode>
+    void ShadePBR(const PBRShadingConstants &constants, const PBREnvironment &environment,
+        const PBRSurfaceBatch &surfaces, PBRColorBatch &colors);
+
+    // Dispatches to the instantiation for mode
+    void ShadePBR(PBRShaderMode mode, const PBRShadingConstants &constants, const PBREnvironment &environment,
+        const PBRSurfaceBatch &surfaces, PBRColorBatch &colors);
+}
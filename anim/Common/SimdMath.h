@@ -0,0 +1,119 @@
+#pragma once
+
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+// SSE2 versions of the transcendental functions the CPU post-processing
+// modules need. Polynomials follow the Cephes single precision ones, the
+// relative error is around 1e-7 over the normal float range.
+namespace DX
+{
+    namespace Simd
+    {
+        // Natural logarithm of four positive floats
+        inline __m128 Log(__m128 x)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            // Keep denormals and zero from producing garbage exponents
+            x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000)));
+
+            __m128i exponent = _mm_srli_epi32(_mm_castps_si128(x), 23);
+            // Mantissa in [0.5, 1)
+            x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+            x = _mm_or_ps(x, _mm_set1_ps(0.5f));
+
+            exponent = _mm_sub_epi32(exponent, _mm_set1_epi32(0x7f));
+            __m128 e = _mm_add_ps(_mm_cvtepi32_ps(exponent), one);
+
+            // Shift the mantissa to [sqrt(0.5), sqrt(2)) for a better polynomial fit
+            __m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+            __m128 tmp = _mm_and_ps(x, mask);
+            x = _mm_sub_ps(x, one);
+            e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+            x = _mm_add_ps(x, tmp);
+
+            __m128 z = _mm_mul_ps(x, x);
+            __m128 y = _mm_set1_ps(7.0376836292E-2f);
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f));
+            y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+            y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+            y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+            x = _mm_add_ps(x, y);
+            return _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+        }
+
+        // Base 2 logarithm of four positive floats
+        inline __m128 Log2(__m128 x)
+        {
+            return _mm_mul_ps(Log(x), _mm_set1_ps(1.44269504088896341f));
+        }
+
+        // Natural exponent of four floats, inputs are clamped to about [-87, 88]
+        inline __m128 Exp(__m128 x)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+            x = _mm_max_ps(x, _mm_set1_ps(-87.3365478515625f));
+
+            // exp(x) = 2^n * exp(g) with n = round(x / ln2)
+            __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+            __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+            // Truncation rounds towards zero, fix it up to floor for negative inputs
+            n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, fx), one));
+
+            x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+            x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+
+            __m128 z = _mm_mul_ps(x, x);
+            __m128 y = _mm_set1_ps(1.9875691500E-4f);
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f));
+            y = _mm_add_ps(_mm_mul_ps(y, z), x);
+            y = _mm_add_ps(y, one);
+
+            __m128i pow2n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(0x7f)), 23);
+            return _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+        }
+
+        // 2 raised to four floats
+        inline __m128 Exp2(__m128 x)
+        {
+            return Exp(_mm_mul_ps(x, _mm_set1_ps(0.693147180559945309f)));
+        }
+
+        // Relative luminance with the weights the luminance shaders use
+        inline __m128 Luminance(__m128 r, __m128 g, __m128 b)
+        {
+            return _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(r, _mm_set1_ps(0.2126f)),
+                _mm_mul_ps(g, _mm_set1_ps(0.7151f))),
+                _mm_mul_ps(b, _mm_set1_ps(0.0722f)));
+        }
+
+        // Log brightness ln(1 + luminance) of four consecutive RGBA float pixels
+        inline __m128 LogBrightness(const float *rgba)
+        {
+            __m128 r = _mm_loadu_ps(rgba);
+            __m128 g = _mm_loadu_ps(rgba + 4);
+            __m128 b = _mm_loadu_ps(rgba + 8);
+            __m128 a = _mm_loadu_ps(rgba + 12);
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+
+            __m128 l = _mm_max_ps(Luminance(r, g, b), _mm_setzero_ps());
+            return Log(_mm_add_ps(l, _mm_set1_ps(1.0f)));
+        }
+    }
+}
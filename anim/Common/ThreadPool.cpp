@@ -0,0 +1,135 @@
+#include "pch.h"
+
+#include "ThreadPool.h"
+
+using namespace DX;
+
+namespace
+{
+    // Pool whose task the current thread is running, and its participant
+    thread_local const ThreadPool *t_pool = nullptr;
+    thread_local unsigned t_participant = 0;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount) :
+    m_nextTask(0)
+{
+    if (threadCount == 0)
+        threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+    for (unsigned i = 1; i < threadCount; i++)
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &worker : m_workers)
+        worker.join();
+}
+
+ThreadPool &ThreadPool::Default()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::ParallelFor(size_t taskCount, const Task &task)
+{
+    if (taskCount == 0)
+        return;
+
+    // A call from one of this pool's tasks keeps the participant of its
+    // thread, which no other thread uses meanwhile
+    if (t_pool == this)
+    {
+        for (size_t i = 0; i < taskCount; i++)
+            task(i, t_participant);
+        return;
+    }
+    if (m_workers.empty() || taskCount == 1)
+    {
+        for (size_t i = 0; i < taskCount; i++)
+            task(i, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> callLock(m_callMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_taskCount = taskCount;
+        m_nextTask = 0;
+        m_error = nullptr;
+        m_busyWorkers = (unsigned)m_workers.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    runTasks(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+        m_task = nullptr;
+        error = m_error;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::workerLoop(unsigned participant)
+{
+    uint64_t seenGeneration = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+            if (m_stop)
+                return;
+            seenGeneration = m_generation;
+        }
+
+        runTasks(participant);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0)
+            m_done.notify_all();
+    }
+}
+
+void ThreadPool::runTasks(unsigned participant)
+{
+    // The thread may be inside a task of another pool
+    const ThreadPool *outerPool = t_pool;
+    unsigned outerParticipant = t_participant;
+    t_pool = this;
+    t_participant = participant;
+    for (;;)
+    {
+        size_t i = m_nextTask.fetch_add(1);
+        if (i >= m_taskCount)
+            break;
+
+        try
+        {
+            (*m_task)(i, participant);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+                m_error = std::current_exception();
+            // Let the remaining participants finish early
+            m_nextTask = m_taskCount;
+        }
+    }
+    t_pool = outerPool;
+    t_participant = outerParticipant;
+}
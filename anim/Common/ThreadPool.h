@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DX
+{
+    // Fixed set of worker threads for data-parallel CPU work. ParallelFor
+    // hands out task indices to the workers and to the calling thread, and
+    // returns once every task has run.
+    class ThreadPool
+    {
+    public:
+        // Task callback: (task index, participant index in [0, GetConcurrency()))
+        typedef std::function<void(size_t, unsigned)> Task;
+
+        // threadCount is the total number of participants including the
+        // calling thread; 0 picks one per hardware thread.
+        explicit ThreadPool(unsigned threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // Run task for every index in [0, taskCount). Calls made from inside
+        // one of this pool's tasks run serially on the current thread, with
+        // the participant index of the task that made them.
+        void ParallelFor(size_t taskCount, const Task &task);
+
+        // Number of threads that may run tasks at the same time
+        unsigned GetConcurrency() const { return (unsigned)m_workers.size() + 1; }
+
+        // Process-wide pool shared by the CPU modules
+        static ThreadPool &Default();
+
+    private:
+        void workerLoop(unsigned participant);
+        void runTasks(unsigned participant);
+
+        std::vector<std::thread> m_workers;
+
+        std::mutex m_callMutex;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        uint64_t m_generation = 0;
+        unsigned m_busyWorkers = 0;
+        bool m_stop = false;
+
+        const Task *m_task = nullptr;
+        size_t m_taskCount = 0;
+        std::atomic<size_t> m_nextTask;
+        std::exception_ptr m_error;
+    };
+}
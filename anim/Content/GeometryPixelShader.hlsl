@@ -1,7 +1,9 @@
+#define INSTANCED_MATERIAL
 #include "PBRInclude.cginc"
 
 float4 main(PixelShaderInput input) : SV_TARGET
 {
+    setInstanceMaterial(input);
     return geometry(
         normalize(input.normal),
         toLight(0, input.worldPos),
@@ -0,0 +1,270 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "HeadlessSceneRenderer.h"
+
+using namespace anim;
+using namespace DirectX;
+
+namespace
+{
+    const float PI = 3.14159265359f;
+
+    // Radiance of the constant environment that stands in for the maps
+    const float AMBIENT = 0.03f;
+    // Rows shaded per thread pool task
+    const uint32_t SHADING_ROWS = 16;
+
+    // Row vector times the untransposed matrix, as the shaders do it
+    void transformPoint(const XMFLOAT4X4 &m, const XMFLOAT3 &p, float *output)
+    {
+        for (int c = 0; c < 4; c++)
+            output[c] = p.x * m.m[0][c] + p.y * m.m[1][c] + p.z * m.m[2][c] + m.m[3][c];
+    }
+
+    void normalize3(float *v)
+    {
+        float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length > 0)
+            for (int c = 0; c < 3; c++)
+                v[c] /= length;
+    }
+}
+
+HeadlessSceneRenderer::HeadlessSceneRenderer(uint32_t width, uint32_t height, DX::ThreadPool &pool) :
+    m_pool(pool),
+    m_target(width, height),
+    m_rasterizer(pool),
+    m_lights(MAX_SCENE_LIGHTS, SCENE_LIGHT_THRESHOLD),
+    m_environment(AMBIENT, AMBIENT, AMBIENT),
+    m_sphereGrid(10, 5),
+    m_sphereLODs({ 8, 16, 32, 64 }, 0.25f),
+    m_sphereCuller(pool)
+{
+    m_sphereGrid.GetBounds(m_sphereLODs.GetRadius(), m_sphereBounds);
+    m_surfaces.resize((size_t)width * height);
+
+    // Dark like in Sample3DSceneRenderer until SetLightStrength
+    for (uint32_t l = 0; l < SCENE_LIGHT_COUNT; l++)
+        m_lightHandles[l] = m_lights.Add(SCENE_LIGHT_POSITIONS[l], SCENE_LIGHT_COLORS[l], 0.0f);
+}
+
+void HeadlessSceneRenderer::Render(FXMMATRIX view, CXMMATRIX projection, const XMFLOAT3 &cameraPos)
+{
+    static const float CLEAR_COLOR[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    m_target.Clear(CLEAR_COLOR);
+    m_covered.assign(m_surfaces.size(), 0);
+    m_rasterizer.SetRenderTarget(&m_target);
+
+    XMMATRIX viewProjection = XMMatrixMultiply(view, projection);
+    XMFLOAT4X4 projection4x4;
+    XMStoreFloat4x4(&projection4x4, projection);
+
+    renderSky(viewProjection, cameraPos);
+    renderSphereGrid(viewProjection, cameraPos, projection4x4._22 * m_target.GetHeight() / 2);
+    m_rasterizer.Flush();
+    shadeSurfaces(cameraPos);
+}
+
+void HeadlessSceneRenderer::renderSky(FXMMATRIX viewProjection, const XMFLOAT3 &cameraPos)
+{
+    // Mirrored through the camera like the D3D11 path, inside facing it,
+    // on the coarsest level
+    XMStoreFloat4x4(&m_skyTransform, XMMatrixMultiply(
+        XMMatrixMultiply(XMMatrixScaling(-999, -999, -999), XMMatrixTranslation(cameraPos.x, cameraPos.y, cameraPos.z)),
+        viewProjection));
+
+    // The pixel shaders run at the flush, everything is captured by value
+    const VertexPositionColorNormal *vertices = m_sphereLODs.GetVertices().data();
+    auto vertexShader = [this, vertices](uint32_t vertex, uint32_t, DX::SoftwareRasterizer::Vertex &output)
+    {
+        const XMFLOAT3 &pos = vertices[vertex].pos;
+        transformPoint(m_skyTransform, pos, output.position);
+        // World position minus the camera, the direction SkySpherePixelShader samples
+        output.varyings[0] = -pos.x;
+        output.varyings[1] = -pos.y;
+        output.varyings[2] = -pos.z;
+    };
+    auto pixelShader = [this](const float *varyings, uint32_t, uint32_t, uint32_t, float *color)
+    {
+        float direction[3] = { varyings[0], varyings[1], varyings[2] };
+        normalize3(direction);
+        if (m_environmentMap)
+        {
+            float u = 0.5f + std::atan2(direction[0], -direction[2]) / (2 * PI);
+            float v = std::acos((std::max)(-1.0f, (std::min)(1.0f, direction[1]))) / PI;
+            m_environmentMap->Sample(u, v, true, color);
+        }
+        else
+        {
+            float t = 0.5f + 0.5f * direction[1];
+            color[0] = 0.6f + 0.2f * t;
+            color[1] = 0.5f + 0.3f * t;
+            color[2] = 0.4f + 0.6f * t;
+        }
+        color[3] = 1.0f;
+        return true;
+    };
+
+    const SphereLODChain::Level &level = m_sphereLODs.GetLevel(0);
+    m_rasterizer.SetShaders(vertexShader, pixelShader, 3);
+    m_rasterizer.DrawIndexed(&m_sphereLODs.GetIndices()[level.startIndex], level.indexCount, level.baseVertex);
+}
+
+void HeadlessSceneRenderer::renderSphereGrid(FXMMATRIX viewProjection, const XMFLOAT3 &cameraPos,
+    float pixelsPerUnit)
+{
+    if (m_sphereGrid.UpdateTransforms())
+        m_sphereGrid.GetBounds(m_sphereLODs.GetRadius(), m_sphereBounds);
+
+    const std::vector<uint32_t> &visible = m_sphereCuller.Cull(m_sphereBounds, DX::ExtractFrustum(viewProjection));
+    const std::vector<uint32_t> &levels = m_lodSelector.Select(m_sphereLODs, m_sphereGrid.GetInstances(),
+        cameraPos, pixelsPerUnit);
+    if (visible.empty())
+        return;
+
+    // Counting sort by level as in SphereGrid::Draw, one instanced draw per
+    // level with the instance id indexing the sorted list
+    uint32_t levelCount = m_sphereLODs.GetLevelCount();
+    m_levelStarts.assign(levelCount + 1, 0);
+    for (uint32_t i : visible)
+        m_levelStarts[levels[i] + 1]++;
+    for (uint32_t l = 0; l < levelCount; l++)
+        m_levelStarts[l + 1] += m_levelStarts[l];
+    m_sortedInstances.resize(visible.size());
+    std::vector<uint32_t> next(m_levelStarts.begin(), m_levelStarts.end() - 1);
+    for (uint32_t i : visible)
+        m_sortedInstances[next[levels[i]]++] = i;
+
+    const SphereInstance *instances = m_sphereGrid.GetInstances().data();
+    m_modelViewProjections.resize(m_sortedInstances.size());
+    for (size_t i = 0; i < m_sortedInstances.size(); i++)
+        XMStoreFloat4x4(&m_modelViewProjections[i],
+            XMMatrixMultiply(XMLoadFloat4x4(&instances[m_sortedInstances[i]].model), viewProjection));
+
+    const VertexPositionColorNormal *vertices = m_sphereLODs.GetVertices().data();
+    auto vertexShader = [this, vertices, instances](uint32_t vertex, uint32_t instance,
+        DX::SoftwareRasterizer::Vertex &output)
+    {
+        const XMFLOAT4X4 &model = instances[m_sortedInstances[instance]].model;
+        const VertexPositionColorNormal &input = vertices[vertex];
+        transformPoint(m_modelViewProjections[instance], input.pos, output.position);
+
+        float worldPos[4];
+        transformPoint(model, input.pos, worldPos);
+        float *normal = output.varyings + 3;
+        for (int c = 0; c < 3; c++)
+        {
+            output.varyings[c] = worldPos[c];
+            normal[c] = input.normal.x * model.m[0][c] + input.normal.y * model.m[1][c] +
+                input.normal.z * model.m[2][c];
+        }
+        normalize3(normal);
+    };
+    // Only records the surface, shadeSurfaces lights the pixels left after the depth test
+    auto pixelShader = [this, instances](const float *varyings, uint32_t instance, uint32_t x, uint32_t y,
+        float *color)
+    {
+        size_t pixel = (size_t)y * m_target.GetWidth() + x;
+        const SphereInstance &material = instances[m_sortedInstances[instance]];
+        Surface &surface = m_surfaces[pixel];
+        for (int c = 0; c < 3; c++)
+        {
+            surface.position[c] = varyings[c];
+            surface.normal[c] = varyings[3 + c];
+        }
+        surface.roughness = material.roughness;
+        surface.metalness = material.metalness;
+        m_covered[pixel] = 1;
+
+        color[0] = color[1] = color[2] = 0.0f;
+        color[3] = 1.0f;
+        return true;
+    };
+
+    m_rasterizer.SetShaders(vertexShader, pixelShader, 6);
+    const std::vector<uint32_t> &indices = m_sphereLODs.GetIndices();
+    for (uint32_t l = 0; l < levelCount; l++)
+    {
+        uint32_t count = m_levelStarts[l + 1] - m_levelStarts[l];
+        if (count == 0)
+            continue;
+        const SphereLODChain::Level &level = m_sphereLODs.GetLevel(l);
+        m_rasterizer.DrawIndexedInstanced(&indices[level.startIndex], level.indexCount, count, level.baseVertex,
+            m_levelStarts[l]);
+    }
+}
+
+void HeadlessSceneRenderer::shadeSurfaces(const XMFLOAT3 &cameraPos)
+{
+    DX::PBRShadingConstants constants;
+    constants.cameraPos[0] = cameraPos.x;
+    constants.cameraPos[1] = cameraPos.y;
+    constants.cameraPos[2] = cameraPos.z;
+    m_lights.GetLights(m_shadingLights);
+    constants.lights = m_shadingLights.data();
+    constants.lightCount = (uint32_t)m_shadingLights.size();
+
+    uint32_t width = m_target.GetWidth();
+    uint32_t height = m_target.GetHeight();
+    uint32_t pitch = m_target.GetPitch();
+    float *color = m_target.GetColor();
+    m_pool.ParallelFor((height + SHADING_ROWS - 1) / SHADING_ROWS, [&](size_t task, unsigned)
+    {
+        DX::PBRSurfaceBatch surfaces;
+        DX::PBRColorBatch colors;
+        float *outputs[DX::PBR_BATCH_SIZE];
+        uint32_t count = 0;
+
+        // Gather covered pixels a batch at a time. A partial batch repeats
+        // its last pixel, only the real ones are written back.
+        auto shade = [&]()
+        {
+            for (uint32_t i = count; i < DX::PBR_BATCH_SIZE; i++)
+            {
+                surfaces.normalX[i] = surfaces.normalX[count - 1];
+                surfaces.normalY[i] = surfaces.normalY[count - 1];
+                surfaces.normalZ[i] = surfaces.normalZ[count - 1];
+                surfaces.positionX[i] = surfaces.positionX[count - 1];
+                surfaces.positionY[i] = surfaces.positionY[count - 1];
+                surfaces.positionZ[i] = surfaces.positionZ[count - 1];
+                surfaces.roughness[i] = surfaces.roughness[count - 1];
+                surfaces.metalness[i] = surfaces.metalness[count - 1];
+            }
+            DX::ShadePBR(m_shaderMode, constants, m_environment, surfaces, colors);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                outputs[i][0] = colors.r[i];
+                outputs[i][1] = colors.g[i];
+                outputs[i][2] = colors.b[i];
+            }
+            count = 0;
+        };
+
+        uint32_t lastRow = (std::min)((uint32_t)(task + 1) * SHADING_ROWS, height);
+        for (uint32_t y = (uint32_t)task * SHADING_ROWS; y < lastRow; y++)
+            for (uint32_t x = 0; x < width; x++)
+            {
+                size_t pixel = (size_t)y * width + x;
+                if (!m_covered[pixel])
+                    continue;
+
+                const Surface &surface = m_surfaces[pixel];
+                surfaces.normalX[count] = surface.normal[0];
+                surfaces.normalY[count] = surface.normal[1];
+                surfaces.normalZ[count] = surface.normal[2];
+                surfaces.positionX[count] = surface.position[0];
+                surfaces.positionY[count] = surface.position[1];
+                surfaces.positionZ[count] = surface.position[2];
+                surfaces.roughness[count] = surface.roughness;
+                surfaces.metalness[count] = surface.metalness;
+                outputs[count] = color + ((size_t)y * pitch + x) * 4;
+                if (++count == DX::PBR_BATCH_SIZE)
+                    shade();
+            }
+        if (count > 0)
+            shade();
+    });
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "..\Common\Culling\FrustumCuller.h"
+#include "..\Common\Lighting\LightManager.h"
+#include "..\Common\Raster\SoftwareRasterizer.h"
+#include "..\Common\Shading\PBRShading.h"
+#include "SceneLights.h"
+#include "ShaderStructures.h"
+#include "LODSelector.h"
+#include "SphereGrid.h"
+#include "SphereLODChain.h"
+
+namespace anim
+{
+    // Renders the sky and the sphere grid of Sample3DSceneRenderer on the
+    // CPU through DX::SoftwareRasterizer, for machines without D3D11: golden
+    // images and throughput benchmarks. Meshes, culling, level selection and
+    // draw order are the ones of the D3D11 path. The sky reads an optional
+    // longitude-latitude map. The grid is rasterized into a surface buffer
+    // and then shaded in batches by DX::ShadePBR, with a constant ambient
+    // environment in place of the image based lighting maps. The lights are
+    // the scene's, in a DX::LightManager like on the D3D11 path.
+    class HeadlessSceneRenderer
+    {
+    public:
+        HeadlessSceneRenderer(uint32_t width, uint32_t height, DX::ThreadPool &pool = DX::ThreadPool::Default());
+
+        // Strength as in Sample3DSceneRenderer::CycleLight, 0 turns the light off
+        void SetLightStrength(int lightId, float strength)
+        {
+            m_lights.SetIntensity(m_lightHandles[lightId], strength);
+        }
+        DX::LightManager &GetLights() { return m_lights; }
+        // Map the sky shows, a gradient when null. Must outlive the renderer or the next call.
+        void SetEnvironmentMap(const DX::RasterTarget *map) { m_environmentMap = map; }
+        void SetShaderMode(DX::PBRShaderMode mode) { m_shaderMode = mode; }
+
+        SphereGrid &GetSphereGrid() { return m_sphereGrid; }
+        const SphereLODChain &GetSphereLODs() const { return m_sphereLODs; }
+        DX::SoftwareRasterizer &GetRasterizer() { return m_rasterizer; }
+        const DX::RasterTarget &GetTarget() const { return m_target; }
+
+        // Matrices as the camera returns them, untransposed
+        void Render(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection, const DirectX::XMFLOAT3 &cameraPos);
+
+    private:
+        void renderSky(DirectX::FXMMATRIX viewProjection, const DirectX::XMFLOAT3 &cameraPos);
+        void renderSphereGrid(DirectX::FXMMATRIX viewProjection, const DirectX::XMFLOAT3 &cameraPos,
+            float pixelsPerUnit);
+        // Shade the surfaces the grid left in m_surfaces into the target
+        void shadeSurfaces(const DirectX::XMFLOAT3 &cameraPos);
+
+        DX::ThreadPool &m_pool;
+        DX::RasterTarget m_target;
+        DX::SoftwareRasterizer m_rasterizer;
+        const DX::RasterTarget *m_environmentMap = nullptr;
+        DX::LightManager m_lights;
+        DX::LightHandle m_lightHandles[SCENE_LIGHT_COUNT];
+        std::vector<DX::GpuPointLight> m_shadingLights;
+        DX::PBRShaderMode m_shaderMode = DX::PBRShaderMode::REGULAR;
+        DX::ConstantPBREnvironment m_environment;
+
+        // Per pixel: normal, world position, roughness and metalness of the
+        // nearest sphere, where covered is set
+        struct Surface
+        {
+            float normal[3];
+            float position[3];
+            float roughness;
+            float metalness;
+        };
+        std::vector<Surface> m_surfaces;
+        std::vector<uint8_t> m_covered;
+
+        SphereGrid m_sphereGrid;
+        SphereLODChain m_sphereLODs;
+        LODSelector m_lodSelector;
+        DX::BoundingSphereSet m_sphereBounds;
+        DX::FrustumCuller m_sphereCuller;
+
+        // Visible instances ordered by level and their transforms, per draw
+        std::vector<uint32_t> m_sortedInstances;
+        std::vector<uint32_t> m_levelStarts;
+        std::vector<DirectX::XMFLOAT4X4> m_modelViewProjections;
+        DirectX::XMFLOAT4X4 m_skyTransform;
+    };
+}
@@ -0,0 +1,57 @@
+#include "PackedVertex.cginc"
+
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+// The model matrix comes from the instance, the one here maps the packed position
+// back to mesh units before it.
+cbuffer ModelViewProjectionConstantBuffer : register(b0)
+{
+    matrix meshTransform;
+    matrix view;
+    matrix projection;
+};
+
+// Packed per-vertex data from stream 0, see DX::PackedVertex, and per-instance data
+// from stream 1, see SphereInstance.
+struct VertexShaderInput
+{
+    float4 pos : POSITION;
+    float2 normal : NORMAL;
+    float2 texcoord : TEXCOORD;
+    float4 model0 : INSTANCE_TRANSFORM0;
+    float4 model1 : INSTANCE_TRANSFORM1;
+    float4 model2 : INSTANCE_TRANSFORM2;
+    float4 model3 : INSTANCE_TRANSFORM3;
+    float2 material : INSTANCE_MATERIAL;
+};
+
+// Per-pixel color data passed through the pixel shader.
+struct PixelShaderInput
+{
+    float4 pos : SV_POSITION;
+    float3 color : COLOR0;
+    float3 normal : NORMAL;
+    float3 worldPos : WORLD_POSITION;
+    nointerpolation float2 material : MATERIAL;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+    PixelShaderInput output;
+    float4x4 model = float4x4(input.model0, input.model1, input.model2, input.model3);
+
+    // Transform the vertex position into projected space.
+    float4 pos = mul(mul(input.pos, meshTransform), model);
+    output.worldPos = pos.xyz;
+    pos = mul(pos, view);
+    pos = mul(pos, projection);
+    output.pos = pos;
+
+    output.normal = normalize(mul(float4(decodeOctahedral(input.normal), 0.0f), model).xyz);
+
+    // The texture coordinate takes the place of the color, pass the instance
+    // material through without modification.
+    output.color = float3(input.texcoord, 0.0f);
+    output.material = input.material;
+
+    return output;
+}
@@ -0,0 +1,71 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "LODSelector.h"
+
+using namespace anim;
+
+namespace
+{
+    // Instances without a level yet go straight to the wanted one
+    const uint32_t NO_LEVEL = ~0u;
+}
+
+LODSelector::LODSelector(float thresholdPixels, float hysteresis) :
+    m_threshold(thresholdPixels),
+    m_hysteresis(hysteresis)
+{
+}
+
+const std::vector<uint32_t> &LODSelector::Select(const SphereLODChain &chain,
+    const std::vector<SphereInstance> &instances, const DirectX::XMFLOAT3 &cameraPos, float pixelsPerUnit)
+{
+    if (m_levels.size() != instances.size())
+        m_levels.assign(instances.size(), NO_LEVEL);
+
+    uint32_t finest = chain.GetLevelCount() - 1;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const DirectX::XMFLOAT4X4 &model = instances[i].model;
+        // Rows of the untransposed matrix: scale in the first three, position in the last
+        float scale = std::sqrt(model._11 * model._11 + model._12 * model._12 + model._13 * model._13);
+        float dx = model._41 - cameraPos.x;
+        float dy = model._42 - cameraPos.y;
+        float dz = model._43 - cameraPos.z;
+        // Distance to the nearest point of the surface, where the error looks largest
+        float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - chain.GetRadius() * scale;
+
+        uint32_t &level = m_levels[i];
+        if (distance <= 0)
+        {
+            level = finest;
+            continue;
+        }
+
+        float errorScale = scale * pixelsPerUnit / distance;
+        auto coarsestWithin = [&](float pixels)
+        {
+            uint32_t l = 0;
+            while (l < finest && chain.GetLevel(l).geometricError * errorScale > pixels)
+                l++;
+            return l;
+        };
+
+        uint32_t wanted = coarsestWithin(m_threshold);
+        if (level == NO_LEVEL || wanted > level)
+            level = wanted;
+        else if (wanted < level)
+            level = (std::min)(level, coarsestWithin(m_threshold * m_hysteresis));
+    }
+    return m_levels;
+}
+
+uint64_t LODSelector::GetTriangleCount(const SphereLODChain &chain) const
+{
+    uint64_t triangles = 0;
+    for (uint32_t level : m_levels)
+        triangles += chain.GetLevel(level).indexCount / 3;
+    return triangles;
+}
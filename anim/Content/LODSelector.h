@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ShaderStructures.h"
+#include "SphereLODChain.h"
+
+namespace anim
+{
+    // Picks a level of a SphereLODChain per instance: the coarsest level
+    // whose geometric error projects to at most thresholdPixels. A level is
+    // only left for a coarser one once that one's error falls below
+    // hysteresis * thresholdPixels, so instances near a switching distance
+    // do not flip between levels from frame to frame.
+    class LODSelector
+    {
+    public:
+        explicit LODSelector(float thresholdPixels = 1.0f, float hysteresis = 0.75f);
+
+        // pixelsPerUnit is the projected size of one unit at distance one,
+        // projection._22 * viewport height / 2. Levels of earlier calls are
+        // kept as long as the instance count does not change.
+        const std::vector<uint32_t> &Select(const SphereLODChain &chain,
+            const std::vector<SphereInstance> &instances, const DirectX::XMFLOAT3 &cameraPos,
+            float pixelsPerUnit);
+
+        const std::vector<uint32_t> &GetLevels() const { return m_levels; }
+        // Triangles the last selection draws
+        uint64_t GetTriangleCount(const SphereLODChain &chain) const;
+
+        void SetThreshold(float thresholdPixels) { m_threshold = thresholdPixels; }
+        float GetThreshold() const { return m_threshold; }
+
+    private:
+        float m_threshold;
+        float m_hysteresis;
+        std::vector<uint32_t> m_levels;
+    };
+}
@@ -1,15 +1,17 @@
+#define INSTANCED_MATERIAL
 #include "PBRInclude.cginc"
 
 float4 main(PixelShaderInput input) : SV_TARGET
 {
+    setInstanceMaterial(input);
     float3 wo = toCamera(input.worldPos);
     float3 n = normalize(input.normal);
 
-    float3 finalColor =
-        ambient(n, wo) +
-        Lo(0, input.worldPos, n, wo) +
-        Lo(1, input.worldPos, n, wo);
-        //Lo(2, input.worldPos, input.normal, wo);
+    float3 finalColor = ambient(n, wo);
+    // Only the lights of the pixel's cluster, SV_POSITION.w is the view depth
+    uint2 range = clusterLightRange(input.pos.xy, input.pos.w);
+    for (uint i = 0; i < range.y; i++)
+        finalColor += Lo(clusterLightIndices[range.x + i], input.worldPos, n, wo);
 
     return float4(finalColor, 1.0f);
 }
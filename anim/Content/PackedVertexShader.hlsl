@@ -0,0 +1,46 @@
+#include "PackedVertex.cginc"
+
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+// The model matrix also maps the packed position back to mesh units.
+cbuffer ModelViewProjectionConstantBuffer : register(b0)
+{
+    matrix model;
+    matrix view;
+    matrix projection;
+};
+
+// Per-vertex data in the packed format, see DX::PackedVertex.
+struct VertexShaderInput
+{
+    float4 pos : POSITION;
+    float2 normal : NORMAL;
+    float2 texcoord : TEXCOORD;
+};
+
+// Per-pixel color data passed through the pixel shader.
+struct PixelShaderInput
+{
+    float4 pos : SV_POSITION;
+    float3 color : COLOR0;
+    float3 normal : NORMAL;
+    float3 worldPos : WORLD_POSITION;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+    PixelShaderInput output;
+
+    // Transform the vertex position into projected space.
+    float4 pos = mul(input.pos, model);
+    output.worldPos = pos.xyz;
+    pos = mul(pos, view);
+    pos = mul(pos, projection);
+    output.pos = pos;
+
+    output.normal = normalize(mul(float4(decodeOctahedral(input.normal), 0.0f), model).xyz);
+
+    // The texture coordinate takes the place of the color, as in the unpacked vertices.
+    output.color = float3(input.texcoord, 0.0f);
+
+    return output;
+}
@@ -3,6 +3,7 @@
 #include "Sample3DSceneRenderer.h"
 #include "WICTextureLoader.h"
 
+#include "..\Common\ConstantRing\D3D11ConstantRingDevice.h"
 #include "..\Common\DirectXHelper.h"
 #include "..\Common\StepTimer.h"
 
@@ -15,17 +16,41 @@ using namespace DirectX;
 using namespace Windows::Foundation;
 using namespace Microsoft::WRL;
 
+namespace
+{
+    // A frame takes six 256-byte slices, this leaves room for many frames
+    // in flight before the ring has to be discarded
+    const uint32_t CONSTANT_RING_SIZE = 64 * 1024;
+
+    // Light indices the cluster buffer starts with, a few lights per cluster
+    const uint32_t CLUSTER_INDICES_PER_CLUSTER = 4;
+
+    // Draw queue passes in drawing order
+    const uint32_t SPHERE_PASS = 0;
+    const uint32_t SKY_PASS = 1;
+}
+
 // Loads vertex and pixel shaders from files and instantiates the sphere geometry.
 Sample3DSceneRenderer::Sample3DSceneRenderer(
     const std::shared_ptr<DX::DeviceResources>& deviceResources,
     const std::shared_ptr<Camera>& camera,
     const std::shared_ptr<input::Keyboard>& keyboard) :
-    m_indexCount(0),
     m_deviceResources(deviceResources),
     m_camera(camera),
     m_keyboard(keyboard),
-    m_shaderMode(PBRShaderMode::REGULAR)
+    m_sphereGrid(10, 5),
+    m_sphereLODs({ 8, 16, 32, 64 }, 0.25f),
+    m_lodPixelsPerUnit(0),
+    m_shaderMode(PBRShaderMode::REGULAR),
+    m_lights(MAX_SCENE_LIGHTS, SCENE_LIGHT_THRESHOLD),
+    m_clusterIndexCapacity(0)
 {
+    m_sphereGrid.GetBounds(m_sphereLODs.GetRadius(), m_sphereBounds);
+
+    // Start dark, CycleLight turns them up
+    for (uint32_t l = 0; l < SCENE_LIGHT_COUNT; l++)
+        m_lightHandles[l] = m_lights.Add(SCENE_LIGHT_POSITIONS[l], SCENE_LIGHT_COLORS[l], 0.0f);
+
     CreateDeviceDependentResources();
     CreateWindowSizeDependentResources();
 }
@@ -38,10 +63,19 @@ void Sample3DSceneRenderer::CreateWindowSizeDependentResources()
 
     m_camera->SetProjectionValues(70.0f, aspectRatio, 0.01f, 1000.0f);
 
+    // Same frustum as the camera, the tile and slice counts stay the default
+    DX::ClusterGridDesc clusterGrid = m_lightCuller.GetGrid();
+    clusterGrid.fovY = XMConvertToRadians(70.0f);
+    clusterGrid.aspectRatio = aspectRatio;
+    clusterGrid.nearZ = 0.01f;
+    clusterGrid.farZ = 1000.0f;
+    m_lightCuller.SetGrid(clusterGrid);
+
     XMStoreFloat4x4(
         &m_constantBufferData.projection,
         XMMatrixTranspose(m_camera->GetProjectionMatrix())
     );
+    m_lodPixelsPerUnit = XMVectorGetY(m_camera->GetProjectionMatrix().r[1]) * outputSize.height / 2;
 
     // Eye is at (0,0.7,1.5), looking at point (0,-0.1,0) with the up-vector along the y-axis.
     static const XMFLOAT3 eye = { 0.0f, 0.0f, 5.0f };
@@ -64,18 +98,18 @@ void Sample3DSceneRenderer::CycleLight(int lightId)
     };
 
     lightState[lightId] = nextState(lightState[lightId]);
-    m_strengths[lightId] = strengths[lightState[lightId]];
+    m_lights.SetIntensity(m_lightHandles[lightId], strengths[lightState[lightId]]);
 }
 
 void Sample3DSceneRenderer::SetMaterial(MaterialConstantBuffer material)
 {
     m_materialConstantBufferData = material;
 
-    auto context = m_deviceResources->GetD3DDeviceContext();
+    auto backend = m_deviceResources->GetRenderBackend();
 
-    context->UpdateSubresource(m_materialConstantBuffer.Get(), 0, NULL,
-        &m_materialConstantBufferData, 0, 0);
-    context->PSSetConstantBuffers(1, 1, m_materialConstantBuffer.GetAddressOf());
+    backend->UpdateBuffer(m_materialConstantBuffer.Get(), &m_materialConstantBufferData,
+        sizeof(m_materialConstantBufferData));
+    backend->PSSetConstantBuffers(1, 1, m_materialConstantBuffer.GetAddressOf());
 }
 
 void Sample3DSceneRenderer::Update(DX::StepTimer const& timer)
@@ -106,132 +140,186 @@ void Sample3DSceneRenderer::Update(DX::StepTimer const& timer)
     // Update the view matrix, cause it can be changed by input
     XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixTranspose(m_camera->GetViewMatrix()));
 
-    m_lightConstantBufferData.lightColor1 = XMFLOAT4(LIGHT_COLOR_1.x, LIGHT_COLOR_1.y, LIGHT_COLOR_1.z, m_strengths[0]);
-    m_lightConstantBufferData.lightColor2 = XMFLOAT4(LIGHT_COLOR_2.x, LIGHT_COLOR_2.y, LIGHT_COLOR_2.z, m_strengths[1]);
-    m_lightConstantBufferData.lightColor3 = XMFLOAT4(LIGHT_COLOR_3.x, LIGHT_COLOR_3.y, LIGHT_COLOR_3.z, m_strengths[2]);
+    m_lightConstantBufferData.lightCount = m_lights.GetCount();
 
     m_generalConstantBufferData.cameraPos = m_camera->GetPositionFloat3();
     m_generalConstantBufferData.time = (float)timer.GetTotalSeconds();
 }
 
-// Renders one frame using the vertex and pixel shaders.
-void Sample3DSceneRenderer::Render()
+void Sample3DSceneRenderer::createClusterIndexBuffer(uint32_t capacity)
 {
-    auto context = m_deviceResources->GetD3DDeviceContext();
-    auto annotation = m_deviceResources->GetAnnotation();
-
-    // Prepare the constant buffer to send it to the graphics device.
-    context->UpdateSubresource(m_lightConstantBuffer.Get(), 0, NULL,
-        &m_lightConstantBufferData, 0, 0);
-    context->UpdateSubresource(m_generalConstantBuffer.Get(), 0, NULL,
-        &m_generalConstantBufferData, 0, 0);
-
-    // Each vertex is one instance of the VertexPositionColor struct.
-    UINT stride = sizeof(VertexPositionColorNormal);
-    UINT offset = 0;
-    context->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    context->IASetInputLayout(m_inputLayout.Get());
-
-    // Send the constant buffer to the graphics device.
-    context->VSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
-    context->PSSetConstantBuffers(0, 1, m_lightConstantBuffer.GetAddressOf());
-    context->PSSetConstantBuffers(2, 1, m_generalConstantBuffer.GetAddressOf());
-
-    annotation->BeginEvent(L"RenderSkySphere");
-    // Set sky sphere texture and shaders
-    context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-    context->PSSetShader(m_skySpherePixelShader.Get(), nullptr, 0);
-
-    if (m_isDrawIrradiance)
-        context->PSSetShaderResources(0, 1, m_irradianceMapSRV.GetAddressOf());
-    else
-        context->PSSetShaderResources(0, 1, m_environmentMapSRV.GetAddressOf());
-    context->PSSetSamplers(0, 1, m_deviceResources->GetSamplerStateClamp());
-
-    // Set sky sphere geometry
-    context->IASetVertexBuffers(0, 1, m_skySphereVertexBuffer.GetAddressOf(), &stride, &offset);
-    // Set scale matrix
-    XMStoreFloat4x4(
-        &m_constantBufferData.model,
-        XMMatrixMultiplyTranspose(
-            XMMatrixScaling(
-                999,
-                999,
-                999
-            ),
-            XMMatrixTranslationFromVector(m_camera->GetPositionVector())
+    CD3D11_BUFFER_DESC indexBufferDesc(capacity * (UINT)sizeof(uint32_t), D3D11_BIND_SHADER_RESOURCE,
+        D3D11_USAGE_DEFAULT, 0, D3D11_RESOURCE_MISC_BUFFER_STRUCTURED, (UINT)sizeof(uint32_t));
+    DX::ThrowIfFailed(
+        m_deviceResources->GetD3DDevice()->CreateBuffer(
+            &indexBufferDesc,
+            nullptr,
+            &m_clusterIndexBuffer
         )
     );
-    context->UpdateSubresource(m_constantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0);
-
-    // Render sky sphere
-    context->DrawIndexed(
-        (UINT)m_indexCount,
-        0,
-        0
-    );
-    annotation->EndEvent(); // RenderSkySphere
+    CD3D11_SHADER_RESOURCE_VIEW_DESC indexSRVDesc(m_clusterIndexBuffer.Get(), DXGI_FORMAT_UNKNOWN, 0, capacity);
+    m_clusterIndexSRV = m_deviceResources->createShaderResourceView(m_clusterIndexBuffer, "ClusterLightIndices",
+        &indexSRVDesc);
+    m_clusterIndexCapacity = capacity;
+}
 
-    annotation->BeginEvent(L"RenderSphereGrid");
+// Copies the culler's cluster ranges and light indices to their buffers
+void Sample3DSceneRenderer::uploadClusters(DX::RenderBackend &backend)
+{
+    const std::vector<DX::ClusteredLightCuller::ClusterRange> &ranges = m_lightCuller.GetRanges();
+    backend.UpdateBuffer(m_clusterRangeBuffer.Get(), ranges.data(),
+        (uint32_t)(ranges.size() * sizeof(DX::ClusteredLightCuller::ClusterRange)));
+
+    const std::vector<uint32_t> &indices = m_lightCuller.GetLightIndices();
+    if (indices.empty())
+        return;
+    if (indices.size() > m_clusterIndexCapacity)
+    {
+        uint32_t capacity = m_clusterIndexCapacity;
+        while (capacity < indices.size())
+            capacity *= 2;
+        createClusterIndexBuffer(capacity);
+    }
+    backend.UpdateBufferRange(m_clusterIndexBuffer.Get(), 0, indices.data(),
+        (uint32_t)(indices.size() * sizeof(uint32_t)));
+}
 
-    // Set sphere geometry
-    context->IASetVertexBuffers(0, 1, m_vertexBuffer.GetAddressOf(), &stride, &offset);
-    // Attach our vertex shader.
-    context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-    // Attach our pixel shader.
+// Renders one frame using the vertex and pixel shaders.
+void Sample3DSceneRenderer::Render(const D3D11_VIEWPORT &viewport)
+{
+    auto backend = m_deviceResources->GetRenderBackend();
+
+    // Only the lights changed since the last frame are copied
+    m_lights.Upload(*backend, m_lightBuffer.Get());
+
+    // Bin the lights into the clusters of this frame's view
+    m_lights.GetBounds(m_lightBounds);
+    m_lightCuller.Build(m_lightBounds, m_camera->GetViewMatrix());
+    uploadClusters(*backend);
+
+    // The frame's constants are written to the ring and bound by offset,
+    // no buffer is updated in place
+    m_constantRing->BeginFrame();
+    DX::ConstantAllocation lightConstants = m_constantRing->Allocate(m_lightConstantBufferData);
+    DX::ConstantAllocation generalConstants = m_constantRing->Allocate(m_generalConstantBufferData);
+    // Roughness and metalness come per instance, only the albedo is shared
+    MaterialConstantBuffer material = { XMFLOAT3(1, 1, 1) };
+    DX::ConstantAllocation materialConstants = m_constantRing->Allocate(material);
+    backend->PSSetConstantBufferRange(0, lightConstants.buffer, lightConstants.GetFirstConstant(),
+        lightConstants.GetConstantCount());
+    backend->PSSetConstantBufferRange(1, materialConstants.buffer, materialConstants.GetFirstConstant(),
+        materialConstants.GetConstantCount());
+    backend->PSSetConstantBufferRange(2, generalConstants.buffer, generalConstants.GetFirstConstant(),
+        generalConstants.GetConstantCount());
+    DX::ConstantAllocation clusterConstants = m_constantRing->Allocate(
+        m_lightCuller.GetShaderConstants(viewport.Width, viewport.Height));
+    backend->PSSetConstantBufferRange(3, clusterConstants.buffer, clusterConstants.GetFirstConstant(),
+        clusterConstants.GetConstantCount());
+
+    // Draws go through the queue, sorted by pass, shader and material. The
+    // sky is the last pass so the spheres in front of it fail the depth test
+    // before its pixels are shaded.
+    m_drawQueue.Reset();
+
+    ID3D11SamplerState *sampler = *m_deviceResources->GetSamplerStateClamp();
+    DX::DrawShader skyShader = { m_packedInputLayout.Get(), m_packedVertexShader.Get(),
+        m_skySpherePixelShader.Get() };
+    DX::DrawMaterial skyMaterial = { { m_isDrawIrradiance ? m_irradianceMapSRV.Get() : m_environmentMapSRV.Get() },
+        1, sampler };
+    DX::DrawShader gridShader = { m_instancedInputLayout.Get(), m_instancedVertexShader.Get(), nullptr };
     switch (m_shaderMode)
     {
     case PBRShaderMode::REGULAR:
-        context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+        gridShader.pixelShader = m_pixelShader.Get();
         break;
     case PBRShaderMode::NORMAL_DISTRIBUTION:
-        context->PSSetShader(m_normDistrPixelShader.Get(), nullptr, 0);
+        gridShader.pixelShader = m_normDistrPixelShader.Get();
         break;
     case PBRShaderMode::GEOMETRY:
-        context->PSSetShader(m_geomPixelShader.Get(), nullptr, 0);
+        gridShader.pixelShader = m_geomPixelShader.Get();
         break;
     case PBRShaderMode::FRESNEL:
-        context->PSSetShader(m_fresnelPixelShader.Get(), nullptr, 0);
+        gridShader.pixelShader = m_fresnelPixelShader.Get();
         break;
     }
-
-    // Bind IBL textures
-    context->PSSetShaderResources(0, 1, m_irradianceMapSRV.GetAddressOf());
-    context->PSSetShaderResources(1, 1, m_prefilteredColorMapSRV.GetAddressOf());
-    context->PSSetShaderResources(2, 1, m_preintegratedBRDFSRV.GetAddressOf());
-
-    static const int sphereGridSize = 10;
-    static const float gridWidth = 5;
-    for (int i = 0; i < sphereGridSize; i++)
-        for (int j = 0; j < sphereGridSize; j++)
-        {
-            XMStoreFloat4x4(
-                &m_constantBufferData.model,
-                XMMatrixTranspose(XMMatrixTranslation(
-                    gridWidth * (i / (sphereGridSize - 1.0f) - 0.5f),
-                    gridWidth * (j / (sphereGridSize - 1.0f) - 0.5f),
-                    0
-                ))
-            );
-            context->UpdateSubresource(m_constantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0);
-
-            SetMaterial(
-                {
-                    XMFLOAT3(1, 1, 1),
-                    i / (sphereGridSize - 1.0f),
-                    j / (sphereGridSize - 1.0f)
-                }
-            );
-
-            context->DrawIndexed(
-                (UINT)m_indexCount,
-                0,
-                0
-            );
-        }
-
-    annotation->EndEvent();
+    // IBL textures
+    DX::DrawMaterial gridMaterial = { { m_irradianceMapSRV.Get(), m_prefilteredColorMapSRV.Get(),
+        m_preintegratedBRDFSRV.Get() }, 3, sampler };
+
+    // Each vertex is one DX::PackedVertex, the grid adds its instances as
+    // the second stream
+    UINT stride = sizeof(DX::PackedVertex);
+    DX::DrawGeometry skyGeometry = { { m_vertexBuffer.Get() }, { stride }, { 0 }, 1,
+        m_indexBuffer.buffer.Get(), (uint32_t)m_indexBuffer.format, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    DX::DrawGeometry gridGeometry = skyGeometry;
+    gridGeometry.vertexBuffers[1] = m_instanceBuffer.Get();
+    gridGeometry.strides[1] = sizeof(SphereInstance);
+    gridGeometry.offsets[1] = 0;
+    gridGeometry.streamCount = 2;
+
+    // View and projection stay in the constant buffer, for the grid the
+    // model matrix comes from the instance and the one in the buffer only
+    // unpacks the positions
+    XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixTranspose(XMLoadFloat4x4(&m_meshTransform)));
+    DX::ConstantAllocation gridConstants = m_constantRing->Allocate(m_constantBufferData);
+    // Cluster ranges, cluster light indices and the lights at t3 to t5
+    ID3D11ShaderResourceView *lightSRVs[3] = { m_clusterRangeSRV.Get(), m_clusterIndexSRV.Get(),
+        m_lightBufferSRV.Get() };
+    m_drawQueue.SetPass(SPHERE_PASS, [gridConstants, lightSRVs](DX::RenderBackend &backend)
+    {
+        backend.VSSetConstantBufferRange(0, gridConstants.buffer, gridConstants.GetFirstConstant(),
+            gridConstants.GetConstantCount());
+        backend.PSSetShaderResources(3, 3, lightSRVs);
+    });
+
+    // Sky sphere. Its scale matrix is negative to mirror the sphere through
+    // its centre so its inside faces the camera. The sky is sampled along
+    // the view ray, which no tessellation changes, so it always takes the
+    // coarsest level.
+    XMStoreFloat4x4(
+        &m_constantBufferData.model,
+        XMMatrixMultiplyTranspose(
+            XMMatrixMultiply(
+                XMLoadFloat4x4(&m_meshTransform),
+                XMMatrixScaling(
+                    -999,
+                    -999,
+                    -999
+                )
+            ),
+            XMMatrixTranslationFromVector(m_camera->GetPositionVector())
+        )
+    );
+    const SphereLODChain::Level &skyLevel = m_sphereLODs.GetLevel(0);
+    // Around the camera at 999 sphere radii, behind everything else
+    uint64_t skyKey = DX::DrawKey::Make(SKY_PASS, m_drawQueue.AddShader(skyShader),
+        m_drawQueue.AddMaterial(skyMaterial), DX::DrawKey::FrontToBack(999 * m_sphereLODs.GetRadius()));
+    uint32_t skyGeometryId = m_drawQueue.AddGeometry(skyGeometry);
+    m_drawQueue.Add(skyKey, skyGeometryId, { skyLevel.indexCount, 0, skyLevel.startIndex, skyLevel.baseVertex, 0 },
+        0, m_constantRing->Allocate(m_constantBufferData));
+
+    // Bounds follow the sphere transforms whenever they move
+    if (m_sphereGrid.UpdateTransforms())
+        m_sphereGrid.GetBounds(m_sphereLODs.GetRadius(), m_sphereBounds);
+
+    // Only the spheres touching the view frustum are uploaded and drawn
+    DX::Frustum frustum = DX::ExtractFrustum(
+        XMMatrixMultiply(m_camera->GetViewMatrix(), m_camera->GetProjectionMatrix()));
+    const std::vector<uint32_t> &visible = m_sphereCuller.Cull(m_sphereBounds, frustum);
+    m_lodSelector.Select(m_sphereLODs, m_sphereGrid.GetInstances(), m_camera->GetPositionFloat3(),
+        m_lodPixelsPerUnit);
+    uint64_t gridKey = DX::DrawKey::Make(SPHERE_PASS, m_drawQueue.AddShader(gridShader),
+        m_drawQueue.AddMaterial(gridMaterial), 0);
+    uint32_t gridGeometryId = m_drawQueue.AddGeometry(gridGeometry);
+    m_sphereGrid.Queue(*backend, m_instanceBuffer.Get(), m_drawQueue, gridKey, gridGeometryId, m_sphereLODs,
+        m_lodSelector.GetLevels(), visible, m_camera->GetViewMatrix());
+
+    backend->BeginEvent(L"RenderScene");
+    m_drawQueue.Submit(*backend);
+    backend->EndEvent();
+
+    // The draws reading this frame's constants are all issued
+    m_constantRing->EndFrame();
 }
 
 void Sample3DSceneRenderer::CreateDeviceDependentResources()
@@ -286,6 +374,56 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
         )
     );
 
+    // Sky sphere shader, reading the packed sphere vertices, see DX::PackedVertex
+    std::vector<byte> packedVSData;
+    m_packedVertexShader = m_deviceResources->createVertexShader("Packed", &packedVSData);
+
+    static const D3D11_INPUT_ELEMENT_DESC packedVertexDesc[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    };
+
+    DX::ThrowIfFailed(
+        device->CreateInputLayout(
+            packedVertexDesc,
+            ARRAYSIZE(packedVertexDesc),
+            packedVSData.data(),
+            packedVSData.size(),
+            &m_packedInputLayout
+        )
+    );
+
+    // Sphere grid shader, its input layout adds the per-instance stream
+    std::vector<byte> instancedVSData;
+    m_instancedVertexShader = m_deviceResources->createVertexShader("Instanced", &instancedVSData);
+
+    static const D3D11_INPUT_ELEMENT_DESC instancedVertexDesc[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "INSTANCE_TRANSFORM", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_TRANSFORM", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_TRANSFORM", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_TRANSFORM", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTANCE_MATERIAL", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    };
+
+    DX::ThrowIfFailed(
+        device->CreateInputLayout(
+            instancedVertexDesc,
+            ARRAYSIZE(instancedVertexDesc),
+            instancedVSData.data(),
+            instancedVSData.size(),
+            &m_instancedInputLayout
+        )
+    );
+
+    // Rewritten every frame, default usage like the constant buffers
+    m_instanceBuffer = m_deviceResources->createVertexBuffer(m_sphereGrid.GetInstances(), "SphereInstances");
+
     m_unlitVertexShader = m_deviceResources->createVertexShader("Unlit");
 
     // Create pixel shader
@@ -306,114 +444,73 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
         )
     );
 
-    CD3D11_BUFFER_DESC lightConstantBufferDesc(sizeof(LightConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    // Frame constants, written to the ring every Render
+    m_constantRing.reset(new DX::ConstantRingAllocator(
+        std::make_shared<DX::D3D11ConstantRingDevice>(m_deviceResources, CONSTANT_RING_SIZE, "FrameConstants")));
+
+    // Lights are rewritten in ranges, default usage so UpdateSubresource can
+    CD3D11_BUFFER_DESC lightBufferDesc(MAX_SCENE_LIGHTS * (UINT)sizeof(DX::GpuPointLight),
+        D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT, 0, D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+        (UINT)sizeof(DX::GpuPointLight));
     DX::ThrowIfFailed(
         device->CreateBuffer(
-            &lightConstantBufferDesc,
+            &lightBufferDesc,
             nullptr,
-            &m_lightConstantBuffer
+            &m_lightBuffer
         )
     );
-
-    CD3D11_BUFFER_DESC materialConstantBufferDesc(sizeof(MaterialConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    CD3D11_SHADER_RESOURCE_VIEW_DESC lightBufferSRVDesc(m_lightBuffer.Get(), DXGI_FORMAT_UNKNOWN, 0,
+        MAX_SCENE_LIGHTS);
+    m_lightBufferSRV = m_deviceResources->createShaderResourceView(m_lightBuffer, "Lights", &lightBufferSRVDesc);
+    // The new buffer holds nothing yet
+    m_lights.InvalidateBuffer();
+
+    // Rewritten every frame from DX::ClusteredLightCuller
+    uint32_t clusterCount = m_lightCuller.GetClusterCount();
+    CD3D11_BUFFER_DESC clusterRangeBufferDesc(clusterCount * (UINT)sizeof(DX::ClusteredLightCuller::ClusterRange),
+        D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT, 0, D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+        (UINT)sizeof(DX::ClusteredLightCuller::ClusterRange));
     DX::ThrowIfFailed(
         device->CreateBuffer(
-            &materialConstantBufferDesc,
+            &clusterRangeBufferDesc,
             nullptr,
-            &m_materialConstantBuffer
+            &m_clusterRangeBuffer
         )
     );
+    CD3D11_SHADER_RESOURCE_VIEW_DESC clusterRangeSRVDesc(m_clusterRangeBuffer.Get(), DXGI_FORMAT_UNKNOWN, 0,
+        clusterCount);
+    m_clusterRangeSRV = m_deviceResources->createShaderResourceView(m_clusterRangeBuffer, "ClusterRanges",
+        &clusterRangeSRVDesc);
+    createClusterIndexBuffer(clusterCount * CLUSTER_INDICES_PER_CLUSTER);
 
-    CD3D11_BUFFER_DESC generalConstantBufferDesc(sizeof(GeneralConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    CD3D11_BUFFER_DESC materialConstantBufferDesc(sizeof(MaterialConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
     DX::ThrowIfFailed(
         device->CreateBuffer(
-            &generalConstantBufferDesc,
+            &materialConstantBufferDesc,
             nullptr,
-            &m_generalConstantBuffer
+            &m_materialConstantBuffer
         )
     );
 
-    // Create sphere geometry
-    static const int
-        numLatitudeLines = 16,
-        numLongitudeLines = 16;
-    static const float radius = 0.5f;
-    static const float latitudeSpacing = 1.0f / numLatitudeLines;
-    static const float longitudeSpacing = 1.0f / numLongitudeLines;
-    static const float PI = 3.141592653589793238463f;
-
-    std::vector<VertexPositionColorNormal> vertices;
-    for (int latitude = 0; latitude <= numLatitudeLines; latitude++)
-    {
-        for (int longitude = 0; longitude <= numLongitudeLines; longitude++)
-        {
-            VertexPositionColorNormal v;
-
-            // Scale coordinates into the 0...1 texture coordinate range,
-            // with north at the top (y = 1).
-            v.color = XMFLOAT3(
-                longitude * longitudeSpacing,
-                1.0f - latitude * latitudeSpacing,
-                0
-            );
-
-            // Convert to spherical coordinates:
-            // theta is a longitude angle (around the equator) in radians.
-            // phi is a latitude angle (north or south of the equator).
-            float theta = v.color.x * 2.0f * PI;
-            float phi = (v.color.y - 0.5f) * PI;
-
-            float c = cos(phi);
-
-            v.normal = XMFLOAT3(
-                c * cos(theta) * radius,
-                sin(phi) * radius,
-                c * sin(theta) * radius
-            );
-
-            v.pos = XMFLOAT3(
-                v.normal.x * radius,
-                v.normal.y * radius,
-                v.normal.z * radius
-            );
-
-            vertices.push_back(v);
-        }
-    }
-    m_vertexBuffer = m_deviceResources->createVertexBuffer(vertices, "Sphere");
-
-    // Create sky sphere vertex buffer
-    for (auto &v : vertices)
-    {
-        v.pos.x = -v.pos.x;
-        v.pos.y = -v.pos.y;
-        v.pos.z = -v.pos.z;
-    
-        v.normal.x = -v.normal.x;
-        v.normal.y = -v.normal.y;
-        v.normal.z = -v.normal.z;
-    }
-    m_skySphereVertexBuffer =
-        m_deviceResources->createVertexBuffer(vertices, "SkySphere");
+    // Create sphere geometry in the packed format, 16 instead of 36 bytes a
+    // vertex. The color holds the texture coordinate.
+    const std::vector<VertexPositionColorNormal> &vertices = m_sphereLODs.GetVertices();
+    DX::PositionQuantization quantization = DX::ComputePositionQuantization(
+        &vertices[0].pos.x, sizeof(VertexPositionColorNormal), vertices.size());
+    std::vector<DX::PackedVertex> packedVertices(vertices.size());
+    DX::PackVertices(&vertices[0].pos.x, &vertices[0].normal.x, &vertices[0].color.x,
+        sizeof(VertexPositionColorNormal), vertices.size(), quantization, packedVertices.data());
+    m_vertexPackingError = DX::MeasurePackingError(&vertices[0].pos.x, &vertices[0].normal.x,
+        &vertices[0].color.x, sizeof(VertexPositionColorNormal), vertices.size(), quantization,
+        packedVertices.data());
+    m_vertexBuffer = m_deviceResources->createVertexBuffer(packedVertices, "Sphere");
+    XMStoreFloat4x4(&m_meshTransform, XMMatrixMultiply(
+        XMMatrixScaling(quantization.scale, quantization.scale, quantization.scale),
+        XMMatrixTranslation(quantization.offset[0], quantization.offset[1], quantization.offset[2])));
 
     // Create sphere index buffer
-    std::vector<unsigned short> indices;
-    for (int latitude = 0; latitude < numLatitudeLines; latitude++)
-    {
-        for (int longitude = 0; longitude < numLongitudeLines; longitude++)
-        {
-            indices.push_back(latitude * (numLongitudeLines + 1) + longitude);
-            indices.push_back((latitude + 1) * (numLongitudeLines + 1) + longitude);
-            indices.push_back(latitude * (numLongitudeLines + 1) + (longitude + 1));
-
-            indices.push_back(latitude * (numLongitudeLines + 1) + (longitude + 1));
-            indices.push_back((latitude + 1) * (numLongitudeLines + 1) + longitude);
-            indices.push_back((latitude + 1) * (numLongitudeLines + 1) + (longitude + 1));
-        }
-    }
-
-    m_indexCount = indices.size();
-    m_indexBuffer = m_deviceResources->createIndexBuffer(indices, "Sphere");
+    m_indexBuffer = m_deviceResources->createIndexBuffer(m_sphereLODs.GetIndices(),
+        m_sphereLODs.GetMaxLevelVertexCount(), "Sphere");
 
     // Load sky sphere texture
     struct STBImage
@@ -523,7 +620,7 @@ void Sample3DSceneRenderer::renderSkyMapTexture()
             { { -0.5f, -0.5f, -0.5f }, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f} }
         }
     );
-    static const std::vector<unsigned short> indices(
+    static const std::vector<uint32_t> indices(
         {
             2, 0, 1,
             2, 3, 0
@@ -531,8 +628,8 @@ void Sample3DSceneRenderer::renderSkyMapTexture()
     );
     ComPtr<ID3D11Buffer> vertexBuffer =
         m_deviceResources->createVertexBuffer(vertices, "CubeMapFullScreenQuad");
-    ComPtr<ID3D11Buffer> indexBuffer =
-        m_deviceResources->createIndexBuffer(indices, "CubeMapFullScreenQuad");
+    DX::IndexBuffer indexBuffer = m_deviceResources->createIndexBuffer(indices,
+        (uint32_t)vertices.size(), "CubeMapFullScreenQuad");
 
     // Quad rotation matrices
     static const XMMATRIX rotations[6] =
@@ -577,7 +674,7 @@ void Sample3DSceneRenderer::renderSkyMapTexture()
     UINT stride = sizeof(VertexPositionColorNormal);
     UINT offset = 0;
     context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-    context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    context->IASetIndexBuffer(indexBuffer.buffer.Get(), indexBuffer.format, 0);
     context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     context->IASetInputLayout(m_inputLayout.Get());
 
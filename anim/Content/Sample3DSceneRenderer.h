@@ -2,9 +2,20 @@
 
 #include "..\Common\Input\Keyboard.h"
 #include "..\Common\Camera\Camera.h"
+#include "..\Common\ConstantRing\ConstantRingAllocator.h"
+#include "..\Common\Culling\FrustumCuller.h"
 #include "..\Common\DeviceResources.h"
+#include "..\Common\DrawQueue\DrawQueue.h"
+#include "..\Common\Lighting\ClusteredLightCuller.h"
+#include "..\Common\Lighting\LightManager.h"
+#include "..\Common\Mesh\VertexPacking.h"
+#include "..\Common\Shading\PBRShading.h"
 #include "..\Common\StepTimer.h"
+#include "SceneLights.h"
 #include "ShaderStructures.h"
+#include "LODSelector.h"
+#include "SphereGrid.h"
+#include "SphereLODChain.h"
 
 namespace anim
 {
@@ -19,7 +30,17 @@ namespace anim
         void CreateDeviceDependentResources();
         void CreateWindowSizeDependentResources();
         void Update(DX::StepTimer const& timer);
-        void Render();
+        // Renders into the bound target with the viewport set on it
+        void Render(const D3D11_VIEWPORT &viewport);
+
+        // How far the packed sphere vertices are off the generated ones
+        const DX::VertexPackingError &GetVertexPackingError() const { return m_vertexPackingError; }
+        // What the last frame copied into the light buffer
+        const DX::LightUploadStatistics &GetLightUploadStatistics() const { return m_lights.GetStatistics(); }
+        // State changes and draws of the last frame's draw queue
+        const DX::DrawQueueStatistics &GetDrawQueueStatistics() const { return m_drawQueue.GetStatistics(); }
+        // Constants the last frame allocated from the ring
+        const DX::ConstantRingStatistics &GetConstantRingStatistics() const { return m_constantRing->GetStatistics(); }
 
     private:
         // Cached pointer to device resources.
@@ -31,11 +52,31 @@ namespace anim
         // Cached pointer to keyboard handler
         std::shared_ptr<input::Keyboard> m_keyboard;
 
-        // Direct3D resources for cube geometry.
+        // Direct3D resources for sphere geometry, every level of detail in one
+        // buffer of packed vertices. The sky sphere draws them mirrored.
         Microsoft::WRL::ComPtr<ID3D11InputLayout>  m_inputLayout;
         Microsoft::WRL::ComPtr<ID3D11Buffer>       m_vertexBuffer;
-        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_skySphereVertexBuffer;
-        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_indexBuffer;
+        DX::IndexBuffer                            m_indexBuffer;
+        Microsoft::WRL::ComPtr<ID3D11InputLayout>  m_packedInputLayout;
+        Microsoft::WRL::ComPtr<ID3D11VertexShader> m_packedVertexShader;
+        // Maps the packed positions back to mesh units
+        DirectX::XMFLOAT4X4                        m_meshTransform;
+        DX::VertexPackingError                     m_vertexPackingError;
+
+        // The sphere grid, drawn instanced with per-instance transform and material
+        SphereGrid                                 m_sphereGrid;
+        SphereLODChain                             m_sphereLODs;
+        LODSelector                                m_lodSelector;
+        // Instance bounds for the frustum test
+        DX::BoundingSphereSet                      m_sphereBounds;
+        DX::FrustumCuller                          m_sphereCuller;
+        // Projected pixels of one unit at distance one
+        float                                      m_lodPixelsPerUnit;
+        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_instanceBuffer;
+        Microsoft::WRL::ComPtr<ID3D11InputLayout>  m_instancedInputLayout;
+        Microsoft::WRL::ComPtr<ID3D11VertexShader> m_instancedVertexShader;
+        // Rebuilt every frame, the tables are a handful of entries
+        DX::DrawQueue                              m_drawQueue;
 
         Microsoft::WRL::ComPtr<ID3D11Texture2D>    m_environmentMap;
         Microsoft::WRL::ComPtr<ID3D11Texture2D>    m_irradianceMap;
@@ -54,10 +95,24 @@ namespace anim
         Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_geomPixelShader;
         Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_fresnelPixelShader;
 
+        // The frame's constants come from the ring, the buffers below only
+        // serve the sky map and IBL rendering
+        std::unique_ptr<DX::ConstantRingAllocator> m_constantRing;
         Microsoft::WRL::ComPtr<ID3D11Buffer>       m_constantBuffer;
-        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_lightConstantBuffer;
         Microsoft::WRL::ComPtr<ID3D11Buffer>       m_materialConstantBuffer;
-        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_generalConstantBuffer;
+        // DX::GpuPointLight per light, see DX::LightManager
+        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_lightBuffer;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_lightBufferSRV;
+        // Lights binned into the view's clusters every frame, a pixel only
+        // shades the lights of its cluster, see ClusteredLighting.cginc
+        DX::BoundingSphereSet                      m_lightBounds;
+        DX::ClusteredLightCuller                   m_lightCuller;
+        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_clusterRangeBuffer;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_clusterRangeSRV;
+        // Grows when a frame's light indices do not fit
+        Microsoft::WRL::ComPtr<ID3D11Buffer>       m_clusterIndexBuffer;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_clusterIndexSRV;
+        uint32_t                                   m_clusterIndexCapacity;
 
         Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_loadedSkyTextureSRV;
         Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_environmentMapSRV;
@@ -69,35 +124,26 @@ namespace anim
         MaterialConstantBuffer               m_materialConstantBufferData;
         GeneralConstantBuffer                m_generalConstantBufferData;
 
-        size_t                               m_indexCount;
-
-        enum struct PBRShaderMode
-        {
-            REGULAR,
-            NORMAL_DISTRIBUTION,
-            GEOMETRY,
-            FRESNEL
-        } m_shaderMode;
+        // Shared with the CPU shading, see DX::ShadePBR
+        typedef DX::PBRShaderMode PBRShaderMode;
+        PBRShaderMode m_shaderMode;
 
         bool m_isDrawIrradiance = false;
         bool m_isTestEnvironment = false;
 
         // Lights information
         LightConstantBuffer                  m_lightConstantBufferData;
-
-        // Constant colors
-        const DirectX::XMFLOAT3 LIGHT_COLOR_1 = DirectX::XMFLOAT3(1.0f, 1.0f, 0.8f);
-        const DirectX::XMFLOAT3 LIGHT_COLOR_2 = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
-        const DirectX::XMFLOAT3 LIGHT_COLOR_3 = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-        // Variable strength
-        float m_strengths[3] = { 0.0f, 0.0f, 0.0f };
+        DX::LightManager                     m_lights;
+        DX::LightHandle                      m_lightHandles[SCENE_LIGHT_COUNT];
 
         void CycleLight(int lightId);
 
         void SetMaterial(MaterialConstantBuffer material);
 
         void renderSkyMapTexture();
+
+        void createClusterIndexBuffer(uint32_t capacity);
+        void uploadClusters(DX::RenderBackend &backend);
     };
 }
 
@@ -50,6 +50,8 @@ void SampleFpsTextRenderer::Update(DX::StepTimer const& timer)
     size_t fps = timer.GetFramesPerSecond();
 
     m_text = (fps > 0) ? std::to_wstring(fps) + L" FPS" : L" - FPS";
+    if (!m_status.empty())
+        m_text += L"\n" + m_status;
 
     ComPtr<IDWriteTextLayout> textLayout;
     DX::ThrowIfFailed(
@@ -57,8 +59,8 @@ void SampleFpsTextRenderer::Update(DX::StepTimer const& timer)
             m_text.c_str(),
             (UINT32)m_text.length(),
             m_textFormat.Get(),
-            240.0f, // Max width of the input text.
-            50.0f, // Max height of the input text.
+            480.0f, // Max width of the input text.
+            100.0f, // Max height of the input text.
             &textLayout
             )
         );
@@ -16,12 +16,16 @@ namespace anim
         void Update(DX::StepTimer const& timer);
         void Render();
 
+        // Extra line shown under the FPS value, empty for none
+        void SetStatus(const std::wstring &status) { m_status = status; }
+
     private:
         // Cached pointer to device resources.
         std::shared_ptr<DX::DeviceResources> m_deviceResources;
 
         // Resources related to text rendering.
         std::wstring                                    m_text;
+        std::wstring                                    m_status;
         DWRITE_TEXT_METRICS                             m_textMetrics;
         Microsoft::WRL::ComPtr<ID2D1SolidColorBrush>    m_whiteBrush;
         Microsoft::WRL::ComPtr<ID2D1DrawingStateBlock1> m_stateBlock;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+namespace anim
+{
+    // The point lights of the scene, added to a DX::LightManager by both
+    // Sample3DSceneRenderer and HeadlessSceneRenderer
+    const uint32_t SCENE_LIGHT_COUNT = 3;
+    const DirectX::XMFLOAT3 SCENE_LIGHT_POSITIONS[SCENE_LIGHT_COUNT] =
+    {
+        DirectX::XMFLOAT3(0.0f, 0.0f, 3.0f), DirectX::XMFLOAT3(2.0f, 1.0f, 1.0f), DirectX::XMFLOAT3(0.0f, 1.0f, 0.3f)
+    };
+    const DirectX::XMFLOAT3 SCENE_LIGHT_COLORS[SCENE_LIGHT_COUNT] =
+    {
+        DirectX::XMFLOAT3(1.0f, 1.0f, 0.8f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f), DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f)
+    };
+
+    // Size of the light buffer
+    const uint32_t MAX_SCENE_LIGHTS = 1024;
+    // Intensity a light is cut off at, well below what shows after tonemapping
+    const float SCENE_LIGHT_THRESHOLD = 0.01f;
+}
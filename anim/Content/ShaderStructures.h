@@ -18,12 +18,12 @@ namespace anim
         DirectX::XMFLOAT3 normal;
     };
 
-    // Constant buffer used to send light positions, colors and strengths.
+    // Constant buffer used to send the number of lights, the lights
+    // themselves are DX::GpuPointLight in a structured buffer.
     struct LightConstantBuffer
     {
-        DirectX::XMFLOAT4 lightColor1;
-        DirectX::XMFLOAT4 lightColor2;
-        DirectX::XMFLOAT4 lightColor3;
+        uint32_t lightCount;
+        float padding[3];
     };
 
     struct MaterialConstantBuffer
@@ -34,6 +34,15 @@ namespace anim
         float dummy[3];
     };
 
+    // Per-instance vertex data of the sphere grid. The model matrix is not
+    // transposed, the vertex shader builds it from its rows.
+    struct SphereInstance
+    {
+        DirectX::XMFLOAT4X4 model;
+        float roughness;
+        float metalness;
+    };
+
     struct GeneralConstantBuffer
     {
         DirectX::XMFLOAT3 cameraPos;
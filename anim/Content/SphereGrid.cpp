@@ -0,0 +1,97 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "SphereGrid.h"
+
+using namespace anim;
+
+SphereGrid::SphereGrid(uint32_t gridSize, float gridWidth)
+{
+    float step = gridSize > 1 ? 1.0f / (gridSize - 1) : 0.0f;
+    uint32_t root = m_transforms.Add(DX::TransformHierarchy::NO_PARENT, DirectX::XMFLOAT3(0, 0, 0));
+    m_instances.reserve((size_t)gridSize * gridSize);
+    for (uint32_t i = 0; i < gridSize; i++)
+        for (uint32_t j = 0; j < gridSize; j++)
+        {
+            m_transforms.Add(root, DirectX::XMFLOAT3(gridWidth * (i * step - 0.5f), gridWidth * (j * step - 0.5f), 0));
+
+            SphereInstance instance;
+            instance.roughness = i * step;
+            instance.metalness = j * step;
+            m_instances.push_back(instance);
+        }
+    UpdateTransforms();
+}
+
+bool SphereGrid::UpdateTransforms()
+{
+    if (m_transforms.Update() == 0)
+        return false;
+
+    // Straight into the instances, skipping the grid node. The vertex
+    // shader takes the rows as they are.
+    m_transforms.WriteWorldMatrices(1, GetInstanceCount(), &m_instances[0].model, sizeof(SphereInstance), false);
+    return true;
+}
+
+void SphereGrid::GetBounds(float radius, DX::BoundingSphereSet &bounds) const
+{
+    bounds.Resize(m_instances.size());
+    for (size_t i = 0; i < m_instances.size(); i++)
+    {
+        const DirectX::XMFLOAT4X4 &model = m_instances[i].model;
+        float scale = std::sqrt(model._11 * model._11 + model._12 * model._12 + model._13 * model._13);
+        bounds.Set(i, model._41, model._42, model._43, radius * scale);
+    }
+}
+
+void SphereGrid::Queue(DX::RenderBackend &backend, ID3D11Buffer *instanceBuffer, DX::DrawQueue &queue, uint64_t key,
+    uint32_t geometry, const SphereLODChain &lods, const std::vector<uint32_t> &levels,
+    const std::vector<uint32_t> &visible, DirectX::FXMMATRIX view)
+{
+    if (visible.empty())
+        return;
+
+    DirectX::XMFLOAT4X4 view4x4;
+    DirectX::XMStoreFloat4x4(&view4x4, view);
+
+    // Counting sort by level, each level's instances end up contiguous.
+    // Meanwhile find each level's nearest centre, the camera looks down -z.
+    uint32_t levelCount = lods.GetLevelCount();
+    m_levelStarts.assign(levelCount + 1, 0);
+    m_levelDepths.assign(levelCount, FLT_MAX);
+    for (uint32_t i : visible)
+    {
+        m_levelStarts[levels[i] + 1]++;
+        const DirectX::XMFLOAT4X4 &model = m_instances[i].model;
+        float depth = -(model._41 * view4x4._13 + model._42 * view4x4._23 + model._43 * view4x4._33 + view4x4._43);
+        m_levelDepths[levels[i]] = (std::min)(m_levelDepths[levels[i]], depth);
+    }
+    for (uint32_t l = 0; l < levelCount; l++)
+        m_levelStarts[l + 1] += m_levelStarts[l];
+    m_sortedInstances.resize(visible.size());
+    for (uint32_t i : visible)
+        m_sortedInstances[m_levelStarts[levels[i]]++] = m_instances[i];
+
+    // Only the visible instances, the buffer is sized for the whole grid
+    backend.UpdateBufferRange(instanceBuffer, 0, m_sortedInstances.data(),
+        (uint32_t)(m_sortedInstances.size() * sizeof(SphereInstance)));
+
+    // The scatter moved every start to the end of its level
+    uint32_t start = 0;
+    for (uint32_t l = 0; l < levelCount; l++)
+    {
+        uint32_t end = m_levelStarts[l];
+        if (end > start)
+        {
+            const SphereLODChain::Level &level = lods.GetLevel(l);
+            DX::DrawArguments arguments = { level.indexCount, end - start, level.startIndex, level.baseVertex, start };
+            queue.Add(key | DX::DrawKey::Make(0, 0, 0, DX::DrawKey::FrontToBack(m_levelDepths[l])), geometry,
+                arguments);
+        }
+        start = end;
+    }
+}
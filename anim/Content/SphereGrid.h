@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "..\Common\Backend\RenderBackend.h"
+#include "..\Common\Culling\FrustumCuller.h"
+#include "..\Common\DrawQueue\DrawQueue.h"
+#include "..\Common\Scene\TransformHierarchy.h"
+#include "ShaderStructures.h"
+#include "SphereLODChain.h"
+
+namespace anim
+{
+    // Square grid of unit spheres in the z = 0 plane, roughness growing
+    // along x and metalness along y. The whole grid is one upload of the
+    // per-instance buffer and one instanced draw packet per level of detail
+    // in use, whatever the grid size.
+    class SphereGrid
+    {
+    public:
+        SphereGrid(uint32_t gridSize, float gridWidth);
+
+        const std::vector<SphereInstance> &GetInstances() const { return m_instances; }
+        uint32_t GetInstanceCount() const { return (uint32_t)m_instances.size(); }
+
+        // Node 0 is the whole grid, instance i is node i + 1 below it
+        DX::TransformHierarchy &GetTransforms() { return m_transforms; }
+        // Copy changed world matrices into the instances, true if there were any
+        bool UpdateTransforms();
+
+        // Bounding spheres of the instances for meshes of the given radius
+        void GetBounds(float radius, DX::BoundingSphereSet &bounds) const;
+
+        // Upload the instances listed in visible grouped by their entry in
+        // levels to instanceBuffer and queue a draw of every level in use.
+        // key holds pass, shader and material, geometry has to take the
+        // chain's buffers and instanceBuffer as vertex stream 1. Each draw's
+        // depth is the view depth of its nearest instance, front to back.
+        void Queue(DX::RenderBackend &backend, ID3D11Buffer *instanceBuffer, DX::DrawQueue &queue, uint64_t key,
+            uint32_t geometry, const SphereLODChain &lods, const std::vector<uint32_t> &levels,
+            const std::vector<uint32_t> &visible, DirectX::FXMMATRIX view);
+
+    private:
+        DX::TransformHierarchy m_transforms;
+        std::vector<SphereInstance> m_instances;
+        // Instances ordered by level, rebuilt every draw
+        std::vector<SphereInstance> m_sortedInstances;
+        std::vector<uint32_t> m_levelStarts;
+        std::vector<float> m_levelDepths;
+    };
+}
@@ -0,0 +1,82 @@
+#include "pch.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "SphereLODChain.h"
+
+using namespace anim;
+
+SphereLODChain::SphereLODChain(const std::vector<uint32_t> &segmentCounts, float radius) :
+    m_radius(radius)
+{
+    static const float PI = 3.141592653589793238463f;
+
+    for (uint32_t segments : segmentCounts)
+    {
+        if (segments < 3 || (!m_levels.empty() && segments <= m_levels.back().segments))
+            throw std::invalid_argument("SphereLODChain: segment counts must grow from at least 3");
+        uint32_t rowLength = segments + 1;
+
+        Level level;
+        level.segments = segments;
+        level.startIndex = (uint32_t)m_indices.size();
+        level.indexCount = segments * segments * 6;
+        level.baseVertex = (int32_t)m_vertices.size();
+        level.vertexCount = rowLength * rowLength;
+        // Longitude lines are twice as far apart as latitude lines, the
+        // chord between two of them at the equator is furthest inside
+        level.geometricError = radius * (1 - std::cos(PI / segments));
+
+        std::vector<VertexPositionColorNormal> vertices;
+        vertices.reserve(level.vertexCount);
+        float spacing = 1.0f / segments;
+        for (uint32_t latitude = 0; latitude <= segments; latitude++)
+        {
+            for (uint32_t longitude = 0; longitude <= segments; longitude++)
+            {
+                VertexPositionColorNormal v;
+
+                // Scale coordinates into the 0...1 texture coordinate range,
+                // with north at the top (y = 1).
+                v.color = DirectX::XMFLOAT3(longitude * spacing, 1.0f - latitude * spacing, 0);
+
+                // theta is a longitude angle (around the equator) in radians.
+                // phi is a latitude angle (north or south of the equator).
+                float theta = v.color.x * 2.0f * PI;
+                float phi = (v.color.y - 0.5f) * PI;
+                float c = std::cos(phi);
+
+                v.normal = DirectX::XMFLOAT3(c * std::cos(theta), std::sin(phi), c * std::sin(theta));
+                v.pos = DirectX::XMFLOAT3(v.normal.x * radius, v.normal.y * radius, v.normal.z * radius);
+                vertices.push_back(v);
+            }
+        }
+
+        std::vector<uint32_t> indices;
+        indices.reserve(level.indexCount);
+        for (uint32_t latitude = 0; latitude < segments; latitude++)
+        {
+            for (uint32_t longitude = 0; longitude < segments; longitude++)
+            {
+                uint32_t i0 = latitude * rowLength + longitude;
+                uint32_t i1 = (latitude + 1) * rowLength + longitude;
+                indices.insert(indices.end(), { i0, i1, i0 + 1 });
+                indices.insert(indices.end(), { i0 + 1, i1, i1 + 1 });
+            }
+        }
+
+        // Row order reuses a vertex only a whole row later, far past any cache
+        DX::OptimizeVertexCache(indices, level.vertexCount);
+        std::vector<uint32_t> remap = DX::OptimizeVertexFetch(indices, level.vertexCount);
+        vertices = DX::RemapVertices(vertices, remap, level.vertexCount);
+        level.cacheStatistics = DX::AnalyzeVertexCache(indices, level.vertexCount);
+
+        m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+        m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+        m_levels.push_back(level);
+    }
+
+    if (m_levels.empty())
+        throw std::invalid_argument("SphereLODChain: no levels");
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "..\Common\Mesh\MeshOptimizer.h"
+#include "ShaderStructures.h"
+
+namespace anim
+{
+    // Latitude/longitude spheres of increasing tessellation sharing one
+    // vertex and one index buffer. Level 0 is the coarsest; every level is
+    // drawn with its own start index and base vertex. Each level's triangles
+    // are ordered for the vertex cache and its vertices for fetch.
+    class SphereLODChain
+    {
+    public:
+        struct Level
+        {
+            // Latitude and longitude lines
+            uint32_t segments;
+            uint32_t startIndex;
+            uint32_t indexCount;
+            int32_t baseVertex;
+            uint32_t vertexCount;
+            // Largest distance between the mesh and the true sphere,
+            // in object space
+            float geometricError;
+            DX::VertexCacheStatistics cacheStatistics;
+        };
+
+        // segmentCounts in increasing order from at least 3, throws
+        // std::invalid_argument otherwise
+        SphereLODChain(const std::vector<uint32_t> &segmentCounts, float radius);
+
+        const std::vector<VertexPositionColorNormal> &GetVertices() const { return m_vertices; }
+        // Relative to the level's base vertex
+        const std::vector<uint32_t> &GetIndices() const { return m_indices; }
+        const std::vector<Level> &GetLevels() const { return m_levels; }
+        const Level &GetLevel(uint32_t level) const { return m_levels[level]; }
+        uint32_t GetLevelCount() const { return (uint32_t)m_levels.size(); }
+        float GetRadius() const { return m_radius; }
+        // Largest vertex count of a level, what the indices have to address
+        uint32_t GetMaxLevelVertexCount() const { return m_levels.back().vertexCount; }
+
+    private:
+        float m_radius;
+        std::vector<VertexPositionColorNormal> m_vertices;
+        std::vector<uint32_t> m_indices;
+        std::vector<Level> m_levels;
+    };
+}
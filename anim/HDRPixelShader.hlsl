@@ -1,12 +1,39 @@
-Texture2D shaderTexture;
-SamplerState samplerState;
+Texture2D shaderTexture : register(t0);
+// Filmic curve, white scale and gamma baked over log2 of the exposed colour, see TonemapLUT
+Texture2D tonemapLUT : register(t1);
+// Upsampled bloom chain at half the scene size, see BloomPyramid
+Texture2D bloomTexture : register(t2);
+// Tonemap and .cube grade baked over a log shaper of the exposed colour, see ColorGradingLUT
+Texture3D<float4> gradingLUT : register(t3);
+SamplerState samplerState : register(s0);
+SamplerState lutSamplerState : register(s1);
 
 cbuffer averageLogBrightnessConstantBuffer : register(b0)
 {
     float averageLogBrightness;
-    float minL;
-    float maxL;
+    float minLogBrightness;
+    float maxLogBrightness;
     float dummy;
+    // Exposure is applied on the CPU as an offset in log2 space
+    float tonemapScale;
+    float tonemapOffset;
+    // The scene covers the top left part of the pooled scene texture, it is
+    // upscaled here when rendered at a lower resolution
+    float2 sceneUVScale;
+    // Last texel center of the scene, keeps filtering inside it
+    float2 sceneUVMax;
+    // Same for the bloom texture
+    float2 bloomUVScale;
+    float2 bloomUVMax;
+    // Zero when bloom is off
+    float bloomIntensity;
+    float gradingExposure;
+    // Grading table shaper, t = log2(x * exposure + bias) * scale + offset
+    float gradingBias;
+    float gradingScale;
+    float gradingOffset;
+    // Last table entry, zero when grading is off
+    float gradingLastEntry;
 };
 
 // Per-pixel color data passed through the pixel shader.
@@ -16,42 +43,42 @@ struct PixelShaderInput
     float2 texcoord : TEXCOORD;
 };
 
-static const float A = 0.1;  // Shoulder Strength
-static const float B = 0.50; // Linear Strength
-static const float C = 0.1;  // Linear Angle
-static const float D = 0.20; // Toe Strength
-static const float E = 0.02; // Toe Numerator
-static const float F = 0.30; // Toe Denominator
-                             // Note: E/F = Toe Angle
-static const float W = 11.2; // Linear White Point Value
-
-float3 uncharted2Tonemap(float3 x)
+float tonemap(float x)
 {
-    return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+    float u = log2(max(x, 1e-30)) * tonemapScale + tonemapOffset;
+    return tonemapLUT.SampleLevel(lutSamplerState, float2(u, 0.5), 0).r;
 }
 
-float keyValue(float l)
+// Tetrahedral interpolation of the grading table: greys only blend entries
+// on the cube diagonal, where trilinear filtering would mix in coloured corners
+float3 grade(float3 color)
 {
-    return 1.03 - 2 / (2 + log10(l + 1));
-}
+    float3 t = clamp(log2(max(color * gradingExposure, 0) + gradingBias) * gradingScale + gradingOffset,
+        0, gradingLastEntry);
+    float3 cell = min(floor(t), gradingLastEntry - 1);
+    float3 f = t - cell;
 
-float exposure()
-{
-    float l = exp(averageLogBrightness) - 1;
-    return keyValue(l) / (clamp(l, 0, 9999));
-}
+    // The corners add the axes in order of decreasing fraction, picked
+    // without sorting; on ties the extra axes get zero weight
+    float fMax = max(f.r, max(f.g, f.b));
+    float fMin = min(f.r, min(f.g, f.b));
+    float fMid = f.r + f.g + f.b - fMax - fMin;
+    int3 origin = int3(cell);
+    int3 corner1 = origin + int3(f >= fMax);
+    int3 corner2 = origin + int3(f > fMin);
 
-float3 tonemapFilmic(float3 color)
-{
-    float E = exposure();
-    float3 curr = uncharted2Tonemap(E * color);
-    float3 whiteScale = 1.0f / uncharted2Tonemap(W);
-    return curr * whiteScale;
+    return (1 - fMax) * gradingLUT.Load(int4(origin, 0)).rgb +
+        (fMax - fMid) * gradingLUT.Load(int4(corner1, 0)).rgb +
+        (fMid - fMin) * gradingLUT.Load(int4(corner2, 0)).rgb +
+        fMin * gradingLUT.Load(int4(origin + 1, 0)).rgb;
 }
 
 float4 main(PixelShaderInput input) : SV_TARGET
 {
-    float4 textureColor = shaderTexture.Sample(samplerState, input.texcoord);
-    //return float4(tonemapFilmic(textureColor.rgb), 1);
-    return float4(pow(tonemapFilmic(textureColor.rgb), 1 / 2.2), 1);
-}
\ No newline at end of file
+    float4 textureColor = shaderTexture.Sample(samplerState, min(input.texcoord * sceneUVScale, sceneUVMax));
+    if (bloomIntensity > 0)
+        textureColor.rgb += bloomIntensity * bloomTexture.Sample(samplerState, min(input.texcoord * bloomUVScale, bloomUVMax)).rgb;
+    if (gradingLastEntry > 0)
+        return float4(grade(textureColor.rgb), 1);
+    return float4(tonemap(textureColor.r), tonemap(textureColor.g), tonemap(textureColor.b), 1);
+}
@@ -0,0 +1,28 @@
+Texture2D sceneTexture : register(t0);
+// Blue noise sample positions in [0, 1)^2, see SparseLuminanceEstimator
+Texture2D<float2> samplePositions : register(t1);
+
+cbuffer LuminanceSamplesConstantBuffer : register(b0)
+{
+    uint2 sourceSize;
+    // Toroidal shift of the point set for this frame
+    float2 offset;
+};
+
+// Per-pixel color data passed through the pixel shader.
+struct PixelShaderInput
+{
+    float4 pos : SV_POSITION;
+    float2 texcoord : TEXCOORD;
+};
+
+// Each output texel reads one scene pixel and returns its log brightness
+// as a tile of one pixel, the same layout as the luminance tiles.
+float4 main(PixelShaderInput input) : SV_TARGET
+{
+    float2 p = frac(samplePositions.Load(int3(input.pos.xy, 0)) + offset);
+    uint2 pixel = min((uint2)(p * sourceSize), sourceSize - 1);
+
+    float3 c = sceneTexture.Load(int3(pixel, 0)).rgb;
+    return float4(log(max(0.2126 * c.r + 0.7151 * c.g + 0.0722 * c.b, 0) + 1), 1, 0, 0);
+}
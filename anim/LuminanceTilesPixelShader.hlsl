@@ -0,0 +1,55 @@
+Texture2D sceneTexture;
+
+// Tiling of the scene, see LuminanceReduction on the CPU side
+cbuffer LuminanceTilesConstantBuffer : register(b0)
+{
+    uint2 sourceSize;
+    uint tileSize;
+    uint dummy;
+};
+
+// Per-pixel color data passed through the pixel shader.
+struct PixelShaderInput
+{
+    float4 pos : SV_POSITION;
+    float2 texcoord : TEXCOORD;
+};
+
+float logBrightness(uint x, uint y)
+{
+    float3 p = sceneTexture.Load(int3(x, y, 0)).rgb;
+    return log(max(0.2126 * p.r + 0.7151 * p.g + 0.0722 * p.b, 0) + 1);
+}
+
+// Each output texel covers one tileSize x tileSize tile of the scene and
+// returns its mean log brightness, the number of pixels it covers and the
+// variance and third central moment of their log brightness.
+// Edge tiles are clipped to the scene, so every pixel is counted once.
+// The grid is sized for the full resolution scene; tiles outside a scaled
+// down scene cover no pixels and return zero.
+float4 main(PixelShaderInput input) : SV_TARGET
+{
+    uint2 begin = (uint2)input.pos.xy * tileSize;
+    uint2 end = max(min(begin + tileSize, sourceSize), begin);
+    float count = (end.x - begin.x) * (end.y - begin.y);
+    if (count == 0)
+        return 0;
+
+    // Moments around the first pixel stay accurate for nearly uniform tiles
+    float shift = logBrightness(begin.x, begin.y);
+    float3 sum = 0;
+    [loop]
+    for (uint y = begin.y; y < end.y; y++)
+    {
+        [loop]
+        for (uint x = begin.x; x < end.x; x++)
+        {
+            float d = logBrightness(x, y) - shift;
+            sum += float3(d, d * d, d * d * d);
+        }
+    }
+
+    float3 m = sum / count;
+    return float4(shift + m.x, count, max(m.y - m.x * m.x, 0),
+        m.z - 3 * m.x * m.y + 2 * m.x * m.x * m.x);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Timing for the CPU benchmarks: runs a body a number of times and keeps the
+// fastest run, which is the least disturbed by the rest of the system.
+namespace Benchmark
+{
+    template <typename Body>
+    double BestSeconds(int runs, const Body &body)
+    {
+        double best = 1e30;
+        for (int i = 0; i < runs; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            body();
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            best = (std::min)(best, elapsed.count());
+        }
+        return best;
+    }
+
+    // Prints one result line: name, time per run and items per second
+    inline void Print(const char *name, double seconds, double items, const char *unit)
+    {
+        std::printf("%-40s %10.3f ms %12.1f M%s/s\n", name, seconds * 1e3, items / seconds * 1e-6, unit);
+    }
+
+    // Keeps the compiler from dropping results that are never read
+    inline void Consume(float value)
+    {
+        static volatile float sink;
+        sink = value;
+    }
+}
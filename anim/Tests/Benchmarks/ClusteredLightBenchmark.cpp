@@ -0,0 +1,62 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <random>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/Lighting/ClusteredLightCuller.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    // Lights spread through the view of the scene camera at (0, 0, 5), most
+    // of them inside the frustum
+    void makeLights(size_t count, BoundingSphereSet &lights)
+    {
+        std::mt19937 random(47);
+        std::uniform_real_distribution<float> across(-60.0f, 60.0f), depth(-200.0f, 4.0f), radius(0.5f, 4.0f);
+        lights.Resize(count);
+        for (size_t i = 0; i < count; i++)
+            lights.Set(i, across(random), across(random) * 9 / 16, depth(random), radius(random));
+    }
+
+    void run(size_t count, ThreadPool &serial, ThreadPool &parallel)
+    {
+        BoundingSphereSet lights;
+        makeLights(count, lights);
+
+        ClusterGridDesc grid;
+        grid.fovY = 70.0f * 3.14159265f / 180;
+        grid.aspectRatio = 16.0f / 9;
+        grid.nearZ = 0.01f;
+        grid.farZ = 1000.0f;
+        XMMATRIX view = XMMatrixTranslation(0, 0, -5);
+        int runs = count >= 16384 ? 10 : 50;
+        char line[64];
+
+        ClusteredLightCuller serialCuller(serial), parallelCuller(parallel);
+        for (ClusteredLightCuller *culler : { &serialCuller, &parallelCuller })
+        {
+            culler->SetGrid(grid);
+            double seconds = Benchmark::BestSeconds(runs, [&] { culler->Build(lights, view); });
+            std::snprintf(line, sizeof(line), "%zu lights build %s", count,
+                culler == &serialCuller ? "serial" : "pool");
+            Benchmark::Print(line, seconds, (double)count, "lights");
+        }
+        std::printf("%-40s %10.1f\n", "  indices per cluster",
+            (double)serialCuller.GetLightIndices().size() / serialCuller.GetClusterCount());
+    }
+}
+
+// Build time of the light clusters against the light count, on one thread
+// and on the whole pool, for the scene's 16 x 9 x 24 grid
+int main()
+{
+    ThreadPool serial(1), parallel;
+    std::printf("pool of %u threads\n", parallel.GetConcurrency());
+    for (size_t count : { 1024, 4096, 16384, 65536 })
+        run(count, serial, parallel);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/DrawQueue/DrawKey.h"
+#include "Common/DrawQueue/RadixSort.h"
+
+using namespace DX;
+
+namespace
+{
+    // Keys of a scene: a few passes, shaders and materials, depths from the
+    // view distance of objects out to 1000 units
+    void makeKeys(size_t count, bool backToFront, std::vector<uint64_t> &keys, std::vector<uint32_t> &values)
+    {
+        std::mt19937 random(49);
+        std::uniform_int_distribution<uint32_t> pass(0, 3), shader(0, 31), material(0, 1023);
+        std::uniform_real_distribution<float> distance(0.01f, 1000.0f);
+        keys.resize(count);
+        values.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            float depth = distance(random);
+            keys[i] = DrawKey::Make(pass(random), shader(random), material(random),
+                backToFront ? DrawKey::BackToFront(depth) : DrawKey::FrontToBack(depth));
+            values[i] = (uint32_t)i;
+        }
+    }
+
+    void run(size_t count, bool backToFront, ThreadPool &serial, ThreadPool &parallel)
+    {
+        std::vector<uint64_t> sourceKeys, keys;
+        std::vector<uint32_t> sourceValues, values;
+        makeKeys(count, backToFront, sourceKeys, sourceValues);
+        const char *order = backToFront ? "back to front" : "front to back";
+        int runs = count >= 1000000 ? 5 : 20;
+        char line[64];
+
+        RadixSorter serialSorter(serial), parallelSorter(parallel);
+        for (RadixSorter *sorter : { &serialSorter, &parallelSorter })
+        {
+            double seconds = Benchmark::BestSeconds(runs, [&]
+            {
+                keys = sourceKeys;
+                values = sourceValues;
+                sorter->Sort(keys, values);
+            });
+            Benchmark::Consume((float)values[0]);
+            std::snprintf(line, sizeof(line), "%zu %s radix %s", count, order,
+                sorter == &serialSorter ? "serial" : "pool");
+            Benchmark::Print(line, seconds, (double)count, "keys");
+        }
+        std::printf("%-40s %10u\n", "  passes", serialSorter.GetPassCount());
+
+        // What the radix sort replaces
+        std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+        double seconds = Benchmark::BestSeconds(runs, [&]
+        {
+            for (size_t i = 0; i < count; i++)
+                pairs[i] = std::make_pair(sourceKeys[i], sourceValues[i]);
+            std::stable_sort(pairs.begin(), pairs.end(),
+                [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+                {
+                    return a.first < b.first;
+                });
+        });
+        Benchmark::Consume((float)pairs[0].second);
+        std::snprintf(line, sizeof(line), "%zu %s std::stable_sort", count, order);
+        Benchmark::Print(line, seconds, (double)count, "keys");
+    }
+}
+
+// Draw packets with the depth field filled, 10k to 1M of them, on one
+// thread and on the whole pool against std::stable_sort
+int main()
+{
+    ThreadPool serial(1), parallel;
+    std::printf("pool of %u threads\n", parallel.GetConcurrency());
+    for (size_t count : { 10000, 100000, 1000000 })
+    {
+        run(count, false, serial, parallel);
+        run(count, true, serial, parallel);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/Culling/FrustumCuller.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    void printRate(const char *name, double seconds, size_t count, size_t visible)
+    {
+        std::printf("%-40s %10.3f ms %12.0f instances/ms %8zu visible\n", name, seconds * 1e3,
+            (double)count / (seconds * 1e3), visible);
+    }
+
+    void run(size_t count, ThreadPool &serial, ThreadPool &parallel)
+    {
+        // Spheres around the scene camera, about a quarter of them in view
+        std::mt19937 random(43);
+        std::uniform_real_distribution<float> position(-60.0f, 60.0f), radius(0.0f, 5.0f);
+        BoundingSphereSet spheres;
+        spheres.Resize(count);
+        for (size_t i = 0; i < count; i++)
+            spheres.Set(i, position(random), position(random), position(random), radius(random));
+
+        XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(3, 2, 8, 0), XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 1, 0, 0));
+        Frustum frustum = ExtractFrustum(XMMatrixMultiply(view,
+            XMMatrixPerspectiveFovRH(70.0f * 3.14159265f / 180, 16.0f / 9, 0.01f, 100.0f)));
+        int runs = count >= 1000000 ? 10 : 50;
+        char line[64];
+
+        // The per-instance test the culler replaces
+        std::vector<uint32_t> visible;
+        visible.reserve(count);
+        double seconds = Benchmark::BestSeconds(runs, [&]
+        {
+            visible.clear();
+            for (size_t i = 0; i < count; i++)
+            {
+                if (IsSphereVisible(frustum, spheres.GetX()[i], spheres.GetY()[i], spheres.GetZ()[i],
+                    spheres.GetRadius()[i]))
+                    visible.push_back((uint32_t)i);
+            }
+        });
+        std::snprintf(line, sizeof(line), "%zu scalar", count);
+        printRate(line, seconds, count, visible.size());
+
+        FrustumCuller serialCuller(serial), parallelCuller(parallel);
+        for (FrustumCuller *culler : { &serialCuller, &parallelCuller })
+        {
+            seconds = Benchmark::BestSeconds(runs, [&] { culler->Cull(spheres, frustum); });
+            std::snprintf(line, sizeof(line), "%zu SSE2 %s", count, culler == &serialCuller ? "serial" : "pool");
+            printRate(line, seconds, count, culler->GetVisible().size());
+        }
+    }
+}
+
+// Sphere instances culled per millisecond by the scalar test and by the
+// SSE2 culler on one thread and on the whole pool
+int main()
+{
+    ThreadPool serial(1), parallel;
+    std::printf("pool of %u threads\n", parallel.GetConcurrency());
+    for (size_t count : { 10000, 250000, 1000000 })
+        run(count, serial, parallel);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "pch.h"
+
+#include <cstdio>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/Backend/NullRenderBackend.h"
+#include "Common/Backend/RecordingRenderBackend.h"
+#include "Common/Backend/StateCacheRenderBackend.h"
+#include "SceneFrame.h"
+
+using namespace DX;
+
+namespace
+{
+    const int FRAMES = 1000;
+
+    // CPU cost of recording frames into a backend, without a device
+    template <typename Backend>
+    void run(const char *name, uint32_t gridSize, Backend &backend, RenderBackend &front,
+        StateCacheRenderBackend *cache)
+    {
+        SceneFrame frame(gridSize, 12);
+        double seconds = Benchmark::BestSeconds(5, [&]
+        {
+            for (int i = 0; i < FRAMES; i++)
+            {
+                backend.Reset();
+                if (cache)
+                    cache->BeginFrame();
+                frame.Record(front);
+            }
+        });
+
+        uint64_t calls = backend.GetStatistics().apiCalls;
+        std::printf("%-20s %2ux%-2u grid %8.2f us/frame %8.0f frames/s %5llu calls/frame %6.1f ns/call\n",
+            name, gridSize, gridSize, seconds / FRAMES * 1e6, FRAMES / seconds,
+            (unsigned long long)calls, seconds / FRAMES / calls * 1e9);
+    }
+}
+
+// Frame loop against the null, recording and state cache backends
+int main()
+{
+    for (uint32_t gridSize : { 10u, 64u })
+    {
+        NullRenderBackend null;
+        run("null", gridSize, null, null, nullptr);
+
+        RecordingRenderBackend recording;
+        run("recording", gridSize, recording, recording, nullptr);
+
+        NullRenderBackend behindCache;
+        StateCacheRenderBackend cache(&behindCache);
+        run("state cache + null", gridSize, behindCache, cache, &cache);
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "pch.h"
+
+#include <cstdio>
+
+#include "Benchmarks/Benchmark.h"
+#include "CameraPaths.h"
+#include "Content/LODSelector.h"
+#include "Content/SphereGrid.h"
+#include "Content/SphereLODChain.h"
+
+using namespace DirectX;
+
+namespace
+{
+    const int FRAMES = 2000;
+
+    // Triangles per frame with the selector against the fixed 16-segment
+    // mesh, and the selection cost, along one camera path
+    void run(const char *name, const std::vector<XMFLOAT3> &path, float threshold)
+    {
+        anim::SphereGrid grid(10, 5);
+        anim::SphereLODChain lods({ 8, 16, 32, 64 }, 0.25f);
+        anim::LODSelector selector(threshold);
+
+        uint64_t triangles = 0;
+        double seconds = Benchmark::BestSeconds(5, [&]
+        {
+            triangles = 0;
+            for (const XMFLOAT3 &camera : path)
+            {
+                selector.Select(lods, grid.GetInstances(), camera, CameraPaths::PIXELS_PER_UNIT);
+                triangles += selector.GetTriangleCount(lods);
+            }
+        });
+
+        uint64_t fixed = (uint64_t)grid.GetInstanceCount() * (lods.GetLevel(1).indexCount / 3);
+        std::printf("%-8s %.0f px %8.1fk triangles/frame %8.1fk fixed %8.2f us/frame\n", name, threshold,
+            triangles / (double)path.size() / 1000, fixed / 1000.0, seconds / path.size() * 1e6);
+    }
+}
+
+// Level of detail selection over the camera paths of LODSelectorTests
+int main()
+{
+    for (float threshold : { 1.0f, 2.0f })
+    {
+        run("dolly", CameraPaths::Dolly(FRAMES), threshold);
+        run("orbit", CameraPaths::Orbit(FRAMES), threshold);
+        run("strafe", CameraPaths::Strafe(FRAMES), threshold);
+    }
+    return 0;
+}
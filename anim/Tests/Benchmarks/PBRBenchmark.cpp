@@ -0,0 +1,119 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/Shading/PBRShading.h"
+#include "Content/HeadlessSceneRenderer.h"
+#include "Content/SceneLights.h"
+#include "PBRReference.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    const size_t PIXELS = 1 << 16;
+    const float AMBIENT = 0.03f;
+    const char *const MODE_NAMES[4] = { "regular", "normal distribution", "geometry", "fresnel" };
+
+    // The scene's lights at strength 100, the constants point into lights
+    PBRShadingConstants constants(std::vector<GpuPointLight> &lights)
+    {
+        LightManager manager(anim::MAX_SCENE_LIGHTS, anim::SCENE_LIGHT_THRESHOLD);
+        for (uint32_t l = 0; l < anim::SCENE_LIGHT_COUNT; l++)
+            manager.Add(anim::SCENE_LIGHT_POSITIONS[l], XMFLOAT3(1, 1, 1), 100);
+        manager.GetLights(lights);
+
+        PBRShadingConstants result;
+        result.lights = lights.data();
+        result.lightCount = (uint32_t)lights.size();
+        result.cameraPos[2] = 6;
+        return result;
+    }
+
+    // ShadePBR against the double precision port, pixels per second on one thread
+    void shading()
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> unit(-1, 1), material(0, 1);
+        std::vector<PBRSurfaceBatch> surfaces(PIXELS / PBR_BATCH_SIZE);
+        std::vector<PBRReference::Surface> scalar;
+        for (PBRSurfaceBatch &batch : surfaces)
+            for (uint32_t i = 0; i < PBR_BATCH_SIZE; i++)
+            {
+                batch.normalX[i] = unit(random);
+                batch.normalY[i] = unit(random);
+                batch.normalZ[i] = unit(random);
+                batch.positionX[i] = unit(random) * 2.5f;
+                batch.positionY[i] = unit(random) * 2.5f;
+                batch.positionZ[i] = 0;
+                batch.roughness[i] = material(random);
+                batch.metalness[i] = material(random);
+                scalar.push_back({ { batch.normalX[i], batch.normalY[i], batch.normalZ[i] },
+                    { batch.positionX[i], batch.positionY[i], 0 }, batch.roughness[i], batch.metalness[i] });
+            }
+
+        std::vector<GpuPointLight> lights;
+        PBRShadingConstants shading = constants(lights);
+        ConstantPBREnvironment environment(AMBIENT, AMBIENT, AMBIENT);
+        PBRReference::Shader reference(shading, AMBIENT);
+        char name[64];
+        for (int m = 0; m < 4; m++)
+        {
+            PBRShaderMode mode = (PBRShaderMode)m;
+            PBRColorBatch colors;
+            double seconds = Benchmark::BestSeconds(10, [&]
+            {
+                for (const PBRSurfaceBatch &batch : surfaces)
+                {
+                    ShadePBR(mode, shading, environment, batch, colors);
+                    Benchmark::Consume(colors.r[0]);
+                }
+            });
+            std::snprintf(name, sizeof(name), "ShadePBR %s", MODE_NAMES[m]);
+            Benchmark::Print(name, seconds, PIXELS, "px");
+
+            double color[3];
+            seconds = Benchmark::BestSeconds(3, [&]
+            {
+                for (const PBRReference::Surface &surface : scalar)
+                {
+                    reference.Shade(mode, surface, color);
+                    Benchmark::Consume((float)color[0]);
+                }
+            });
+            std::snprintf(name, sizeof(name), "double reference %s", MODE_NAMES[m]);
+            Benchmark::Print(name, seconds, PIXELS, "px");
+        }
+    }
+
+    // The headless scene at 720p: rasterization and shading per frame
+    void scene()
+    {
+        const uint32_t WIDTH = 1280, HEIGHT = 720;
+        anim::HeadlessSceneRenderer renderer(WIDTH, HEIGHT);
+        renderer.SetLightStrength(0, 10);
+        renderer.SetLightStrength(1, 10);
+        XMFLOAT3 cameraPos(0.0f, 0.0f, 4.0f);
+        XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(0, 0, 4, 1), XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 0));
+        XMMATRIX projection = XMMatrixPerspectiveFovRH(70.0f * 3.14159265f / 180, (float)WIDTH / HEIGHT, 0.01f, 1000.0f);
+
+        const int FRAMES = 5;
+        double seconds = Benchmark::BestSeconds(3, [&]
+        {
+            for (int i = 0; i < FRAMES; i++)
+                renderer.Render(view, projection, cameraPos);
+        });
+        Benchmark::Print("headless scene 1280x720 per frame", seconds / FRAMES, (double)WIDTH * HEIGHT, "px");
+    }
+}
+
+int main()
+{
+    shading();
+    scene();
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "pch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/PostProcess/LuminanceReduction.h"
+#include "Common/PostProcess/SparseLuminanceEstimator.h"
+
+using namespace DX;
+
+// Bytes touched, time and error of the sparse estimate against the full
+// tile reduction on 1080p frames with a moving bright area
+int main()
+{
+    const uint32_t WIDTH = 1920, HEIGHT = 1080;
+    const size_t PITCH = WIDTH * 4;
+    const uint64_t FRAMES = 60;
+
+    std::vector<float> rgba(PITCH * HEIGHT);
+    SparseLuminanceEstimator estimator;
+    LuminanceReduction reduction;
+
+    double sparseSeconds = 0, fullSeconds = 0;
+    double errorSum = 0, maxError = 0;
+    uint32_t insideBound = 0;
+    uint64_t sparseBytes = 0;
+    for (uint64_t frame = 0; frame < FRAMES; frame++)
+    {
+        float sunX = WIDTH * (0.2f + 0.6f * frame / FRAMES);
+        for (uint32_t y = 0; y < HEIGHT; y++)
+            for (uint32_t x = 0; x < WIDTH; x++)
+            {
+                float dx = x - sunX, dy = y - HEIGHT * 0.3f;
+                float l = 0.05f + 0.5f * (float)y / HEIGHT + 40.0f * std::exp(-(dx * dx + dy * dy) / 20000.0f);
+                float *p = rgba.data() + y * PITCH + 4 * x;
+                p[0] = l * 1.1f;
+                p[1] = l;
+                p[2] = l * 0.8f;
+                p[3] = 1;
+            }
+
+        LuminanceReductionResult full;
+        fullSeconds += Benchmark::BestSeconds(1, [&]
+        {
+            full = reduction.Reduce(rgba.data(), WIDTH, HEIGHT, PITCH);
+        });
+
+        SparseLuminanceEstimate sparse;
+        sparseSeconds += Benchmark::BestSeconds(1, [&]
+        {
+            sparse = estimator.Estimate(rgba.data(), WIDTH, HEIGHT, PITCH, frame);
+        });
+
+        double error = std::fabs(sparse.averageLogBrightness - full.averageLogBrightness);
+        errorSum += error;
+        maxError = (std::max)(maxError, error);
+        if (error <= sparse.GetErrorBound())
+            insideBound++;
+        sparseBytes = sparse.bytesRead;
+    }
+
+    uint64_t fullBytes = SparseLuminanceEstimator::GetFullResolutionBytesRead(WIDTH, HEIGHT);
+    std::printf("bytes per frame: sparse %llu, full %llu (%.0fx fewer)\n",
+        (unsigned long long)sparseBytes, (unsigned long long)fullBytes, (double)fullBytes / sparseBytes);
+    Benchmark::Print("full tile reduction", fullSeconds / FRAMES, (double)WIDTH * HEIGHT, "pixels");
+    Benchmark::Print("sparse estimate", sparseSeconds / FRAMES, (double)WIDTH * HEIGHT, "pixels");
+    std::printf("error: mean %.4f, max %.4f, %u of %llu inside the 95%% bound\n",
+        errorSum / FRAMES, maxError, insideBound, (unsigned long long)FRAMES);
+    return 0;
+}
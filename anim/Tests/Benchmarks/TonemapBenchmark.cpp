@@ -0,0 +1,61 @@
+#include "pch.h"
+
+#include <cmath>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/PostProcess/TonemapLUT.h"
+
+using namespace DX;
+
+// Tonemapping a 1080p frame: per channel curve evaluation, scalar table
+// lookups and the four pixel SSE path
+int main()
+{
+    const size_t PIXELS = 1920 * 1080;
+    const float EXPOSURE = 0.35f;
+
+    std::vector<float> in(PIXELS * 4), out(PIXELS * 4);
+    uint32_t state = 1;
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        in[i] = std::exp2((state >> 8) / 16777216.0f * 14.0f - 6.0f);
+    }
+
+    TonemapLUT lut;
+
+    double direct = Benchmark::BestSeconds(5, [&]
+    {
+        for (size_t p = 0; p < PIXELS; p++)
+        {
+            for (int c = 0; c < 3; c++)
+                out[4 * p + c] = lut.EvaluateDirect(in[4 * p + c] * EXPOSURE);
+            out[4 * p + 3] = 1;
+        }
+        Benchmark::Consume(out[0]);
+    });
+    Benchmark::Print("EvaluateDirect", direct, PIXELS, "pixels");
+
+    double scalar = Benchmark::BestSeconds(5, [&]
+    {
+        for (size_t p = 0; p < PIXELS; p++)
+        {
+            for (int c = 0; c < 3; c++)
+                out[4 * p + c] = lut.Apply(in[4 * p + c] * EXPOSURE);
+            out[4 * p + 3] = 1;
+        }
+        Benchmark::Consume(out[0]);
+    });
+    Benchmark::Print("Apply, one channel at a time", scalar, PIXELS, "pixels");
+
+    double simd = Benchmark::BestSeconds(5, [&]
+    {
+        lut.Apply(in.data(), out.data(), PIXELS, EXPOSURE);
+        Benchmark::Consume(out[0]);
+    });
+    Benchmark::Print("Apply, four pixels per iteration", simd, PIXELS, "pixels");
+
+    std::printf("speedup over EvaluateDirect: %.1fx\n", direct / simd);
+    return 0;
+}
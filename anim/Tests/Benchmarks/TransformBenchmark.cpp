@@ -0,0 +1,71 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/Scene/TransformHierarchy.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    // 1000 trees of a root, 15 children and 16 grandchildren each
+    const uint32_t TREES = 1000;
+
+    void build(TransformHierarchy &hierarchy)
+    {
+        for (uint32_t t = 0; t < TREES; t++)
+        {
+            uint32_t root = hierarchy.Add(TransformHierarchy::NO_PARENT, XMFLOAT3((float)t, 0, 0));
+            for (uint32_t c = 0; c < 15; c++)
+            {
+                uint32_t child = hierarchy.Add(root, XMFLOAT3(0, (float)c, 0), XMFLOAT4(0, 0.6f, 0, 0.8f));
+                for (uint32_t g = 0; g < 16; g++)
+                    hierarchy.Add(child, XMFLOAT3(0, 0, (float)g), XMFLOAT4(0.6f, 0, 0, 0.8f), XMFLOAT3(2, 2, 2));
+            }
+        }
+    }
+
+    void run(const char *name, ThreadPool &pool)
+    {
+        TransformHierarchy hierarchy(pool);
+        build(hierarchy);
+        uint32_t count = hierarchy.GetCount();
+        std::vector<XMFLOAT4X4> output(count);
+        char line[64];
+
+        // Every node dirty, as after loading, and written out for upload
+        double seconds = Benchmark::BestSeconds(10, [&]
+        {
+            for (uint32_t t = 0; t < TREES; t++)
+                hierarchy.SetPosition(t * 256, XMFLOAT3((float)t, 1, 0));
+            hierarchy.Update();
+            hierarchy.WriteWorldMatrices(0, count, output.data(), sizeof(XMFLOAT4X4), true);
+        });
+        Benchmark::Consume(output[count - 1]._41);
+        std::snprintf(line, sizeof(line), "%s full update + write", name);
+        Benchmark::Print(line, seconds, count, "nodes");
+
+        // One tree moved
+        seconds = Benchmark::BestSeconds(10, [&]
+        {
+            hierarchy.SetPosition(0, XMFLOAT3(0, 2, 0));
+            hierarchy.Update();
+        });
+        std::snprintf(line, sizeof(line), "%s one subtree", name);
+        Benchmark::Print(line, seconds, 256, "nodes");
+    }
+}
+
+// World matrices of 256000 nodes on one thread and on the whole pool
+int main()
+{
+    ThreadPool serial(1);
+    run("serial", serial);
+    ThreadPool parallel;
+    std::printf("pool of %u threads\n", parallel.GetConcurrency());
+    run("parallel", parallel);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Common/Mesh/VertexPacking.h"
+#include "Content/SphereLODChain.h"
+
+using namespace DX;
+
+// Error and size of the scene's sphere chain in the packed format, and the
+// pack and unpack throughput over it
+int main()
+{
+    anim::SphereLODChain lods({ 8, 16, 32, 64 }, 0.25f);
+    const auto &vertices = lods.GetVertices();
+    size_t count = vertices.size(), stride = sizeof(anim::VertexPositionColorNormal);
+
+    PositionQuantization quantization = ComputePositionQuantization(&vertices[0].pos.x, stride, count);
+    std::vector<PackedVertex> packed(count);
+    PackVertices(&vertices[0].pos.x, &vertices[0].normal.x, &vertices[0].color.x, stride, count,
+        quantization, packed.data());
+    VertexPackingError error = MeasurePackingError(&vertices[0].pos.x, &vertices[0].normal.x,
+        &vertices[0].color.x, stride, count, quantization, packed.data());
+
+    std::printf("%zu vertices, radius %.2f\n", count, lods.GetRadius());
+    std::printf("position error %.2g, normal error %.4f deg, texcoord error %.2g\n",
+        error.position, error.normalDegrees, error.texcoord);
+    std::printf("vertex buffer %zu -> %zu bytes, %.2fx less fetch per vertex\n",
+        count * stride, count * sizeof(PackedVertex), (double)stride / sizeof(PackedVertex));
+
+    const int REPEATS = 200;
+    double seconds = Benchmark::BestSeconds(5, [&]
+    {
+        for (int i = 0; i < REPEATS; i++)
+            PackVertices(&vertices[0].pos.x, &vertices[0].normal.x, &vertices[0].color.x, stride, count,
+                quantization, packed.data());
+    });
+    Benchmark::Print("pack", seconds / REPEATS, (double)count, "vertices");
+
+    std::vector<anim::VertexPositionColorNormal> unpacked(count);
+    seconds = Benchmark::BestSeconds(5, [&]
+    {
+        for (int i = 0; i < REPEATS; i++)
+            UnpackVertices(packed.data(), count, quantization, &unpacked[0].pos.x, &unpacked[0].normal.x,
+                &unpacked[0].color.x, stride);
+    });
+    Benchmark::Consume(unpacked[count / 2].pos.x);
+    Benchmark::Print("unpack", seconds / REPEATS, (double)count, "vertices");
+    return 0;
+}
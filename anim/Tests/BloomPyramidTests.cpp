@@ -0,0 +1,237 @@
+#include "pch.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Common/PostProcess/BloomPyramid.h"
+#include "Common/RenderGraph/RenderGraph.h"
+#include "Common/RenderTarget/FakeRenderTargetAllocator.h"
+
+using namespace DX;
+
+namespace
+{
+    typedef RenderGraph<FakeRenderTarget> Graph;
+
+    std::vector<float> uniformImage(uint32_t width, uint32_t height, float r, float g, float b)
+    {
+        std::vector<float> rgba((size_t)width * height * 4);
+        for (size_t i = 0; i < rgba.size(); i += 4)
+        {
+            rgba[i] = r;
+            rgba[i + 1] = g;
+            rgba[i + 2] = b;
+            rgba[i + 3] = 1;
+        }
+        return rgba;
+    }
+
+    // Above threshold + knee the prefilter keeps colour * (1 - threshold /
+    // brightness). The levels of a uniform image stay uniform, and each
+    // upsample adds the whole coarser level, so the finest upsampled level
+    // holds levelCount times the prefiltered colour.
+    void testUniformGain()
+    {
+        BloomSettings settings;
+        settings.threshold = 1.0f;
+        settings.knee = 0.5f;
+        settings.intensity = 0.05f;
+        BloomPyramid bloom(settings);
+
+        const float COLOR[3] = { 4.0f, 2.0f, 1.0f };
+        for (uint32_t size : { 64u, 37u })
+        {
+            uint32_t width = size * 2 - 5, height = size;
+            std::vector<float> scene = uniformImage(width, height, COLOR[0], COLOR[1], COLOR[2]);
+            bloom.Build(scene.data(), width, height, (size_t)width * 4);
+
+            uint32_t levelCount = BloomPyramid::GetLevelCount(width, height, settings.maxLevelCount);
+            CHECK_EQUAL(bloom.GetUpsampled().size(), (size_t)levelCount);
+            float keep = 1 - settings.threshold / COLOR[0];
+            for (uint32_t l = 0; l < levelCount; l++)
+            {
+                const BloomLevel &level = bloom.GetUpsampled()[l];
+                float gain = (levelCount - l) * keep;
+                for (size_t i = 0; i < level.rgba.size(); i += 4)
+                    for (int c = 0; c < 3; c++)
+                        CHECK_NEAR(level.rgba[i + c], gain * COLOR[c], 1e-4 * gain * COLOR[c]);
+            }
+
+            for (uint32_t y : { 0u, height / 2, height - 1 })
+                for (uint32_t x : { 0u, width / 3, width - 1 })
+                {
+                    float out[4];
+                    bloom.Composite(scene.data(), width, height, (size_t)width * 4, x, y, out);
+                    for (int c = 0; c < 3; c++)
+                        CHECK_NEAR(out[c], COLOR[c] * (1 + settings.intensity * levelCount * keep), 1e-4 * COLOR[c]);
+                    CHECK_EQUAL(out[3], 1.0f);
+                }
+        }
+    }
+
+    // Below threshold - knee nothing blooms, just above it the knee lets a
+    // little through
+    void testBelowThreshold()
+    {
+        BloomSettings settings;
+        settings.threshold = 1.0f;
+        settings.knee = 0.25f;
+        BloomPyramid bloom(settings);
+
+        const uint32_t WIDTH = 40, HEIGHT = 30;
+        std::vector<float> scene = uniformImage(WIDTH, HEIGHT, 0.74f, 0.5f, 0.1f);
+        bloom.Build(scene.data(), WIDTH, HEIGHT, WIDTH * 4);
+        for (const BloomLevel &level : bloom.GetUpsampled())
+            for (size_t i = 0; i < level.rgba.size(); i += 4)
+                for (int c = 0; c < 3; c++)
+                    CHECK_EQUAL(level.rgba[i + c], 0.0f);
+        float out[4];
+        bloom.Composite(scene.data(), WIDTH, HEIGHT, WIDTH * 4, 5, 5, out);
+        CHECK_EQUAL(out[0], 0.74f);
+
+        float rgb[3] = { 0.8f, 0.4f, 0.2f }, filtered[3];
+        BloomPyramid::Prefilter(rgb, settings.threshold, settings.knee, filtered);
+        CHECK(filtered[0] > 0 && filtered[0] < 0.8f - settings.threshold + settings.knee);
+    }
+
+    void testLevelSizes()
+    {
+        uint32_t width, height;
+        // Odd sides round up, so no scene pixel falls off the edge
+        BloomPyramid::GetLevelSize(1281, 721, 0, width, height);
+        CHECK(width == 641 && height == 361);
+        BloomPyramid::GetLevelSize(1281, 721, 1, width, height);
+        CHECK(width == 321 && height == 181);
+        BloomPyramid::GetLevelSize(1281, 721, 5, width, height);
+        CHECK(width == 21 && height == 12);
+
+        // The chain stops before the shorter side reaches one pixel
+        CHECK_EQUAL(BloomPyramid::GetLevelCount(1280, 720, 6), 6u);
+        CHECK_EQUAL(BloomPyramid::GetLevelCount(1280, 720, 20), 10u);
+        CHECK_EQUAL(BloomPyramid::GetLevelCount(5, 1000, 6), 3u);
+        CHECK_EQUAL(BloomPyramid::GetLevelCount(3, 3, 6), 2u);
+        BloomPyramid::GetLevelSize(3, 3, 1, width, height);
+        CHECK(width == 1 && height == 1);
+
+        // A 1-pixel scene still gets one 1-pixel level
+        CHECK_EQUAL(BloomPyramid::GetLevelCount(1, 1, 6), 1u);
+        CHECK_EQUAL(BloomPyramid::GetLevelCount(1000, 1, 6), 1u);
+        BloomPyramid::GetLevelSize(1, 1, 0, width, height);
+        CHECK(width == 1 && height == 1);
+        BloomPyramid::GetLevelSize(0, 0, 0, width, height);
+        CHECK(width == 1 && height == 1);
+
+        BloomPyramid bloom;
+        std::vector<float> pixel = uniformImage(1, 1, 3, 3, 3);
+        bloom.Build(pixel.data(), 1, 1, 4);
+        CHECK_EQUAL(bloom.GetUpsampled().size(), 1u);
+        CHECK_NEAR(bloom.GetUpsampled()[0].rgba[0], 2.0f, 1e-4f);
+
+        CHECK_THROWS(std::logic_error, BloomPyramid().Composite(pixel.data(), 1, 1, 4, 0, 0, pixel.data()));
+        BloomSettings noLevels;
+        noLevels.maxLevelCount = 0;
+        CHECK_THROWS(std::invalid_argument, BloomPyramid pyramid(noLevels));
+    }
+
+    // The passes of AnimMain::addBloomPasses and addHDRPasses: the
+    // downsample chain, the in-place upsample chain, and an HDR pass that
+    // reads the finest level only while bloom is on
+    struct BloomFrame
+    {
+        BloomFrame(uint32_t width, uint32_t height, bool bloomEnabled) :
+            allocator(std::make_shared<FakeRenderTargetAllocator>()),
+            pool(allocator),
+            graph(pool, [](const FakeRenderTarget &, const ClearValue &) {})
+        {
+            RenderTargetDesc sceneDesc;
+            sceneDesc.width = width;
+            sceneDesc.height = height;
+            sceneDesc.format = 2;
+            FakeRenderTarget backBufferTexture;
+            backBufferTexture.id = 1000;
+            Graph::Resource backBuffer = graph.ImportTexture("BackBuffer", backBufferTexture);
+            Graph::Resource scene = graph.CreateTexture("Scene", sceneDesc);
+            graph.AddClear(scene, ClearValue());
+            pass("Scene", {}, scene, LoadAction::Load);
+
+            levelCount = BloomPyramid::GetLevelCount(width, height, BloomSettings().maxLevelCount);
+            RenderTargetDesc levelDesc = sceneDesc;
+            levelDesc.format = 10;
+            std::vector<Graph::Resource> levels(levelCount);
+            Graph::Resource source = scene;
+            for (uint32_t level = 0; level < levelCount; level++)
+            {
+                BloomPyramid::GetLevelSize(width, height, level, levelDesc.width, levelDesc.height);
+                levels[level] = graph.CreateTexture("Bloom" + std::to_string(level), levelDesc);
+                pass("BloomDownsample" + std::to_string(level), { source }, levels[level], LoadAction::DontCare);
+                source = levels[level];
+            }
+            for (uint32_t level = levelCount - 1; level-- > 0;)
+                pass("BloomUpsample" + std::to_string(level), { levels[level + 1] }, levels[level], LoadAction::Load);
+
+            std::vector<Graph::Resource> hdrReads = { scene };
+            if (bloomEnabled)
+                hdrReads.push_back(levels[0]);
+            pass("HDR", hdrReads, backBuffer, LoadAction::DontCare);
+        }
+
+        void pass(const std::string &name, const std::vector<Graph::Resource> &reads, Graph::Resource write,
+            LoadAction load)
+        {
+            graph.AddPass(name, [&](Graph::PassBuilder &builder)
+            {
+                for (Graph::Resource read : reads)
+                    builder.Read(read);
+                builder.Write(write, load);
+            }, [this, name](const Graph &)
+            {
+                executed.push_back(name);
+            });
+        }
+
+        std::shared_ptr<FakeRenderTargetAllocator> allocator;
+        RenderTargetPool<FakeRenderTarget> pool;
+        Graph graph;
+        uint32_t levelCount;
+        std::vector<std::string> executed;
+    };
+
+    // Turning bloom off with B culls every bloom pass and allocates none of
+    // its textures
+    void testGraphCullsBloom()
+    {
+        BloomFrame on(1281, 721, true);
+        const Graph::Report &onReport = on.graph.Compile();
+        CHECK(onReport.culledPasses.empty());
+        CHECK_EQUAL(onReport.transientTextureCount, (size_t)on.levelCount + 1);
+        on.graph.Execute();
+        CHECK_EQUAL(on.executed.size(), (size_t)2 * on.levelCount + 1);
+        CHECK_EQUAL(on.executed.back(), std::string("HDR"));
+
+        BloomFrame off(1281, 721, false);
+        const Graph::Report &offReport = off.graph.Compile();
+        CHECK_EQUAL(offReport.culledPasses.size(), (size_t)2 * off.levelCount - 1);
+        for (uint32_t level = 0; level < off.levelCount; level++)
+        {
+            CHECK(off.graph.IsCulled("BloomDownsample" + std::to_string(level)));
+            if (level + 1 < off.levelCount)
+                CHECK(off.graph.IsCulled("BloomUpsample" + std::to_string(level)));
+        }
+        CHECK(!off.graph.IsCulled("Scene") && !off.graph.IsCulled("HDR"));
+        CHECK_EQUAL(offReport.physicalTextureCount, 1u);
+        off.graph.Execute();
+        CHECK((off.executed == std::vector<std::string>{ "Scene", "HDR" }));
+        CHECK_EQUAL(off.allocator->GetAllocationCount(), 1u);
+    }
+}
+
+int main()
+{
+    testUniformGain();
+    testBelowThreshold();
+    testLevelSizes();
+    testGraphCullsBloom();
+    return Test::Report();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include <DirectXMath.h>
+
+// Camera positions along the paths the level of detail tests and benchmark
+// fly past the 10x10 sphere grid of the scene, which lies in the z = 0 plane.
+namespace CameraPaths
+{
+    // Projected size of a unit at distance one for a 1080p output and a
+    // 70 degree vertical field of view
+    const float PIXELS_PER_UNIT = 540.0f / std::tan(35.0f * 3.14159265f / 180);
+
+    // Straight towards the grid's centre from z = 40 to z = 1.5
+    inline std::vector<DirectX::XMFLOAT3> Dolly(int frames)
+    {
+        std::vector<DirectX::XMFLOAT3> path;
+        for (int i = 0; i < frames; i++)
+            path.push_back(DirectX::XMFLOAT3(0, 0, 40 - 38.5f * i / (frames - 1)));
+        return path;
+    }
+
+    // Once around the grid's centre at radius 5, tilted out of its plane
+    inline std::vector<DirectX::XMFLOAT3> Orbit(int frames)
+    {
+        std::vector<DirectX::XMFLOAT3> path;
+        for (int i = 0; i < frames; i++)
+        {
+            float angle = 2 * 3.14159265f * i / frames;
+            path.push_back(DirectX::XMFLOAT3(5 * std::cos(angle), 2.5f * std::sin(angle), 4.33f * std::sin(angle) + 1));
+        }
+        return path;
+    }
+
+    // Sideways across the grid just above it, at z = 1
+    inline std::vector<DirectX::XMFLOAT3> Strafe(int frames)
+    {
+        std::vector<DirectX::XMFLOAT3> path;
+        for (int i = 0; i < frames; i++)
+            path.push_back(DirectX::XMFLOAT3(-3 + 6.0f * i / (frames - 1), 0.3f, 1));
+        return path;
+    }
+
+    // Back and forth by amplitude around a point, as a shaking hand would
+    inline std::vector<DirectX::XMFLOAT3> Jitter(int frames, const DirectX::XMFLOAT3 &centre, float amplitude)
+    {
+        std::vector<DirectX::XMFLOAT3> path;
+        for (int i = 0; i < frames; i++)
+        {
+            float offset = i % 2 ? amplitude : -amplitude;
+            path.push_back(DirectX::XMFLOAT3(centre.x, centre.y, centre.z + offset));
+        }
+        return path;
+    }
+}
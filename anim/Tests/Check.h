@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Checks for the CPU tests. A failed check prints where it failed and the
+// test keeps going; Report returns the exit code for main.
+namespace Test
+{
+    inline int &FailureCount()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline bool Check(bool passed, const char *expression, const char *file, int line)
+    {
+        if (!passed)
+        {
+            std::printf("%s(%d): check failed: %s\n", file, line, expression);
+            FailureCount()++;
+        }
+        return passed;
+    }
+
+    inline int Report()
+    {
+        if (FailureCount() == 0)
+            std::printf("All checks passed\n");
+        else
+            std::printf("%d checks failed\n", FailureCount());
+        return FailureCount() == 0 ? 0 : 1;
+    }
+}
+
+#define CHECK(condition) Test::Check(!!(condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(a, b) Test::Check((a) == (b), #a " == " #b, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) \
+    Test::Check(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance), \
+        #a " near " #b " within " #tolerance, __FILE__, __LINE__)
+#define CHECK_THROWS(exception, statement) \
+    do \
+    { \
+        bool thrown = false; \
+        try { statement; } \
+        catch (const exception &) { thrown = true; } \
+        Test::Check(thrown, #statement " throws " #exception, __FILE__, __LINE__); \
+    } while (false)
@@ -0,0 +1,119 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Lighting/ClusteredLightCuller.h"
+#include "Common/Lighting/LightAttenuation.h"
+#include "Common/Lighting/LightManager.h"
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    const float VIEWPORT_WIDTH = 1280;
+    const float VIEWPORT_HEIGHT = 720;
+
+    // The camera of the scene renderer
+    ClusterGridDesc sceneGrid()
+    {
+        ClusterGridDesc grid;
+        grid.fovY = 70.0f * 3.14159265f / 180;
+        grid.aspectRatio = VIEWPORT_WIDTH / VIEWPORT_HEIGHT;
+        grid.nearZ = 0.01f;
+        grid.farZ = 1000.0f;
+        return grid;
+    }
+
+    // clusterIndex of ClusteredLighting.cginc
+    uint32_t shaderClusterIndex(const ClusterShaderConstants &constants, float pixelX, float pixelY, float viewDepth)
+    {
+        uint32_t tileX = (std::min)((uint32_t)(pixelX * constants.tileScaleX), constants.tilesX - 1);
+        uint32_t tileY = (std::min)((uint32_t)(pixelY * constants.tileScaleY), constants.tilesY - 1);
+        float slice = std::log(viewDepth) * constants.sliceScale + constants.sliceBias;
+        slice = (std::min)((std::max)(slice, 0.0f), (float)(constants.slices - 1));
+        return ((uint32_t)slice * constants.tilesY + tileY) * constants.tilesX + tileX;
+    }
+
+    // Every light that reaches a visible point is in the cluster the pixel
+    // shader looks up for it, as the scene renderer feeds the culler
+    void testClustersCoverLights()
+    {
+        std::mt19937 random(47);
+        std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+        std::uniform_real_distribution<float> intensity(2.0f, 50.0f);
+
+        const uint32_t LIGHTS = 200;
+        LightManager lights(LIGHTS, 1.0f);
+        for (uint32_t i = 0; i < LIGHTS; i++)
+            lights.Add(XMFLOAT3(position(random), position(random), position(random)), XMFLOAT3(1, 1, 1),
+                i % 10 == 0 ? 0.0f : intensity(random));
+
+        BoundingSphereSet bounds;
+        lights.GetBounds(bounds);
+
+        ThreadPool pool(1);
+        ClusteredLightCuller culler(pool);
+        culler.SetGrid(sceneGrid());
+        // The camera at (0, 0, 5) looking at the origin, so view space is
+        // world space moved back by 5
+        XMMATRIX view = XMMatrixTranslation(0, 0, -5);
+        culler.Build(bounds, view);
+        CHECK_EQUAL(culler.GetRanges().size(), (size_t)culler.GetClusterCount());
+
+        // Lights turned down to nothing are in no cluster
+        for (uint32_t light : culler.GetLightIndices())
+            CHECK(light % 10 != 0);
+
+        ClusterShaderConstants constants = culler.GetShaderConstants(VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+        XMFLOAT4X4 p;
+        XMStoreFloat4x4(&p, XMMatrixPerspectiveFovRH(sceneGrid().fovY, sceneGrid().aspectRatio,
+            sceneGrid().nearZ, sceneGrid().farZ));
+
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        uint32_t litPoints = 0;
+        for (int sample = 0; sample < 20000; sample++)
+        {
+            // A pixel centre and a depth in front of the camera
+            float pixelX = std::floor(unit(random) * VIEWPORT_WIDTH) + 0.5f;
+            float pixelY = std::floor(unit(random) * VIEWPORT_HEIGHT) + 0.5f;
+            float depth = 0.1f + unit(random) * 40.0f;
+
+            float ndcX = pixelX / VIEWPORT_WIDTH * 2 - 1;
+            float ndcY = 1 - pixelY / VIEWPORT_HEIGHT * 2;
+            XMFLOAT3 world(ndcX * depth / p._11, ndcY * depth / p._22, 5 - depth);
+
+            const ClusteredLightCuller::ClusterRange &range =
+                culler.GetRanges()[shaderClusterIndex(constants, pixelX, pixelY, depth)];
+            const uint32_t *first = culler.GetLightIndices().data() + range.offset;
+            const uint32_t *last = first + range.count;
+
+            bool lit = false;
+            for (uint32_t i = 0; i < LIGHTS; i++)
+            {
+                float dx = bounds.GetX()[i] - world.x;
+                float dy = bounds.GetY()[i] - world.y;
+                float dz = bounds.GetZ()[i] - world.z;
+                float radius = bounds.GetRadius()[i];
+                if (!(radius > 0) || WindowedAttenuation(dx * dx + dy * dy + dz * dz, radius) <= 0)
+                    continue;
+                lit = true;
+                CHECK(std::binary_search(first, last, i));
+            }
+            if (lit)
+                litPoints++;
+        }
+        // The samples actually exercise the lookup
+        CHECK(litPoints > 1000);
+    }
+}
+
+int main()
+{
+    testClustersCoverLights();
+    return Test::Report();
+}
@@ -0,0 +1,176 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Common/PostProcess/ColorGradingLUT.h"
+#include "Common/PostProcess/CubeLUT.h"
+#include "Common/PostProcess/TonemapLUT.h"
+
+using namespace DX;
+
+namespace
+{
+    const float EXPOSURE = 0.4f;
+
+    // Contrast around mid grey and extra saturation, clipped to [0, 1]
+    void grade(const float *in, float *out)
+    {
+        float luma = 0.2126f * in[0] + 0.7152f * in[1] + 0.0722f * in[2];
+        for (int c = 0; c < 3; c++)
+        {
+            float saturated = luma + (in[c] - luma) * 1.3f;
+            float contrasted = 0.5f + (saturated - 0.5f) * 1.2f;
+            out[c] = (std::min)((std::max)(contrasted, 0.0f), 1.0f);
+        }
+    }
+
+    std::string writeCube(uint32_t size)
+    {
+        std::ostringstream text;
+        text << "# Test grade\nTITLE \"Contrast\"\nLUT_3D_SIZE " << size << "\n";
+        for (uint32_t b = 0; b < size; b++)
+            for (uint32_t g = 0; g < size; g++)
+                for (uint32_t r = 0; r < size; r++)
+                {
+                    float in[3] = { (float)r / (size - 1), (float)g / (size - 1), (float)b / (size - 1) };
+                    float out[3];
+                    grade(in, out);
+                    text << out[0] << " " << out[1] << " " << out[2] << "\r\n";
+                }
+        return text.str();
+    }
+
+    CubeLUT parse(const std::string &text)
+    {
+        std::istringstream in(text);
+        return CubeLUT::Parse(in);
+    }
+
+    // HDR colours over the range the shaper covers, including black
+    std::vector<float> makeColors(size_t count)
+    {
+        std::vector<float> rgba(count * 4);
+        uint32_t state = 99;
+        for (size_t i = 0; i < rgba.size(); i++)
+        {
+            state = state * 1664525u + 1013904223u;
+            rgba[i] = i % 4 == 3 ? 1.0f : std::exp2((state >> 8) / 16777216.0f * 18.0f - 12.0f);
+        }
+        rgba[0] = rgba[1] = rgba[2] = 0;
+        return rgba;
+    }
+
+    void testParse()
+    {
+        CubeLUT lut = parse(writeCube(5));
+        CHECK_EQUAL(lut.GetSize(), 5u);
+        CHECK(lut.GetTitle() == "Contrast");
+        CHECK_EQUAL(lut.GetTable().size(), 5u * 5 * 5 * 3);
+
+        // The table passes through its own entries
+        float in[3] = { 0.25f, 0.75f, 1.0f }, expected[3], sampled[3];
+        grade(in, expected);
+        lut.Sample(in, sampled);
+        for (int c = 0; c < 3; c++)
+            CHECK_NEAR(sampled[c], expected[c], 1e-5);
+
+        CHECK_THROWS(std::runtime_error, parse("LUT_3D_SIZE 2\n0 0 0\n1 1 1\n"));
+        CHECK_THROWS(std::runtime_error, parse("LUT_1D_SIZE 16\n"));
+        CHECK_THROWS(std::runtime_error, parse("LUT_3D_SIZE 2\n0 0 zero\n"));
+        CHECK_THROWS(std::runtime_error, parse("0 0 0\nLUT_3D_SIZE 2\n"));
+        CHECK_THROWS(std::runtime_error, parse("TITLE \"Empty\"\n"));
+        CHECK_THROWS(std::runtime_error, CubeLUT::Load("MissingGrade.cube"));
+    }
+
+    // An identity grade leaves the baked table equal to the 1D tonemap,
+    // clipped to the [0, 1] domain of the cube
+    void testIdentityGrade()
+    {
+        TonemapLUT tonemap;
+        ColorGradingLUT lut(tonemap, CubeLUT::Identity(33));
+
+        std::vector<float> colors = makeColors(20000);
+        float maxError = 0;
+        for (size_t i = 0; i < colors.size(); i += 4)
+        {
+            float out[3];
+            lut.Apply(&colors[i], EXPOSURE, out);
+            for (int c = 0; c < 3; c++)
+                maxError = (std::max)(maxError,
+                    std::fabs(out[c] - (std::min)(tonemap.EvaluateDirect(colors[i + c] * EXPOSURE), 1.0f)));
+        }
+        CHECK(maxError < 0.003f);
+    }
+
+    // Composition accuracy: the fused table against tonemapping with the
+    // exact curve and then grading, at several table sizes
+    void testComposition(uint32_t size, float maxMean, float maxError)
+    {
+        TonemapLUT tonemap;
+        CubeLUT cube = parse(writeCube(33));
+        ColorGradingLUT lut(tonemap, cube, size);
+
+        std::vector<float> colors = makeColors(50000);
+        double errorSum = 0;
+        float worst = 0;
+        for (size_t i = 0; i < colors.size(); i += 4)
+        {
+            float fused[3], sequential[3];
+            lut.Apply(&colors[i], EXPOSURE, fused);
+            ColorGradingLUT::ApplySequential(tonemap, cube, &colors[i], EXPOSURE, sequential);
+            for (int c = 0; c < 3; c++)
+            {
+                float error = std::fabs(fused[c] - sequential[c]);
+                errorSum += error;
+                worst = (std::max)(worst, error);
+            }
+        }
+        double mean = errorSum / (colors.size() / 4 * 3);
+        CHECK(mean * 255 < maxMean);
+        CHECK(worst * 255 < maxError);
+    }
+
+    // The four pixel SSE path and its tail against the per pixel lookup
+    void testBatchMatchesScalar(size_t pixelCount)
+    {
+        TonemapLUT tonemap;
+        ColorGradingLUT lut(tonemap, parse(writeCube(17)));
+
+        std::vector<float> colors = makeColors(pixelCount);
+        std::vector<float> out(colors.size());
+        lut.Apply(colors.data(), out.data(), pixelCount, EXPOSURE);
+
+        float worst = 0;
+        for (size_t p = 0; p < pixelCount; p++)
+        {
+            float expected[3];
+            lut.Apply(&colors[4 * p], EXPOSURE, expected);
+            for (int c = 0; c < 3; c++)
+                worst = (std::max)(worst, std::fabs(out[4 * p + c] - expected[c]));
+            CHECK_EQUAL(out[4 * p + 3], 1.0f);
+        }
+        CHECK(worst < 1e-5f);
+
+        lut.Apply(colors.data(), colors.data(), pixelCount, EXPOSURE);
+        CHECK(colors == out);
+    }
+}
+
+int main()
+{
+    testParse();
+    testIdentityGrade();
+    // Mean and max error in 8-bit steps
+    testComposition(17, 0.6f, 16.0f);
+    testComposition(33, 0.15f, 8.0f);
+    testComposition(65, 0.05f, 4.0f);
+    testBatchMatchesScalar(1);
+    testBatchMatchesScalar(1031);
+    return Test::Report();
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+// The part of DirectXMath the CPU modules use, for building them on Linux.
+// Row vectors and right-handed projections as in DirectXMath; nothing here
+// aims for its speed.
+
+#include <cmath>
+#include <xmmintrin.h>
+
+namespace DirectX
+{
+    typedef __m128 XMVECTOR;
+    typedef const XMVECTOR FXMVECTOR;
+
+    struct XMFLOAT3
+    {
+        float x, y, z;
+
+        XMFLOAT3() = default;
+        XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+    };
+
+    struct XMFLOAT4
+    {
+        float x, y, z, w;
+
+        XMFLOAT4() = default;
+        XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+    };
+
+    struct XMFLOAT4X4
+    {
+        union
+        {
+            struct
+            {
+                float _11, _12, _13, _14;
+                float _21, _22, _23, _24;
+                float _31, _32, _33, _34;
+                float _41, _42, _43, _44;
+            };
+            float m[4][4];
+        };
+
+        XMFLOAT4X4() = default;
+        XMFLOAT4X4(float m00, float m01, float m02, float m03,
+            float m10, float m11, float m12, float m13,
+            float m20, float m21, float m22, float m23,
+            float m30, float m31, float m32, float m33) :
+            _11(m00), _12(m01), _13(m02), _14(m03),
+            _21(m10), _22(m11), _23(m12), _24(m13),
+            _31(m20), _32(m21), _33(m22), _34(m23),
+            _41(m30), _42(m31), _43(m32), _44(m33)
+        {
+        }
+    };
+
+    struct XMMATRIX
+    {
+        XMVECTOR r[4];
+    };
+    typedef const XMMATRIX &FXMMATRIX;
+    typedef const XMMATRIX &CXMMATRIX;
+
+    inline XMVECTOR XMVectorSet(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+    inline XMVECTOR XMVectorAdd(FXMVECTOR a, FXMVECTOR b) { return _mm_add_ps(a, b); }
+    inline XMVECTOR XMVectorSubtract(FXMVECTOR a, FXMVECTOR b) { return _mm_sub_ps(a, b); }
+    inline XMVECTOR XMVectorScale(FXMVECTOR v, float s) { return _mm_mul_ps(v, _mm_set1_ps(s)); }
+    inline float XMVectorGetX(FXMVECTOR v) { return _mm_cvtss_f32(v); }
+
+    inline XMVECTOR XMLoadFloat3(const XMFLOAT3 *source) { return XMVectorSet(source->x, source->y, source->z, 0); }
+    inline void XMStoreFloat3(XMFLOAT3 *dest, FXMVECTOR v)
+    {
+        float f[4];
+        _mm_storeu_ps(f, v);
+        *dest = XMFLOAT3(f[0], f[1], f[2]);
+    }
+    inline XMVECTOR XMLoadFloat4(const XMFLOAT4 *source) { return _mm_loadu_ps(&source->x); }
+    inline void XMStoreFloat4(XMFLOAT4 *dest, FXMVECTOR v) { _mm_storeu_ps(&dest->x, v); }
+
+    inline XMVECTOR XMVector3Length(FXMVECTOR v)
+    {
+        float f[4];
+        _mm_storeu_ps(f, v);
+        return _mm_set1_ps(std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]));
+    }
+    inline XMVECTOR XMVector3Normalize(FXMVECTOR v) { return _mm_div_ps(v, XMVector3Length(v)); }
+    inline XMVECTOR XMPlaneNormalize(FXMVECTOR p) { return _mm_div_ps(p, XMVector3Length(p)); }
+
+    inline XMMATRIX XMMatrixSet(float m00, float m01, float m02, float m03,
+        float m10, float m11, float m12, float m13,
+        float m20, float m21, float m22, float m23,
+        float m30, float m31, float m32, float m33)
+    {
+        XMMATRIX m;
+        m.r[0] = XMVectorSet(m00, m01, m02, m03);
+        m.r[1] = XMVectorSet(m10, m11, m12, m13);
+        m.r[2] = XMVectorSet(m20, m21, m22, m23);
+        m.r[3] = XMVectorSet(m30, m31, m32, m33);
+        return m;
+    }
+    inline XMMATRIX XMMatrixIdentity() { return XMMatrixSet(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1); }
+    inline XMMATRIX XMMatrixScaling(float x, float y, float z)
+    {
+        return XMMatrixSet(x, 0, 0, 0, 0, y, 0, 0, 0, 0, z, 0, 0, 0, 0, 1);
+    }
+    inline XMMATRIX XMMatrixTranslation(float x, float y, float z)
+    {
+        return XMMatrixSet(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1);
+    }
+    inline XMMATRIX XMMatrixTranslationFromVector(FXMVECTOR v)
+    {
+        float f[4];
+        _mm_storeu_ps(f, v);
+        return XMMatrixTranslation(f[0], f[1], f[2]);
+    }
+    inline XMMATRIX XMMatrixRotationY(float angle)
+    {
+        float s = std::sin(angle), c = std::cos(angle);
+        return XMMatrixSet(c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0, 0, 0, 0, 1);
+    }
+
+    inline XMMATRIX XMMatrixTranspose(FXMMATRIX m)
+    {
+        XMMATRIX t = m;
+        _MM_TRANSPOSE4_PS(t.r[0], t.r[1], t.r[2], t.r[3]);
+        return t;
+    }
+
+    inline XMVECTOR XMVector4Transform(FXMVECTOR v, FXMMATRIX m)
+    {
+        float f[4];
+        _mm_storeu_ps(f, v);
+        return _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f[0]), m.r[0]), _mm_mul_ps(_mm_set1_ps(f[1]), m.r[1])),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f[2]), m.r[2]), _mm_mul_ps(_mm_set1_ps(f[3]), m.r[3])));
+    }
+
+    inline XMMATRIX XMMatrixMultiply(FXMMATRIX a, CXMMATRIX b)
+    {
+        XMMATRIX r;
+        for (int i = 0; i < 4; i++)
+            r.r[i] = XMVector4Transform(a.r[i], b);
+        return r;
+    }
+    inline XMMATRIX XMMatrixMultiplyTranspose(FXMMATRIX a, CXMMATRIX b)
+    {
+        return XMMatrixTranspose(XMMatrixMultiply(a, b));
+    }
+
+    inline XMMATRIX XMMatrixPerspectiveFovRH(float fovAngleY, float aspectRatio, float nearZ, float farZ)
+    {
+        float height = 1 / std::tan(fovAngleY / 2);
+        float width = height / aspectRatio;
+        float range = farZ / (nearZ - farZ);
+        return XMMatrixSet(width, 0, 0, 0, 0, height, 0, 0, 0, 0, range, -1, 0, 0, range * nearZ, 0);
+    }
+
+    inline XMMATRIX XMMatrixLookToRH(FXMVECTOR eyePosition, FXMVECTOR eyeDirection, FXMVECTOR upDirection)
+    {
+        float e[4], d[4], u[4];
+        _mm_storeu_ps(e, eyePosition);
+        _mm_storeu_ps(d, XMVector3Normalize(_mm_sub_ps(_mm_setzero_ps(), eyeDirection)));
+        _mm_storeu_ps(u, upDirection);
+        // x = up cross z, y = z cross x
+        float x[3] = { u[1] * d[2] - u[2] * d[1], u[2] * d[0] - u[0] * d[2], u[0] * d[1] - u[1] * d[0] };
+        float length = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+        x[0] /= length, x[1] /= length, x[2] /= length;
+        float y[3] = { d[1] * x[2] - d[2] * x[1], d[2] * x[0] - d[0] * x[2], d[0] * x[1] - d[1] * x[0] };
+        return XMMatrixSet(x[0], y[0], d[0], 0, x[1], y[1], d[1], 0, x[2], y[2], d[2], 0,
+            -(x[0] * e[0] + x[1] * e[1] + x[2] * e[2]),
+            -(y[0] * e[0] + y[1] * e[1] + y[2] * e[2]),
+            -(d[0] * e[0] + d[1] * e[1] + d[2] * e[2]), 1);
+    }
+    inline XMMATRIX XMMatrixLookAtRH(FXMVECTOR eyePosition, FXMVECTOR focusPosition, FXMVECTOR upDirection)
+    {
+        return XMMatrixLookToRH(eyePosition, _mm_sub_ps(focusPosition, eyePosition), upDirection);
+    }
+
+    inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4 *source)
+    {
+        XMMATRIX m;
+        for (int i = 0; i < 4; i++)
+            m.r[i] = _mm_loadu_ps(source->m[i]);
+        return m;
+    }
+    inline void XMStoreFloat4x4(XMFLOAT4X4 *dest, FXMMATRIX m)
+    {
+        for (int i = 0; i < 4; i++)
+            _mm_storeu_ps(dest->m[i], m.r[i]);
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Stands in for the application's precompiled header when the CPU modules
+// are built on Linux for the tests. Only what those modules use from the
+// Windows headers is declared here.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <DirectXMath.h>
+
+typedef unsigned int UINT;
+typedef unsigned char byte;
+
+struct D3D11_VIEWPORT
+{
+    float TopLeftX;
+    float TopLeftY;
+    float Width;
+    float Height;
+    float MinDepth;
+    float MaxDepth;
+};
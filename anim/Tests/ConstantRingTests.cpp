@@ -0,0 +1,105 @@
+#include "pch.h"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "Check.h"
+#include "Common/ConstantRing/ConstantRingAllocator.h"
+#include "Common/ConstantRing/FakeConstantRingDevice.h"
+
+using namespace DX;
+
+namespace
+{
+    // Ring size of the scene renderer
+    const uint32_t RING_SIZE = 64 * 1024;
+
+    // Constant block sizes of one frame of the scene renderer: lights,
+    // general, material, cluster, grid and sky constants
+    const uint32_t FRAME_BLOCKS[] = { 16, 32, 16, 32, 208, 208 };
+
+    // Allocate a frame's blocks filled with the frame number and check that
+    // each reached the device where the allocation says
+    void allocateFrame(ConstantRingAllocator &ring, FakeConstantRingDevice &device, uint32_t frame)
+    {
+        ring.BeginFrame();
+        for (uint32_t size : FRAME_BLOCKS)
+        {
+            std::vector<uint8_t> data(size, (uint8_t)frame);
+            ConstantAllocation allocation = ring.Allocate(data.data(), size);
+            CHECK(allocation.offset % ConstantRingAllocator::ALIGNMENT == 0);
+            CHECK(allocation.byteSize >= size && allocation.byteSize % ConstantRingAllocator::ALIGNMENT == 0);
+            CHECK(std::memcmp(&device.GetData()[allocation.offset], data.data(), size) == 0);
+        }
+        ring.EndFrame();
+        device.AdvanceFrame();
+    }
+
+    // The GPU running behind the CPU never has its constants overwritten,
+    // and a ring of the renderer's size never waits for it
+    void testNoOverwrites(uint32_t latency)
+    {
+        auto device = std::make_shared<FakeConstantRingDevice>(RING_SIZE, latency);
+        ConstantRingAllocator ring(device);
+
+        const uint32_t FRAMES = 2000;
+        uint32_t discards = 0;
+        for (uint32_t frame = 0; frame < FRAMES; frame++)
+        {
+            allocateFrame(ring, *device, frame);
+            CHECK_EQUAL(ring.GetStatistics().waits, 0u);
+            discards += ring.GetStatistics().discards;
+        }
+
+        CHECK_EQUAL(device->GetOverwriteCount(), 0u);
+        CHECK_EQUAL(device->GetBlockingWaitCount(), 0u);
+        CHECK_EQUAL(device->GetWriteCount(), (uint64_t)FRAMES * 6);
+        // Only the first write discards while the GPU keeps up
+        CHECK_EQUAL(discards, 1u);
+    }
+
+    // A ring too small for the frames in flight discards or waits rather
+    // than overwrite
+    void testSmallRing()
+    {
+        // Room for one and a third frames of six blocks
+        auto device = std::make_shared<FakeConstantRingDevice>(8 * 256, 3);
+        ConstantRingAllocator ring(device);
+        uint32_t waits = 0;
+        for (uint32_t frame = 0; frame < 200; frame++)
+        {
+            allocateFrame(ring, *device, frame);
+            waits += ring.GetStatistics().waits;
+        }
+        CHECK_EQUAL(device->GetOverwriteCount(), 0u);
+        CHECK(waits > 0);
+        CHECK_EQUAL(device->GetBlockingWaitCount(), (uint64_t)waits);
+    }
+
+    void testErrors()
+    {
+        auto device = std::make_shared<FakeConstantRingDevice>(4 * 256, 1);
+        ConstantRingAllocator ring(device);
+        uint8_t data[5 * 256] = {};
+        CHECK_THROWS(std::invalid_argument, ring.Allocate(data, 0));
+        CHECK_THROWS(std::length_error, ring.Allocate(data, sizeof(data)));
+
+        // A frame bigger than the ring
+        ring.BeginFrame();
+        for (int i = 0; i < 4; i++)
+            ring.Allocate(data, 256);
+        CHECK_THROWS(std::length_error, ring.Allocate(data, 256));
+    }
+}
+
+int main()
+{
+    testNoOverwrites(1);
+    testNoOverwrites(2);
+    testNoOverwrites(3);
+    testSmallRing();
+    testErrors();
+    return Test::Report();
+}
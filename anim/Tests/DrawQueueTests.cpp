@@ -0,0 +1,148 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Backend/RecordingRenderBackend.h"
+#include "Common/DrawQueue/DrawQueue.h"
+#include "SceneFrame.h"
+
+using namespace DX;
+
+namespace
+{
+    struct Packet
+    {
+        uint64_t key;
+        uint32_t geometry;
+        // Distinct per packet, so the draws recorded tell the order
+        uint32_t instances;
+    };
+
+    // Random packets over a few passes, shaders, materials and geometries,
+    // submitted in one go: the draws come out in stable key order and every
+    // change counter equals the transitions of its field in that order
+    void testChangesMatchTransitions(uint32_t threads, size_t packetCount)
+    {
+        const uint32_t PASSES = 3, SHADERS = 5, MATERIALS = 7, GEOMETRIES = 4;
+        ThreadPool pool(threads);
+        DrawQueue queue(pool);
+
+        uint32_t passCallbacks = 0;
+        for (uint32_t pass = 0; pass < PASSES; pass++)
+            queue.SetPass(pass, [&passCallbacks](RenderBackend &) { passCallbacks++; });
+        for (uint32_t i = 0; i < SHADERS; i++)
+        {
+            DrawShader shader = { FakeObject<ID3D11InputLayout>(10 + i), FakeObject<ID3D11VertexShader>(20 + i),
+                FakeObject<ID3D11PixelShader>(30 + i) };
+            CHECK_EQUAL(queue.AddShader(shader), i);
+        }
+        for (uint32_t i = 0; i < MATERIALS; i++)
+        {
+            DrawMaterial material = {};
+            material.views[0] = FakeObject<ID3D11ShaderResourceView>(40 + i);
+            material.viewCount = 1;
+            CHECK_EQUAL(queue.AddMaterial(material), i);
+        }
+        for (uint32_t i = 0; i < GEOMETRIES; i++)
+        {
+            DrawGeometry geometry = {};
+            geometry.vertexBuffers[0] = FakeObject<ID3D11Buffer>(50 + i);
+            geometry.streamCount = 1;
+            CHECK_EQUAL(queue.AddGeometry(geometry), i);
+        }
+
+        std::mt19937 random(49);
+        std::vector<Packet> packets(packetCount);
+        for (uint32_t i = 0; i < packetCount; i++)
+        {
+            // Few depths, so equal keys are common and stability matters
+            packets[i].key = DrawKey::Make(random() % PASSES, random() % SHADERS, random() % MATERIALS,
+                random() % 3);
+            packets[i].geometry = random() % GEOMETRIES;
+            packets[i].instances = i + 1;
+            DrawArguments arguments = { 36, packets[i].instances, 0, 0, 0 };
+            queue.Add(packets[i].key, packets[i].geometry, arguments);
+        }
+        CHECK_EQUAL(queue.GetPacketCount(), (uint32_t)packetCount);
+
+        std::vector<Packet> sorted = packets;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Packet &a, const Packet &b)
+        {
+            return a.key < b.key;
+        });
+        DrawQueueStatistics expected;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            const Packet *previous = i > 0 ? &sorted[i - 1] : nullptr;
+            // A new pass forgets the state bound before it
+            bool newPass = !previous || DrawKey::GetPass(previous->key) != DrawKey::GetPass(sorted[i].key);
+            expected.passChanges += newPass;
+            expected.shaderChanges += newPass ||
+                DrawKey::GetShader(previous->key) != DrawKey::GetShader(sorted[i].key);
+            expected.materialChanges += newPass ||
+                DrawKey::GetMaterial(previous->key) != DrawKey::GetMaterial(sorted[i].key);
+            expected.geometryChanges += newPass || previous->geometry != sorted[i].geometry;
+        }
+
+        RecordingRenderBackend backend;
+        queue.Submit(backend);
+        const DrawQueueStatistics &statistics = queue.GetStatistics();
+        CHECK_EQUAL(statistics.draws, (uint32_t)packetCount);
+        CHECK_EQUAL(statistics.passChanges, expected.passChanges);
+        CHECK_EQUAL(statistics.shaderChanges, expected.shaderChanges);
+        CHECK_EQUAL(statistics.materialChanges, expected.materialChanges);
+        CHECK_EQUAL(statistics.geometryChanges, expected.geometryChanges);
+        CHECK_EQUAL(statistics.constantBinds, 0u);
+        CHECK_EQUAL(passCallbacks, expected.passChanges);
+        CHECK(statistics.shaderChanges < statistics.draws / 10);
+
+        // The backend saw the binds the statistics count, and the draws in order
+        std::vector<uint32_t> drawn;
+        uint32_t shaderBinds = 0, geometryBinds = 0;
+        for (const RecordingRenderBackend::Call &call : backend.GetCalls())
+        {
+            if (call.type == RenderCall::DrawIndexedInstanced)
+                drawn.push_back(call.count);
+            shaderBinds += call.type == RenderCall::VSSetShader;
+            geometryBinds += call.type == RenderCall::IASetVertexBuffers;
+        }
+        CHECK_EQUAL(shaderBinds, expected.shaderChanges);
+        CHECK_EQUAL(geometryBinds, expected.geometryChanges);
+        bool inOrder = drawn.size() == sorted.size();
+        for (size_t i = 0; inOrder && i < sorted.size(); i++)
+            inOrder = drawn[i] == sorted[i].instances;
+        CHECK(inOrder);
+
+        // Submit drops the packets
+        CHECK_EQUAL(queue.GetPacketCount(), 0u);
+        queue.Submit(backend);
+        CHECK_EQUAL(queue.GetStatistics().draws, 0u);
+    }
+
+    void testErrors()
+    {
+        DrawQueue queue;
+        CHECK_THROWS(std::invalid_argument, queue.SetPass(DrawQueue::MAX_PASSES, [](RenderBackend &) {}));
+
+        // A key naming a shader that was never added
+        DrawGeometry geometry = {};
+        uint32_t geometryId = queue.AddGeometry(geometry);
+        queue.Add(DrawKey::Make(0, 3, 0, 0), geometryId, DrawArguments());
+        RecordingRenderBackend backend;
+        CHECK_THROWS(std::out_of_range, queue.Submit(backend));
+    }
+}
+
+int main()
+{
+    testChangesMatchTransitions(1, 5000);
+    testChangesMatchTransitions(4, 5000);
+    // Past one radix sort chunk
+    testChangesMatchTransitions(4, 70000);
+    testErrors();
+    return Test::Report();
+}
@@ -0,0 +1,105 @@
+#include "pch.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "Check.h"
+#include "Common/RenderTarget/DynamicResolutionController.h"
+
+using namespace DX;
+
+namespace
+{
+    // Depth of the GPU frame timer in the app
+    const uint32_t LATENCY = 4;
+
+    // 60 fps budget with a heavy section early on, in milliseconds
+    void writeTrace(const char *fileName)
+    {
+        std::ofstream file(fileName);
+        for (int frame = 0; frame < 900; frame++)
+            file << (frame >= 200 && frame < 400 ? 26.0f : 12.0f) + (frame % 7) * 0.1f << "\n";
+    }
+
+    // Every decision is based on frames drawn at the current scale: after a
+    // change the measurements still in flight are dropped, not counted again
+    void checkNoStaleDecisions(const DynamicResolutionController::ReplayResult &result)
+    {
+        CHECK_EQUAL(result.staleFrames, LATENCY * result.scaleChanges);
+
+        size_t lastChange = 0;
+        bool changed = false;
+        for (size_t i = 1; i < result.scales.size(); i++)
+            if (result.scales[i] != result.scales[i - 1])
+            {
+                // At least one measurement at the new scale has to arrive first
+                if (changed)
+                    CHECK(i - lastChange > LATENCY);
+                lastChange = i;
+                changed = true;
+            }
+    }
+
+    void testTraceReplay(DynamicResolutionMode mode)
+    {
+        const char *FILE_NAME = "DynamicResolutionTrace.txt";
+        writeTrace(FILE_NAME);
+        std::vector<float> trace = DynamicResolutionController::LoadFrameTimeTrace(FILE_NAME);
+        std::remove(FILE_NAME);
+        CHECK_EQUAL(trace.size(), 900u);
+        CHECK_NEAR(trace[250], 0.0265f, 1e-6);
+
+        DynamicResolutionSettings settings;
+        settings.mode = mode;
+        auto result = DynamicResolutionController::Replay(settings, trace, 0.8f, LATENCY);
+        CHECK_EQUAL(result.scales.size(), trace.size());
+        checkNoStaleDecisions(result);
+
+        // Scales down for the heavy section and back up afterwards
+        CHECK(result.scaleChanges > 0);
+        CHECK_EQUAL(result.scales[150], settings.maxScale);
+        CHECK(result.scales[390] < settings.maxScale);
+        CHECK(result.scales[390] >= settings.minScale);
+        CHECK_EQUAL(result.scales.back(), settings.maxScale);
+
+        // The heavy section settles within budget
+        int overBudget = 0;
+        for (size_t i = 300; i < 400; i++)
+            if (result.frameTimes[i] > settings.targetFrameTime)
+                overBudget++;
+        CHECK_EQUAL(overBudget, 0);
+    }
+
+    // Without latency nothing is ever stale
+    void testImmediateMeasurements()
+    {
+        std::vector<float> trace(300, 0.025f);
+        auto result = DynamicResolutionController::Replay(DynamicResolutionSettings(), trace);
+        CHECK_EQUAL(result.staleFrames, 0u);
+        CHECK(result.scaleChanges > 0);
+    }
+
+    void testBadTraces()
+    {
+        CHECK_THROWS(std::runtime_error, DynamicResolutionController::LoadFrameTimeTrace("MissingTrace.txt"));
+
+        const char *FILE_NAME = "BadTrace.txt";
+        {
+            std::ofstream file(FILE_NAME);
+            file << "16.6\n16.7\nslow\n";
+        }
+        CHECK_THROWS(std::runtime_error, DynamicResolutionController::LoadFrameTimeTrace(FILE_NAME));
+        std::remove(FILE_NAME);
+    }
+}
+
+int main()
+{
+    testTraceReplay(DynamicResolutionMode::Heuristic);
+    testTraceReplay(DynamicResolutionMode::PID);
+    testImmediateMeasurements();
+    testBadTraces();
+    return Test::Report();
+}
@@ -0,0 +1,241 @@
+#include "pch.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Check.h"
+#include "Common/PostProcess/ExposureHistogram.h"
+#include "Common/PostProcess/LuminanceReduction.h"
+
+using namespace DX;
+
+namespace
+{
+    const float NOT_A_NUMBER = std::numeric_limits<float>::quiet_NaN();
+    const float INFINITE = std::numeric_limits<float>::infinity();
+
+    void checkSameResult(const ExposureResult &a, const ExposureResult &b)
+    {
+        CHECK_NEAR(a.averageLogBrightness, b.averageLogBrightness, 1e-5);
+        CHECK_NEAR(a.minLogBrightness, b.minLogBrightness, 1e-5);
+        CHECK_NEAR(a.maxLogBrightness, b.maxLogBrightness, 1e-5);
+    }
+
+    // Ramp of log brightness values with some broken ones mixed in
+    void testBrokenLogBrightness(ThreadPool &pool)
+    {
+        const size_t COUNT = 100000;
+        std::vector<float> values(COUNT), clean(COUNT);
+        for (size_t i = 0; i < COUNT; i++)
+            values[i] = clean[i] = 10.0f * i / COUNT;
+        for (size_t i = 0; i < COUNT; i += 997)
+        {
+            values[i] = i % 3 == 0 ? NOT_A_NUMBER : i % 3 == 1 ? INFINITE : -INFINITE;
+            clean[i] = 0;
+        }
+
+        ExposureHistogram histogram(ExposureHistogramSettings(), pool);
+        ExposureResult broken = histogram.MeasureLogBrightness(values.data(), COUNT, 1);
+        ExposureResult expected = histogram.MeasureLogBrightness(clean.data(), COUNT, 1);
+        checkSameResult(broken, expected);
+
+        // Broken weights drop their samples
+        std::vector<float> weights(COUNT, 1.0f), cleanWeights(COUNT, 1.0f);
+        for (size_t i = 1; i < COUNT; i += 991)
+        {
+            weights[i] = i % 2 == 0 ? NOT_A_NUMBER : INFINITE;
+            cleanWeights[i] = 0;
+        }
+        broken = histogram.MeasureLogBrightness(clean.data(), COUNT, 1, weights.data());
+        expected = histogram.MeasureLogBrightness(clean.data(), COUNT, 1, cleanWeights.data());
+        checkSameResult(broken, expected);
+    }
+
+    // Widths that exercise both the four pixel path and the scalar tail
+    void testBrokenColor(ThreadPool &pool, size_t width)
+    {
+        const size_t HEIGHT = 37;
+        std::vector<float> rgba(width * HEIGHT * 4), clean;
+        for (size_t i = 0; i < width * HEIGHT; i++)
+        {
+            float l = 50.0f * i / (width * HEIGHT);
+            rgba[4 * i + 0] = l;
+            rgba[4 * i + 1] = l * 0.5f;
+            rgba[4 * i + 2] = l * 0.25f;
+            rgba[4 * i + 3] = 1.0f;
+        }
+        clean = rgba;
+        for (size_t i = 0; i < width * HEIGHT; i += 13)
+        {
+            rgba[4 * i + i % 3] = i % 2 == 0 ? NOT_A_NUMBER : -INFINITE;
+            clean[4 * i + 0] = clean[4 * i + 1] = clean[4 * i + 2] = 0;
+        }
+
+        ExposureHistogram histogram(ExposureHistogramSettings(), pool);
+        ExposureResult broken = histogram.MeasureColor(rgba.data(), width, HEIGHT, width * 4);
+        ExposureResult expected = histogram.MeasureColor(clean.data(), width, HEIGHT, width * 4);
+        checkSameResult(broken, expected);
+
+        // Positive infinity is brighter than the range and lands in the last bin
+        std::vector<float> bright(width * HEIGHT * 4, INFINITE);
+        histogram.MeasureColor(bright.data(), width, HEIGHT, width * 4);
+        CHECK_EQUAL(histogram.GetBins()[0] + histogram.GetBins().back(), (double)(width * HEIGHT));
+    }
+
+    void testPercentiles(ThreadPool &pool)
+    {
+        const size_t COUNT = 10000;
+        std::vector<float> values(COUNT);
+        for (size_t i = 0; i < COUNT; i++)
+            values[i] = 12.0f * (i + 0.5f) / COUNT;
+
+        ExposureHistogram histogram(ExposureHistogramSettings(), pool);
+        ExposureResult result = histogram.MeasureLogBrightness(values.data(), COUNT, 1);
+        const float BIN_WIDTH = 12.0f / 128;
+        CHECK_NEAR(result.minLogBrightness, 1.2f, BIN_WIDTH);
+        CHECK_NEAR(result.maxLogBrightness, 11.4f, BIN_WIDTH);
+        CHECK_NEAR(result.averageLogBrightness, 6.3f, BIN_WIDTH);
+    }
+
+    // Tiles without spread, like the sparse samples, measure as weighted
+    // values; a broken moment only loses the spread of its tile
+    void testTilesWithoutSpread(ThreadPool &pool)
+    {
+        const size_t COUNT = 5000;
+        std::vector<float> tiles(COUNT * 4, 0.0f);
+        for (size_t i = 0; i < COUNT; i++)
+        {
+            tiles[4 * i] = 10.0f * ((i * 7919) % COUNT) / COUNT;
+            tiles[4 * i + 1] = (float)(1 + i % 5);
+        }
+
+        ExposureHistogram histogram(ExposureHistogramSettings(), pool);
+        ExposureResult expected = histogram.MeasureLogBrightness(tiles.data(), COUNT, 4, tiles.data() + 1);
+        checkSameResult(histogram.MeasureTiles(tiles.data(), COUNT, 4), expected);
+
+        for (size_t i = 0; i < COUNT; i += 101)
+        {
+            tiles[4 * i + 2] = i % 2 == 0 ? NOT_A_NUMBER : INFINITE;
+            tiles[4 * i + 3] = NOT_A_NUMBER;
+        }
+        checkSameResult(histogram.MeasureTiles(tiles.data(), COUNT, 4), expected);
+
+        // A tile of one background pixel and one highlight splits evenly
+        const float pair[4] = { 2.0f, 2.0f, 1.0f, 0.0f };
+        histogram.MeasureTiles(pair, 1, 4);
+        const std::vector<double> &bins = histogram.GetBins();
+        CHECK_EQUAL(bins[(size_t)(1.0f * 128 / 12)], 1.0);
+        CHECK_EQUAL(bins[(size_t)(3.0f * 128 / 12)], 1.0);
+    }
+
+    // A small very bright region, as scattered glints or as one compact lamp,
+    // is rejected by the high percentile of the tiles as it is per pixel,
+    // while the tile means alone drag the exposure up
+    void testBrightRegionRejected(ThreadPool &pool)
+    {
+        const uint32_t SIZE = 512;
+        const float LAMP = 5000.0f;
+        for (bool glints : { true, false })
+        {
+            // Background gradient, log brightness 0.4 to 1.1
+            std::vector<float> rgba((size_t)SIZE * SIZE * 4, 1.0f);
+            for (uint32_t y = 0; y < SIZE; y++)
+                for (uint32_t x = 0; x < SIZE; x++)
+                {
+                    float *p = rgba.data() + ((size_t)y * SIZE + x) * 4;
+                    float l = 0.5f + 1.5f * x / SIZE;
+                    // Two pixels in every 8x8 tile, or a 24x24 block across tiles
+                    bool lamp = glints ? (x % 8 == 3 && y % 8 == 5) || (x % 8 == 6 && y % 8 == 1) :
+                        x >= 101 && x < 125 && y >= 301 && y < 325;
+                    if (lamp)
+                        l = LAMP;
+                    p[0] = p[1] = p[2] = l;
+                }
+
+            ExposureHistogram histogram(ExposureHistogramSettings(), pool);
+            ExposureResult perPixel = histogram.MeasureColor(rgba.data(), SIZE, SIZE, SIZE * 4);
+
+            LuminanceReduction reduction(64, pool);
+            reduction.Reduce(rgba.data(), SIZE, SIZE, SIZE * 4);
+            const std::vector<float> &tiles = reduction.GetTiles();
+            CHECK_EQUAL(reduction.GetTileSize(), 8u);
+            ExposureResult spread = histogram.MeasureTiles(tiles.data(), tiles.size() / 4, 4);
+            ExposureResult means = histogram.MeasureLogBrightness(tiles.data(), tiles.size() / 4, 4,
+                tiles.data() + 1);
+            const float BIN_WIDTH = 12.0f / 128;
+            // The lamp is far above the cut, which stays on the background
+            CHECK(perPixel.maxLogBrightness < std::log(3.0f) + BIN_WIDTH);
+            CHECK_NEAR(spread.averageLogBrightness, perPixel.averageLogBrightness, BIN_WIDTH / 8);
+            CHECK_NEAR(spread.maxLogBrightness, perPixel.maxLogBrightness, BIN_WIDTH / 8);
+            CHECK_NEAR(spread.minLogBrightness, perPixel.minLogBrightness, BIN_WIDTH / 8);
+            // Glints in every tile raise every tile mean, nothing is left to reject
+            if (glints)
+                CHECK(means.averageLogBrightness > perPixel.averageLogBrightness + 2 * BIN_WIDTH);
+        }
+    }
+
+    // Nested calls keep the participant of the task that made them, so per
+    // participant state is never shared between threads
+    void testNestedParticipants()
+    {
+        ThreadPool pool(4);
+        const size_t OUTER = 64;
+        std::vector<unsigned> owner(pool.GetConcurrency(), 0);
+        std::vector<uint64_t> counts(pool.GetConcurrency(), 0);
+        std::atomic<int> mismatches(0);
+
+        pool.ParallelFor(OUTER, [&](size_t, unsigned participant)
+        {
+            pool.ParallelFor(100, [&](size_t, unsigned nested)
+            {
+                if (nested != participant)
+                    mismatches++;
+                counts[nested]++;
+            });
+        });
+        CHECK_EQUAL(mismatches.load(), 0);
+
+        uint64_t total = 0;
+        for (uint64_t count : counts)
+            total += count;
+        CHECK_EQUAL(total, OUTER * 100);
+
+        // Histograms measured from inside pool tasks match a serial measurement
+        const size_t COUNT = 50000;
+        std::vector<float> values(COUNT);
+        for (size_t i = 0; i < COUNT; i++)
+            values[i] = 8.0f * ((i * 7919) % COUNT) / COUNT;
+
+        ThreadPool serial(1);
+        ExposureHistogram reference(ExposureHistogramSettings(), serial);
+        ExposureResult expected = reference.MeasureLogBrightness(values.data(), COUNT, 1);
+
+        std::vector<ExposureResult> results(8);
+        pool.ParallelFor(results.size(), [&](size_t task, unsigned)
+        {
+            ExposureHistogram histogram(ExposureHistogramSettings(), pool);
+            results[task] = histogram.MeasureLogBrightness(values.data(), COUNT, 1);
+        });
+        for (const ExposureResult &result : results)
+            checkSameResult(result, expected);
+    }
+}
+
+int main()
+{
+    ThreadPool serial(1);
+    ThreadPool parallel(4);
+    for (ThreadPool *pool : { &serial, &parallel })
+    {
+        testBrokenLogBrightness(*pool);
+        testBrokenColor(*pool, 64);
+        testBrokenColor(*pool, 67);
+        testPercentiles(*pool);
+        testTilesWithoutSpread(*pool);
+        testBrightRegionRejected(*pool);
+    }
+    testNestedParticipants();
+    return Test::Report();
+}
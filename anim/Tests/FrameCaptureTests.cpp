@@ -0,0 +1,307 @@
+#include "pch.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Capture/FrameCapture.h"
+#include "Common/Readback/FakeReadbackDevice.h"
+#include "PNGDecoder.h"
+
+using namespace DX;
+
+namespace
+{
+    const uint32_t WIDTH = 8;
+    const uint32_t HEIGHT = 4;
+
+    // What the fake device copies: one tightly packed RGBA8 texture
+    struct Image
+    {
+        std::array<uint8_t, WIDTH * HEIGHT * 4> pixels;
+    };
+
+    typedef FakeReadbackDevice<Image> Device;
+    typedef FrameCapture<Image> Capture;
+
+    // Pixels that tell frames and positions apart
+    Image makeImage(uint64_t frame)
+    {
+        Image image;
+        for (uint32_t i = 0; i < WIDTH * HEIGHT; i++)
+        {
+            image.pixels[i * 4] = (uint8_t)frame;
+            image.pixels[i * 4 + 1] = (uint8_t)(i * 7);
+            image.pixels[i * 4 + 2] = (uint8_t)(frame >> 8);
+            image.pixels[i * 4 + 3] = 255;
+        }
+        return image;
+    }
+
+    // Keeps the files in memory. Writes can be held at a gate, and files
+    // of the frames in failFrames throw instead of being stored.
+    class MemorySink : public CaptureSink
+    {
+    public:
+        void Write(const std::string &fileName, const std::vector<uint8_t> &data) override
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_waiting++;
+            m_changed.notify_all();
+            m_changed.wait(lock, [this]() { return m_open; });
+            m_waiting--;
+            if (m_delay.count() > 0)
+            {
+                lock.unlock();
+                std::this_thread::sleep_for(m_delay);
+                lock.lock();
+            }
+
+            for (const std::string &failing : failFrames)
+                if (fileName.find(failing) != std::string::npos)
+                    throw std::runtime_error("MemorySink: refused " + fileName);
+            if (!files.emplace(fileName, data).second)
+                throw std::logic_error("MemorySink: written twice " + fileName);
+        }
+
+        void SetOpen(bool open)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open = open;
+            m_changed.notify_all();
+        }
+
+        void SetDelay(std::chrono::milliseconds delay) { m_delay = delay; }
+
+        // Wait until count writers are held at the closed gate
+        void WaitForWaiting(unsigned count)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this, count]() { return m_waiting >= count; });
+        }
+
+        size_t GetFileCount() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return files.size();
+        }
+
+        std::vector<std::string> failFrames;
+        std::map<std::string, std::vector<uint8_t>> files;
+
+    private:
+        mutable std::mutex m_mutex;
+        std::condition_variable m_changed;
+        bool m_open = true;
+        unsigned m_waiting = 0;
+        std::chrono::milliseconds m_delay{ 0 };
+    };
+
+    std::string fileName(uint64_t frame)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "scene_%06llu.png", (unsigned long long)frame);
+        return name;
+    }
+
+    // The render loop of AnimMain with capturing on: capture, poll, and the
+    // GPU moves on by a frame
+    void runFrames(Capture &capture, Device &device, uint64_t first, uint64_t count)
+    {
+        for (uint64_t frame = first; frame < first + count; frame++)
+        {
+            capture.Capture(makeImage(frame), frame, WIDTH, HEIGHT);
+            capture.Poll();
+            device.AdvanceFrame();
+        }
+    }
+
+    // With a slot per frame in flight every frame is written, named after
+    // its frame number and decodes to the captured pixels
+    void testWritesEveryFrame()
+    {
+        auto device = std::make_shared<Device>(2);
+        auto sink = std::make_shared<MemorySink>();
+        Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink);
+
+        const uint64_t FRAMES = 100;
+        runFrames(capture, *device, 0, FRAMES);
+        capture.Flush();
+
+        Capture::Statistics statistics = capture.GetStatistics();
+        CHECK_EQUAL(statistics.requested, FRAMES);
+        CHECK_EQUAL(statistics.dropped, 0u);
+        CHECK_EQUAL(statistics.failed, 0u);
+        CHECK_EQUAL(statistics.requested, statistics.written + statistics.dropped + statistics.failed);
+        CHECK_EQUAL(statistics.pendingBytes, 0u);
+        CHECK_EQUAL(statistics.frames, FRAMES);
+        CHECK_EQUAL(device->GetOverwriteCount(), 0u);
+        // Only the last frame, not yet done on the GPU at Flush, waited
+        CHECK_EQUAL(device->GetBlockingWaitCount(), 1u);
+        CHECK_EQUAL(sink->GetFileCount(), (size_t)FRAMES);
+
+        uint64_t bytes = 0;
+        for (uint64_t frame = 0; frame < FRAMES; frame++)
+        {
+            auto file = sink->files.find(fileName(frame));
+            if (!CHECK(file != sink->files.end()))
+                continue;
+            bytes += file->second.size();
+            uint32_t width = 0, height = 0;
+            std::vector<uint8_t> rgb = Test::DecodePNG(file->second, width, height);
+            CHECK(width == WIDTH && height == HEIGHT);
+            Image image = makeImage(frame);
+            for (uint32_t i = 0; i < WIDTH * HEIGHT && i * 3 + 2 < rgb.size(); i++)
+                CHECK(rgb[i * 3] == image.pixels[i * 4] && rgb[i * 3 + 1] == image.pixels[i * 4 + 1] &&
+                    rgb[i * 3 + 2] == image.pixels[i * 4 + 2]);
+        }
+        CHECK_EQUAL(statistics.bytesWritten, bytes);
+
+        // A capture of part of the texture, with a frame number past six digits
+        capture.Capture(makeImage(1234567), 1234567, 5, 3);
+        capture.Flush();
+        auto partial = sink->files.find("scene_1234567.png");
+        if (CHECK(partial != sink->files.end()))
+        {
+            uint32_t width = 0, height = 0;
+            Test::DecodePNG(partial->second, width, height);
+            CHECK(width == 5 && height == 3);
+        }
+    }
+
+    // A GPU further behind than there are slots drops captures instead of
+    // overwriting copies in flight, and every request is accounted for
+    void testDropsWhenSlotsBusy()
+    {
+        auto device = std::make_shared<Device>(4);
+        auto sink = std::make_shared<MemorySink>();
+        FrameCaptureSettings settings;
+        settings.slotCount = 2;
+        Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink, settings);
+
+        runFrames(capture, *device, 0, 60);
+        capture.Flush();
+
+        Capture::Statistics statistics = capture.GetStatistics();
+        CHECK(statistics.dropped > 0 && statistics.written > 0);
+        CHECK_EQUAL(statistics.requested, statistics.written + statistics.dropped + statistics.failed);
+        CHECK_EQUAL(device->GetOverwriteCount(), 0u);
+        CHECK_EQUAL(sink->GetFileCount(), (size_t)statistics.written);
+    }
+
+    // A sink that throws fails those files only
+    void testSinkFailure()
+    {
+        auto device = std::make_shared<Device>(1);
+        auto sink = std::make_shared<MemorySink>();
+        sink->failFrames = { "_000003.", "_000010.", "_000011." };
+        Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink);
+        CHECK(capture.GetLastError().empty());
+
+        runFrames(capture, *device, 0, 20);
+        capture.Flush();
+
+        Capture::Statistics statistics = capture.GetStatistics();
+        CHECK_EQUAL(statistics.failed, 3u);
+        CHECK_EQUAL(statistics.written, 17u);
+        CHECK_EQUAL(statistics.requested, statistics.written + statistics.dropped + statistics.failed);
+        CHECK(capture.GetLastError().find("MemorySink: refused scene_0000") != std::string::npos);
+        CHECK(sink->files.count(fileName(3)) == 0 && sink->files.count(fileName(4)) == 1);
+    }
+
+    // While the encoders are blocked the read back frames stay within the
+    // budget: finished copies wait in their slots and polls count stalls
+    void testBudgetStalls()
+    {
+        auto device = std::make_shared<Device>(1);
+        auto sink = std::make_shared<MemorySink>();
+        FrameCaptureSettings settings;
+        settings.slotCount = 4;
+        settings.workerCount = 2;
+        settings.maxPendingBytes = 2 * sizeof(Image);
+        Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink, settings);
+
+        sink->SetOpen(false);
+        runFrames(capture, *device, 0, 3);
+        // Both workers hold a frame, the budget is used up
+        sink->WaitForWaiting(2);
+        uint64_t stalls = capture.GetStatistics().budgetStalls;
+        runFrames(capture, *device, 3, 10);
+
+        Capture::Statistics statistics = capture.GetStatistics();
+        CHECK(statistics.budgetStalls >= stalls + 10);
+        CHECK_EQUAL(statistics.pendingBytes, settings.maxPendingBytes);
+        CHECK(statistics.dropped > 0);
+        CHECK_EQUAL(statistics.written, 0u);
+        CHECK_EQUAL(device->GetOverwriteCount(), 0u);
+
+        sink->SetOpen(true);
+        capture.Flush();
+        statistics = capture.GetStatistics();
+        CHECK(statistics.peakPendingBytes <= settings.maxPendingBytes);
+        CHECK_EQUAL(statistics.peakPendingBytes, settings.maxPendingBytes);
+        CHECK_EQUAL(statistics.pendingBytes, 0u);
+        CHECK_EQUAL(statistics.requested, 13u);
+        CHECK_EQUAL(statistics.requested, statistics.written + statistics.dropped + statistics.failed);
+        CHECK_EQUAL(sink->GetFileCount(), (size_t)statistics.written);
+    }
+
+    // Frames handed to the encoders are still written when the capture is
+    // destroyed, before the workers exit
+    void testShutdownDrain()
+    {
+        auto device = std::make_shared<Device>(0);
+        auto sink = std::make_shared<MemorySink>();
+        sink->SetDelay(std::chrono::milliseconds(5));
+        FrameCaptureSettings settings;
+        settings.slotCount = 2;
+        settings.workerCount = 1;
+        {
+            Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink, settings);
+            runFrames(capture, *device, 0, 8);
+            CHECK_EQUAL(capture.GetStatistics().dropped, 0u);
+            CHECK(capture.GetStatistics().written < 8);
+        }
+        CHECK_EQUAL(sink->GetFileCount(), 8u);
+        CHECK(sink->files.count(fileName(7)) == 1);
+    }
+
+    void testErrors()
+    {
+        auto device = std::make_shared<Device>(1);
+        auto sink = std::make_shared<MemorySink>();
+        CHECK_THROWS(std::invalid_argument,
+            Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA32Float, "scene", sink));
+        CHECK_THROWS(std::invalid_argument,
+            Capture capture(device, WIDTH + 1, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink));
+        FrameCaptureSettings settings;
+        settings.maxPendingBytes = sizeof(Image) - 1;
+        CHECK_THROWS(std::invalid_argument,
+            Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink, settings));
+
+        Capture capture(device, WIDTH, HEIGHT, CapturePixelFormat::RGBA8Unorm, "scene", sink);
+        CHECK_THROWS(std::invalid_argument, capture.Capture(makeImage(0), 0, WIDTH + 1, HEIGHT));
+        CHECK_THROWS(std::invalid_argument, capture.Capture(makeImage(0), 0, 0, HEIGHT));
+        capture.Flush();
+        CHECK_EQUAL(capture.GetStatistics().requested, 0u);
+    }
+}
+
+int main()
+{
+    testWritesEveryFrame();
+    testDropsWhenSlotsBusy();
+    testSinkFailure();
+    testBudgetStalls();
+    testShutdownDrain();
+    testErrors();
+    return Test::Report();
+}
@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Culling/FrustumCuller.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    // The camera of the scene renderer, moved off the axes so no plane is
+    // axis aligned
+    XMMATRIX viewProjection()
+    {
+        XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(3, 2, 8, 0), XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 1, 0, 0));
+        return XMMatrixMultiply(view, XMMatrixPerspectiveFovRH(70.0f * 3.14159265f / 180, 16.0f / 9, 0.01f, 100.0f));
+    }
+
+    // Spheres scattered around the frustum, about a fifth of them visible
+    void randomSpheres(size_t count, std::mt19937 &random, BoundingSphereSet &spheres)
+    {
+        std::uniform_real_distribution<float> position(-60.0f, 60.0f), radius(0.0f, 5.0f);
+        spheres.Resize(count);
+        for (size_t i = 0; i < count; i++)
+            spheres.Set(i, position(random), position(random), position(random), radius(random));
+    }
+
+    // Lowest signed distance from the sphere's surface to a plane, what
+    // IsSphereVisible compares with 0
+    float nearestPlaneDistance(const Frustum &frustum, float x, float y, float z, float radius)
+    {
+        float nearest = 1e30f;
+        for (const XMFLOAT4 &plane : frustum.planes)
+            nearest = (std::min)(nearest, plane.x * x + plane.y * y + plane.z * z + plane.w + radius);
+        return nearest;
+    }
+
+    // The culler agrees with IsSphereVisible on every sphere, up to the
+    // rounding of its different summation order, and does not depend on
+    // the thread count. The sizes end mid-group and mid-chunk.
+    void testMatchesScalar()
+    {
+        std::mt19937 random(43);
+        Frustum frustum = ExtractFrustum(viewProjection());
+        ThreadPool serial(1);
+        FrustumCuller serialCuller(serial), poolCuller(ThreadPool::Default());
+
+        const size_t CHUNK = FrustumCuller::CHUNK_SIZE;
+        for (size_t count : { (size_t)0, (size_t)1, (size_t)7, (size_t)8, (size_t)13, CHUNK - 3, CHUNK,
+            CHUNK + 5, 3 * CHUNK + 11, (size_t)100003 })
+        {
+            BoundingSphereSet spheres;
+            randomSpheres(count, random, spheres);
+            std::vector<uint32_t> visible = serialCuller.Cull(spheres, frustum);
+            CHECK(poolCuller.Cull(spheres, frustum) == visible);
+            CHECK(std::is_sorted(visible.begin(), visible.end()));
+            CHECK(std::adjacent_find(visible.begin(), visible.end()) == visible.end());
+            CHECK(visible.empty() || visible.back() < count);
+
+            size_t expected = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                float x = spheres.GetX()[i], y = spheres.GetY()[i], z = spheres.GetZ()[i];
+                float radius = spheres.GetRadius()[i];
+                bool reference = IsSphereVisible(frustum, x, y, z, radius);
+                bool culled = std::binary_search(visible.begin(), visible.end(), (uint32_t)i);
+                if (reference != culled)
+                    CHECK(std::fabs(nearestPlaneDistance(frustum, x, y, z, radius)) < 1e-4f);
+                expected += reference;
+            }
+            CHECK_NEAR(visible.size(), expected, 2);
+            // Both outcomes are common
+            if (count > 1000)
+                CHECK(visible.size() > count / 20 && visible.size() < count / 2);
+        }
+    }
+
+    // Culling the same set again reuses the chunk lists without leaving
+    // survivors of the larger set behind
+    void testReuse()
+    {
+        std::mt19937 random(44);
+        Frustum frustum = ExtractFrustum(viewProjection());
+        FrustumCuller culler;
+        BoundingSphereSet large, small;
+        randomSpheres(3 * FrustumCuller::CHUNK_SIZE, random, large);
+        randomSpheres(100, random, small);
+        culler.Cull(large, frustum);
+        std::vector<uint32_t> visible = culler.Cull(small, frustum);
+        CHECK(visible == FrustumCuller(ThreadPool::Default()).Cull(small, frustum));
+        CHECK(visible.empty() || visible.back() < 100);
+    }
+
+    // A point is inside every plane exactly when its clip position is in
+    // -w <= x, y <= w, 0 <= z <= w, and the planes are unit length
+    void testExtractFrustum()
+    {
+        XMMATRIX m = viewProjection();
+        Frustum frustum = ExtractFrustum(m);
+        for (const XMFLOAT4 &plane : frustum.planes)
+            CHECK_NEAR(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z, 1.0f, 1e-5f);
+
+        // The clip position in double, z - w is tiny near the far plane
+        XMFLOAT4X4 matrix;
+        XMStoreFloat4x4(&matrix, m);
+        std::mt19937 random(45);
+        std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+        int inside = 0, compared = 0;
+        for (int sample = 0; sample < 100000; sample++)
+        {
+            float x = position(random), y = position(random), z = position(random);
+            // Points too near a plane to tell apart in float are skipped
+            if (std::fabs(nearestPlaneDistance(frustum, x, y, z, 0)) < 1e-3f)
+                continue;
+            double clip[4];
+            for (int c = 0; c < 4; c++)
+                clip[c] = x * (double)matrix.m[0][c] + y * (double)matrix.m[1][c] + z * (double)matrix.m[2][c] +
+                    matrix.m[3][c];
+            bool clipInside = std::fabs(clip[0]) <= clip[3] && std::fabs(clip[1]) <= clip[3] &&
+                clip[2] >= 0 && clip[2] <= clip[3];
+            CHECK_EQUAL(IsSphereVisible(frustum, x, y, z, 0), clipInside);
+            inside += clipInside;
+            compared++;
+        }
+        CHECK(compared > 99000 && inside > 1000);
+    }
+}
+
+int main()
+{
+    testMatchesScalar();
+    testReuse();
+    testExtractFrustum();
+    return Test::Report();
+}
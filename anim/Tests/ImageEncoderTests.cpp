@@ -0,0 +1,136 @@
+#include "pch.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Capture/ImageEncoder.h"
+#include "PNGDecoder.h"
+
+using namespace DX;
+
+namespace
+{
+    // Images with flat areas, gradients and noise so every filter and
+    // back references show up; rows are padded past the captured width
+    void testPNGRoundTrip(bool bgra, uint32_t width, uint32_t height)
+    {
+        const uint32_t FULL_WIDTH = width + 7;
+        size_t rowPitch = FULL_WIDTH * 4 + 12;
+        std::vector<uint8_t> pixels(rowPitch * (height + 3));
+        uint32_t state = 7;
+        for (uint32_t y = 0; y < height + 3; y++)
+            for (uint32_t x = 0; x < FULL_WIDTH; x++)
+            {
+                uint8_t *p = &pixels[y * rowPitch + 4 * x];
+                state = state * 1103515245u + 12345u;
+                p[0] = (uint8_t)(x < width / 3 ? 40 : x * 255 / FULL_WIDTH);
+                p[1] = (uint8_t)(y * 255 / (height + 3));
+                p[2] = (uint8_t)(y > height / 2 ? state >> 24 : 200);
+                p[3] = (uint8_t)(state >> 16);
+            }
+
+        std::vector<uint8_t> png = ImageEncoder::EncodePNG(pixels.data(), bgra, width, height, rowPitch);
+        uint32_t decodedWidth = 0, decodedHeight = 0;
+        std::vector<uint8_t> rgb = Test::DecodePNG(png, decodedWidth, decodedHeight);
+        CHECK_EQUAL(decodedWidth, width);
+        CHECK_EQUAL(decodedHeight, height);
+
+        size_t mismatches = 0;
+        for (uint32_t y = 0; y < height; y++)
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const uint8_t *p = &pixels[y * rowPitch + 4 * x];
+                const uint8_t *d = &rgb[((size_t)y * width + x) * 3];
+                uint8_t r = bgra ? p[2] : p[0], b = bgra ? p[0] : p[2];
+                if (d[0] != r || d[1] != p[1] || d[2] != b)
+                    mismatches++;
+            }
+        CHECK_EQUAL(mismatches, 0u);
+
+        // Encode picks the PNG encoder from the pixel format
+        std::vector<uint8_t> viaFormat = ImageEncoder::Encode(pixels.data(),
+            bgra ? CapturePixelFormat::BGRA8Unorm : CapturePixelFormat::RGBA8Unorm, width, height, rowPitch);
+        CHECK(viaFormat == png);
+    }
+
+    void testPFMRoundTrip(uint32_t width, uint32_t height)
+    {
+        size_t rowPitch = (width + 3) * 4;
+        std::vector<float> rgba(rowPitch * height);
+        for (size_t i = 0; i < rgba.size(); i++)
+            rgba[i] = (float)((i * 2654435761u) % 100000) / 997.0f - 3.0f;
+
+        std::vector<uint8_t> pfm = ImageEncoder::EncodePFM(rgba.data(), width, height, rowPitch);
+        std::string expectedHeader = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+        CHECK(pfm.size() == expectedHeader.size() + (size_t)width * height * 12);
+        CHECK(std::string(pfm.begin(), pfm.begin() + expectedHeader.size()) == expectedHeader);
+
+        // Little endian floats, bottom row first, bit exact
+        const uint8_t *data = pfm.data() + expectedHeader.size();
+        size_t mismatches = 0;
+        for (uint32_t y = 0; y < height; y++)
+            for (uint32_t x = 0; x < width; x++)
+                for (int c = 0; c < 3; c++)
+                {
+                    const uint8_t *p = data + (((size_t)(height - 1 - y) * width + x) * 3 + c) * 4;
+                    uint32_t bits = (uint32_t)p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+                    float value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    if (value != rgba[y * rowPitch + 4 * x + c])
+                        mismatches++;
+                }
+        CHECK_EQUAL(mismatches, 0u);
+
+        std::vector<uint8_t> viaFormat = ImageEncoder::Encode(rgba.data(), CapturePixelFormat::RGBA32Float,
+            width, height, rowPitch * sizeof(float));
+        CHECK(viaFormat == pfm);
+    }
+
+    void testChecksums()
+    {
+        const char *check = "123456789";
+        CHECK_EQUAL(ImageEncoder::Crc32((const uint8_t *)check, 9), 0xcbf43926u);
+        const char *wikipedia = "Wikipedia";
+        CHECK_EQUAL(ImageEncoder::Adler32((const uint8_t *)wikipedia, 9), 0x11e60398u);
+    }
+
+    void testDeflate()
+    {
+        // Empty, incompressible and highly repetitive input
+        std::vector<uint8_t> inputs[3];
+        inputs[1].resize(70000);
+        uint32_t state = 3;
+        for (auto &byte : inputs[1])
+        {
+            state = state * 1664525u + 1013904223u;
+            byte = (uint8_t)(state >> 24);
+        }
+        inputs[2].assign(100000, 'a');
+        for (size_t i = 0; i < inputs[2].size(); i += 37)
+            inputs[2][i] = 'b';
+
+        for (const auto &input : inputs)
+        {
+            std::vector<uint8_t> compressed = ImageEncoder::Deflate(input.data(), input.size());
+            CHECK(Test::Inflater(compressed.data(), compressed.size()).Run() == input);
+        }
+        std::vector<uint8_t> repetitive = ImageEncoder::Deflate(inputs[2].data(), inputs[2].size());
+        CHECK(repetitive.size() < inputs[2].size() / 20);
+    }
+}
+
+int main()
+{
+    testChecksums();
+    testDeflate();
+    testPNGRoundTrip(true, 320, 200);
+    testPNGRoundTrip(false, 1, 1);
+    testPNGRoundTrip(false, 97, 41);
+    testPFMRoundTrip(320, 200);
+    testPFMRoundTrip(1, 1);
+    return Test::Report();
+}
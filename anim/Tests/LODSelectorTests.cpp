@@ -0,0 +1,127 @@
+#include "pch.h"
+
+#include <cmath>
+#include <vector>
+
+#include "CameraPaths.h"
+#include "Check.h"
+#include "Content/LODSelector.h"
+#include "Content/SphereGrid.h"
+#include "Content/SphereLODChain.h"
+
+using namespace DirectX;
+
+namespace
+{
+    const float THRESHOLD = 1.0f;
+    const float HYSTERESIS = 0.75f;
+
+    // The scene's grid and chain
+    struct Scene
+    {
+        anim::SphereGrid grid = anim::SphereGrid(10, 5);
+        anim::SphereLODChain lods = anim::SphereLODChain({ 8, 16, 32, 64 }, 0.25f);
+    };
+
+    // Error of a level in pixels as seen from camera, at the nearest point
+    // of the instance's surface; negative if the camera is inside it
+    float projectedError(const anim::SphereLODChain &lods, const anim::SphereInstance &instance,
+        uint32_t level, const XMFLOAT3 &camera)
+    {
+        float dx = instance.model._41 - camera.x;
+        float dy = instance.model._42 - camera.y;
+        float dz = instance.model._43 - camera.z;
+        float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - lods.GetRadius();
+        if (distance <= 0)
+            return -1;
+        return lods.GetLevel(level).geometricError * CameraPaths::PIXELS_PER_UNIT / distance;
+    }
+
+    // Fly a path: every instance stays within the threshold, and no level is
+    // finer than the hysteresis allows. Returns the triangles drawn.
+    uint64_t flyPath(const std::vector<XMFLOAT3> &path)
+    {
+        Scene scene;
+        anim::LODSelector selector(THRESHOLD, HYSTERESIS);
+        const auto &instances = scene.grid.GetInstances();
+        uint32_t finest = scene.lods.GetLevelCount() - 1;
+
+        uint64_t triangles = 0;
+        for (const XMFLOAT3 &camera : path)
+        {
+            const auto &levels = selector.Select(scene.lods, instances, camera, CameraPaths::PIXELS_PER_UNIT);
+            for (size_t i = 0; i < instances.size(); i++)
+            {
+                float error = projectedError(scene.lods, instances[i], levels[i], camera);
+                if (error < 0)
+                {
+                    CHECK_EQUAL(levels[i], finest);
+                    continue;
+                }
+                if (levels[i] != finest)
+                    CHECK(error <= THRESHOLD * 1.0001f);
+                if (levels[i] > 0)
+                    CHECK(projectedError(scene.lods, instances[i], levels[i] - 1, camera) > THRESHOLD * HYSTERESIS);
+            }
+            triangles += selector.GetTriangleCount(scene.lods);
+        }
+        return triangles;
+    }
+
+    // Triangles of the previous fixed 16-segment mesh over a path
+    uint64_t fixedTriangles(size_t frames)
+    {
+        Scene scene;
+        return frames * scene.grid.GetInstanceCount() * (scene.lods.GetLevel(1).indexCount / 3);
+    }
+
+    void testPaths()
+    {
+        const int FRAMES = 500;
+        // Far away most spheres take the coarse levels
+        CHECK(flyPath(CameraPaths::Dolly(FRAMES)) < fixedTriangles(FRAMES));
+        flyPath(CameraPaths::Orbit(FRAMES));
+        // Close up the fixed mesh was too coarse, more is right there
+        CHECK(flyPath(CameraPaths::Strafe(FRAMES)) > fixedTriangles(FRAMES));
+    }
+
+    // A camera shaking around the distance where level 1 switches to level 2
+    uint32_t jitterSwitches(float hysteresis)
+    {
+        anim::SphereLODChain lods({ 8, 16, 32, 64 }, 0.25f);
+        std::vector<anim::SphereInstance> instances(1);
+        XMStoreFloat4x4(&instances[0].model, XMMatrixIdentity());
+
+        float switchDistance = lods.GetLevel(1).geometricError * CameraPaths::PIXELS_PER_UNIT / THRESHOLD + lods.GetRadius();
+        anim::LODSelector selector(THRESHOLD, hysteresis);
+        uint32_t switches = 0, previous = ~0u;
+        for (const XMFLOAT3 &camera : CameraPaths::Jitter(200, XMFLOAT3(0, 0, switchDistance), 0.01f * switchDistance))
+        {
+            uint32_t level = selector.Select(lods, instances, camera, CameraPaths::PIXELS_PER_UNIT)[0];
+            if (previous != ~0u && level != previous)
+                switches++;
+            previous = level;
+        }
+        return switches;
+    }
+
+    void testHysteresis()
+    {
+        CHECK(jitterSwitches(1.0f) >= 190);
+        CHECK(jitterSwitches(HYSTERESIS) <= 1);
+    }
+
+    void testInvalidChain()
+    {
+        CHECK_THROWS(std::invalid_argument, anim::SphereLODChain({ 2, 8 }, 1.0f));
+        CHECK_THROWS(std::invalid_argument, anim::SphereLODChain({ 16, 8 }, 1.0f));
+    }
+}
+
+int main()
+{
+    testPaths();
+    testHysteresis();
+    testInvalidChain();
+    return Test::Report();
+}
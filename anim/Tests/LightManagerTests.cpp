@@ -0,0 +1,246 @@
+#include "pch.h"
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Backend/RecordingRenderBackend.h"
+#include "Common/Lighting/LightManager.h"
+#include "SceneFrame.h"
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    // Recording backend that applies the range updates of one buffer to a
+    // copy of its contents, as the GPU would see them
+    class MirrorBackend : public RecordingRenderBackend
+    {
+    public:
+        MirrorBackend(ID3D11Buffer *buffer, uint32_t capacity) :
+            m_buffer(buffer),
+            mirror(capacity)
+        {
+        }
+
+        void UpdateBufferRange(ID3D11Buffer *buffer, uint32_t byteOffset, const void *data,
+            uint32_t byteSize) override
+        {
+            CHECK(buffer == m_buffer);
+            CHECK(byteOffset % sizeof(GpuPointLight) == 0 && byteSize % sizeof(GpuPointLight) == 0);
+            if (CHECK(byteOffset + byteSize <= mirror.size() * sizeof(GpuPointLight)))
+                std::memcpy((uint8_t *)mirror.data() + byteOffset, data, byteSize);
+            RecordingRenderBackend::UpdateBufferRange(buffer, byteOffset, data, byteSize);
+        }
+
+        // A recreated buffer starts out with garbage
+        void Scramble()
+        {
+            std::memset(mirror.data(), 0xcd, mirror.size() * sizeof(GpuPointLight));
+        }
+
+        std::vector<GpuPointLight> mirror;
+
+    private:
+        ID3D11Buffer *m_buffer;
+    };
+
+    bool sameLights(const std::vector<GpuPointLight> &lights, const std::vector<GpuPointLight> &mirror)
+    {
+        return lights.size() <= mirror.size() &&
+            std::memcmp(lights.data(), mirror.data(), lights.size() * sizeof(GpuPointLight)) == 0;
+    }
+
+    // Random adds, removes and changes, uploaded every frame: the buffer
+    // always holds what GetLights reports, and the statistics add up to
+    // the calls the backend received
+    void testMirror()
+    {
+        const uint32_t CAPACITY = 300;
+        LightManager lights(CAPACITY, 0.01f);
+        ID3D11Buffer *buffer = FakeObject<ID3D11Buffer>(1);
+        MirrorBackend backend(buffer, CAPACITY);
+        backend.Scramble();
+
+        std::mt19937 random(48);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<LightHandle> live, removed;
+        std::vector<GpuPointLight> expected;
+        uint64_t totalBytes = 0;
+        for (int frame = 0; frame < 3000; frame++)
+        {
+            // Bursts of adding and of removing, so the count sweeps the capacity
+            bool growing = (frame / 200) % 2 == 0;
+            int operations = random() % 12;
+            for (int op = 0; op < operations; op++)
+            {
+                uint32_t kind = random() % 10;
+                if (kind < 3 && live.size() < CAPACITY && (growing || kind == 0))
+                    live.push_back(lights.Add(XMFLOAT3(unit(random), unit(random), unit(random)),
+                        XMFLOAT3(unit(random), unit(random), unit(random)), unit(random) * 10));
+                else if (kind < 5 && !live.empty() && (!growing || kind == 3))
+                {
+                    size_t i = random() % live.size();
+                    lights.Remove(live[i]);
+                    removed.push_back(live[i]);
+                    live[i] = live.back();
+                    live.pop_back();
+                }
+                else if (!live.empty())
+                {
+                    LightHandle light = live[random() % live.size()];
+                    if (kind == 5)
+                        lights.SetPosition(light, XMFLOAT3(unit(random), unit(random), unit(random)));
+                    else if (kind == 6)
+                        lights.SetColor(light, XMFLOAT3(unit(random), unit(random), unit(random)));
+                    else
+                        lights.SetIntensity(light, unit(random) * 10);
+                }
+            }
+            if (frame % 500 == 250)
+            {
+                backend.Scramble();
+                lights.InvalidateBuffer();
+            }
+
+            size_t callsBefore = backend.GetCalls().size();
+            lights.Upload(backend, buffer);
+            lights.GetLights(expected);
+            CHECK_EQUAL(lights.GetCount(), (uint32_t)live.size());
+            CHECK(sameLights(expected, backend.mirror));
+
+            const LightUploadStatistics &statistics = lights.GetStatistics();
+            CHECK_EQUAL(backend.GetCalls().size() - callsBefore, (size_t)statistics.ranges);
+            uint64_t bytes = 0;
+            for (size_t call = callsBefore; call < backend.GetCalls().size(); call++)
+                bytes += backend.GetCalls()[call].count;
+            CHECK_EQUAL(statistics.bytes, bytes);
+            CHECK_EQUAL(statistics.bytes, (uint64_t)statistics.lights * sizeof(GpuPointLight));
+            CHECK(statistics.lights <= lights.GetCount());
+            totalBytes += bytes;
+        }
+        CHECK_EQUAL(lights.GetTotalUploadedBytes(), totalBytes);
+        CHECK(removed.size() > 1000);
+
+        // Handles keep finding their light however often it moved
+        for (LightHandle light : live)
+        {
+            uint32_t index = lights.GetIndex(light);
+            CHECK(index < lights.GetCount());
+        }
+        for (LightHandle light : removed)
+            CHECK(!lights.IsValid(light));
+    }
+
+    void testStaleHandles()
+    {
+        LightManager lights(2, 0.01f);
+        CHECK(!lights.IsValid(LightHandle()));
+        CHECK_THROWS(std::invalid_argument, lights.Remove(LightHandle()));
+
+        LightHandle a = lights.Add(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), 1);
+        LightHandle b = lights.Add(XMFLOAT3(1, 0, 0), XMFLOAT3(1, 1, 1), 2);
+        CHECK_THROWS(std::length_error, lights.Add(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), 1));
+
+        // b moves into a's element and keeps its handle
+        lights.Remove(a);
+        CHECK(!lights.IsValid(a));
+        CHECK_EQUAL(lights.GetIndex(b), 0u);
+        CHECK_EQUAL(lights.GetIntensity()[0], 2.0f);
+        CHECK_THROWS(std::invalid_argument, lights.Remove(a));
+        CHECK_THROWS(std::invalid_argument, lights.SetPosition(a, XMFLOAT3(0, 0, 0)));
+        CHECK_THROWS(std::invalid_argument, lights.SetColor(a, XMFLOAT3(0, 0, 0)));
+        CHECK_THROWS(std::invalid_argument, lights.SetIntensity(a, 1));
+        CHECK_THROWS(std::invalid_argument, lights.GetIndex(a));
+
+        // The slot is reused under a new generation, the old handle stays stale
+        LightHandle c = lights.Add(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), 3);
+        CHECK_EQUAL(c.slot, a.slot);
+        CHECK(c.generation != a.generation);
+        CHECK(!lights.IsValid(a) && lights.IsValid(c));
+        CHECK_THROWS(std::invalid_argument, lights.SetIntensity(a, 1));
+        CHECK_EQUAL(lights.GetIntensity()[lights.GetIndex(c)], 3.0f);
+
+        LightHandle outside;
+        outside.slot = 7;
+        CHECK(!lights.IsValid(outside));
+        CHECK_THROWS(std::invalid_argument, LightManager bad(4, 0.0f));
+    }
+
+    // Ranges, lights and bytes of one upload after marking the given elements
+    void checkUpload(LightManager &lights, MirrorBackend &backend, ID3D11Buffer *buffer,
+        const std::vector<LightHandle> &handles, const std::vector<uint32_t> &dirty,
+        uint32_t ranges, uint32_t count)
+    {
+        for (uint32_t index : dirty)
+            lights.SetPosition(handles[index], XMFLOAT3((float)index, 1, 0));
+        lights.Upload(backend, buffer);
+        CHECK_EQUAL(lights.GetStatistics().ranges, ranges);
+        CHECK_EQUAL(lights.GetStatistics().lights, count);
+        CHECK_EQUAL(lights.GetStatistics().bytes, (uint64_t)count * sizeof(GpuPointLight));
+    }
+
+    // Dirty runs closer than MERGE_GAP are joined, within a 64-element word
+    // and across one
+    void testDirtyRanges()
+    {
+        const uint32_t COUNT = 200;
+        LightManager lights(COUNT, 0.01f);
+        ID3D11Buffer *buffer = FakeObject<ID3D11Buffer>(1);
+        MirrorBackend backend(buffer, COUNT);
+        std::vector<LightHandle> handles;
+        for (uint32_t i = 0; i < COUNT; i++)
+            handles.push_back(lights.Add(XMFLOAT3((float)i, 0, 0), XMFLOAT3(1, 1, 1), 1));
+
+        const uint32_t GAP = LightManager::MERGE_GAP;
+        checkUpload(lights, backend, buffer, handles, {}, 1, COUNT);
+        checkUpload(lights, backend, buffer, handles, {}, 0, 0);
+        checkUpload(lights, backend, buffer, handles, { 60, 61, 62, 63, 64, 65, 66 }, 1, 7);
+        checkUpload(lights, backend, buffer, handles, { 63, 64 }, 1, 2);
+        checkUpload(lights, backend, buffer, handles, { 127, 128, 191 }, 2, 3);
+        // A gap one short of MERGE_GAP is uploaded, a full one is not
+        checkUpload(lights, backend, buffer, handles, { 10, 10 + GAP }, 1, GAP + 1);
+        checkUpload(lights, backend, buffer, handles, { 10, 11 + GAP }, 2, 2);
+        // The same, with the gap across element 64
+        checkUpload(lights, backend, buffer, handles, { 60, 60 + GAP }, 1, GAP + 1);
+        checkUpload(lights, backend, buffer, handles, { 60, 61 + GAP }, 2, 2);
+        // A chain of short gaps becomes one run spanning two word boundaries
+        std::vector<uint32_t> chain;
+        for (uint32_t i = 40; i < 140; i += GAP)
+            chain.push_back(i);
+        checkUpload(lights, backend, buffer, handles, chain, 1, chain.back() - 40 + 1);
+        checkUpload(lights, backend, buffer, handles, { 0, COUNT - 1 }, 2, 2);
+
+        // The last light moves into the hole, only that element changes
+        lights.Remove(handles[5]);
+        lights.Upload(backend, buffer);
+        CHECK_EQUAL(lights.GetStatistics().ranges, 1u);
+        CHECK_EQUAL(lights.GetStatistics().lights, 1u);
+        CHECK_EQUAL(lights.GetIndex(handles[COUNT - 1]), 5u);
+        // Removing the last light leaves nothing to upload, even if it was dirty
+        lights.SetColor(handles[COUNT - 2], XMFLOAT3(0, 0, 1));
+        lights.Remove(handles[COUNT - 2]);
+        lights.Upload(backend, buffer);
+        CHECK_EQUAL(lights.GetStatistics().ranges, 0u);
+
+        lights.InvalidateBuffer();
+        lights.Upload(backend, buffer);
+        CHECK_EQUAL(lights.GetStatistics().ranges, 1u);
+        CHECK_EQUAL(lights.GetStatistics().lights, COUNT - 2);
+
+        std::vector<GpuPointLight> expected;
+        lights.GetLights(expected);
+        CHECK(sameLights(expected, backend.mirror));
+    }
+}
+
+int main()
+{
+    testMirror();
+    testStaleHandles();
+    testDirtyRanges();
+    return Test::Report();
+}
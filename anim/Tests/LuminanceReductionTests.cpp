@@ -0,0 +1,117 @@
+#include "pch.h"
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "Check.h"
+#include "Common/PostProcess/LuminanceReduction.h"
+
+using namespace DX;
+
+namespace
+{
+    // Deterministic HDR image with a wide brightness range
+    std::vector<float> makeImage(uint32_t width, uint32_t height, size_t rowPitch)
+    {
+        std::vector<float> rgba(rowPitch * height, -1.0f);
+        uint32_t state = 12345;
+        for (uint32_t y = 0; y < height; y++)
+            for (uint32_t x = 0; x < width; x++)
+            {
+                float *p = rgba.data() + y * rowPitch + 4 * x;
+                for (int c = 0; c < 3; c++)
+                {
+                    state = state * 1664525u + 1013904223u;
+                    p[c] = std::exp2((state >> 8) / 16777216.0f * 16.0f - 6.0f);
+                }
+                p[3] = 1.0f;
+            }
+        return rgba;
+    }
+
+    // Plain double precision (mean, count, variance, third central moment)
+    // per tile in the layout of GetTiles, the moments in a second pass
+    std::vector<double> referenceTiles(const std::vector<float> &rgba, uint32_t width,
+        uint32_t height, size_t rowPitch, uint32_t tileSize)
+    {
+        uint32_t gridWidth = (width + tileSize - 1) / tileSize;
+        uint32_t gridHeight = (height + tileSize - 1) / tileSize;
+        std::vector<double> tiles(4 * gridWidth * gridHeight, 0.0);
+        auto forEachPixel = [&](const std::function<void(size_t, double)> &f)
+        {
+            for (uint32_t y = 0; y < height; y++)
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    const float *p = rgba.data() + y * rowPitch + 4 * x;
+                    double l = 0.2126 * p[0] + 0.7151 * p[1] + 0.0722 * p[2];
+                    f((size_t)(y / tileSize) * gridWidth + x / tileSize, std::log(1.0 + (l > 0 ? l : 0)));
+                }
+        };
+        forEachPixel([&](size_t tile, double v)
+        {
+            tiles[4 * tile] += v;
+            tiles[4 * tile + 1] += 1;
+        });
+        for (size_t i = 0; i < tiles.size(); i += 4)
+            tiles[i] /= tiles[i + 1];
+        forEachPixel([&](size_t tile, double v)
+        {
+            double d = v - tiles[4 * tile];
+            tiles[4 * tile + 2] += d * d / tiles[4 * tile + 1];
+            tiles[4 * tile + 3] += d * d * d / tiles[4 * tile + 1];
+        });
+        return tiles;
+    }
+
+    void testAgainstReference(ThreadPool &pool, uint32_t width, uint32_t height)
+    {
+        // Padded rows catch reads past the end of a row
+        size_t rowPitch = 4 * (size_t)width + 8;
+        std::vector<float> rgba = makeImage(width, height, rowPitch);
+
+        LuminanceReduction reduction(64, pool);
+        LuminanceReductionResult result = reduction.Reduce(rgba.data(), width, height, rowPitch);
+
+        uint32_t tileSize = reduction.GetTileSize();
+        CHECK_EQUAL(tileSize, LuminanceReduction::ComputeTileSize(width, height, 64));
+        CHECK(reduction.GetGridWidth() <= 64 && reduction.GetGridHeight() <= 64);
+
+        std::vector<double> expected = referenceTiles(rgba, width, height, rowPitch, tileSize);
+        const std::vector<float> &tiles = reduction.GetTiles();
+        CHECK_EQUAL(tiles.size(), expected.size());
+
+        double sum = 0;
+        for (size_t i = 0; i < expected.size(); i += 4)
+        {
+            CHECK_NEAR(tiles[i], expected[i], 1e-5 * (1 + expected[i]));
+            CHECK_EQUAL((double)tiles[i + 1], expected[i + 1]);
+            CHECK_NEAR(tiles[i + 2], expected[i + 2], 1e-4 * (1 + expected[i + 2]));
+            CHECK_NEAR(tiles[i + 3], expected[i + 3], 1e-4 * (1 + std::fabs(expected[i + 3])));
+            sum += expected[i] * expected[i + 1];
+        }
+
+        uint64_t pixelCount = (uint64_t)width * height;
+        CHECK_EQUAL(result.pixelCount, pixelCount);
+        CHECK_NEAR(result.logBrightnessSum, sum, 1e-6 * sum);
+        CHECK_NEAR(result.averageLogBrightness, sum / pixelCount, 1e-5);
+
+        // The GPU path combines the same tiles
+        LuminanceReductionResult combined = LuminanceReduction::Combine(tiles.data(), tiles.size() / 4, 4);
+        CHECK_EQUAL(combined.pixelCount, pixelCount);
+        CHECK_NEAR(combined.averageLogBrightness, result.averageLogBrightness, 1e-5);
+    }
+}
+
+int main()
+{
+    ThreadPool serial(1);
+    ThreadPool parallel(4);
+    for (ThreadPool *pool : { &serial, &parallel })
+    {
+        testAgainstReference(*pool, 1, 1);
+        testAgainstReference(*pool, 63, 65);
+        testAgainstReference(*pool, 1921, 1079);
+    }
+    return Test::Report();
+}
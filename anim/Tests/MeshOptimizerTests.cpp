@@ -0,0 +1,203 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Mesh/MeshOptimizer.h"
+#include "Content/SphereLODChain.h"
+
+using namespace DX;
+
+namespace
+{
+    typedef std::array<uint32_t, 3> Triangle;
+
+    // Triangles rotated to start at their lowest index, which keeps the
+    // winding, and sorted, so two lists of the same triangles compare equal
+    std::vector<Triangle> canonicalTriangles(const std::vector<uint32_t> &indices)
+    {
+        std::vector<Triangle> triangles;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            Triangle t = { indices[i], indices[i + 1], indices[i + 2] };
+            std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+            triangles.push_back(t);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    // Row order triangles of a latitude/longitude grid, as SphereLODChain
+    // builds them before optimizing
+    std::vector<uint32_t> gridIndices(uint32_t segments)
+    {
+        uint32_t rowLength = segments + 1;
+        std::vector<uint32_t> indices;
+        for (uint32_t latitude = 0; latitude < segments; latitude++)
+        {
+            for (uint32_t longitude = 0; longitude < segments; longitude++)
+            {
+                uint32_t i0 = latitude * rowLength + longitude;
+                uint32_t i1 = (latitude + 1) * rowLength + longitude;
+                indices.insert(indices.end(), { i0, i1, i0 + 1 });
+                indices.insert(indices.end(), { i0 + 1, i1, i1 + 1 });
+            }
+        }
+        return indices;
+    }
+
+    // The cache order emits every triangle once with its winding, for a
+    // regular grid and for random triangles with repeats
+    void testCacheOrderKeepsTriangles()
+    {
+        std::vector<uint32_t> grid = gridIndices(40);
+        std::vector<uint32_t> optimized = grid;
+        OptimizeVertexCache(optimized, 41 * 41);
+        CHECK(optimized != grid);
+        CHECK(canonicalTriangles(optimized) == canonicalTriangles(grid));
+
+        std::mt19937 random(41);
+        const uint32_t VERTICES = 500;
+        std::vector<uint32_t> soup;
+        for (int i = 0; i < 3000; i++)
+        {
+            uint32_t a = random() % VERTICES, b = random() % VERTICES, c = random() % VERTICES;
+            soup.insert(soup.end(), { a, b, c });
+        }
+        soup.insert(soup.end(), soup.begin(), soup.begin() + 30);
+        optimized = soup;
+        OptimizeVertexCache(optimized, VERTICES);
+        CHECK(canonicalTriangles(optimized) == canonicalTriangles(soup));
+
+        std::vector<uint32_t> empty;
+        OptimizeVertexCache(empty, 10);
+        CHECK(empty.empty());
+    }
+
+    // Vertices are renumbered in order of first use, every used vertex gets
+    // its own number and unused ones none
+    void testFetchRemap()
+    {
+        std::mt19937 random(42);
+        const uint32_t VERTICES = 1000;
+        std::vector<uint32_t> indices;
+        for (int i = 0; i < 900; i++)
+            indices.push_back(random() % VERTICES);
+        std::vector<uint32_t> original = indices;
+        std::vector<bool> used(VERTICES, false);
+        uint32_t usedCount = 0;
+        for (uint32_t index : original)
+        {
+            usedCount += !used[index];
+            used[index] = true;
+        }
+
+        uint32_t vertexCount = VERTICES;
+        std::vector<uint32_t> remap = OptimizeVertexFetch(indices, vertexCount);
+        CHECK_EQUAL(vertexCount, usedCount);
+        CHECK_EQUAL(remap.size(), (size_t)VERTICES);
+
+        // First uses come in the order 0, 1, 2...
+        uint32_t next = 0;
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            CHECK_EQUAL(indices[i], remap[original[i]]);
+            CHECK(indices[i] <= next);
+            if (indices[i] == next)
+                next++;
+        }
+        CHECK_EQUAL(next, usedCount);
+
+        // A bijection from the used vertices onto [0, vertexCount)
+        std::vector<bool> taken(vertexCount, false);
+        for (uint32_t v = 0; v < VERTICES; v++)
+        {
+            CHECK_EQUAL(remap[v] == ~0u, !used[v]);
+            if (remap[v] == ~0u)
+                continue;
+            CHECK(remap[v] < vertexCount && !taken[remap[v]]);
+            taken[remap[v]] = true;
+        }
+
+        // The vertices follow their numbers
+        std::vector<uint32_t> vertices(VERTICES);
+        for (uint32_t v = 0; v < VERTICES; v++)
+            vertices[v] = v * 7;
+        std::vector<uint32_t> remapped = RemapVertices(vertices, remap, vertexCount);
+        CHECK_EQUAL(remapped.size(), (size_t)vertexCount);
+        for (size_t i = 0; i < indices.size(); i++)
+            CHECK_EQUAL(remapped[indices[i]], vertices[original[i]]);
+    }
+
+    void testAnalyze()
+    {
+        // Two triangles sharing an edge, then the first again while cached
+        VertexCacheStatistics statistics = AnalyzeVertexCache({ 0, 1, 2, 2, 1, 3, 0, 1, 2 }, 4);
+        CHECK_EQUAL(statistics.transforms, 4u);
+        CHECK_NEAR(statistics.acmr, 4.0f / 3, 1e-6f);
+        CHECK_NEAR(statistics.atvr, 1.0f, 1e-6f);
+
+        // A cache of two has evicted vertex 0 by the time it comes back
+        statistics = AnalyzeVertexCache({ 0, 1, 2, 2, 1, 3, 0, 1, 2 }, 4, 2);
+        CHECK_EQUAL(statistics.transforms, 7u);
+        CHECK_NEAR(statistics.atvr, 7.0f / 4, 1e-6f);
+    }
+
+    // Every level of the scene's chain transforms no more vertices per
+    // triangle than its row order did, in the FIFO caches of 16 and of 8
+    // entries AnalyzeVertexCache compares hardware with
+    void testSphereChainACMR()
+    {
+        anim::SphereLODChain chain({ 8, 16, 32, 64 }, 0.25f);
+        for (const anim::SphereLODChain::Level &level : chain.GetLevels())
+        {
+            std::vector<uint32_t> rowOrder = gridIndices(level.segments);
+            std::vector<uint32_t> indices(chain.GetIndices().begin() + level.startIndex,
+                chain.GetIndices().begin() + level.startIndex + level.indexCount);
+            CHECK_EQUAL(indices.size(), rowOrder.size());
+            CHECK_EQUAL(AnalyzeVertexCache(indices, level.vertexCount).transforms,
+                level.cacheStatistics.transforms);
+
+            for (uint32_t cacheSize : { 8u, 16u })
+            {
+                float before = AnalyzeVertexCache(rowOrder, level.vertexCount, cacheSize).acmr;
+                CHECK(AnalyzeVertexCache(indices, level.vertexCount, cacheSize).acmr <= before);
+            }
+            // Well past row order on the finer levels
+            if (level.segments >= 32)
+                CHECK(level.cacheStatistics.acmr < 0.8f * AnalyzeVertexCache(rowOrder, level.vertexCount).acmr);
+        }
+    }
+
+    // 16-bit indices up to 65536 vertices, then 32-bit. 255 segments make
+    // 256 x 256 vertices, the last level that still fits.
+    void testIndexWidth()
+    {
+        CHECK(FitsShortIndices(65535));
+        CHECK(FitsShortIndices(65536));
+        CHECK(!FitsShortIndices(65537));
+
+        anim::SphereLODChain fits({ 8, 255 }, 1.0f);
+        CHECK_EQUAL(fits.GetMaxLevelVertexCount(), 65536u);
+        CHECK(FitsShortIndices(fits.GetMaxLevelVertexCount()));
+        uint32_t largest = *std::max_element(fits.GetIndices().begin(), fits.GetIndices().end());
+        CHECK_EQUAL(largest, 65535u);
+        CHECK_EQUAL((uint32_t)(uint16_t)largest, largest);
+
+        anim::SphereLODChain tooLarge({ 8, 256 }, 1.0f);
+        CHECK(!FitsShortIndices(tooLarge.GetMaxLevelVertexCount()));
+    }
+}
+
+int main()
+{
+    testCacheOrderKeepsTriangles();
+    testFetchRemap();
+    testAnalyze();
+    testSphereChainACMR();
+    testIndexWidth();
+    return Test::Report();
+}
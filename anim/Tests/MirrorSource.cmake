@@ -0,0 +1,18 @@
+# Copies INPUT to OUTPUT with the backslashes of its #include paths turned
+# into forward slashes, which GCC and Clang need
+
+file(READ "${INPUT}" content)
+set(previous "")
+while(NOT content STREQUAL previous)
+    set(previous "${content}")
+    string(REGEX REPLACE "(#include[ \t]+\"[^\"\n\\\\]*)\\\\" "\\1/" content "${content}")
+endwhile()
+
+# Unchanged files keep their time stamp, so nothing rebuilds needlessly
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" existing)
+    if(existing STREQUAL content)
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT}" "${content}")
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "Common/Shading/PBRShading.h"
+
+// Double precision port of PBRInclude.cginc and the four sphere pixel
+// shaders, one pixel at a time, with the constant environment and Karis'
+// BRDF fit of DX::ConstantPBREnvironment and the windowed light falloff. What DX::ShadePBR is checked and timed against.
+namespace PBRReference
+{
+    const double PI = 3.14159265359;
+
+    struct Vector
+    {
+        double x, y, z;
+    };
+
+    inline Vector operator+(const Vector &a, const Vector &b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+    inline Vector operator-(const Vector &a, const Vector &b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Vector operator*(double s, const Vector &a) { return { s * a.x, s * a.y, s * a.z }; }
+    inline double dot(const Vector &a, const Vector &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Vector normalize(const Vector &a) { return (1 / std::sqrt(dot(a, a))) * a; }
+    inline double sqr(double x) { return x * x; }
+    inline double myDot(const Vector &a, const Vector &b) { return (std::max)(dot(a, b), 0.0); }
+
+    struct Surface
+    {
+        Vector normal;
+        Vector position;
+        double roughness;
+        double metalness;
+    };
+
+    class Shader
+    {
+    public:
+        Shader(const DX::PBRShadingConstants &constants, double ambient) :
+            m_constants(constants),
+            m_ambient(ambient)
+        {
+        }
+
+        void Shade(DX::PBRShaderMode mode, const Surface &surface, double *color) const
+        {
+            m_roughness = surface.roughness;
+            m_metalness = surface.metalness;
+            Vector p = surface.position;
+            Vector n = normalize(surface.normal);
+            Vector wo = normalize(vector(m_constants.cameraPos) - p);
+
+            if (mode != DX::PBRShaderMode::REGULAR)
+            {
+                Vector wi = normalize(vector(m_constants.lights[0].position) - p);
+                for (int c = 0; c < 3; c++)
+                    color[c] = mode == DX::PBRShaderMode::NORMAL_DISTRIBUTION ? normalDistribution(n, wi, wo) :
+                        mode == DX::PBRShaderMode::GEOMETRY ? geometry(n, wi, wo) : fresnel(c, n, wi, wo);
+                return;
+            }
+
+            for (int c = 0; c < 3; c++)
+                color[c] = ambient(c, n, wo);
+            for (uint32_t l = 0; l < m_constants.lightCount; l++)
+            {
+                const DX::GpuPointLight &light = m_constants.lights[l];
+                if (!(light.radius > 0))
+                    continue;
+                Vector toLight = vector(light.position) - p;
+                Vector wi = normalize(toLight);
+                double distanceSqr = dot(toLight, toLight);
+                double window = (std::max)(1 - sqr(distanceSqr / sqr(light.radius)), 0.0);
+                double attenuation = sqr(window) / (1 + 0.30 * distanceSqr);
+                const double lightColor[3] = { light.color.x, light.color.y, light.color.z };
+                for (int c = 0; c < 3; c++)
+                    color[c] += cookTorranceBRDF(c, n, wi, wo) * lightColor[c] * light.intensity * attenuation *
+                        myDot(wi, n);
+            }
+        }
+
+    private:
+        static Vector vector(const float *v) { return { v[0], v[1], v[2] }; }
+        static Vector vector(const DirectX::XMFLOAT3 &v) { return { v.x, v.y, v.z }; }
+
+        double f0(int c) const { return 0.04 + (m_constants.albedo[c] - 0.04) * m_metalness; }
+
+        double normalDistribution(const Vector &n, const Vector &wi, const Vector &wo) const
+        {
+            double roughSqr = sqr((std::max)(m_roughness, 0.01));
+            return roughSqr / (PI * sqr(sqr(myDot(n, normalize(wi + wo))) * (roughSqr - 1) + 1));
+        }
+
+        static double schlickGGX(const Vector &n, const Vector &v, double k)
+        {
+            double nv = myDot(n, v);
+            return nv / (nv * (1 - k) + k);
+        }
+
+        double geometry(const Vector &n, const Vector &wi, const Vector &wo) const
+        {
+            double k = sqr(m_roughness + 1) / 8;
+            return schlickGGX(n, wi, k) * schlickGGX(n, wo, k);
+        }
+
+        double fresnel(int c, const Vector &n, const Vector &wi, const Vector &wo) const
+        {
+            double F0 = f0(c);
+            double facing = myDot(wi, n) > 0 ? 1 : 0;
+            return (F0 + (1 - F0) * std::pow(1 - myDot(normalize(wi + wo), wo), 5)) * facing;
+        }
+
+        double ambient(int c, const Vector &n, const Vector &wo) const
+        {
+            // EnvBRDFApprox at dot(n, wo), clamped as a texture coordinate
+            double nv = (std::min)((std::max)(dot(n, wo), 0.0), 1.0);
+            double r[4] = { 1 - m_roughness, 0.0425 - 0.0275 * m_roughness, 1.04 - 0.572 * m_roughness,
+                -0.04 + 0.022 * m_roughness };
+            double a004 = (std::min)(r[0] * r[0], std::exp2(-9.28 * nv)) * r[0] + r[1];
+            double scale = a004 * -1.04 + r[2], bias = a004 * 1.04 + r[3];
+
+            double specular = m_ambient * (f0(c) * scale + bias);
+            double F = f0(c) + ((std::max)(1 - m_roughness, f0(c)) - f0(c)) * std::pow(1 - myDot(n, wo), 5);
+            double kD = (1 - F) * (1 - m_metalness);
+            return kD * m_ambient * m_constants.albedo[c] + specular;
+        }
+
+        double cookTorranceBRDF(int c, const Vector &n, const Vector &wi, const Vector &wo) const
+        {
+            double D = normalDistribution(n, wi, wo);
+            double G = geometry(n, wi, wo);
+            double F = fresnel(c, n, wi, wo);
+            return (1 - F) * m_constants.albedo[c] / PI * (1 - m_metalness) +
+                D * F * G / (0.001 + 4 * (myDot(wi, n) * myDot(wo, n)));
+        }
+
+        const DX::PBRShadingConstants &m_constants;
+        double m_ambient;
+        mutable double m_roughness = 0;
+        mutable double m_metalness = 0;
+    };
+}
@@ -0,0 +1,177 @@
+#include "pch.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Shading/PBRShading.h"
+#include "Content/SceneLights.h"
+#include "PBRReference.h"
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+    const float AMBIENT = 0.03f;
+    const PBRShaderMode MODES[4] =
+    {
+        PBRShaderMode::REGULAR, PBRShaderMode::NORMAL_DISTRIBUTION, PBRShaderMode::GEOMETRY, PBRShaderMode::FRESNEL
+    };
+
+    // The scene's lights at strengths the app cycles through, from a
+    // LightManager like in the renderers. The constants point into lights.
+    PBRShadingConstants sceneConstants(std::vector<GpuPointLight> &lights)
+    {
+        const float strengths[anim::SCENE_LIGHT_COUNT] = { 100, 10, 300 };
+        LightManager manager(anim::MAX_SCENE_LIGHTS, anim::SCENE_LIGHT_THRESHOLD);
+        for (uint32_t l = 0; l < anim::SCENE_LIGHT_COUNT; l++)
+            manager.Add(anim::SCENE_LIGHT_POSITIONS[l], anim::SCENE_LIGHT_COLORS[l], strengths[l]);
+        manager.GetLights(lights);
+
+        PBRShadingConstants constants;
+        constants.lights = lights.data();
+        constants.lightCount = (uint32_t)lights.size();
+        constants.cameraPos[0] = 1.5f;
+        constants.cameraPos[1] = 1.0f;
+        constants.cameraPos[2] = 6.0f;
+        constants.albedo[1] = 0.7f;
+        constants.albedo[2] = 0.3f;
+        return constants;
+    }
+
+    // Random surfaces on spheres of the grid, facing every way, with
+    // roughness from minRoughness up
+    std::vector<PBRSurfaceBatch> randomSurfaces(size_t batches, float minRoughness, std::mt19937 &random)
+    {
+        std::uniform_real_distribution<float> unit(-1, 1), material(0, 1), roughness(minRoughness, 1);
+        std::vector<PBRSurfaceBatch> surfaces(batches);
+        for (PBRSurfaceBatch &batch : surfaces)
+            for (uint32_t i = 0; i < PBR_BATCH_SIZE; i++)
+            {
+                // Not unit length, the shaders normalize
+                float n[3] = { unit(random), unit(random), unit(random) };
+                float scale = 0.5f + material(random);
+                batch.normalX[i] = n[0] * scale;
+                batch.normalY[i] = n[1] * scale;
+                batch.normalZ[i] = n[2] * scale;
+                batch.positionX[i] = unit(random) * 2.5f;
+                batch.positionY[i] = unit(random) * 2.5f;
+                batch.positionZ[i] = unit(random) * 0.25f;
+                batch.roughness[i] = roughness(random);
+                batch.metalness[i] = material(random);
+            }
+        return surfaces;
+    }
+
+    // Largest error of ShadePBR against the reference, relative to the
+    // reference or to one for values below it
+    double worstError(PBRShaderMode mode, const PBRShadingConstants &constants,
+        const std::vector<PBRSurfaceBatch> &surfaces)
+    {
+        ConstantPBREnvironment environment(AMBIENT, AMBIENT, AMBIENT);
+        PBRReference::Shader reference(constants, AMBIENT);
+        double worst = 0;
+        for (const PBRSurfaceBatch &batch : surfaces)
+        {
+            PBRColorBatch colors;
+            ShadePBR(mode, constants, environment, batch, colors);
+            for (uint32_t i = 0; i < PBR_BATCH_SIZE; i++)
+            {
+                PBRReference::Surface surface = { { batch.normalX[i], batch.normalY[i], batch.normalZ[i] },
+                    { batch.positionX[i], batch.positionY[i], batch.positionZ[i] },
+                    batch.roughness[i], batch.metalness[i] };
+                double expected[3];
+                reference.Shade(mode, surface, expected);
+                const float actual[3] = { colors.r[i], colors.g[i], colors.b[i] };
+                for (int c = 0; c < 3; c++)
+                {
+                    if (!std::isfinite(actual[c]))
+                        return INFINITY;
+                    worst = (std::max)(worst, std::fabs(actual[c] - expected[c]) / (std::max)(std::fabs(expected[c]), 1.0));
+                }
+            }
+        }
+        return worst;
+    }
+
+    // Every mode against the double precision port over 65536 pixels. The
+    // distribution term cancels in float at the smallest roughness, so the
+    // regular mode gets more room there.
+    void testAgainstReference()
+    {
+        std::mt19937 random(23);
+        std::vector<GpuPointLight> lights;
+        PBRShadingConstants constants = sceneConstants(lights);
+        std::vector<PBRSurfaceBatch> any = randomSurfaces(65536 / PBR_BATCH_SIZE, 0.0f, random);
+        std::vector<PBRSurfaceBatch> rough = randomSurfaces(65536 / PBR_BATCH_SIZE, 0.1f, random);
+
+        CHECK(worstError(PBRShaderMode::REGULAR, constants, any) < 1e-3);
+        for (PBRShaderMode mode : MODES)
+            CHECK(worstError(mode, constants, rough) < 1e-4);
+        CHECK(worstError(PBRShaderMode::FRESNEL, constants, any) < 1e-6);
+        CHECK(worstError(PBRShaderMode::GEOMETRY, constants, any) < 1e-6);
+    }
+
+    // No lights leaves the ambient term, facing away from light 0 no fresnel
+    void testEdgeCases()
+    {
+        std::mt19937 random(29);
+        std::vector<GpuPointLight> lights;
+        PBRShadingConstants constants = sceneConstants(lights);
+        constants.lightCount = 0;
+        std::vector<PBRSurfaceBatch> surfaces = randomSurfaces(64, 0.0f, random);
+        CHECK(worstError(PBRShaderMode::REGULAR, constants, surfaces) < 1e-3);
+
+        constants = sceneConstants(lights);
+        PBRSurfaceBatch batch = surfaces[0];
+        for (uint32_t i = 0; i < PBR_BATCH_SIZE; i++)
+        {
+            batch.positionX[i] = batch.positionY[i] = batch.positionZ[i] = 0;
+            batch.normalX[i] = batch.normalY[i] = 0;
+            batch.normalZ[i] = -1;
+        }
+        ConstantPBREnvironment environment(AMBIENT, AMBIENT, AMBIENT);
+        PBRColorBatch colors;
+        ShadePBR(PBRShaderMode::FRESNEL, constants, environment, batch, colors);
+        for (uint32_t i = 0; i < PBR_BATCH_SIZE; i++)
+            CHECK(colors.r[i] == 0 && colors.g[i] == 0 && colors.b[i] == 0);
+    }
+
+    // Lights add nothing from their radius on, and lights turned down to
+    // nothing are skipped rather than divided by their zero radius
+    void testLightReach()
+    {
+        std::mt19937 random(31);
+        std::vector<PBRSurfaceBatch> surfaces = randomSurfaces(64, 0.0f, random);
+        std::vector<GpuPointLight> lights;
+        PBRShadingConstants constants = sceneConstants(lights);
+        lights[0].radius = 0;
+        lights[0].intensity = 0;
+        lights[1].position = XMFLOAT3(0, 0, 50);
+        lights[1].radius = 40;
+        constants.lightCount = 2;
+        CHECK(worstError(PBRShaderMode::REGULAR, constants, surfaces) < 1e-3);
+
+        ConstantPBREnvironment environment(AMBIENT, AMBIENT, AMBIENT);
+        PBRShadingConstants dark = constants;
+        dark.lightCount = 0;
+        for (const PBRSurfaceBatch &batch : surfaces)
+        {
+            PBRColorBatch lit, unlit;
+            ShadePBR(PBRShaderMode::REGULAR, constants, environment, batch, lit);
+            ShadePBR(PBRShaderMode::REGULAR, dark, environment, batch, unlit);
+            for (uint32_t i = 0; i < PBR_BATCH_SIZE; i++)
+                CHECK(lit.r[i] == unlit.r[i] && lit.g[i] == unlit.g[i] && lit.b[i] == unlit.b[i]);
+        }
+    }
+}
+
+int main()
+{
+    testAgainstReference();
+    testEdgeCases();
+    testLightReach();
+    return Test::Report();
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Capture/ImageEncoder.h"
+
+// Readers for what ImageEncoder writes, for the tests that decode captures
+// and golden images
+namespace Test
+{
+    // Minimal zlib reader for stored and fixed Huffman blocks, the only
+    // kinds Deflate writes
+    class Inflater
+    {
+    public:
+        Inflater(const uint8_t *data, size_t size) : m_data(data), m_size(size) {}
+
+        std::vector<uint8_t> Run()
+        {
+            if (m_size < 6 || m_data[0] != 0x78 || ((m_data[0] << 8) | m_data[1]) % 31 != 0)
+                throw std::runtime_error("Inflater: bad zlib header");
+            m_position = 2;
+
+            std::vector<uint8_t> out;
+            bool last = false;
+            while (!last)
+            {
+                last = bits(1) != 0;
+                uint32_t type = bits(2);
+                if (type == 0)
+                    stored(out);
+                else if (type == 1)
+                    fixed(out);
+                else
+                    throw std::runtime_error("Inflater: unexpected block type");
+            }
+
+            // Adler-32 follows byte aligned, big endian
+            m_bitCount = 0;
+            if (m_position + 4 != m_size)
+                throw std::runtime_error("Inflater: trailing data");
+            uint32_t adler = (uint32_t)m_data[m_position] << 24 | m_data[m_position + 1] << 16 |
+                m_data[m_position + 2] << 8 | m_data[m_position + 3];
+            if (adler != DX::ImageEncoder::Adler32(out.data(), out.size()))
+                throw std::runtime_error("Inflater: Adler-32 mismatch");
+            return out;
+        }
+
+    private:
+        uint32_t bits(int count)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < count; i++)
+            {
+                if (m_bitCount == 0)
+                {
+                    if (m_position >= m_size)
+                        throw std::runtime_error("Inflater: truncated stream");
+                    m_byte = m_data[m_position++];
+                    m_bitCount = 8;
+                }
+                value |= (uint32_t)(m_byte & 1) << i;
+                m_byte >>= 1;
+                m_bitCount--;
+            }
+            return value;
+        }
+
+        // Huffman codes are read most significant bit first
+        uint32_t code(int count)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < count; i++)
+                value = (value << 1) | bits(1);
+            return value;
+        }
+
+        void stored(std::vector<uint8_t> &out)
+        {
+            m_bitCount = 0;
+            uint32_t length = bits(16);
+            uint32_t complement = bits(16);
+            if ((length ^ 0xffff) != complement)
+                throw std::runtime_error("Inflater: bad stored length");
+            for (uint32_t i = 0; i < length; i++)
+                out.push_back((uint8_t)bits(8));
+        }
+
+        uint32_t fixedSymbol()
+        {
+            uint32_t c = code(7);
+            if (c <= 0x17)
+                return 256 + c;
+            c = (c << 1) | bits(1);
+            if (c >= 0x30 && c <= 0xbf)
+                return c - 0x30;
+            if (c >= 0xc0 && c <= 0xc7)
+                return 280 + c - 0xc0;
+            c = (c << 1) | bits(1);
+            return 144 + c - 0x190;
+        }
+
+        void fixed(std::vector<uint8_t> &out)
+        {
+            static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97,
+                129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+            static const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5,
+                6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+            for (;;)
+            {
+                uint32_t symbol = fixedSymbol();
+                if (symbol < 256)
+                {
+                    out.push_back((uint8_t)symbol);
+                    continue;
+                }
+                if (symbol == 256)
+                    return;
+                if (symbol > 285)
+                    throw std::runtime_error("Inflater: bad length symbol");
+
+                uint32_t length = LENGTH_BASE[symbol - 257] + bits(LENGTH_EXTRA[symbol - 257]);
+                uint32_t distanceSymbol = code(5);
+                if (distanceSymbol >= 30)
+                    throw std::runtime_error("Inflater: bad distance symbol");
+                uint32_t distance = DISTANCE_BASE[distanceSymbol] + bits(DISTANCE_EXTRA[distanceSymbol]);
+                if (distance > out.size())
+                    throw std::runtime_error("Inflater: distance before the start");
+                for (uint32_t i = 0; i < length; i++)
+                    out.push_back(out[out.size() - distance]);
+            }
+        }
+
+        const uint8_t *m_data;
+        size_t m_size;
+        size_t m_position = 0;
+        uint8_t m_byte = 0;
+        int m_bitCount = 0;
+    };
+
+    inline uint32_t ReadBigEndian(const uint8_t *p)
+    {
+        return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+    }
+
+    inline uint8_t Paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        return (uint8_t)(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+    }
+
+    // Decodes an 8-bit RGB PNG into RGB bytes, checking every CRC
+    inline std::vector<uint8_t> DecodePNG(const std::vector<uint8_t> &png, uint32_t &width, uint32_t &height)
+    {
+        static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        CHECK(png.size() > 8 && std::memcmp(png.data(), SIGNATURE, 8) == 0);
+
+        std::vector<uint8_t> idat;
+        bool ended = false;
+        size_t position = 8;
+        while (position + 12 <= png.size() && !ended)
+        {
+            uint32_t length = ReadBigEndian(&png[position]);
+            std::string type((const char *)&png[position + 4], 4);
+            const uint8_t *data = &png[position + 8];
+            uint32_t crc = ReadBigEndian(data + length);
+            CHECK_EQUAL(crc, DX::ImageEncoder::Crc32(&png[position + 4], length + 4));
+
+            if (type == "IHDR")
+            {
+                width = ReadBigEndian(data);
+                height = ReadBigEndian(data + 4);
+                // 8 bits, RGB, deflate, adaptive filters, no interlace
+                CHECK(data[8] == 8 && data[9] == 2 && data[10] == 0 && data[11] == 0 && data[12] == 0);
+            }
+            else if (type == "IDAT")
+                idat.insert(idat.end(), data, data + length);
+            else if (type == "IEND")
+                ended = true;
+            position += 12 + length;
+        }
+        CHECK(ended && position == png.size());
+
+        std::vector<uint8_t> filtered = Inflater(idat.data(), idat.size()).Run();
+        size_t stride = (size_t)width * 3;
+        CHECK_EQUAL(filtered.size(), (stride + 1) * height);
+
+        std::vector<uint8_t> rgb(stride * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            uint8_t filter = filtered[y * (stride + 1)];
+            const uint8_t *in = &filtered[y * (stride + 1) + 1];
+            uint8_t *row = &rgb[y * stride];
+            const uint8_t *up = y > 0 ? row - stride : nullptr;
+            for (size_t i = 0; i < stride; i++)
+            {
+                int a = i >= 3 ? row[i - 3] : 0;
+                int b = up ? up[i] : 0;
+                int c = up && i >= 3 ? up[i - 3] : 0;
+                int predicted = filter == 0 ? 0 : filter == 1 ? a : filter == 2 ? b :
+                    filter == 3 ? (a + b) / 2 : Paeth(a, b, c);
+                CHECK(filter <= 4);
+                row[i] = (uint8_t)(in[i] + predicted);
+            }
+        }
+        return rgb;
+    }
+}
@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+#include "Common/DrawQueue/DrawKey.h"
+#include "Common/DrawQueue/RadixSort.h"
+
+using namespace DX;
+
+namespace
+{
+    enum class Keys
+    {
+        // Every byte varies, eight passes ending in the caller's storage
+        Random,
+        // Only the low three bytes vary, three passes ending in scratch storage
+        Random24,
+        // No byte varies, no pass
+        Constant,
+        // Draw keys of a scene: few passes and shaders, many equal keys, the
+        // unused low byte skipped
+        Scene
+    };
+
+    std::vector<uint64_t> makeKeys(Keys kind, size_t count, std::mt19937_64 &random)
+    {
+        std::uniform_real_distribution<float> distance(0.01f, 1000.0f);
+        std::vector<uint64_t> keys(count);
+        for (uint64_t &key : keys)
+        {
+            switch (kind)
+            {
+            case Keys::Random:
+                key = random();
+                break;
+            case Keys::Random24:
+                key = random() & 0xffffff;
+                break;
+            case Keys::Constant:
+                key = 0x0123456789abcdefull;
+                break;
+            case Keys::Scene:
+                key = DrawKey::Make(random() % 4, random() % 32, random() % 1024,
+                    DrawKey::FrontToBack(distance(random)));
+                break;
+            }
+        }
+        return keys;
+    }
+
+    // The sorted keys and values equal those of std::stable_sort on the
+    // (key, value) pairs ordered by key alone
+    void checkSort(RadixSorter &sorter, Keys kind, size_t count, std::mt19937_64 &random)
+    {
+        std::vector<uint64_t> keys = makeKeys(kind, count, random);
+        std::vector<uint32_t> values(count);
+        for (size_t i = 0; i < count; i++)
+            values[i] = (uint32_t)i;
+
+        std::vector<std::pair<uint64_t, uint32_t>> expected(count);
+        for (size_t i = 0; i < count; i++)
+            expected[i] = std::make_pair(keys[i], values[i]);
+        std::stable_sort(expected.begin(), expected.end(),
+            [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+            {
+                return a.first < b.first;
+            });
+
+        sorter.Sort(keys, values);
+        if (!CHECK(keys.size() == count && values.size() == count))
+            return;
+        bool same = true;
+        for (size_t i = 0; i < count; i++)
+            same = same && keys[i] == expected[i].first && values[i] == expected[i].second;
+        CHECK(same);
+
+        // A few keys may share a byte by chance, many do not
+        uint32_t passes = sorter.GetPassCount();
+        if (kind == Keys::Constant || count < 2)
+            CHECK_EQUAL(passes, 0u);
+        else if (kind == Keys::Random)
+            CHECK(count < 1000 ? passes <= 8 : passes == 8);
+        else if (kind == Keys::Random24)
+            CHECK(count < 1000 ? passes <= 3 : passes == 3);
+        else
+            CHECK(passes > 0 && passes < 8);
+    }
+
+    // Sizes around one chunk and past several, on one thread and on four
+    void testMatchesStableSort()
+    {
+        std::mt19937_64 random(49);
+        const size_t CHUNK = RadixSorter::CHUNK_SIZE;
+        ThreadPool serial(1), parallel(4);
+        RadixSorter serialSorter(serial), parallelSorter(parallel);
+        for (RadixSorter *sorter : { &serialSorter, &parallelSorter })
+            for (size_t count : { (size_t)0, (size_t)1, (size_t)2, CHUNK - 1, CHUNK + 1, (size_t)300000 })
+                for (Keys kind : { Keys::Random, Keys::Random24, Keys::Constant, Keys::Scene })
+                    checkSort(*sorter, kind, count, random);
+    }
+
+    // Both thread counts give the same order of equal keys
+    void testThreadCountIndependent()
+    {
+        std::mt19937_64 random(50);
+        ThreadPool serial(1), parallel(4);
+        RadixSorter serialSorter(serial), parallelSorter(parallel);
+        std::vector<uint64_t> keys = makeKeys(Keys::Scene, 200000, random), parallelKeys = keys;
+        std::vector<uint32_t> values(keys.size()), parallelValues;
+        for (size_t i = 0; i < values.size(); i++)
+            values[i] = (uint32_t)i;
+        parallelValues = values;
+        serialSorter.Sort(keys, values);
+        parallelSorter.Sort(parallelKeys, parallelValues);
+        CHECK(keys == parallelKeys);
+        CHECK(values == parallelValues);
+        CHECK_EQUAL(serialSorter.GetPassCount(), parallelSorter.GetPassCount());
+    }
+
+    void testErrors()
+    {
+        RadixSorter sorter;
+        std::vector<uint64_t> keys(3);
+        std::vector<uint32_t> values(2);
+        CHECK_THROWS(std::invalid_argument, sorter.Sort(keys, values));
+    }
+}
+
+int main()
+{
+    testMatchesStableSort();
+    testThreadCountIndependent();
+    testErrors();
+    return Test::Report();
+}
@@ -0,0 +1,156 @@
+#include "pch.h"
+
+#include "Check.h"
+#include "Common/Readback/FakeReadbackDevice.h"
+#include "Common/Readback/ReadbackQueue.h"
+
+using namespace DX;
+
+namespace
+{
+    // Depth the app reads brightness back with
+    const size_t DEPTH = 3;
+
+    // Fake device whose blocking reads still fail, as a lost device would
+    class RefusingReadbackDevice : public FakeReadbackDevice<float>
+    {
+    public:
+        RefusingReadbackDevice() : FakeReadbackDevice<float>(2) {}
+
+        bool ReadSlot(size_t, void *, size_t, bool) override { return false; }
+    };
+
+    // The frame loop of AnimMain::updateExposure: poll, then enqueue the
+    // frame's value, then the GPU moves on by a frame
+    void testNoBlockingWaits(uint32_t latency)
+    {
+        auto device = std::make_shared<FakeReadbackDevice<float>>(latency);
+        ReadbackQueue<float, float> queue(device, DEPTH);
+
+        const uint64_t FRAMES = 1000;
+        for (uint64_t frame = 0; frame < FRAMES; frame++)
+        {
+            if (queue.Poll())
+            {
+                // The value enqueued on a frame is the frame number
+                CHECK_EQUAL(queue.GetLatest()[0], (float)queue.GetLatestFrame());
+                CHECK_EQUAL(frame - queue.GetLatestFrame(), latency);
+            }
+            CHECK(queue.Enqueue((float)frame, frame));
+            device->AdvanceFrame();
+        }
+
+        CHECK_EQUAL(device->GetBlockingWaitCount(), 0u);
+        CHECK_EQUAL(device->GetStalledFrameCount(), 0u);
+        CHECK_EQUAL(device->GetOverwriteCount(), 0u);
+        CHECK_EQUAL(queue.GetStatistics().dropped, 0u);
+        CHECK_EQUAL(queue.GetStatistics().completed, FRAMES - latency);
+    }
+
+    // A latency past the depth drops frames instead of waiting
+    void testDeepLatencyDrops()
+    {
+        auto device = std::make_shared<FakeReadbackDevice<float>>((uint32_t)DEPTH + 2);
+        ReadbackQueue<float, float> queue(device, DEPTH);
+
+        for (uint64_t frame = 0; frame < 100; frame++)
+        {
+            queue.Poll();
+            queue.Enqueue((float)frame, frame);
+            device->AdvanceFrame();
+        }
+
+        CHECK_EQUAL(device->GetBlockingWaitCount(), 0u);
+        CHECK(queue.GetStatistics().dropped > 0);
+        CHECK(queue.HasValue());
+    }
+
+    void testFlush()
+    {
+        auto device = std::make_shared<FakeReadbackDevice<float>>(3);
+        ReadbackQueue<float, float> queue(device, DEPTH);
+        CHECK(!queue.Flush());
+
+        queue.Enqueue(1.0f, 1);
+        queue.Enqueue(2.0f, 2);
+        CHECK(queue.Flush());
+        CHECK_EQUAL(queue.GetLatest()[0], 2.0f);
+        CHECK_EQUAL(queue.GetLatestFrame(), 2u);
+        CHECK_EQUAL(queue.GetStatistics().skipped, 1u);
+        CHECK_EQUAL(device->GetBlockingWaitCount(), 1u);
+        CHECK(queue.CanEnqueue());
+    }
+
+    void testFlushFailure()
+    {
+        auto device = std::make_shared<RefusingReadbackDevice>();
+        ReadbackQueue<float, float> queue(device, DEPTH);
+
+        queue.Enqueue(1.0f, 1);
+        CHECK(!queue.Flush());
+        CHECK(!queue.HasValue());
+        // The copy stays in flight
+        CHECK(!queue.Flush() && queue.GetStatistics().completed == 0);
+    }
+
+    // Switching between two queues like the L key in the app: the queue
+    // switched back to must not deliver results from before it went idle
+    void testSwitchQueues()
+    {
+        const uint32_t LATENCY = 2;
+        std::shared_ptr<FakeReadbackDevice<float>> devices[2] = {
+            std::make_shared<FakeReadbackDevice<float>>(LATENCY),
+            std::make_shared<FakeReadbackDevice<float>>(LATENCY) };
+        ReadbackQueue<float, float> full(devices[0], DEPTH), sparse(devices[1], DEPTH);
+
+        uint64_t maxLag = 0;
+        for (uint64_t frame = 0; frame < 400; frame++)
+        {
+            bool useSparse = (frame / 100) % 2 == 1;
+            auto &queue = useSparse ? sparse : full;
+            if (frame % 100 == 0)
+                queue.Reset();
+
+            if (queue.Poll())
+                CHECK_EQUAL(queue.GetLatest()[0], (float)queue.GetLatestFrame());
+            if (queue.HasValue())
+                maxLag = (std::max)(maxLag, frame - queue.GetLatestFrame());
+            queue.Enqueue((float)frame, frame);
+            devices[0]->AdvanceFrame();
+            devices[1]->AdvanceFrame();
+        }
+
+        CHECK_EQUAL(maxLag, (uint64_t)LATENCY);
+        CHECK_EQUAL(full.GetStatistics().dropped + sparse.GetStatistics().dropped, 0u);
+    }
+
+    void testReset()
+    {
+        auto device = std::make_shared<FakeReadbackDevice<float>>(1);
+        ReadbackQueue<float, float> queue(device, DEPTH);
+        queue.Enqueue(1.0f, 1);
+        device->AdvanceFrame();
+        CHECK(queue.Poll());
+        queue.Enqueue(2.0f, 2);
+        queue.Enqueue(3.0f, 3);
+
+        queue.Reset();
+        CHECK(!queue.HasValue());
+        CHECK_EQUAL(queue.GetStatistics().skipped, 2u);
+        device->AdvanceFrame();
+        CHECK(!queue.Poll());
+        CHECK(queue.CanEnqueue());
+    }
+}
+
+int main()
+{
+    testNoBlockingWaits(2);
+    testNoBlockingWaits(3);
+    testDeepLatencyDrops();
+    testFlush();
+    testFlushFailure();
+    testSwitchQueues();
+    testReset();
+    return Test::Report();
+}
@@ -0,0 +1,91 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "Check.h"
+#include "Common/Backend/NullRenderBackend.h"
+#include "Common/Backend/RecordingRenderBackend.h"
+#include "SceneFrame.h"
+
+using namespace DX;
+
+namespace
+{
+    const uint32_t POST_PASSES = 12;
+
+    // Calls per frame of SceneFrame, fixed so a change in the command
+    // stream shows up here
+    void testFrameCallCounts(uint32_t gridSize)
+    {
+        SceneFrame frame(gridSize, POST_PASSES);
+        NullRenderBackend backend;
+        frame.Record(backend);
+
+        const RenderStatistics &stats = backend.GetStatistics();
+        uint32_t gridDraws = frame.GetGridDrawCount();
+        CHECK_EQUAL(gridDraws, 4u);
+        CHECK_EQUAL(stats.draws, gridDraws + POST_PASSES);
+        CHECK_EQUAL(stats.instances, frame.GetInstanceCount() + POST_PASSES);
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::DrawIndexedInstanced), gridDraws);
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::Draw), POST_PASSES);
+        CHECK_EQUAL(stats.clears, 2u);
+        // Frame constants and the instances
+        CHECK_EQUAL(stats.uploads, 2u);
+        CHECK_EQUAL(stats.uploadBytes, 32 * sizeof(float) + frame.GetInstanceCount() * sizeof(anim::SphereInstance));
+
+        // Scene: 2 targets and viewport, 2 constant buffers, shader (3),
+        // material (2) and geometry (3) once. Post: 8 binds per pass.
+        CHECK_EQUAL(stats.stateChanges, 4u + 8 + 8 * POST_PASSES);
+        CHECK_EQUAL(stats.apiCalls, stats.stateChanges + stats.uploads + stats.clears + stats.draws);
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::BeginEvent), 1 + POST_PASSES);
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::EndEvent), 1 + POST_PASSES);
+
+        // The next frame costs the same
+        RenderStatistics first = stats;
+        backend.Reset();
+        CHECK_EQUAL(backend.GetStatistics().apiCalls, 0u);
+        frame.Record(backend);
+        CHECK_EQUAL(backend.GetStatistics().apiCalls, first.apiCalls);
+        CHECK_EQUAL(backend.GetStatistics().uploadBytes, first.uploadBytes);
+    }
+
+    // The recording keeps exactly the calls the counters saw, in order
+    void testRecordingMatchesCounts()
+    {
+        SceneFrame frame(10, POST_PASSES);
+        RecordingRenderBackend backend;
+        frame.Record(backend);
+
+        const auto &calls = backend.GetCalls();
+        uint64_t counts[(size_t)RenderCall::Count] = {};
+        for (const auto &call : calls)
+            counts[(size_t)call.type]++;
+        for (size_t type = 0; type < (size_t)RenderCall::Count; type++)
+            CHECK_EQUAL(counts[type], backend.GetCallCount((RenderCall)type));
+
+        CHECK(calls.front().type == RenderCall::BeginEvent);
+        CHECK(calls[1].type == RenderCall::OMSetRenderTargets);
+        CHECK(calls.back().type == RenderCall::EndEvent);
+
+        // Draws only come after their targets are bound
+        bool targetsBound = false;
+        for (const auto &call : calls)
+        {
+            if (call.type == RenderCall::OMSetRenderTargets)
+                targetsBound = true;
+            if (call.type == RenderCall::Draw || call.type == RenderCall::DrawIndexedInstanced)
+                CHECK(targetsBound);
+        }
+
+        backend.Reset();
+        CHECK(backend.GetCalls().empty());
+    }
+}
+
+int main()
+{
+    testFrameCallCounts(10);
+    testFrameCallCounts(64);
+    testRecordingMatchesCounts();
+    return Test::Report();
+}
@@ -0,0 +1,163 @@
+#include "pch.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Common/RenderGraph/RenderGraph.h"
+#include "Common/RenderTarget/FakeRenderTargetAllocator.h"
+
+using namespace DX;
+
+namespace
+{
+    typedef RenderGraph<FakeRenderTarget> Graph;
+
+    RenderTargetDesc makeDesc(uint32_t size)
+    {
+        RenderTargetDesc desc;
+        desc.width = desc.height = size;
+        desc.format = 10;
+        return desc;
+    }
+
+    struct Frame
+    {
+        Frame() :
+            allocator(std::make_shared<FakeRenderTargetAllocator>()),
+            pool(allocator),
+            graph(pool, [this](const FakeRenderTarget &texture, const ClearValue &)
+            {
+                cleared.push_back(texture.id);
+            })
+        {
+        }
+
+        void pass(const std::string &name, const std::vector<Graph::Resource> &reads,
+            Graph::Resource write, LoadAction load = LoadAction::DontCare)
+        {
+            graph.AddPass(name, [&](Graph::PassBuilder &builder)
+            {
+                for (Graph::Resource read : reads)
+                    builder.Read(read);
+                builder.Write(write, load);
+            }, [this, name, write](const Graph &executing)
+            {
+                executed.push_back(name);
+                written.push_back(executing.GetTexture(write).id);
+            });
+        }
+
+        std::shared_ptr<FakeRenderTargetAllocator> allocator;
+        RenderTargetPool<FakeRenderTarget> pool;
+        Graph graph;
+
+        std::vector<uint64_t> cleared;
+        std::vector<std::string> executed;
+        std::vector<uint64_t> written;
+    };
+
+    // Big -> Small -> Small2 -> Big2 -> Present into the back buffer, plus
+    // a pass and a clear nobody observes
+    void testCullAndAlias()
+    {
+        Frame frame;
+        Graph &graph = frame.graph;
+
+        FakeRenderTarget backBufferTexture;
+        backBufferTexture.id = 1000;
+        Graph::Resource backBuffer = graph.ImportTexture("BackBuffer", backBufferTexture);
+        Graph::Resource a = graph.CreateTexture("A", makeDesc(256));
+        Graph::Resource b = graph.CreateTexture("B", makeDesc(64));
+        Graph::Resource c = graph.CreateTexture("C", makeDesc(64));
+        Graph::Resource d = graph.CreateTexture("D", makeDesc(256));
+        Graph::Resource e = graph.CreateTexture("E", makeDesc(128));
+
+        graph.AddClear(backBuffer, ClearValue());
+        frame.pass("Big", {}, a);
+        frame.pass("Small", { a }, b);
+        frame.pass("Small2", { b }, c);
+        frame.pass("Big2", { c }, d);
+        frame.pass("Present", { d }, backBuffer, LoadAction::Load);
+        graph.AddClear(e, ClearValue());
+        frame.pass("Unused", { e }, e, LoadAction::Load);
+
+        const Graph::Report &report = graph.Compile();
+        CHECK_EQUAL(report.passCount, 6u);
+        CHECK_EQUAL(report.culledPasses.size(), 1u);
+        CHECK(graph.IsCulled("Unused"));
+        CHECK(!graph.IsCulled("Present"));
+        CHECK_EQUAL(report.clearsRequested, 2u);
+        CHECK_EQUAL(report.clearsExecuted, 1u);
+
+        // D takes A's texture, B and C overlap at Small2 and stay separate
+        CHECK_EQUAL(report.transientTextureCount, 4u);
+        CHECK_EQUAL(report.physicalTextureCount, 3u);
+
+        const uint64_t BIG = 256 * 256 * 16;
+        const uint64_t SMALL = 64 * 64 * 16;
+        // A and B live together at Small
+        CHECK_EQUAL(report.transientBytes, BIG + SMALL);
+        // A's texture stays held until Big2, so Small2 holds all three
+        CHECK_EQUAL(report.aliasedBytes, BIG + 2 * SMALL);
+        CHECK_EQUAL(report.pooledBytes, BIG + 2 * SMALL);
+
+        graph.Execute();
+        CHECK((frame.executed == std::vector<std::string>{ "Big", "Small", "Small2", "Big2", "Present" }));
+        CHECK_EQUAL(frame.written[0], frame.written[3]);
+        CHECK(frame.written[1] != frame.written[2]);
+        CHECK_EQUAL(frame.written[4], 1000u);
+        CHECK((frame.cleared == std::vector<uint64_t>{ 1000 }));
+        CHECK_EQUAL(frame.allocator->GetAllocationCount(), 3u);
+
+        // Everything went back to the pool and the next frame reuses it
+        CHECK_EQUAL(frame.pool.GetStatistics().inUse, 0u);
+        graph.Execute();
+        CHECK_EQUAL(frame.allocator->GetAllocationCount(), 3u);
+        CHECK_THROWS(std::logic_error, graph.GetTexture(a));
+    }
+
+    // A clear overwritten by a full write is dropped, a side effect keeps
+    // a pass whose output nobody reads
+    void testClearsAndSideEffects()
+    {
+        Frame frame;
+        Graph &graph = frame.graph;
+
+        Graph::Resource target = graph.ImportTexture("Target", FakeRenderTarget());
+        Graph::Resource scratch = graph.CreateTexture("Scratch", makeDesc(64));
+        graph.AddClear(target, ClearValue());
+        frame.pass("Fill", {}, target);
+        graph.AddPass("Readback", [&](Graph::PassBuilder &builder)
+        {
+            builder.Write(scratch, LoadAction::DontCare);
+            builder.SideEffect();
+        }, [](const Graph &) {});
+
+        const Graph::Report &report = graph.Compile();
+        CHECK_EQUAL(report.clearsExecuted, 0u);
+        CHECK(!graph.IsCulled("Fill"));
+        CHECK(!graph.IsCulled("Readback"));
+        CHECK_THROWS(std::invalid_argument, graph.IsCulled("Missing"));
+    }
+
+    void testUndefinedContents()
+    {
+        Frame frame;
+        Graph::Resource texture = frame.graph.CreateTexture("Texture", makeDesc(64));
+        Graph::Resource target = frame.graph.ImportTexture("Target", FakeRenderTarget());
+        frame.pass("ReadsGarbage", { texture }, target);
+        CHECK_THROWS(std::logic_error, frame.graph.Compile());
+        CHECK_THROWS(std::out_of_range, frame.pass("Unknown", { 99 }, target));
+    }
+}
+
+int main()
+{
+    testCullAndAlias();
+    testClearsAndSideEffects();
+    testUndefinedContents();
+    return Test::Report();
+}
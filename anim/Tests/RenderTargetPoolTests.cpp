@@ -0,0 +1,123 @@
+#include "pch.h"
+
+#include <cmath>
+#include <memory>
+#include <set>
+
+#include "Check.h"
+#include "Common/RenderTarget/FakeRenderTargetAllocator.h"
+#include "Common/RenderTarget/RenderTargetPool.h"
+
+using namespace DX;
+
+namespace
+{
+    const uint32_t COLOR_FORMAT = 10;
+    const uint32_t DEPTH_FORMAT = 45;
+
+    RenderTargetDesc makeDesc(uint32_t width, uint32_t height, uint32_t format)
+    {
+        RenderTargetDesc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.format = format;
+        return desc;
+    }
+
+    // Dragging the window edge for 300 frames: every frame has a new size and
+    // takes a colour and a depth target, as the render graph does
+    void testResizeDrag()
+    {
+        auto allocator = std::make_shared<FakeRenderTargetAllocator>();
+        std::set<std::pair<uint32_t, uint32_t>> sizeClasses;
+        {
+            RenderTargetPool<FakeRenderTarget> pool(allocator);
+            const int FRAMES = 300;
+            for (int frame = 0; frame < FRAMES; frame++)
+            {
+                uint32_t width = 1280 + (uint32_t)(300 * std::sin(frame * 0.05));
+                uint32_t height = 720 + frame / 3;
+                RenderTargetDesc key = RenderTargetPool<FakeRenderTarget>::GetSizeClass(
+                    makeDesc(width, height, COLOR_FORMAT), pool.GetSizeGranularity());
+                sizeClasses.insert(std::make_pair(key.width, key.height));
+
+                auto color = pool.Acquire(makeDesc(width, height, COLOR_FORMAT));
+                auto depth = pool.Acquire(makeDesc(width, height, DEPTH_FORMAT));
+                CHECK(color->desc.width >= width && color->desc.height >= height);
+                CHECK(color->desc.width % 64 == 0 && color->desc.height % 64 == 0);
+                CHECK_EQUAL(color->desc.format, COLOR_FORMAT);
+                CHECK_EQUAL(depth->desc.format, DEPTH_FORMAT);
+                CHECK(color->id != depth->id);
+                CHECK_EQUAL(pool.GetStatistics().inUse, 2u);
+
+                color.reset();
+                depth.reset();
+                pool.EndFrame();
+            }
+
+            // One colour and one depth texture per size class instead of two per frame
+            const auto &stats = pool.GetStatistics();
+            CHECK_EQUAL(stats.allocations, 2 * sizeClasses.size());
+            CHECK_EQUAL(stats.allocations + stats.reuses, 2u * FRAMES);
+            CHECK_EQUAL(allocator->GetAllocationCount(), stats.allocations);
+            CHECK(stats.allocations * 5 < 2u * FRAMES);
+            CHECK_EQUAL(stats.inUse, 0u);
+            CHECK(stats.peakBytes >= stats.allocatedBytes);
+
+            pool.Trim();
+            CHECK_EQUAL(allocator->GetLiveCount(), 0u);
+            CHECK_EQUAL(pool.GetStatistics().allocatedBytes, 0u);
+            CHECK_EQUAL(pool.GetStatistics().idle, 0u);
+        }
+        CHECK_EQUAL(allocator->GetFreeCount(), allocator->GetAllocationCount());
+    }
+
+    // Idle textures are freed after maxIdleFrames, textures in use never
+    void testIdleExpiry()
+    {
+        auto allocator = std::make_shared<FakeRenderTargetAllocator>();
+        RenderTargetPool<FakeRenderTarget> pool(allocator, 64, 4);
+
+        auto held = pool.Acquire(makeDesc(100, 100, COLOR_FORMAT));
+        pool.Acquire(makeDesc(300, 300, COLOR_FORMAT));
+        CHECK_EQUAL(allocator->GetLiveCount(), 2u);
+
+        for (int frame = 0; frame < 3; frame++)
+            pool.EndFrame();
+        CHECK_EQUAL(allocator->GetLiveCount(), 2u);
+        pool.EndFrame();
+        CHECK_EQUAL(allocator->GetLiveCount(), 1u);
+        CHECK_EQUAL(pool.GetStatistics().trimmed, 1u);
+
+        // A size in the same class reuses the texture
+        held.reset();
+        auto reused = pool.Acquire(makeDesc(120, 90, COLOR_FORMAT));
+        CHECK_EQUAL(pool.GetStatistics().reuses, 1u);
+        CHECK_EQUAL(allocator->GetAllocationCount(), 2u);
+
+        for (int frame = 0; frame < 10; frame++)
+            pool.EndFrame();
+        CHECK_EQUAL(allocator->GetLiveCount(), 1u);
+    }
+
+    void testReferenceOutlivesPool()
+    {
+        auto allocator = std::make_shared<FakeRenderTargetAllocator>();
+        std::shared_ptr<const FakeRenderTarget> texture;
+        {
+            RenderTargetPool<FakeRenderTarget> pool(allocator);
+            texture = pool.Acquire(makeDesc(64, 64, COLOR_FORMAT));
+        }
+        // Dropping it must not touch the destroyed pool
+        texture.reset();
+        CHECK_EQUAL(allocator->GetAllocationCount(), 1u);
+    }
+}
+
+int main()
+{
+    testResizeDrag();
+    testIdleExpiry();
+    testReferenceOutlivesPool();
+    return Test::Report();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Common/Backend/RenderBackend.h"
+#include "Common/DrawQueue/DrawQueue.h"
+#include "Content/SphereGrid.h"
+#include "Content/SphereLODChain.h"
+
+// Stand-in for a D3D11 object. Backends without a device only compare the
+// pointers, so any distinct non-null value will do.
+template <typename T>
+T *FakeObject(uintptr_t id)
+{
+    return reinterpret_cast<T *>(id << 4);
+}
+
+// Command stream shaped like an AnimMain frame without a device: the scene
+// pass clears its targets and draws the instanced sphere grid through a
+// DrawQueue, then a chain of fullscreen passes ping-pongs between two
+// textures, each reading the previous pass's output and unbinding it after.
+class SceneFrame
+{
+public:
+    // Topologies and formats as D3D11 numbers
+    static const uint32_t TRIANGLE_LIST = 4;
+    static const uint32_t TRIANGLE_STRIP = 5;
+    static const uint32_t R32_UINT = 42;
+
+    SceneFrame(uint32_t gridSize, uint32_t postPasses) :
+        m_pool(1),
+        m_grid(gridSize, 5.0f),
+        m_lods({ 8, 16, 32, 64 }, 0.25f),
+        m_queue(m_pool),
+        m_postPasses(postPasses)
+    {
+        DX::DrawShader shader = { FakeObject<ID3D11InputLayout>(1), FakeObject<ID3D11VertexShader>(2),
+            FakeObject<ID3D11PixelShader>(3) };
+        DX::DrawMaterial material = {};
+        material.views[0] = FakeObject<ID3D11ShaderResourceView>(4);
+        material.viewCount = 1;
+        material.sampler = FakeObject<ID3D11SamplerState>(5);
+        DX::DrawGeometry geometry = {};
+        geometry.vertexBuffers[0] = FakeObject<ID3D11Buffer>(6);
+        geometry.vertexBuffers[1] = instanceBuffer();
+        geometry.strides[0] = 16;
+        geometry.strides[1] = sizeof(anim::SphereInstance);
+        geometry.streamCount = 2;
+        geometry.indexBuffer = FakeObject<ID3D11Buffer>(8);
+        geometry.indexFormat = R32_UINT;
+        geometry.topology = TRIANGLE_LIST;
+        m_key = DX::DrawKey::Make(0, m_queue.AddShader(shader), m_queue.AddMaterial(material), 0);
+        m_geometry = m_queue.AddGeometry(geometry);
+
+        // Levels from the grid position, everything visible
+        m_levels.resize(m_grid.GetInstanceCount());
+        for (uint32_t i = 0; i < m_grid.GetInstanceCount(); i++)
+        {
+            m_levels[i] = i * m_lods.GetLevelCount() / m_grid.GetInstanceCount();
+            m_visible.push_back(i);
+        }
+    }
+
+    void Record(DX::RenderBackend &backend)
+    {
+        static const float CLEAR_COLOR[4] = { 0, 0, 0, 1 };
+        D3D11_VIEWPORT viewport = { 0, 0, 1280, 720, 0, 1 };
+
+        ID3D11RenderTargetView *scene = FakeObject<ID3D11RenderTargetView>(20);
+        ID3D11DepthStencilView *depth = FakeObject<ID3D11DepthStencilView>(21);
+        ID3D11Buffer *constants = FakeObject<ID3D11Buffer>(22);
+
+        backend.BeginEvent(L"Scene");
+        backend.OMSetRenderTargets(1, &scene, depth);
+        backend.RSSetViewports(1, &viewport);
+        backend.ClearRenderTargetView(scene, CLEAR_COLOR);
+        backend.ClearDepthStencilView(depth, 3, 1.0f, 0);
+        backend.UpdateBuffer(constants, m_frameConstants, sizeof(m_frameConstants));
+        backend.VSSetConstantBuffers(0, 1, &constants);
+        backend.PSSetConstantBuffers(0, 1, &constants);
+        // Seen from where the app's camera starts
+        DirectX::XMMATRIX view = DirectX::XMMatrixLookAtRH(DirectX::XMVectorSet(0, 0, 5, 1),
+            DirectX::XMVectorSet(0, 0, 0, 1), DirectX::XMVectorSet(0, 1, 0, 0));
+        m_grid.Queue(backend, instanceBuffer(), m_queue, m_key, m_geometry, m_lods, m_levels, m_visible, view);
+        m_queue.Submit(backend);
+        backend.EndEvent();
+
+        // Pass i writes texture i % 2 and reads the other one
+        ID3D11RenderTargetView *targets[2] = { FakeObject<ID3D11RenderTargetView>(30),
+            FakeObject<ID3D11RenderTargetView>(31) };
+        ID3D11ShaderResourceView *sources[2] = { FakeObject<ID3D11ShaderResourceView>(32),
+            FakeObject<ID3D11ShaderResourceView>(33) };
+        ID3D11SamplerState *sampler = FakeObject<ID3D11SamplerState>(34);
+        ID3D11ShaderResourceView *const nullView = nullptr;
+        for (uint32_t i = 0; i < m_postPasses; i++)
+        {
+            backend.BeginEvent(L"Post process");
+            backend.OMSetRenderTargets(1, &targets[i % 2], nullptr);
+            backend.RSSetViewports(1, &viewport);
+            backend.IASetPrimitiveTopology(TRIANGLE_STRIP);
+            backend.VSSetShader(FakeObject<ID3D11VertexShader>(35));
+            backend.PSSetShader(FakeObject<ID3D11PixelShader>(36 + i % 3));
+            backend.PSSetShaderResources(0, 1, &sources[1 - i % 2]);
+            backend.PSSetSamplers(0, 1, &sampler);
+            backend.Draw(4, 0);
+            backend.PSSetShaderResources(0, 1, &nullView);
+            backend.EndEvent();
+        }
+    }
+
+    // Levels of detail that get a draw, each draws its instances at once
+    uint32_t GetGridDrawCount() const
+    {
+        uint32_t count = 0;
+        for (uint32_t l = 0; l < m_lods.GetLevelCount(); l++)
+            if (std::find(m_levels.begin(), m_levels.end(), l) != m_levels.end())
+                count++;
+        return count;
+    }
+    uint32_t GetInstanceCount() const { return m_grid.GetInstanceCount(); }
+    uint32_t GetPostPassCount() const { return m_postPasses; }
+
+private:
+    static ID3D11Buffer *instanceBuffer() { return FakeObject<ID3D11Buffer>(7); }
+
+    DX::ThreadPool m_pool;
+    anim::SphereGrid m_grid;
+    anim::SphereLODChain m_lods;
+    DX::DrawQueue m_queue;
+    uint32_t m_postPasses;
+
+    uint64_t m_key;
+    uint32_t m_geometry;
+    std::vector<uint32_t> m_levels;
+    std::vector<uint32_t> m_visible;
+    float m_frameConstants[32] = {};
+};
@@ -0,0 +1,272 @@
+#include "pch.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Capture/ImageEncoder.h"
+#include "Common/Raster/SoftwareRasterizer.h"
+#include "Content/HeadlessSceneRenderer.h"
+#include "PNGDecoder.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    // Triangles in normalized device coordinates, one id per triangle
+    struct Triangles
+    {
+        std::vector<float> positions;
+        std::vector<uint32_t> indices;
+    };
+
+    // Draw with the id as the only varying, which is flat since w is one
+    void drawIds(SoftwareRasterizer &rasterizer, const Triangles &triangles)
+    {
+        rasterizer.SetShaders(
+            [&](uint32_t vertex, uint32_t, SoftwareRasterizer::Vertex &output)
+            {
+                output.position[0] = triangles.positions[2 * vertex];
+                output.position[1] = triangles.positions[2 * vertex + 1];
+                output.position[2] = 0.5f;
+                output.position[3] = 1.0f;
+                output.varyings[0] = (float)(vertex / 3);
+            },
+            [](const float *varyings, uint32_t, uint32_t, uint32_t, float *color)
+            {
+                color[0] = varyings[0];
+                color[1] = color[2] = 0;
+                color[3] = 1;
+                return true;
+            }, 1);
+        rasterizer.SetCullMode(RasterCullMode::None);
+        rasterizer.SetDepthState(false, false);
+        rasterizer.DrawIndexed(triangles.indices.data(), (uint32_t)triangles.indices.size(), 0);
+        rasterizer.Flush();
+    }
+
+    // Brute force over every pixel centre: snapped vertices, edge functions
+    // in 64 bits and the top-left rule, triangles painted in order
+    std::vector<float> referenceIds(const Triangles &triangles, uint32_t width, uint32_t height)
+    {
+        std::vector<float> ids((size_t)width * height, -1.0f);
+        for (size_t t = 0; t < triangles.indices.size() / 3; t++)
+        {
+            int64_t x[3], y[3];
+            for (int i = 0; i < 3; i++)
+            {
+                const float *p = &triangles.positions[2 * triangles.indices[3 * t + i]];
+                x[i] = (int64_t)std::floor((p[0] * 0.5f + 0.5f) * width * 16 + 0.5f);
+                y[i] = (int64_t)std::floor((0.5f - p[1] * 0.5f) * height * 16 + 0.5f);
+            }
+            int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (area == 0)
+                continue;
+            if (area < 0)
+            {
+                std::swap(x[1], x[2]);
+                std::swap(y[1], y[2]);
+            }
+
+            for (uint32_t py = 0; py < height; py++)
+                for (uint32_t px = 0; px < width; px++)
+                {
+                    int64_t cx = px * 16 + 8, cy = py * 16 + 8;
+                    bool inside = true;
+                    for (int e = 0; e < 3; e++)
+                    {
+                        int i = e, j = (e + 1) % 3;
+                        int64_t a = y[i] - y[j], b = x[j] - x[i];
+                        int64_t edge = a * (cx - x[i]) + b * (cy - y[i]);
+                        bool topLeft = a > 0 || (a == 0 && b > 0);
+                        inside &= edge > 0 || (edge == 0 && topLeft);
+                    }
+                    if (inside)
+                        ids[(size_t)py * width + px] = (float)t;
+                }
+        }
+        return ids;
+    }
+
+    std::vector<float> targetIds(const RasterTarget &target)
+    {
+        std::vector<float> ids((size_t)target.GetWidth() * target.GetHeight());
+        for (uint32_t y = 0; y < target.GetHeight(); y++)
+            for (uint32_t x = 0; x < target.GetWidth(); x++)
+                ids[(size_t)y * target.GetWidth() + x] = target.GetColor()[((size_t)y * target.GetPitch() + x) * 4];
+        return ids;
+    }
+
+    // Random triangles of every size and orientation, some past the edges,
+    // match the brute force rasterizer exactly on one thread and on four
+    void testMatchesReference()
+    {
+        const uint32_t WIDTH = 97, HEIGHT = 61;
+        std::mt19937 random(17);
+        std::uniform_real_distribution<float> coordinate(-1.2f, 1.2f), offset(-0.15f, 0.15f);
+        Triangles triangles;
+        for (uint32_t t = 0; t < 3000; t++)
+        {
+            // Mostly small triangles, every tenth a large one
+            float cx = coordinate(random), cy = coordinate(random);
+            for (int i = 0; i < 3; i++)
+            {
+                triangles.positions.push_back(t % 10 ? cx + offset(random) : coordinate(random));
+                triangles.positions.push_back(t % 10 ? cy + offset(random) : coordinate(random));
+                triangles.indices.push_back(3 * t + i);
+            }
+        }
+        std::vector<float> expected = referenceIds(triangles, WIDTH, HEIGHT);
+
+        for (unsigned threads : { 1u, 4u })
+        {
+            ThreadPool pool(threads);
+            SoftwareRasterizer rasterizer(pool);
+            RasterTarget target(WIDTH, HEIGHT);
+            const float clear[4] = { -1, 0, 0, 0 };
+            target.Clear(clear);
+            rasterizer.SetRenderTarget(&target);
+            drawIds(rasterizer, triangles);
+            CHECK(targetIds(target) == expected);
+            CHECK_EQUAL(rasterizer.GetStatistics().triangles, 3000u);
+        }
+    }
+
+    // A jittered mesh over the whole target, with random diagonals, covers
+    // every pixel exactly once: shared edges are neither doubled nor missed
+    void testMeshCoversOnce()
+    {
+        const uint32_t WIDTH = 130, HEIGHT = 70, CELLS = 23;
+        std::mt19937 random(5);
+        std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+        Triangles mesh;
+        for (uint32_t j = 0; j <= CELLS; j++)
+            for (uint32_t i = 0; i <= CELLS; i++)
+            {
+                bool borderX = i == 0 || i == CELLS, borderY = j == 0 || j == CELLS;
+                mesh.positions.push_back(-1 + 2 * (i + (borderX ? 0 : jitter(random))) / CELLS);
+                mesh.positions.push_back(-1 + 2 * (j + (borderY ? 0 : jitter(random))) / CELLS);
+            }
+        for (uint32_t j = 0; j < CELLS; j++)
+            for (uint32_t i = 0; i < CELLS; i++)
+            {
+                uint32_t a = j * (CELLS + 1) + i, b = a + 1, c = a + CELLS + 1, d = c + 1;
+                const uint32_t quad[2][6] = { { a, b, d, a, d, c }, { a, b, c, b, d, c } };
+                const uint32_t *pick = quad[random() % 2];
+                mesh.indices.insert(mesh.indices.end(), pick, pick + 6);
+            }
+
+        ThreadPool pool(4);
+        SoftwareRasterizer rasterizer(pool);
+        RasterTarget target(WIDTH, HEIGHT);
+        rasterizer.SetRenderTarget(&target);
+        std::vector<uint32_t> coverage((size_t)WIDTH * HEIGHT, 0);
+        rasterizer.SetShaders(
+            [&](uint32_t vertex, uint32_t, SoftwareRasterizer::Vertex &output)
+            {
+                output.position[0] = mesh.positions[2 * vertex];
+                output.position[1] = mesh.positions[2 * vertex + 1];
+                output.position[2] = 0.5f;
+                output.position[3] = 1.0f;
+            },
+            // Each pixel lies in one tile and tiles run on one thread each
+            [&](const float *, uint32_t, uint32_t x, uint32_t y, float *color)
+            {
+                coverage[(size_t)y * WIDTH + x]++;
+                color[0] = color[1] = color[2] = color[3] = 1;
+                return true;
+            }, 0);
+        rasterizer.SetCullMode(RasterCullMode::None);
+        rasterizer.SetDepthState(false, false);
+        rasterizer.DrawIndexed(mesh.indices.data(), (uint32_t)mesh.indices.size(), 0);
+        rasterizer.Flush();
+
+        size_t wrong = 0;
+        for (uint32_t count : coverage)
+            wrong += count != 1;
+        CHECK_EQUAL(wrong, 0u);
+        CHECK_EQUAL(rasterizer.GetStatistics().pixelsWritten, (uint64_t)WIDTH * HEIGHT);
+    }
+
+    // The scene the way the app starts it up, tonemapped to 8 bits
+    std::vector<uint8_t> renderScene(ThreadPool &pool, uint32_t width, uint32_t height)
+    {
+        anim::HeadlessSceneRenderer renderer(width, height, pool);
+        renderer.SetLightStrength(0, 10);
+        renderer.SetLightStrength(1, 10);
+        renderer.SetLightStrength(2, 10);
+
+        XMFLOAT3 cameraPos(1.5f, 1.0f, 6.0f);
+        XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(cameraPos.x, cameraPos.y, cameraPos.z, 1),
+            XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 0));
+        XMMATRIX projection = XMMatrixPerspectiveFovRH(70.0f * 3.14159265f / 180, (float)width / height, 0.01f, 1000.0f);
+        renderer.Render(view, projection, cameraPos);
+
+        const RasterTarget &target = renderer.GetTarget();
+        std::vector<uint8_t> rgba((size_t)width * height * 4);
+        for (uint32_t y = 0; y < height; y++)
+            for (uint32_t x = 0; x < width; x++)
+                for (int c = 0; c < 4; c++)
+                {
+                    float value = target.GetColor()[((size_t)y * target.GetPitch() + x) * 4 + c];
+                    value = c == 3 ? 1 : std::pow(value / (1 + value), 1 / 2.2f);
+                    rgba[((size_t)y * width + x) * 4 + c] = (uint8_t)(value * 255 + 0.5f);
+                }
+        return rgba;
+    }
+
+    // The headless scene against Golden/HeadlessScene.png. Set
+    // ANIM_UPDATE_GOLDEN to write the image instead after a deliberate change.
+    void testHeadlessSceneGolden()
+    {
+        const uint32_t WIDTH = 160, HEIGHT = 90;
+        ThreadPool serial(1), parallel(4);
+        std::vector<uint8_t> image = renderScene(serial, WIDTH, HEIGHT);
+        CHECK(renderScene(parallel, WIDTH, HEIGHT) == image);
+
+        std::string fileName = std::string(ANIM_GOLDEN_DIR) + "/HeadlessScene.png";
+        if (std::getenv("ANIM_UPDATE_GOLDEN"))
+        {
+            std::vector<uint8_t> png = ImageEncoder::EncodePNG(image.data(), false, WIDTH, HEIGHT, WIDTH * 4);
+            std::ofstream(fileName, std::ios::binary).write((const char *)png.data(), png.size());
+            std::printf("wrote %s\n", fileName.c_str());
+        }
+
+        std::ifstream file(fileName, std::ios::binary);
+        CHECK(file.good());
+        std::vector<uint8_t> png((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (png.empty())
+            return;
+        uint32_t width = 0, height = 0;
+        std::vector<uint8_t> golden = Test::DecodePNG(png, width, height);
+        CHECK(width == WIDTH && height == HEIGHT);
+        if (golden.size() != (size_t)WIDTH * HEIGHT * 3)
+            return;
+
+        // Other compilers may round a few edge pixels differently
+        size_t different = 0;
+        for (size_t p = 0; p < (size_t)WIDTH * HEIGHT; p++)
+            for (int c = 0; c < 3; c++)
+                if (std::abs(image[p * 4 + c] - golden[p * 3 + c]) > 2)
+                {
+                    different++;
+                    break;
+                }
+        CHECK(different * 500 <= (size_t)WIDTH * HEIGHT);
+    }
+}
+
+int main()
+{
+    testMatchesReference();
+    testMeshCoversOnce();
+    testHeadlessSceneGolden();
+    return Test::Report();
+}
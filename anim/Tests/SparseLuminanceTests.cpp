@@ -0,0 +1,151 @@
+#include "pch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "Check.h"
+#include "Common/PostProcess/LuminanceReduction.h"
+#include "Common/PostProcess/SparseLuminanceEstimator.h"
+
+using namespace DX;
+
+namespace
+{
+    const uint32_t WIDTH = 320;
+    const uint32_t HEIGHT = 180;
+    // Rows padded like a mapped texture
+    const size_t PITCH = WIDTH * 4 + 8;
+
+    enum class Scene
+    {
+        // Vertical gradient with a soft sun, the image of the benchmark
+        Sun,
+        // Random cells of 5x5 pixels over 16 stops, a rough texture
+        Cells,
+        // Dark ground, bright sky and a small hard-edged lamp
+        Blocks
+    };
+
+    std::vector<float> makeImage(Scene scene)
+    {
+        std::vector<float> rgba(PITCH * HEIGHT, -1.0f);
+        for (uint32_t y = 0; y < HEIGHT; y++)
+            for (uint32_t x = 0; x < WIDTH; x++)
+            {
+                float *p = rgba.data() + y * PITCH + 4 * x;
+                float l = 0;
+                switch (scene)
+                {
+                case Scene::Sun:
+                {
+                    float dx = x - WIDTH * 0.7f, dy = y - HEIGHT * 0.3f;
+                    l = 0.05f + 0.5f * y / HEIGHT + 40 * std::exp(-(dx * dx + dy * dy) / 800.0f);
+                    break;
+                }
+                case Scene::Cells:
+                {
+                    uint32_t cell = (y / 5) * 1000 + x / 5;
+                    uint32_t state = (cell * 2654435761u ^ 33) * 1664525u + 1013904223u;
+                    l = std::exp2((state >> 8) / 16777216.0f * 16.0f - 6.0f);
+                    break;
+                }
+                case Scene::Blocks:
+                    l = y < HEIGHT / 3 ? 8.0f : 0.02f;
+                    if (x >= 200 && x < 216 && y >= 100 && y < 110)
+                        l = 500.0f;
+                    break;
+                }
+                p[0] = 1.1f * l;
+                p[1] = l;
+                p[2] = 0.8f * l;
+                p[3] = 1;
+            }
+        return rgba;
+    }
+
+    // On fixed images the full resolution mean lies within GetErrorBound of
+    // the estimate in at least 95% of the frames, and every estimate reads
+    // one pixel per sample
+    void testErrorBound()
+    {
+        LuminanceReduction reduction;
+        for (Scene scene : { Scene::Sun, Scene::Cells, Scene::Blocks })
+        {
+            std::vector<float> rgba = makeImage(scene);
+            float full = reduction.Reduce(rgba.data(), WIDTH, HEIGHT, PITCH).averageLogBrightness;
+
+            for (uint32_t sampleCount : { 256u, 1000u, 1024u })
+            {
+                const uint32_t FRAMES = 200;
+                uint32_t inside = 0;
+                for (uint32_t seed : { 1u, 7u })
+                {
+                    SparseLuminanceEstimator estimator(sampleCount, seed);
+                    for (uint64_t frame = 0; frame < FRAMES; frame++)
+                    {
+                        SparseLuminanceEstimate estimate = estimator.Estimate(rgba.data(), WIDTH, HEIGHT,
+                            PITCH, frame);
+                        CHECK_EQUAL(estimate.sampleCount, sampleCount);
+                        CHECK_EQUAL(estimate.bytesRead, (uint64_t)sampleCount * 16);
+                        CHECK(estimate.standardError > 0);
+                        inside += std::fabs(estimate.averageLogBrightness - full) <= estimate.GetErrorBound();
+                    }
+                }
+                double rate = inside / (2.0 * FRAMES);
+                std::printf("scene %d, %u samples: %.1f%% inside the bound\n", (int)scene, sampleCount,
+                    rate * 100);
+                CHECK(rate >= 0.95);
+            }
+        }
+    }
+
+    // Samples land inside the image at every resolution and every frame
+    void testSamplePixels()
+    {
+        SparseLuminanceEstimator estimator(64);
+        for (const float point : estimator.GetPoints())
+            CHECK(point >= 0 && point < 1);
+        for (uint64_t frame : { 0ull, 1ull, 1000ull, 123456789ull })
+            for (uint32_t size : { 1u, 3u, 1920u })
+                for (uint32_t sample = 0; sample < estimator.GetSampleCount(); sample++)
+                {
+                    uint32_t x, y;
+                    estimator.GetSamplePixel(sample, frame, size, size / 2 + 1, x, y);
+                    CHECK(x < size && y < size / 2 + 1);
+                }
+
+        // A uniform image has no error
+        std::vector<float> rgba = { 2, 2, 2, 1 };
+        SparseLuminanceEstimate estimate = estimator.Estimate(rgba.data(), 1, 1, 4, 5);
+        CHECK_NEAR(estimate.averageLogBrightness, std::log(3.0f), 1e-4f);
+        CHECK_EQUAL(estimate.standardError, 0.0f);
+        CHECK_EQUAL(estimate.bytesRead, (uint64_t)64 * 16);
+    }
+
+    void testSummarize()
+    {
+        // Every other value, so stride is honoured
+        const float values[] = { 1, 100, 2, 100, 3, 100, 4, 100 };
+        SparseLuminanceEstimate estimate = SparseLuminanceEstimator::Summarize(values, 4, 2);
+        CHECK_EQUAL(estimate.sampleCount, 4u);
+        CHECK_NEAR(estimate.averageLogBrightness, 2.5f, 1e-6f);
+        // Sample variance 5/3 over 4 samples
+        CHECK_NEAR(estimate.standardError, std::sqrt(5.0f / 12.0f), 1e-6f);
+        CHECK_NEAR(estimate.GetErrorBound(), 1.96f * std::sqrt(5.0f / 12.0f), 1e-6f);
+        CHECK_EQUAL(estimate.bytesRead, 0u);
+
+        CHECK_EQUAL(SparseLuminanceEstimator::Summarize(values, 0, 1).sampleCount, 0u);
+        CHECK_EQUAL(SparseLuminanceEstimator::Summarize(values, 1, 1).standardError, 0.0f);
+        CHECK_THROWS(std::invalid_argument, SparseLuminanceEstimator estimator(0));
+    }
+}
+
+int main()
+{
+    testErrorBound();
+    testSamplePixels();
+    testSummarize();
+    return Test::Report();
+}
@@ -0,0 +1,161 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "Check.h"
+#include "Common/Backend/RecordingRenderBackend.h"
+#include "Common/DrawQueue/DrawQueue.h"
+#include "Content/SphereGrid.h"
+#include "Content/SphereLODChain.h"
+
+using namespace DX;
+
+namespace
+{
+    struct GridFrame
+    {
+        uint64_t uploads;
+        uint64_t uploadBytes;
+        uint64_t draws;
+        uint64_t instances;
+        size_t calls;
+    };
+
+    // Queue and submit one frame of the grid, the way the scene renderer
+    // does, and count what reached the backend
+    GridFrame recordFrame(uint32_t gridSize, bool everyOther)
+    {
+        anim::SphereGrid grid(gridSize, 10.0f);
+        anim::SphereLODChain lods({ 8, 16, 32 }, 0.5f);
+
+        std::vector<uint32_t> levels(grid.GetInstanceCount()), visible;
+        for (uint32_t i = 0; i < grid.GetInstanceCount(); i++)
+        {
+            levels[i] = i % lods.GetLevelCount();
+            if (!everyOther || i % 2 == 0)
+                visible.push_back(i);
+        }
+
+        ThreadPool pool(1);
+        DrawQueue queue(pool);
+        DrawShader shader = {};
+        DrawMaterial material = {};
+        DrawGeometry geometry = {};
+        uint64_t key = DrawKey::Make(0, queue.AddShader(shader), queue.AddMaterial(material), 0);
+        uint32_t geometryId = queue.AddGeometry(geometry);
+
+        RecordingRenderBackend backend;
+        grid.Queue(backend, nullptr, queue, key, geometryId, lods, levels, visible, DirectX::XMMatrixIdentity());
+        queue.Submit(backend);
+
+        // Every instance is drawn once, with its level's mesh
+        uint64_t instances = 0;
+        for (const auto &call : backend.GetCalls())
+            if (call.type == RenderCall::DrawIndexedInstanced)
+                instances += call.count;
+        CHECK_EQUAL(instances, visible.size());
+        CHECK_EQUAL(backend.GetStatistics().instances, visible.size());
+
+        const RenderStatistics &stats = backend.GetStatistics();
+        CHECK_EQUAL(stats.uploadBytes, visible.size() * sizeof(anim::SphereInstance));
+        // A whole buffer update would copy the full grid on D3D11
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::UpdateBufferRange), 1u);
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::UpdateBuffer), 0u);
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::DrawIndexed), 0u);
+        CHECK_EQUAL(backend.GetCallCount(RenderCall::Draw), 0u);
+        return { stats.uploads, stats.uploadBytes, stats.draws, stats.instances, backend.GetCalls().size() };
+    }
+
+    // One upload and one draw per level in use, whatever the grid size
+    void testConstantCallCount()
+    {
+        GridFrame small = recordFrame(4, false);
+        GridFrame large = recordFrame(64, false);
+
+        CHECK_EQUAL(small.uploads, 1u);
+        CHECK_EQUAL(large.uploads, 1u);
+        CHECK_EQUAL(small.draws, 3u);
+        CHECK_EQUAL(large.draws, 3u);
+        CHECK_EQUAL(large.instances, 64u * 64);
+        CHECK_EQUAL(small.calls, large.calls);
+    }
+
+    // Culled instances are neither uploaded nor drawn
+    void testVisibleSubset()
+    {
+        GridFrame frame = recordFrame(16, true);
+        CHECK_EQUAL(frame.uploads, 1u);
+        CHECK_EQUAL(frame.instances, 16u * 16 / 2);
+        CHECK_EQUAL(frame.draws, 3u);
+
+        anim::SphereGrid grid(4, 1.0f);
+        anim::SphereLODChain lods({ 8, 16 }, 0.5f);
+        ThreadPool pool(1);
+        DrawQueue queue(pool);
+        RecordingRenderBackend backend;
+        grid.Queue(backend, nullptr, queue, 0, 0, lods, std::vector<uint32_t>(16, 0), std::vector<uint32_t>(),
+            DirectX::XMMatrixIdentity());
+        CHECK_EQUAL(queue.GetPacketCount(), 0u);
+        CHECK(backend.GetCalls().empty());
+    }
+
+    // Levels draw in the order of their nearest sphere, here the coarsest
+    // level first since it holds the row next to the camera
+    void testDrawsFrontToBack()
+    {
+        const uint32_t SIZE = 6;
+        anim::SphereGrid grid(SIZE, 10.0f);
+        anim::SphereLODChain lods({ 8, 16, 32 }, 0.5f);
+
+        // Instance i * SIZE + j is in row j, rows go up along y. The top row
+        // gets level 2, the two below level 1, the rest level 0.
+        std::vector<uint32_t> levels(grid.GetInstanceCount()), visible;
+        for (uint32_t i = 0; i < grid.GetInstanceCount(); i++)
+        {
+            uint32_t row = i % SIZE;
+            levels[i] = row == SIZE - 1 ? 2 : row >= SIZE - 3 ? 1 : 0;
+            visible.push_back(i);
+        }
+
+        ThreadPool pool(1);
+        DrawQueue queue(pool);
+        DrawShader shader = {};
+        DrawMaterial material = {};
+        DrawGeometry geometry = {};
+        uint64_t key = DrawKey::Make(0, queue.AddShader(shader), queue.AddMaterial(material), 0);
+        uint32_t geometryId = queue.AddGeometry(geometry);
+
+        RecordingRenderBackend backend;
+        // Above the grid's top edge, looking down at its centre
+        DirectX::XMMATRIX view = DirectX::XMMatrixLookAtRH(DirectX::XMVectorSet(0, 20, 5, 1),
+            DirectX::XMVectorSet(0, 0, 0, 1), DirectX::XMVectorSet(0, 0, 1, 0));
+        grid.Queue(backend, nullptr, queue, key, geometryId, lods, levels, visible, view);
+        queue.Submit(backend);
+
+        std::vector<uint32_t> instanceCounts;
+        for (const auto &call : backend.GetCalls())
+            if (call.type == RenderCall::DrawIndexedInstanced)
+                instanceCounts.push_back(call.count);
+        CHECK(instanceCounts == std::vector<uint32_t>({ SIZE, 2 * SIZE, 3 * SIZE }));
+    }
+
+    void testDepthField()
+    {
+        // Nearer is smaller, up to the precision kept
+        CHECK(DrawKey::FrontToBack(1.0f) < DrawKey::FrontToBack(1.01f));
+        CHECK(DrawKey::FrontToBack(0.5f) < DrawKey::FrontToBack(250.0f));
+        CHECK_EQUAL(DrawKey::FrontToBack(-1.0f), 0u);
+        CHECK(DrawKey::BackToFront(1.0f) > DrawKey::BackToFront(2.0f));
+        // The field survives Make
+        CHECK_EQUAL(DrawKey::GetDepth(DrawKey::Make(1, 2, 3, DrawKey::FrontToBack(7.5f))), DrawKey::FrontToBack(7.5f));
+    }
+}
+
+int main()
+{
+    testConstantCallCount();
+    testVisibleSubset();
+    testDrawsFrontToBack();
+    testDepthField();
+    return Test::Report();
+}
@@ -0,0 +1,166 @@
+#include "pch.h"
+
+#include <vector>
+
+#include "Check.h"
+#include "Common/Backend/RecordingRenderBackend.h"
+#include "Common/Backend/StateCacheRenderBackend.h"
+#include "SceneFrame.h"
+
+using namespace DX;
+
+namespace
+{
+    // Views of texture t: shader resource view 100 + t, render target view 200 + t
+    ID3D11ShaderResourceView *textureView(uintptr_t texture) { return FakeObject<ID3D11ShaderResourceView>(100 + texture); }
+    ID3D11RenderTargetView *textureTarget(uintptr_t texture) { return FakeObject<ID3D11RenderTargetView>(200 + texture); }
+    uintptr_t textureOf(const void *view) { return ((uintptr_t)view >> 4) % 100; }
+
+    // Recording backend that also keeps the pixel shader resources the way
+    // the D3D11 runtime does: binding a texture as a render target unbinds
+    // its shader resource views, and a view of a bound target is not bound.
+    class RuntimeModelBackend : public RecordingRenderBackend
+    {
+    public:
+        ID3D11ShaderResourceView *views[8] = {};
+        std::vector<ID3D11RenderTargetView *> targets;
+
+        void PSSetShaderResources(uint32_t startSlot, uint32_t count, ID3D11ShaderResourceView *const *bound) override
+        {
+            for (uint32_t i = 0; i < count; i++)
+                views[startSlot + i] = isTarget(bound[i]) ? nullptr : bound[i];
+            RecordingRenderBackend::PSSetShaderResources(startSlot, count, bound);
+        }
+
+        void OMSetRenderTargets(uint32_t count, ID3D11RenderTargetView *const *bound, ID3D11DepthStencilView *depth) override
+        {
+            targets.assign(bound, bound + count);
+            for (auto &view : views)
+                if (isTarget(view))
+                    view = nullptr;
+            RecordingRenderBackend::OMSetRenderTargets(count, bound, depth);
+        }
+
+    private:
+        bool isTarget(ID3D11ShaderResourceView *view) const
+        {
+            for (auto target : targets)
+                if (view && textureOf(view) == textureOf(target))
+                    return true;
+            return false;
+        }
+    };
+
+    // The SceneFrame through the cache: the same draws, only redundant binds dropped
+    void testFilteredFrame()
+    {
+        SceneFrame frame(10, 12);
+        RecordingRenderBackend direct;
+        frame.Record(direct);
+
+        RecordingRenderBackend behind;
+        StateCacheRenderBackend cache(&behind);
+        cache.BeginFrame();
+        frame.Record(cache);
+
+        const StateCacheStatistics &stats = cache.GetStatistics();
+        CHECK_EQUAL(stats.forwarded, behind.GetStatistics().apiCalls);
+        CHECK_EQUAL(stats.forwarded + stats.filtered, direct.GetStatistics().apiCalls);
+        // Per post pass after the first: viewport, topology, vertex shader
+        // and sampler repeat; the first pass repeats the scene's viewport
+        CHECK_EQUAL(stats.filtered, 12u + 3 * 11);
+
+        // Nothing but binds is ever dropped
+        CHECK_EQUAL(behind.GetStatistics().draws, direct.GetStatistics().draws);
+        CHECK_EQUAL(behind.GetStatistics().instances, direct.GetStatistics().instances);
+        CHECK_EQUAL(behind.GetStatistics().uploadBytes, direct.GetStatistics().uploadBytes);
+        CHECK_EQUAL(behind.GetStatistics().clears, direct.GetStatistics().clears);
+
+        // Without BeginFrame the next frame starts from the last one's state
+        uint64_t firstFrameForwarded = stats.forwarded;
+        behind.Reset();
+        frame.Record(cache);
+        CHECK(behind.GetStatistics().apiCalls < firstFrameForwarded);
+        cache.BeginFrame();
+        CHECK_EQUAL(cache.GetStatistics().forwarded, 0u);
+        behind.Reset();
+        frame.Record(cache);
+        CHECK_EQUAL(cache.GetStatistics().forwarded, firstFrameForwarded);
+    }
+
+    // A texture read by one pass, written by the next and read again: the
+    // runtime unbinds its view in between, so the last bind must go through
+    void testViewUnboundByRenderTarget()
+    {
+        RuntimeModelBackend runtime;
+        StateCacheRenderBackend cache(&runtime);
+        cache.BeginFrame();
+
+        ID3D11ShaderResourceView *a = textureView(1);
+        ID3D11RenderTargetView *targetA = textureTarget(1), *targetB = textureTarget(2);
+
+        cache.OMSetRenderTargets(1, &targetB, nullptr);
+        cache.PSSetShaderResources(0, 1, &a);
+        cache.Draw(4, 0);
+        CHECK(runtime.views[0] == a);
+
+        // Pass writing A without unbinding its view first
+        cache.OMSetRenderTargets(1, &targetA, nullptr);
+        cache.Draw(4, 0);
+        CHECK(runtime.views[0] == nullptr);
+
+        // Back to B, reading A again
+        uint64_t forwarded = cache.GetStatistics().forwarded;
+        cache.OMSetRenderTargets(1, &targetB, nullptr);
+        cache.PSSetShaderResources(0, 1, &a);
+        cache.Draw(4, 0);
+        CHECK(runtime.views[0] == a);
+        CHECK_EQUAL(cache.GetStatistics().forwarded, forwarded + 3);
+
+        // With the targets unchanged a repeated bind is still dropped
+        cache.PSSetShaderResources(0, 1, &a);
+        CHECK_EQUAL(cache.GetStatistics().filtered, 1u);
+        CHECK_EQUAL(runtime.GetCallCount(RenderCall::PSSetShaderResources), 2u);
+    }
+
+    // Range binds only pass on the slots that change
+    void testPartialRanges()
+    {
+        RecordingRenderBackend behind;
+        StateCacheRenderBackend cache(&behind);
+        cache.BeginFrame();
+
+        ID3D11SamplerState *samplers[3] = { FakeObject<ID3D11SamplerState>(1),
+            FakeObject<ID3D11SamplerState>(2), FakeObject<ID3D11SamplerState>(3) };
+        cache.PSSetSamplers(0, 3, samplers);
+        samplers[1] = FakeObject<ID3D11SamplerState>(4);
+        cache.PSSetSamplers(0, 3, samplers);
+        cache.PSSetSamplers(0, 3, samplers);
+
+        const auto &calls = behind.GetCalls();
+        CHECK_EQUAL(calls.size(), 2u);
+        CHECK_EQUAL(calls[0].count, 3u);
+        CHECK_EQUAL(calls[1].count, 1u);
+        CHECK_EQUAL(cache.GetStatistics().filtered, 1u);
+
+        // A constant range forgets the slot, the whole buffer binds again after
+        ID3D11Buffer *buffer = FakeObject<ID3D11Buffer>(9);
+        cache.VSSetConstantBuffers(1, 1, &buffer);
+        cache.VSSetConstantBufferRange(1, buffer, 16, 16);
+        cache.VSSetConstantBuffers(1, 1, &buffer);
+        CHECK_EQUAL(behind.GetCallCount(RenderCall::VSSetConstantBuffers), 2u);
+
+        // Invalidate after binding past the cache
+        cache.Invalidate();
+        cache.PSSetSamplers(0, 3, samplers);
+        CHECK_EQUAL(behind.GetCallCount(RenderCall::PSSetSamplers), 3u);
+    }
+}
+
+int main()
+{
+    testFilteredFrame();
+    testViewUnboundByRenderTarget();
+    testPartialRanges();
+    return Test::Report();
+}
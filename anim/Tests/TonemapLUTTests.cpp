@@ -0,0 +1,53 @@
+#include "pch.h"
+
+#include <cmath>
+#include <vector>
+
+#include "Check.h"
+#include "Common/PostProcess/TonemapLUT.h"
+
+using namespace DX;
+
+namespace
+{
+    // The four pixel path, its scalar tail and in place use agree with the
+    // per channel lookup and stay close to the exact curve
+    void testBatchMatchesScalar(size_t pixelCount)
+    {
+        const float EXPOSURE = 0.35f;
+        std::vector<float> in(pixelCount * 4);
+        for (size_t i = 0; i < in.size(); i++)
+            in[i] = i % 4 == 3 ? 0.5f : std::exp2(-10.0f + 20.0f * i / in.size());
+        in[0] = 0.0f;
+        in[1] = -1.0f;
+
+        TonemapLUT lut;
+        std::vector<float> out(in.size());
+        lut.Apply(in.data(), out.data(), pixelCount, EXPOSURE);
+
+        for (size_t p = 0; p < pixelCount; p++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                float x = in[4 * p + c] * EXPOSURE;
+                CHECK_NEAR(out[4 * p + c], lut.Apply(x), 1e-5);
+                // Outside the table range the output holds the first or last entry
+                if (x > std::exp2(-20.0f) && x < 256.0f)
+                    CHECK_NEAR(out[4 * p + c], lut.EvaluateDirect(x), 1e-4);
+            }
+            CHECK_EQUAL(out[4 * p + 3], 1.0f);
+        }
+
+        std::vector<float> inPlace = in;
+        lut.Apply(inPlace.data(), inPlace.data(), pixelCount, EXPOSURE);
+        CHECK(inPlace == out);
+    }
+}
+
+int main()
+{
+    testBatchMatchesScalar(1);
+    testBatchMatchesScalar(4);
+    testBatchMatchesScalar(1027);
+    return Test::Report();
+}
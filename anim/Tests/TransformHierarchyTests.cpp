@@ -0,0 +1,210 @@
+#include "pch.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Scene/TransformHierarchy.h"
+
+using namespace DX;
+using namespace DirectX;
+
+namespace
+{
+    struct Node
+    {
+        uint32_t parent;
+        XMFLOAT3 position;
+        XMFLOAT4 rotation;
+        XMFLOAT3 scale;
+    };
+
+    // Random forest in topological order: most nodes hang below an earlier
+    // one, so levels get wider than a thread pool chunk
+    std::vector<Node> randomForest(size_t count, std::mt19937 &random)
+    {
+        std::uniform_real_distribution<float> unit(-1, 1), scale(0.5f, 2);
+        std::vector<Node> nodes(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            Node &node = nodes[i];
+            node.parent = i < 10 || random() % 50 == 0 ? TransformHierarchy::NO_PARENT : (uint32_t)(random() % i);
+            node.position = XMFLOAT3(unit(random) * 10, unit(random) * 10, unit(random) * 10);
+            float q[4] = { unit(random), unit(random), unit(random), unit(random) };
+            float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+            node.rotation = XMFLOAT4(q[0] / length, q[1] / length, q[2] / length, q[3] / length);
+            node.scale = XMFLOAT3(scale(random), scale(random), scale(random));
+        }
+        return nodes;
+    }
+
+    // Scale * rotation * translation, then times the parent's world matrix, in double
+    void referenceWorld(const std::vector<Node> &nodes, std::vector<double> &world)
+    {
+        world.resize(nodes.size() * 16);
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const Node &n = nodes[i];
+            double x = n.rotation.x, y = n.rotation.y, z = n.rotation.z, w = n.rotation.w;
+            double local[16] =
+            {
+                n.scale.x * (1 - 2 * (y * y + z * z)), n.scale.x * 2 * (x * y + w * z), n.scale.x * 2 * (x * z - w * y), 0,
+                n.scale.y * 2 * (x * y - w * z), n.scale.y * (1 - 2 * (x * x + z * z)), n.scale.y * 2 * (y * z + w * x), 0,
+                n.scale.z * 2 * (x * z + w * y), n.scale.z * 2 * (y * z - w * x), n.scale.z * (1 - 2 * (x * x + y * y)), 0,
+                n.position.x, n.position.y, n.position.z, 1,
+            };
+
+            double *result = &world[i * 16];
+            if (n.parent == TransformHierarchy::NO_PARENT)
+            {
+                std::memcpy(result, local, sizeof(local));
+                continue;
+            }
+            const double *parent = &world[n.parent * 16];
+            for (int r = 0; r < 4; r++)
+                for (int c = 0; c < 4; c++)
+                {
+                    double sum = 0;
+                    for (int k = 0; k < 4; k++)
+                        sum += local[r * 4 + k] * parent[k * 4 + c];
+                    result[r * 4 + c] = sum;
+                }
+        }
+    }
+
+    void build(TransformHierarchy &hierarchy, const std::vector<Node> &nodes)
+    {
+        for (const Node &node : nodes)
+            hierarchy.Add(node.parent, node.position, node.rotation, node.scale);
+    }
+
+    // Largest difference to the reference relative to the matrix's size
+    double worstError(const TransformHierarchy &hierarchy, const std::vector<double> &reference)
+    {
+        double worst = 0;
+        for (uint32_t i = 0; i < hierarchy.GetCount(); i++)
+        {
+            const float *world = &hierarchy.GetWorld(i).m[0][0];
+            double size = 1;
+            for (int e = 0; e < 16; e++)
+                size = (std::max)(size, std::fabs(reference[i * 16 + e]));
+            for (int e = 0; e < 16; e++)
+                worst = (std::max)(worst, std::fabs(world[e] - reference[i * 16 + e]) / size);
+        }
+        return worst;
+    }
+
+    bool sameWorld(const TransformHierarchy &a, const TransformHierarchy &b)
+    {
+        for (uint32_t i = 0; i < a.GetCount(); i++)
+            if (std::memcmp(&a.GetWorld(i), &b.GetWorld(i), sizeof(XMFLOAT4X4)) != 0)
+                return false;
+        return true;
+    }
+
+    // The parallel update gives the serial one's matrices bit for bit, and
+    // both match the double precision reference
+    void testParallelMatchesSerial()
+    {
+        std::mt19937 random(3);
+        ThreadPool serial(1), parallel(4);
+        for (size_t count : { 1u, 7u, 5000u, 40000u })
+        {
+            std::vector<Node> nodes = randomForest(count, random);
+            TransformHierarchy a(serial), b(parallel);
+            build(a, nodes);
+            build(b, nodes);
+            CHECK_EQUAL(a.Update(), (uint32_t)count);
+            CHECK_EQUAL(b.Update(), (uint32_t)count);
+            CHECK(sameWorld(a, b));
+
+            std::vector<double> reference;
+            referenceWorld(nodes, reference);
+            CHECK(worstError(b, reference) < 1e-5);
+        }
+    }
+
+    // Edits update exactly the edited subtrees, serially and in parallel alike
+    void testDirtySubtrees()
+    {
+        std::mt19937 random(11);
+        std::vector<Node> nodes = randomForest(20000, random);
+        ThreadPool serial(1), parallel(4);
+        TransformHierarchy a(serial), b(parallel);
+        build(a, nodes);
+        build(b, nodes);
+        a.Update();
+        b.Update();
+        CHECK_EQUAL(a.Update(), 0u);
+
+        for (int round = 0; round < 10; round++)
+        {
+            std::vector<uint8_t> edited(nodes.size(), 0);
+            for (int e = 0; e < 20; e++)
+            {
+                uint32_t node = (uint32_t)(random() % nodes.size());
+                nodes[node].position.x += 1;
+                a.SetPosition(node, nodes[node].position);
+                b.SetPosition(node, nodes[node].position);
+                edited[node] = 1;
+            }
+
+            uint32_t subtrees = 0;
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                if (nodes[i].parent != TransformHierarchy::NO_PARENT)
+                    edited[i] |= edited[nodes[i].parent];
+                subtrees += edited[i];
+            }
+            CHECK_EQUAL(a.Update(), subtrees);
+            CHECK_EQUAL(b.Update(), subtrees);
+            CHECK(sameWorld(a, b));
+        }
+
+        std::vector<double> reference;
+        referenceWorld(nodes, reference);
+        CHECK(worstError(b, reference) < 1e-5);
+    }
+
+    // Strided and transposed, as for constant buffers
+    void testWriteWorldMatrices()
+    {
+        std::mt19937 random(5);
+        std::vector<Node> nodes = randomForest(9000, random);
+        ThreadPool parallel(4);
+        TransformHierarchy hierarchy(parallel);
+        build(hierarchy, nodes);
+        hierarchy.Update();
+
+        struct Element
+        {
+            XMFLOAT4X4 matrix;
+            float padding[3];
+        };
+        std::vector<Element> output(nodes.size() - 2);
+        hierarchy.WriteWorldMatrices(2, (uint32_t)output.size(), &output[0].matrix, sizeof(Element), true);
+        bool same = true;
+        for (size_t i = 0; i < output.size(); i++)
+            for (int r = 0; r < 4; r++)
+                for (int c = 0; c < 4; c++)
+                    same &= output[i].matrix.m[r][c] == hierarchy.GetWorld((uint32_t)i + 2).m[c][r];
+        CHECK(same);
+    }
+
+    void testInvalidParent()
+    {
+        TransformHierarchy hierarchy;
+        CHECK_THROWS(std::invalid_argument, hierarchy.Add(0, XMFLOAT3(0, 0, 0)));
+    }
+}
+
+int main()
+{
+    testParallelMatchesSerial();
+    testDirtySubtrees();
+    testWriteWorldMatrices();
+    testInvalidParent();
+    return Test::Report();
+}
@@ -0,0 +1,215 @@
+#include "pch.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "Common/Mesh/VertexPacking.h"
+#include "Content/SphereLODChain.h"
+
+using namespace DX;
+
+namespace
+{
+    bool isNaN(float value) { return value != value; }
+
+    uint32_t bits(float value)
+    {
+        uint32_t result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+
+    float fromBits(uint32_t value)
+    {
+        float result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+
+    // Position, normal and texture coordinate of one vertex
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float texcoord[2];
+    };
+
+    const PositionQuantization UNIT = { 1, { 0, 0, 0 } };
+
+    std::vector<PackedVertex> pack(const std::vector<Vertex> &vertices)
+    {
+        std::vector<PackedVertex> packed(vertices.size());
+        PackVertices(vertices[0].position, vertices[0].normal, vertices[0].texcoord, sizeof(Vertex),
+            vertices.size(), UNIT, packed.data());
+        return packed;
+    }
+
+    // Vertices at the origin facing +z with the given texture coordinates
+    std::vector<Vertex> texcoordVertices(const std::vector<float> &texcoords)
+    {
+        std::vector<Vertex> vertices(texcoords.size() / 2);
+        for (size_t i = 0; i < vertices.size(); i++)
+            vertices[i] = { { 0, 0, 0 }, { 0, 0, 1 }, { texcoords[2 * i], texcoords[2 * i + 1] } };
+        return vertices;
+    }
+
+    // Every half through the SIMD unpack against the scalar conversion,
+    // and back through the scalar one
+    void testAllHalves()
+    {
+        std::vector<PackedVertex> packed(65536 / 2);
+        for (size_t i = 0; i < packed.size(); i++)
+            packed[i] = { { 0, 0, 0, 32767 }, { 0, 0 }, { (uint16_t)(2 * i), (uint16_t)(2 * i + 1) } };
+
+        std::vector<Vertex> vertices(packed.size());
+        UnpackVertices(packed.data(), packed.size(), UNIT, vertices[0].position, vertices[0].normal,
+            vertices[0].texcoord, sizeof(Vertex));
+
+        size_t mismatches = 0, roundTrips = 0;
+        for (size_t i = 0; i < packed.size(); i++)
+            for (int c = 0; c < 2; c++)
+            {
+                uint16_t half = packed[i].texcoord[c];
+                float expected = HalfToFloat(half), unpacked = vertices[i].texcoord[c];
+                if (isNaN(expected) ? !isNaN(unpacked) : bits(expected) != bits(unpacked))
+                    mismatches++;
+                // NaNs come back as the quiet NaN of their sign
+                uint16_t back = FloatToHalf(unpacked);
+                if (back != (isNaN(expected) ? (half & 0x8000) | 0x7e00 : half))
+                    roundTrips++;
+            }
+        CHECK_EQUAL(mismatches, 0u);
+        CHECK_EQUAL(roundTrips, 0u);
+    }
+
+    // Random floats of every magnitude: the SIMD pack equals the scalar
+    // conversion, which rounds to the nearest half
+    void testFloatToHalf()
+    {
+        std::mt19937 random(42);
+        std::uniform_int_distribution<uint32_t> anyBits;
+        std::vector<float> texcoords(1 << 20);
+        for (float &t : texcoords)
+        {
+            // Mostly the half range, some outside and some NaN or infinite
+            uint32_t value = anyBits(random);
+            uint32_t exponent = 127 - 28 + (value >> 23) % 48;
+            t = fromBits((value & 0x807fffff) | (exponent << 23));
+            if (value % 97 == 0)
+                t = fromBits(value);
+        }
+        std::vector<PackedVertex> packed = pack(texcoordVertices(texcoords));
+
+        size_t mismatches = 0, notNearest = 0;
+        for (size_t i = 0; i < texcoords.size(); i++)
+        {
+            float value = texcoords[i];
+            uint16_t half = packed[i / 2].texcoord[i % 2];
+            if (half != FloatToHalf(value))
+                mismatches++;
+            if (isNaN(value) || std::fabs(value) >= 65520.0f)
+                continue;
+
+            // Neither neighbour of the half is nearer
+            double error = std::fabs((double)HalfToFloat(half) - value);
+            for (int step : { -1, 1 })
+            {
+                uint16_t neighbour = (uint16_t)(half + step);
+                if ((neighbour & 0x7c00) == 0x7c00 || (neighbour & 0x8000) != (half & 0x8000))
+                    continue;
+                if (std::fabs((double)HalfToFloat(neighbour) - value) < error)
+                    notNearest++;
+            }
+        }
+        CHECK_EQUAL(mismatches, 0u);
+        CHECK_EQUAL(notNearest, 0u);
+    }
+
+    // Random unit normals: the SIMD pack equals the scalar mapping and the
+    // decoded normal is within a hundredth of a degree
+    void testOctahedral()
+    {
+        std::mt19937 random(7);
+        std::normal_distribution<float> gaussian;
+        std::vector<Vertex> vertices(1 << 18, Vertex());
+        for (Vertex &vertex : vertices)
+        {
+            float *n = vertex.normal;
+            float length;
+            do
+            {
+                n[0] = gaussian(random);
+                n[1] = gaussian(random);
+                n[2] = gaussian(random);
+                length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            } while (length < 1e-3f);
+            for (int c = 0; c < 3; c++)
+                n[c] /= length;
+        }
+        // The poles and the octahedron's edges
+        const float axes[][3] = { { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0.6f, 0, -0.8f } };
+        for (size_t a = 0; a < 5; a++)
+            std::memcpy(vertices[a].normal, axes[a], sizeof(axes[a]));
+        std::vector<PackedVertex> packed = pack(vertices);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            int16_t expected[2];
+            EncodeOctahedral(vertices[i].normal, expected);
+            if (expected[0] != packed[i].normal[0] || expected[1] != packed[i].normal[1])
+                mismatches++;
+        }
+        CHECK_EQUAL(mismatches, 0u);
+
+        VertexPackingError error = MeasurePackingError(vertices[0].position, vertices[0].normal,
+            vertices[0].texcoord, sizeof(Vertex), vertices.size(), UNIT, packed.data());
+        CHECK(error.normalDegrees < 0.01f);
+    }
+
+    // The scene's sphere chain: errors within a quantization step, and the
+    // buffer shrinks from 36 to 16 bytes a vertex
+    void testSphereChain()
+    {
+        anim::SphereLODChain lods({ 8, 16, 32, 64 }, 0.25f);
+        const auto &vertices = lods.GetVertices();
+        size_t stride = sizeof(anim::VertexPositionColorNormal);
+
+        PositionQuantization quantization = ComputePositionQuantization(&vertices[0].pos.x, stride, vertices.size());
+        CHECK_NEAR(quantization.scale, 0.25f, 1e-6f);
+        std::vector<PackedVertex> packed(vertices.size());
+        PackVertices(&vertices[0].pos.x, &vertices[0].normal.x, &vertices[0].color.x, stride, vertices.size(),
+            quantization, packed.data());
+        VertexPackingError error = MeasurePackingError(&vertices[0].pos.x, &vertices[0].normal.x,
+            &vertices[0].color.x, stride, vertices.size(), quantization, packed.data());
+
+        // Half a SNORM16 step on each axis
+        CHECK(error.position <= quantization.scale / 32767 * 0.87f);
+        CHECK(error.normalDegrees < 0.01f);
+        CHECK(error.texcoord <= 1.0f / 2048);
+
+        CHECK_EQUAL(sizeof(PackedVertex), 16u);
+        CHECK_EQUAL(vertices.size() * sizeof(PackedVertex) * 9, vertices.size() * stride * 4);
+    }
+
+    void testEmpty()
+    {
+        float unused[3] = {};
+        PositionQuantization quantization = ComputePositionQuantization(unused, 0, 0);
+        CHECK(quantization.scale > 0);
+        PackVertices(unused, unused, unused, 0, 0, quantization, nullptr);
+    }
+}
+
+int main()
+{
+    testAllHalves();
+    testFloatToHalf();
+    testOctahedral();
+    testSphereChain();
+    testEmpty();
+    return Test::Report();
+}
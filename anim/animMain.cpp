@@ -2,31 +2,31 @@
 
 #include "animMain.h"
 #include "Common\DirectXHelper.h"
+#include "Common\Readback\D3D11ReadbackDevice.h"
+#include "Common\RenderTarget\D3D11RenderTargetAllocator.h"
 
 using namespace anim;
 using namespace Concurrency;
 using namespace DirectX;
 
-Microsoft::WRL::ComPtr<ID3D11Texture2D> AnimMain::createCPUAccessibleTexture(
-    const DX::Size &size, const std::string &namePrefix)
+namespace
 {
-    CD3D11_TEXTURE2D_DESC textureDesc(
-        DXGI_FORMAT_R32G32B32A32_FLOAT,
-        lround(size.width),
-        lround(size.height),
-        1, // Only one texture.
-        1, // Use a single mipmap level.
-        0,
-        D3D11_USAGE_STAGING,
-        D3D11_CPU_ACCESS_READ
-    );
-
-    return m_deviceResources->createTexture2D(textureDesc, namePrefix + "CPUAcc");
+    // Frame captures go here, relative to the working directory
+    const char CAPTURE_DIRECTORY[] = "captures";
+    // Optional .cube grade, looked up like the sky sphere image
+    const char GRADING_FILE[] = "grading.cube";
 }
 
 // Loads and initializes application assets when the application is loaded.
 AnimMain::AnimMain(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
-    m_deviceResources(deviceResources)
+    m_deviceResources(deviceResources),
+    m_renderTargetPool(std::make_shared<DX::D3D11RenderTargetAllocator>(deviceResources, "Pooled")),
+    m_renderGraph(m_renderTargetPool, [this](const DX::RenderTargetTexture &texture, const DX::ClearValue &value)
+    {
+        clearTexture(texture, value);
+    }),
+    m_gpuFrameTimer(deviceResources, GPU_TIMER_DEPTH),
+    m_sparseLuminanceEstimator(LUMINANCE_SAMPLE_GRID * LUMINANCE_SAMPLE_GRID)
 {
     m_camera = std::make_shared<Camera>();
     m_keyboard = std::make_shared<input::Keyboard>();
@@ -36,9 +36,11 @@ AnimMain::AnimMain(const std::shared_ptr<DX::DeviceResources>& deviceResources)
     m_fpsTextRenderer = std::unique_ptr<SampleFpsTextRenderer>(new SampleFpsTextRenderer(m_deviceResources));
 
     m_vertexShader = deviceResources->createVertexShader("CopyTexture");
-    m_copyPixelShader = deviceResources->createPixelShader("CopyTexture");
-    m_brightnessPixelShader = deviceResources->createPixelShader("BrightnessCopyTexture");
+    m_luminanceTilesPixelShader = deviceResources->createPixelShader("LuminanceTiles");
+    m_luminanceSamplesPixelShader = deviceResources->createPixelShader("LuminanceSamples");
     m_hdrPixelShader = deviceResources->createPixelShader("HDR");
+    m_bloomDownsamplePixelShader = deviceResources->createPixelShader("BloomDownsample");
+    m_bloomUpsamplePixelShader = deviceResources->createPixelShader("BloomUpsample");
 
     // Create post-proccessing constant buffer
     CD3D11_BUFFER_DESC constantBufferDesc(sizeof(PostProcConstBuffer),
@@ -51,13 +53,103 @@ AnimMain::AnimMain(const std::shared_ptr<DX::DeviceResources>& deviceResources)
         )
     );
 
-    // Create 1x1 average brightness texture accessible via CPU
-    m_averageBrightnessCPUAccTexture = createCPUAccessibleTexture({ 1, 1 },
-        "averageLogBrightness");
+    CD3D11_BUFFER_DESC luminanceTilesBufferDesc(sizeof(LuminanceTilesConstBuffer),
+        D3D11_BIND_CONSTANT_BUFFER);
+    DX::ThrowIfFailed(
+        m_deviceResources->GetD3DDevice()->CreateBuffer(
+            &luminanceTilesBufferDesc,
+            nullptr,
+            &m_luminanceTilesConstantBuffer
+        )
+    );
+
+    // Create sparse luminance sample positions, one texel per sample
+    CD3D11_TEXTURE2D_DESC samplePositionsDesc(
+        DXGI_FORMAT_R32G32_FLOAT,
+        LUMINANCE_SAMPLE_GRID,
+        LUMINANCE_SAMPLE_GRID,
+        1, // 1 texture.
+        1, // 1 mip level.
+        D3D11_BIND_SHADER_RESOURCE,
+        D3D11_USAGE_IMMUTABLE
+    );
+    D3D11_SUBRESOURCE_DATA samplePositionsData = {};
+    samplePositionsData.pSysMem = m_sparseLuminanceEstimator.GetPoints().data();
+    samplePositionsData.SysMemPitch = LUMINANCE_SAMPLE_GRID * 2 * sizeof(float);
+    m_samplePositionsSRV = m_deviceResources->createShaderResourceView(
+        m_deviceResources->createTexture2D(samplePositionsDesc, "LuminanceSamplePositions", &samplePositionsData),
+        "LuminanceSamplePositions"
+    );
+
+    m_luminanceSamplesTarget = m_deviceResources->createRenderTargetTexture(
+        DX::Size((float)LUMINANCE_SAMPLE_GRID, (float)LUMINANCE_SAMPLE_GRID), "LuminanceSamples");
+    m_sampleReadback.reset(new DX::ReadbackQueue<float, ID3D11Resource *>(
+        std::make_shared<DX::D3D11ReadbackDevice>(m_deviceResources,
+            m_luminanceSamplesTarget.textureDesc, "LuminanceSamples"),
+        BRIGHTNESS_READBACK_DEPTH));
+
+    CD3D11_BUFFER_DESC luminanceSamplesBufferDesc(sizeof(LuminanceSamplesConstBuffer),
+        D3D11_BIND_CONSTANT_BUFFER);
+    DX::ThrowIfFailed(
+        m_deviceResources->GetD3DDevice()->CreateBuffer(
+            &luminanceSamplesBufferDesc,
+            nullptr,
+            &m_luminanceSamplesConstantBuffer
+        )
+    );
+
+    // Bloom upsamples are added onto the finer level in place
+    CD3D11_BLEND_DESC additiveBlendDesc(D3D11_DEFAULT);
+    additiveBlendDesc.RenderTarget[0].BlendEnable = TRUE;
+    additiveBlendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+    additiveBlendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_ONE;
+    additiveBlendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ZERO;
+    additiveBlendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+    DX::ThrowIfFailed(
+        m_deviceResources->GetD3DDevice()->CreateBlendState(
+            &additiveBlendDesc,
+            &m_additiveBlendState
+        )
+    );
+
+    CD3D11_BUFFER_DESC bloomBufferDesc(sizeof(BloomConstBuffer),
+        D3D11_BIND_CONSTANT_BUFFER);
+    DX::ThrowIfFailed(
+        m_deviceResources->GetD3DDevice()->CreateBuffer(
+            &bloomBufferDesc,
+            nullptr,
+            &m_bloomConstantBuffer
+        )
+    );
+
+    // Create tonemap table texture, sampled with linear filtering in the HDR shader
+    CD3D11_TEXTURE2D_DESC tonemapLUTDesc(
+        DXGI_FORMAT_R32_FLOAT,
+        m_tonemapLUT.GetSize(),
+        1,
+        1, // 1 texture.
+        1, // 1 mip level.
+        D3D11_BIND_SHADER_RESOURCE,
+        D3D11_USAGE_IMMUTABLE
+    );
+    D3D11_SUBRESOURCE_DATA tonemapLUTData = {};
+    tonemapLUTData.pSysMem = m_tonemapLUT.GetTable().data();
+    tonemapLUTData.SysMemPitch = m_tonemapLUT.GetSize() * sizeof(float);
+    m_tonemapLUTSRV = m_deviceResources->createShaderResourceView(
+        m_deviceResources->createTexture2D(tonemapLUTDesc, "TonemapLUT", &tonemapLUTData),
+        "TonemapLUT"
+    );
+
+    createColorGradingLUT();
 }
 
 AnimMain::~AnimMain()
 {
+    // Write the captures still in flight
+    if (m_sceneCapture)
+        m_sceneCapture->Flush();
+    if (m_outputCapture)
+        m_outputCapture->Flush();
 }
 
 // Updates application state when the window size changes (e.g. device orientation change)
@@ -67,24 +159,42 @@ void AnimMain::CreateWindowSizeDependentResources()
 
     DX::Size size = m_deviceResources->GetLogicalSize();
 
-    // Create scene render target
-    m_sceneRenderTarget = m_deviceResources->createRenderTargetTexture(size, "Scene");
-
-    // Create averaging render targets
-    float minDim = min(size.width, size.height);
-    size_t n = 0;
-    while (1 << (n + 1) <= minDim)
-        n++;
-    m_averagingRenderTargets.clear();
-    m_averagingRenderTargets.reserve(n + 1);
-    for (size_t i = 0; i <= n; i++)
-    {
-        float dim = (float)(1 << (n - i));
-        DX::Size avgSize(dim, dim);
-        m_averagingRenderTargets.push_back(
-            m_deviceResources->createRenderTargetTexture(avgSize,
-            std::to_string(lround(avgSize.width)) + "x" + std::to_string(lround(avgSize.height))));
-    }
+    UINT width = (UINT)lround(size.width);
+    UINT height = (UINT)lround(size.height);
+    m_sceneWidth = width;
+    m_sceneHeight = height;
+
+    // Scene render target and depth buffer are taken from the pool every
+    // frame, a resize within the same size class reuses them
+    m_sceneDesc.width = width;
+    m_sceneDesc.height = height;
+    m_sceneDesc.format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    m_sceneDesc.bindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    m_sceneDepthDesc = m_sceneDesc;
+    m_sceneDepthDesc.format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+    m_sceneDepthDesc.bindFlags = D3D11_BIND_DEPTH_STENCIL;
+
+    // Create luminance tiles render target, one texel per tile of the full resolution scene.
+    // It is read back as a whole, so it keeps its exact size.
+    UINT tileSize = DX::LuminanceReduction::ComputeTileSize(width, height, LUMINANCE_GRID_SIZE);
+    DX::Size gridSize((float)((height + tileSize - 1) / tileSize),
+        (float)((width + tileSize - 1) / tileSize));
+    bool gridChanged = !m_brightnessReadback ||
+        m_luminanceTilesTarget.textureDesc.Width != (UINT)gridSize.width ||
+        m_luminanceTilesTarget.textureDesc.Height != (UINT)gridSize.height;
+    if (gridChanged)
+        m_luminanceTilesTarget = m_deviceResources->createRenderTargetTexture(gridSize, "LuminanceTiles");
+
+    m_luminanceTilesData.tileSize = tileSize;
+    updateSceneViewport();
+
+    // Create ring of luminance tiles textures accessible via CPU
+    if (gridChanged)
+        m_brightnessReadback.reset(new DX::ReadbackQueue<float, ID3D11Resource *>(
+            std::make_shared<DX::D3D11ReadbackDevice>(m_deviceResources,
+                m_luminanceTilesTarget.textureDesc, "LuminanceTiles"),
+            BRIGHTNESS_READBACK_DEPTH));
 }
 
 void AnimMain::InputUpdate(DX::StepTimer const& timer)
@@ -130,6 +240,28 @@ void AnimMain::InputUpdate(DX::StepTimer const& timer)
 
     if (m_keyboard->KeyWasReleased('3'))
         isHDR = true;
+    if (m_keyboard->KeyWasReleased('L'))
+    {
+        m_sparseLuminance = !m_sparseLuminance;
+        // The other queue sat idle since the last switch, its copies are from back then
+        if (m_sparseLuminance)
+            m_sampleReadback->Reset();
+        else
+            m_brightnessReadback->Reset();
+    }
+    if (m_keyboard->KeyWasReleased('B'))
+        m_bloomEnabled = !m_bloomEnabled;
+    if (m_keyboard->KeyWasReleased('G'))
+        m_gradingEnabled = !m_gradingEnabled;
+    if (m_keyboard->KeyWasReleased('C'))
+    {
+        m_capturing = !m_capturing;
+        if (m_capturing && !m_captureSink)
+        {
+            CreateDirectoryA(CAPTURE_DIRECTORY, nullptr);
+            m_captureSink = std::make_shared<DX::FileCaptureSink>(CAPTURE_DIRECTORY);
+        }
+    }
     if (m_keyboard->KeyWasReleased('4') ||
         m_keyboard->KeyWasReleased('5') ||
         m_keyboard->KeyWasReleased('6'))
@@ -154,26 +286,462 @@ void AnimMain::Update()
 void AnimMain::copyTexture(const DX::RenderTargetTexture &source,
     const DX::RenderTargetTexture &dest) const
 {
-    auto context = m_deviceResources->GetD3DDeviceContext();
+    auto backend = m_deviceResources->GetRenderBackend();
 
     // Set destination texture as render target
     UnbindShaderResource();
-    context->OMSetRenderTargets(1, dest.renderTargetView.GetAddressOf(), nullptr);
+    backend->OMSetRenderTargets(1, dest.renderTargetView.GetAddressOf(), nullptr);
     // Set viewport
-    context->RSSetViewports(1, &dest.viewport);
+    backend->RSSetViewports(1, &dest.viewport);
     // Set source render target as shader resource
-    context->PSSetShaderResources(0, 1, source.shaderResourceView.GetAddressOf());
+    backend->PSSetShaderResources(0, 1, source.shaderResourceView.GetAddressOf());
 
     // Render full-screen quad
-    context->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-    context->PSSetSamplers(0, 1, m_deviceResources->GetSamplerStateWrap());
-    context->Draw(4, 0);
+    backend->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    backend->PSSetSamplers(0, 1, m_deviceResources->GetSamplerStateWrap());
+    backend->Draw(4, 0);
+}
+
+void AnimMain::drawBloomLevel(const DX::RenderTargetTexture &source, UINT sourceWidth, UINT sourceHeight,
+    const DX::RenderTargetTexture &dest, UINT destWidth, UINT destHeight,
+    bool prefilter, bool upsample) const
+{
+    auto backend = m_deviceResources->GetRenderBackend();
+
+    BloomConstBuffer data = {};
+    data.sourceScale[0] = (float)sourceWidth / destWidth;
+    data.sourceScale[1] = (float)sourceHeight / destHeight;
+    data.sourceSize[0] = (float)sourceWidth;
+    data.sourceSize[1] = (float)sourceHeight;
+    data.sourceTexelSize[0] = 1.0f / source.textureDesc.Width;
+    data.sourceTexelSize[1] = 1.0f / source.textureDesc.Height;
+    data.threshold = m_bloomSettings.threshold;
+    data.knee = m_bloomSettings.knee;
+    data.prefilter = prefilter ? 1 : 0;
+    backend->UpdateBuffer(m_bloomConstantBuffer.Get(), &data, sizeof(data));
+
+    // Set destination texture as render target, only its top left part is written
+    UnbindShaderResource();
+    backend->OMSetRenderTargets(1, dest.renderTargetView.GetAddressOf(), nullptr);
+    D3D11_VIEWPORT viewport = CD3D11_VIEWPORT(0.0f, 0.0f, (float)destWidth, (float)destHeight);
+    backend->RSSetViewports(1, &viewport);
+
+    backend->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    backend->VSSetShader(m_vertexShader.Get());
+    backend->PSSetShader(upsample ? m_bloomUpsamplePixelShader.Get() :
+        m_bloomDownsamplePixelShader.Get());
+    backend->PSSetConstantBuffers(0, 1, m_bloomConstantBuffer.GetAddressOf());
+    backend->PSSetShaderResources(0, 1, source.shaderResourceView.GetAddressOf());
+    backend->PSSetSamplers(0, 1, m_deviceResources->GetSamplerStateClamp());
+    if (upsample)
+        backend->OMSetBlendState(m_additiveBlendState.Get(), nullptr, 0xffffffff);
+    backend->Draw(4, 0);
+    if (upsample)
+        backend->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+}
+
+void AnimMain::captureTexture(std::unique_ptr<TextureCapture> &capture, const std::string &name,
+    const DX::RenderTargetTexture &texture, UINT width, UINT height)
+{
+    const D3D11_TEXTURE2D_DESC &desc = texture.textureDesc;
+    DX::CapturePixelFormat format;
+    switch (desc.Format)
+    {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        format = DX::CapturePixelFormat::RGBA32Float;
+        break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+        format = DX::CapturePixelFormat::BGRA8Unorm;
+        break;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        format = DX::CapturePixelFormat::RGBA8Unorm;
+        break;
+    default:
+        throw std::invalid_argument("AnimMain: texture format cannot be captured");
+    }
+
+    // Staging slots are sized for one texture, start over when it changes
+    if (!capture || capture->GetTextureWidth() != desc.Width ||
+        capture->GetTextureHeight() != desc.Height || capture->GetFormat() != format)
+    {
+        if (capture)
+            capture->Flush();
+        capture.reset(new TextureCapture(
+            std::make_shared<DX::D3D11ReadbackDevice>(m_deviceResources, desc, "Capture" + name),
+            desc.Width, desc.Height, format, name, m_captureSink));
+    }
+
+    capture->Capture(texture.texture.Get(), m_timer.GetFrameCount(), width, height);
+}
+
+void AnimMain::updateCaptureStatus()
+{
+    if (!m_sceneCapture && !m_outputCapture)
+        return;
+
+    // Render thread cost of the last frame and frames lost so far
+    double frameSeconds = 0;
+    uint64_t written = 0, dropped = 0;
+    for (auto capture : { m_sceneCapture.get(), m_outputCapture.get() })
+    {
+        if (!capture)
+            continue;
+        capture->Poll();
+        TextureCapture::Statistics stats = capture->GetStatistics();
+        frameSeconds += stats.lastFrameSeconds;
+        written += stats.written;
+        dropped += stats.dropped;
+    }
+
+    wchar_t status[128];
+    swprintf_s(status, L"%s %.2f ms/frame, %llu written, %llu dropped",
+        m_capturing ? L"Capturing" : L"Captured", frameSeconds * 1000,
+        (unsigned long long)written, (unsigned long long)dropped);
+    m_fpsTextRenderer->SetStatus(status);
+}
+
+void AnimMain::updateExposure()
+{
+    auto &readback = m_sparseLuminance ? *m_sampleReadback : *m_brightnessReadback;
+
+    // Take the newest result the GPU has finished, never waiting for the GPU to catch up
+    if (readback.Poll())
+    {
+        // Every texel holds a tile's mean log brightness, pixel count and
+        // spread, or a single sample as a tile of one pixel
+        const std::vector<float> &tiles = readback.GetLatest();
+        m_postProcData.exposure = m_exposureHistogram.MeasureTiles(tiles.data(), tiles.size() / 4, 4);
+    }
+    if (readback.HasValue())
+    {
+        uint64_t lagFrames = m_timer.GetFrameCount() - readback.GetLatestFrame();
+        m_postProcData.exposure.averageLogBrightness = m_brightnessAdaptation.Update(
+            m_exposureHistogram.GetLastResult().averageLogBrightness,
+            m_timer.GetElapsedSeconds(), lagFrames * m_timer.GetElapsedSeconds());
+    }
+
+    // Exposure only depends on the adapted brightness, compute it once per frame
+    float exposure = DX::TonemapLUT::ComputeExposure(m_postProcData.exposure.averageLogBrightness);
+    m_tonemapLUT.GetTextureMapping(exposure, m_postProcData.tonemapScale, m_postProcData.tonemapOffset);
+
+    m_postProcData.gradingLastEntry = 0;
+    if (m_colorGradingLUT && m_gradingEnabled)
+    {
+        m_postProcData.gradingExposure = exposure;
+        m_colorGradingLUT->GetShaper(m_postProcData.gradingBias, m_postProcData.gradingScale,
+            m_postProcData.gradingOffset);
+        m_postProcData.gradingLastEntry = (float)(m_colorGradingLUT->GetSize() - 1);
+    }
+}
+
+void AnimMain::createColorGradingLUT()
+{
+    // Grading is optional, without a file the tonemap table is used. A
+    // malformed file throws like any other broken asset.
+    std::string fileName = GRADING_FILE;
+    if (GetFileAttributesA(fileName.c_str()) == INVALID_FILE_ATTRIBUTES)
+        fileName = std::string("..\\..\\") + GRADING_FILE;
+    if (GetFileAttributesA(fileName.c_str()) == INVALID_FILE_ATTRIBUTES)
+        return;
+
+    m_colorGradingLUT.reset(new DX::ColorGradingLUT(m_tonemapLUT, DX::CubeLUT::Load(fileName)));
+
+    // Read with Load in the HDR shader, which interpolates tetrahedrally itself
+    UINT size = m_colorGradingLUT->GetSize();
+    CD3D11_TEXTURE3D_DESC gradingLUTDesc(
+        DXGI_FORMAT_R32G32B32A32_FLOAT,
+        size,
+        size,
+        size,
+        1, // 1 mip level.
+        D3D11_BIND_SHADER_RESOURCE,
+        D3D11_USAGE_IMMUTABLE
+    );
+    D3D11_SUBRESOURCE_DATA gradingLUTData = {};
+    gradingLUTData.pSysMem = m_colorGradingLUT->GetTable().data();
+    gradingLUTData.SysMemPitch = size * 4 * sizeof(float);
+    gradingLUTData.SysMemSlicePitch = size * gradingLUTData.SysMemPitch;
+    m_colorGradingLUTSRV = m_deviceResources->createShaderResourceView(
+        m_deviceResources->createTexture3D(gradingLUTDesc, "ColorGradingLUT", &gradingLUTData),
+        "ColorGradingLUT"
+    );
+}
+
+void AnimMain::updateRenderScale()
+{
+    // Frames measured before the last change ran at the old scale and are dropped
+    if (!m_gpuFrameTimer.Poll(m_renderScale))
+        return;
+
+    float scale = m_resolutionController.Update(m_gpuFrameTimer.GetFrameTime());
+    if (scale == m_renderScale)
+        return;
+
+    m_renderScale = scale;
+    updateSceneViewport();
+}
+
+void AnimMain::updateSceneViewport()
+{
+    UINT width = (std::max)((UINT)lround(m_sceneWidth * m_renderScale), 1u);
+    UINT height = (std::max)((UINT)lround(m_sceneHeight * m_renderScale), 1u);
+    m_sceneViewport = CD3D11_VIEWPORT(0.0f, 0.0f, (float)width, (float)height);
+
+    // The scene only covers the top left part of the pooled texture
+    DX::RenderTargetDesc sceneTexture = DX::RenderTargetPool<DX::RenderTargetTexture>::GetSizeClass(
+        m_sceneDesc, m_renderTargetPool.GetSizeGranularity());
+    float textureWidth = (float)sceneTexture.width;
+    float textureHeight = (float)sceneTexture.height;
+    m_postProcData.sceneUVScale[0] = width / textureWidth;
+    m_postProcData.sceneUVScale[1] = height / textureHeight;
+    m_postProcData.sceneUVMax[0] = (width - 0.5f) / textureWidth;
+    m_postProcData.sceneUVMax[1] = (height - 0.5f) / textureHeight;
+
+    m_luminanceTilesData.sourceSize[0] = width;
+    m_luminanceTilesData.sourceSize[1] = height;
+    m_deviceResources->GetRenderBackend()->UpdateBuffer(
+        m_luminanceTilesConstantBuffer.Get(), &m_luminanceTilesData, sizeof(m_luminanceTilesData));
 }
 
 void AnimMain::UnbindShaderResource() const
 {
     ID3D11ShaderResourceView *const pSRV[1] = { NULL };
-    m_deviceResources->GetD3DDeviceContext()->PSSetShaderResources(0, 1, pSRV);
+    m_deviceResources->GetRenderBackend()->PSSetShaderResources(0, 1, pSRV);
+}
+
+void AnimMain::clearTexture(const DX::RenderTargetTexture &texture, const DX::ClearValue &value) const
+{
+    auto backend = m_deviceResources->GetRenderBackend();
+
+    if (texture.renderTargetView)
+        backend->ClearRenderTargetView(texture.renderTargetView.Get(), value.color);
+    if (texture.depthStencilView)
+        backend->ClearDepthStencilView(texture.depthStencilView.Get(),
+            D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, value.depth, value.stencil);
+}
+
+void AnimMain::addLuminancePass(FrameGraph::Resource scene)
+{
+    bool sparse = m_sparseLuminance;
+    auto &readback = sparse ? *m_sampleReadback : *m_brightnessReadback;
+    const DX::RenderTargetTexture &target = sparse ? m_luminanceSamplesTarget : m_luminanceTilesTarget;
+    // Only read through the staging ring, nothing looks at it after the frame
+    FrameGraph::Resource output = m_renderGraph.ImportTexture(
+        sparse ? "LuminanceSamples" : "LuminanceTiles", target, false);
+
+    m_renderGraph.AddPass(sparse ? "LuminanceSamples" : "LuminanceTiles", [&](FrameGraph::PassBuilder &builder)
+    {
+        builder.Read(scene);
+        builder.Write(output, DX::LoadAction::DontCare);
+        // The result only feeds the readback, skip it while every staging slot is in flight
+        if (readback.CanEnqueue())
+            builder.SideEffect();
+    }, [this, scene, sparse, &readback, &target](const FrameGraph &graph)
+    {
+        auto backend = m_deviceResources->GetRenderBackend();
+        backend->BeginEvent(L"Calculate frame average brightness");
+        // Attach copy texture vertex shader
+        backend->VSSetShader(m_vertexShader.Get());
+
+        if (sparse)
+        {
+            // Read the blue noise samples, shifted to new positions every frame
+            m_luminanceSamplesData.sourceSize[0] = m_luminanceTilesData.sourceSize[0];
+            m_luminanceSamplesData.sourceSize[1] = m_luminanceTilesData.sourceSize[1];
+            DX::SparseLuminanceEstimator::GetFrameOffset(m_timer.GetFrameCount(),
+                m_luminanceSamplesData.offset[0], m_luminanceSamplesData.offset[1]);
+            backend->UpdateBuffer(m_luminanceSamplesConstantBuffer.Get(), &m_luminanceSamplesData,
+                sizeof(m_luminanceSamplesData));
+
+            backend->PSSetShader(m_luminanceSamplesPixelShader.Get());
+            backend->PSSetConstantBuffers(0, 1, m_luminanceSamplesConstantBuffer.GetAddressOf());
+            backend->PSSetShaderResources(1, 1, m_samplePositionsSRV.GetAddressOf());
+        }
+        else
+        {
+            // Sum log of scene brightness over each tile in a single pass
+            backend->PSSetShader(m_luminanceTilesPixelShader.Get());
+            backend->PSSetConstantBuffers(0, 1, m_luminanceTilesConstantBuffer.GetAddressOf());
+        }
+        copyTexture(graph.GetTexture(scene), target);
+
+        // Queue the result for reading back on a later frame
+        readback.Enqueue(target.texture.Get(), m_timer.GetFrameCount());
+        backend->EndEvent(); // Calculate frame average brightness
+    });
+}
+
+AnimMain::FrameGraph::Resource AnimMain::addBloomPasses(FrameGraph::Resource scene)
+{
+    UINT sceneWidth = (UINT)m_sceneViewport.Width;
+    UINT sceneHeight = (UINT)m_sceneViewport.Height;
+    UINT levelCount = DX::BloomPyramid::GetLevelCount(sceneWidth, sceneHeight,
+        m_bloomSettings.maxLevelCount);
+
+    // Half precision is plenty for bloom and halves the bandwidth of the chain
+    DX::RenderTargetDesc levelDesc = m_sceneDesc;
+    levelDesc.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+    // Downsample chain, the first level is thresholded while reading the scene
+    std::vector<FrameGraph::Resource> levels(levelCount);
+    std::vector<UINT> widths(levelCount), heights(levelCount);
+    FrameGraph::Resource source = scene;
+    UINT sourceWidth = sceneWidth, sourceHeight = sceneHeight;
+    for (UINT level = 0; level < levelCount; level++)
+    {
+        UINT width, height;
+        DX::BloomPyramid::GetLevelSize(sceneWidth, sceneHeight, level, width, height);
+        levelDesc.width = width;
+        levelDesc.height = height;
+        FrameGraph::Resource dest = m_renderGraph.CreateTexture(
+            "Bloom" + std::to_string(level), levelDesc);
+        levels[level] = dest;
+        widths[level] = width;
+        heights[level] = height;
+
+        m_renderGraph.AddPass("BloomDownsample" + std::to_string(level), [&](FrameGraph::PassBuilder &builder)
+        {
+            builder.Read(source);
+            builder.Write(dest, DX::LoadAction::DontCare);
+        }, [this, source, sourceWidth, sourceHeight, dest, width, height, level](const FrameGraph &graph)
+        {
+            auto backend = m_deviceResources->GetRenderBackend();
+            backend->BeginEvent(L"Bloom downsample");
+            drawBloomLevel(graph.GetTexture(source), sourceWidth, sourceHeight,
+                graph.GetTexture(dest), width, height, level == 0, false);
+            backend->EndEvent(); // Bloom downsample
+        });
+
+        source = dest;
+        sourceWidth = width;
+        sourceHeight = height;
+    }
+
+    // Upsample chain, each level is added onto the next finer one in place,
+    // so the chain needs no textures beyond the downsampled levels
+    for (UINT level = levelCount - 1; level-- > 0;)
+    {
+        FrameGraph::Resource coarse = levels[level + 1];
+        FrameGraph::Resource dest = levels[level];
+        UINT coarseWidth = widths[level + 1], coarseHeight = heights[level + 1];
+        UINT width = widths[level], height = heights[level];
+
+        m_renderGraph.AddPass("BloomUpsample" + std::to_string(level), [&](FrameGraph::PassBuilder &builder)
+        {
+            builder.Read(coarse);
+            builder.Write(dest);
+        }, [this, coarse, coarseWidth, coarseHeight, dest, width, height](const FrameGraph &graph)
+        {
+            auto backend = m_deviceResources->GetRenderBackend();
+            backend->BeginEvent(L"Bloom upsample");
+            drawBloomLevel(graph.GetTexture(coarse), coarseWidth, coarseHeight,
+                graph.GetTexture(dest), width, height, false, true);
+            backend->EndEvent(); // Bloom upsample
+        });
+    }
+
+    return levels[0];
+}
+
+void AnimMain::addHDRPasses(FrameGraph::Resource backBuffer, const DX::ClearValue &background)
+{
+    FrameGraph::Resource scene = m_renderGraph.CreateTexture("Scene", m_sceneDesc);
+    FrameGraph::Resource sceneDepth = m_renderGraph.CreateTexture("SceneDepth", m_sceneDepthDesc);
+
+    m_renderGraph.AddClear(scene, background);
+    m_renderGraph.AddClear(sceneDepth, DX::ClearValue());
+
+    m_renderGraph.AddPass("Scene", [&](FrameGraph::PassBuilder &builder)
+    {
+        builder.Write(scene);
+        builder.Write(sceneDepth);
+    }, [this, scene, sceneDepth](const FrameGraph &graph)
+    {
+        auto backend = m_deviceResources->GetRenderBackend();
+
+        UnbindShaderResource();
+        backend->OMSetRenderTargets(1, graph.GetTexture(scene).renderTargetView.GetAddressOf(),
+            graph.GetTexture(sceneDepth).depthStencilView.Get());
+        backend->RSSetViewports(1, &m_sceneViewport);
+
+        // Render the 3d scene
+        m_sceneRenderer->Render(m_sceneViewport);
+    });
+
+    addLuminancePass(scene);
+
+    if (m_capturing)
+        m_renderGraph.AddPass("CaptureScene", [&](FrameGraph::PassBuilder &builder)
+        {
+            builder.Read(scene);
+            builder.SideEffect();
+        }, [this, scene](const FrameGraph &graph)
+        {
+            captureTexture(m_sceneCapture, "scene", graph.GetTexture(scene),
+                (UINT)m_sceneViewport.Width, (UINT)m_sceneViewport.Height);
+        });
+
+    FrameGraph::Resource bloom = addBloomPasses(scene);
+    bool bloomEnabled = m_bloomEnabled;
+
+    m_renderGraph.AddPass("HDR", [&](FrameGraph::PassBuilder &builder)
+    {
+        builder.Read(scene);
+        if (bloomEnabled)
+            builder.Read(bloom);
+        builder.Write(backBuffer, DX::LoadAction::DontCare);
+    }, [this, scene, bloom, bloomEnabled, backBuffer](const FrameGraph &graph)
+    {
+        auto backend = m_deviceResources->GetRenderBackend();
+        backend->BeginEvent(L"Render with HDR to screen");
+        const DX::RenderTargetTexture &target = graph.GetTexture(backBuffer);
+        // Set render target to screen
+        UnbindShaderResource();
+        backend->OMSetRenderTargets(1, target.renderTargetView.GetAddressOf(), nullptr);
+        backend->RSSetViewports(1, &target.viewport);
+        // Attach copy texture vertex shader and HDR shader
+        backend->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        backend->VSSetShader(m_vertexShader.Get());
+        backend->PSSetShader(m_hdrPixelShader.Get());
+
+        // Bloom covers the top left part of its pooled texture, like the scene
+        ID3D11ShaderResourceView *bloomSRV = NULL;
+        m_postProcData.bloomIntensity = 0;
+        if (bloomEnabled)
+        {
+            const DX::RenderTargetTexture &bloomTexture = graph.GetTexture(bloom);
+            UINT bloomWidth, bloomHeight;
+            DX::BloomPyramid::GetLevelSize((UINT)m_sceneViewport.Width, (UINT)m_sceneViewport.Height, 0,
+                bloomWidth, bloomHeight);
+            float textureWidth = (float)bloomTexture.textureDesc.Width;
+            float textureHeight = (float)bloomTexture.textureDesc.Height;
+            m_postProcData.bloomUVScale[0] = bloomWidth / textureWidth;
+            m_postProcData.bloomUVScale[1] = bloomHeight / textureHeight;
+            m_postProcData.bloomUVMax[0] = (bloomWidth - 0.5f) / textureWidth;
+            m_postProcData.bloomUVMax[1] = (bloomHeight - 0.5f) / textureHeight;
+            m_postProcData.bloomIntensity = m_bloomSettings.intensity;
+            bloomSRV = bloomTexture.shaderResourceView.Get();
+        }
+
+        // Calculate adapted exposure and set constant buffer parameters
+        updateExposure();
+        backend->UpdateBuffer(m_constantBuffer.Get(), &m_postProcData, sizeof(m_postProcData));
+        backend->PSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
+        // Set scene texture and tonemap tables as shader resources
+        backend->PSSetShaderResources(0, 1, graph.GetTexture(scene).shaderResourceView.GetAddressOf());
+        backend->PSSetShaderResources(1, 1, m_tonemapLUTSRV.GetAddressOf());
+        backend->PSSetShaderResources(2, 1, &bloomSRV);
+        backend->PSSetShaderResources(3, 1, m_colorGradingLUTSRV.GetAddressOf());
+        backend->PSSetSamplers(0, 1, m_deviceResources->GetSamplerStateClamp());
+        backend->PSSetSamplers(1, 1, m_deviceResources->GetSamplerStateClamp());
+        // Render full-screen quad
+        backend->Draw(4, 0);
+        // The bloom texture goes back to the pool and may be a render target next frame
+        ID3D11ShaderResourceView *const nullSRV[1] = { NULL };
+        backend->PSSetShaderResources(2, 1, nullSRV);
+        m_gpuFrameTimer.EndFrame();
+        backend->EndEvent(); // Render with HDR to screen
+    });
 }
 
 // Renders the current frame according to the current application state.
@@ -186,92 +754,88 @@ bool AnimMain::Render()
         return false;
     }
 
-    auto context = m_deviceResources->GetD3DDeviceContext();
+    // Resizes, the sky map and D2D bind past the state cache between frames
+    m_deviceResources->GetStateCache()->BeginFrame();
+
+    // Swap chain views are recreated on resize, so they are imported anew every frame
+    DX::RenderTargetTexture backBufferTarget = {};
+    backBufferTarget.renderTargetView = m_deviceResources->GetBackBufferRenderTargetView();
+    backBufferTarget.viewport = m_deviceResources->GetScreenViewport();
+    if (m_capturing)
+    {
+        // The capture copies from the texture itself
+        DX::ThrowIfFailed(
+            m_deviceResources->GetSwapChain()->GetBuffer(0, IID_PPV_ARGS(&backBufferTarget.texture))
+        );
+        backBufferTarget.texture->GetDesc(&backBufferTarget.textureDesc);
+    }
+    FrameGraph::Resource backBuffer = m_renderGraph.ImportTexture("BackBuffer", backBufferTarget);
+
+    DX::ClearValue background;
+    memcpy(background.color, DirectX::Colors::CornflowerBlue.f, sizeof(background.color));
+    m_renderGraph.AddClear(backBuffer, background);
 
-    // Set scene render target
-    UnbindShaderResource();
     if (isHDR)
-        context->OMSetRenderTargets(1, m_sceneRenderTarget.renderTargetView.GetAddressOf(), m_deviceResources->GetDepthStencilView());
-    else
     {
-        ID3D11RenderTargetView * const rt[] = { m_deviceResources->GetBackBufferRenderTargetView() };
-        context->OMSetRenderTargets(1, rt, m_deviceResources->GetDepthStencilView());
+        updateRenderScale();
+        m_gpuFrameTimer.BeginFrame(m_renderScale);
+        addHDRPasses(backBuffer, background);
     }
+    else
+    {
+        DX::RenderTargetTexture depthTarget = {};
+        depthTarget.depthStencilView = m_deviceResources->GetDepthStencilView();
+        FrameGraph::Resource depth = m_renderGraph.ImportTexture("DepthStencil", depthTarget, false);
+        m_renderGraph.AddClear(depth, DX::ClearValue());
 
-    context->RSSetViewports(1, &m_sceneRenderTarget.viewport);
+        m_renderGraph.AddPass("Scene", [&](FrameGraph::PassBuilder &builder)
+        {
+            builder.Write(backBuffer);
+            builder.Write(depth);
+        }, [this, backBuffer, depth](const FrameGraph &graph)
+        {
+            auto backend = m_deviceResources->GetRenderBackend();
+            const DX::RenderTargetTexture &target = graph.GetTexture(backBuffer);
 
-    // Clear back buffer, averaging textures and depth stencil view.
-    context->ClearRenderTargetView(m_deviceResources->GetBackBufferRenderTargetView(), DirectX::Colors::CornflowerBlue);
-    context->ClearRenderTargetView(m_sceneRenderTarget.renderTargetView.Get(), DirectX::Colors::CornflowerBlue);
-    for (auto &rtt : m_averagingRenderTargets)
-        context->ClearRenderTargetView(rtt.renderTargetView.Get(), DirectX::Colors::CornflowerBlue);
-    context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+            UnbindShaderResource();
+            backend->OMSetRenderTargets(1, target.renderTargetView.GetAddressOf(),
+                graph.GetTexture(depth).depthStencilView.Get());
+            backend->RSSetViewports(1, &target.viewport);
 
-    // Render the 3d scene
-    m_sceneRenderer->Render();
+            // Render the 3d scene
+            m_sceneRenderer->Render(target.viewport);
+        });
+    }
 
-    if (isHDR)
+    m_renderGraph.AddPass("GUI", [&](FrameGraph::PassBuilder &builder)
     {
-        // Render post-proccessing texture to the screen
-        auto annotation = m_deviceResources->GetAnnotation();
-        annotation->BeginEvent(L"Post-Proccessing");
-        annotation->BeginEvent(L"Calculate frame average brightness");
-        // Attach copy texture vertex shader
-        context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+        builder.Write(backBuffer);
+    }, [this](const FrameGraph &)
+    {
+        m_fpsTextRenderer->Render();
+    });
 
-        // Calculate log of scene brightness
-        context->PSSetShader(m_brightnessPixelShader.Get(), nullptr, 0);
-        copyTexture(m_sceneRenderTarget, m_averagingRenderTargets.front());
+    if (m_capturing)
+        m_renderGraph.AddPass("CaptureOutput", [&](FrameGraph::PassBuilder &builder)
+        {
+            builder.Read(backBuffer);
+            builder.SideEffect();
+        }, [this, backBuffer](const FrameGraph &graph)
+        {
+            const DX::RenderTargetTexture &target = graph.GetTexture(backBuffer);
+            captureTexture(m_outputCapture, "output", target,
+                target.textureDesc.Width, target.textureDesc.Height);
+        });
 
-        // Continuously copy to smaller textures
-        context->PSSetShader(m_copyPixelShader.Get(), nullptr, 0);
-        for (size_t i = 1; i < m_averagingRenderTargets.size(); i++)
-            copyTexture(m_averagingRenderTargets[i - 1], m_averagingRenderTargets[i]);
-        annotation->EndEvent(); // Calculate frame average brightness
+    // Drops passes and clears nobody observes, then runs the rest
+    m_renderGraph.Execute();
+    m_renderGraph.Reset();
 
-        annotation->BeginEvent(L"Render with HDR to screen");
-        // Set render target to screen
-        ID3D11RenderTargetView *const targets[1] = { m_deviceResources->GetBackBufferRenderTargetView() };
-        UnbindShaderResource();
-        context->OMSetRenderTargets(1, targets, nullptr);
-        // Reset the viewport to target the whole screen.
-        auto viewport = m_deviceResources->GetScreenViewport();
-        context->RSSetViewports(1, &viewport);
-        // Attach HDR shader
-        context->PSSetShader(m_hdrPixelShader.Get(), nullptr, 0);
-
-        // Calculate adapted average brightness
-        context->CopyResource(m_averageBrightnessCPUAccTexture.Get(),
-            m_averagingRenderTargets.back().texture.Get());
-        DX::ThrowIfFailed(
-            context->Map(
-                m_averageBrightnessCPUAccTexture.Get(),
-                0,
-                D3D11_MAP_READ,
-                0,
-                &m_averageBrightnessAccessor
-            )
-        );
-        float averageLogBrightness = *(float *)m_averageBrightnessAccessor.pData;
-        m_adaptedAverageLogBrightness += (averageLogBrightness - m_adaptedAverageLogBrightness) *
-            (float)(1 - std::exp(-m_timer.GetElapsedSeconds() / m_adaptationTime));
-        context->Unmap(m_averageBrightnessCPUAccTexture.Get(), 0);
-
-        //Set constant buffer parameter
-        m_postProcData.averageLogBrightness = m_adaptedAverageLogBrightness;
-        context->UpdateSubresource(m_constantBuffer.Get(), 0, NULL,
-            &m_postProcData, 0, 0);
-        context->PSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
-        // Set scene texture as shader resource
-        context->PSSetShaderResources(0, 1, m_sceneRenderTarget.shaderResourceView.GetAddressOf());
-        // Render full-screen quad
-        context->Draw(4, 0);
-        annotation->EndEvent(); // Render with HDR to screen
-        annotation->EndEvent(); // Post-proccessing
-    }
+    // Hand finished capture copies to the encoder threads
+    updateCaptureStatus();
 
-    // Render GUI
-    m_fpsTextRenderer->Render();
+    // Release pooled render targets left behind by earlier window sizes
+    m_renderTargetPool.EndFrame();
 
     return true;
 }
@@ -1,10 +1,23 @@
 ﻿#pragma once
 
 #include "Common\StepTimer.h"
+#include "Common\GpuFrameTimer.h"
 #include "Common\DeviceResources.h"
 #include "Common\Camera\Camera.h"
 #include "Common\Input\Mouse.h"
 #include "Common\Input\Keyboard.h"
+#include "Common\Readback\ReadbackQueue.h"
+#include "Common\Capture\FrameCapture.h"
+#include "Common\RenderTarget\RenderTargetPool.h"
+#include "Common\RenderTarget\DynamicResolutionController.h"
+#include "Common\RenderGraph\RenderGraph.h"
+#include "Common\PostProcess\LuminanceAdaptation.h"
+#include "Common\PostProcess\ExposureHistogram.h"
+#include "Common\PostProcess\LuminanceReduction.h"
+#include "Common\PostProcess\TonemapLUT.h"
+#include "Common\PostProcess\ColorGradingLUT.h"
+#include "Common\PostProcess\SparseLuminanceEstimator.h"
+#include "Common\PostProcess\BloomPyramid.h"
 #include "Content\Sample3DSceneRenderer.h"
 #include "Content\SampleFpsTextRenderer.h"
 
@@ -63,38 +76,162 @@ namespace anim
 
         // Post-proccessing shaders
         Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
-        Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_copyPixelShader;
-        Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_brightnessPixelShader;
+        Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_luminanceTilesPixelShader;
         Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_hdrPixelShader;
+        Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_bloomDownsamplePixelShader;
+        Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_bloomUpsamplePixelShader;
+
+        // Transient render targets, reused across frames and window resizes
+        DX::RenderTargetPool<DX::RenderTargetTexture> m_renderTargetPool;
+
+        // Frame passes, declared anew every frame in Render()
+        typedef DX::RenderGraph<DX::RenderTargetTexture> FrameGraph;
+        FrameGraph m_renderGraph;
+
+        // Scene render target and depth buffer, transient textures of the
+        // frame graph. The scene covers the m_sceneViewport sub-rectangle of both.
+        DX::RenderTargetDesc m_sceneDesc;
+        DX::RenderTargetDesc m_sceneDepthDesc;
+        D3D11_VIEWPORT m_sceneViewport = {};
+        UINT m_sceneWidth = 1;
+        UINT m_sceneHeight = 1;
+
+        // Dynamic resolution: the HDR scene is rendered at m_renderScale of
+        // the window size, picked from the measured GPU frame time, and
+        // upscaled by the HDR pass. Targets stay allocated at full size.
+        static const size_t GPU_TIMER_DEPTH = 4;
+        DX::GpuFrameTimer m_gpuFrameTimer;
+        DX::DynamicResolutionController m_resolutionController;
+        float m_renderScale = 1;
+
+        // Per-tile log brightness of the scene, at most LUMINANCE_GRID_SIZE
+        // tiles per side. Written in one pass, read back and turned into a
+        // brightness histogram on the CPU.
+        static const UINT LUMINANCE_GRID_SIZE = 64;
+        DX::RenderTargetTexture m_luminanceTilesTarget;
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer> m_luminanceTilesConstantBuffer;
+        struct LuminanceTilesConstBuffer
+        {
+            UINT sourceSize[2];
+            UINT tileSize;
+            UINT dummy;
+        } m_luminanceTilesData = {};
+
+        // Ring of staging textures the luminance tiles are read back through.
+        // Deep enough to cover the frames the GPU may run behind the CPU.
+        static const size_t BRIGHTNESS_READBACK_DEPTH = 3;
+        std::unique_ptr<DX::ReadbackQueue<float, ID3D11Resource *>> m_brightnessReadback;
+
+        // Sparse mode, toggled with L: LUMINANCE_SAMPLE_GRID^2 blue noise
+        // samples of the scene instead of every pixel. The samples texture has
+        // the tiles layout and feeds the same histogram.
+        static const UINT LUMINANCE_SAMPLE_GRID = 32;
+        bool m_sparseLuminance = false;
+        DX::SparseLuminanceEstimator m_sparseLuminanceEstimator;
+        Microsoft::WRL::ComPtr<ID3D11PixelShader> m_luminanceSamplesPixelShader;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_samplePositionsSRV;
+        DX::RenderTargetTexture m_luminanceSamplesTarget;
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer> m_luminanceSamplesConstantBuffer;
+        struct LuminanceSamplesConstBuffer
+        {
+            UINT sourceSize[2];
+            float offset[2];
+        } m_luminanceSamplesData = {};
 
-        // Scene render target
-        DX::RenderTargetTexture m_sceneRenderTarget;
-
-        // Render targets of decreasing sizes used to calculate frame average brightness
-        std::vector<DX::RenderTargetTexture> m_averagingRenderTargets;
+        std::unique_ptr<DX::ReadbackQueue<float, ID3D11Resource *>> m_sampleReadback;
 
-        Microsoft::WRL::ComPtr<ID3D11Texture2D> m_averageBrightnessCPUAccTexture;
+        DX::ExposureHistogram m_exposureHistogram;
 
         // Post-proccessing constant buffer
         Microsoft::WRL::ComPtr<ID3D11Buffer> m_constantBuffer;
         struct PostProcConstBuffer
         {
-            float averageLogBrightness;
+            DX::ExposureResult exposure;
+            // Maps log2 of the scene colour to the tonemap texture coordinate,
+            // exposure included
+            float tonemapScale;
+            float tonemapOffset;
+            // Part of the pooled scene texture covered by the scene
+            float sceneUVScale[2];
+            float sceneUVMax[2];
+            // Part of the pooled bloom texture covered by the bloom
+            float bloomUVScale[2];
+            float bloomUVMax[2];
+            float bloomIntensity;
+            // Grading table shaper and last entry, which is zero when
+            // grading is off and the tonemap table is used instead
+            float gradingExposure;
+            float gradingBias;
+            float gradingScale;
+            float gradingOffset;
+            float gradingLastEntry;
+        } m_postProcData = {};
+
+        // Bloom chain, transient textures of the frame graph. The first
+        // downsample thresholds the scene, the upsample chain blends every
+        // level onto the next finer one up to half the scene size and the HDR
+        // pass adds the result before tonemapping. Toggled with B; when off
+        // nothing reads the chain and the graph culls it.
+        DX::BloomSettings m_bloomSettings;
+        bool m_bloomEnabled = true;
+        Microsoft::WRL::ComPtr<ID3D11BlendState> m_additiveBlendState;
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer> m_bloomConstantBuffer;
+        struct BloomConstBuffer
+        {
+            float sourceScale[2];
+            float sourceSize[2];
+            float sourceTexelSize[2];
+            float threshold;
+            float knee;
+            UINT prefilter;
             float dummy[3];
-        } m_postProcData;
+        };
 
-        float m_adaptedAverageLogBrightness = 0;
-        float m_adaptationTime = 2;
+        // Filmic curve and gamma baked over log2 of the exposed colour
+        DX::TonemapLUT m_tonemapLUT;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_tonemapLUTSRV;
 
-        bool isHDR = true;
+        // Tonemap and the grading.cube next to the executable composed into
+        // one 3D table, replacing the tonemap table. Toggled with G, absent
+        // if there is no grading file.
+        std::unique_ptr<DX::ColorGradingLUT> m_colorGradingLUT;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_colorGradingLUTSRV;
+        bool m_gradingEnabled = true;
+
+        DX::LuminanceAdaptation m_brightnessAdaptation;
 
-        D3D11_MAPPED_SUBRESOURCE m_averageBrightnessAccessor;
+        bool isHDR = true;
 
-        Microsoft::WRL::ComPtr<ID3D11Texture2D> createCPUAccessibleTexture(
-            const DX::Size &size, const std::string &namePrefix);
+        // Frame capture, toggled with C: the HDR scene as PFM and the
+        // tonemapped output as PNG, encoded and written by background threads
+        typedef DX::FrameCapture<ID3D11Resource *> TextureCapture;
+        bool m_capturing = false;
+        std::shared_ptr<DX::CaptureSink> m_captureSink;
+        std::unique_ptr<TextureCapture> m_sceneCapture;
+        std::unique_ptr<TextureCapture> m_outputCapture;
+
+        void addHDRPasses(FrameGraph::Resource backBuffer, const DX::ClearValue &background);
+        void addLuminancePass(FrameGraph::Resource scene);
+        FrameGraph::Resource addBloomPasses(FrameGraph::Resource scene);
+        void clearTexture(const DX::RenderTargetTexture &texture, const DX::ClearValue &value) const;
+        void createColorGradingLUT();
+        void updateExposure();
+        void updateRenderScale();
+        void updateSceneViewport();
+        void captureTexture(std::unique_ptr<TextureCapture> &capture, const std::string &name,
+            const DX::RenderTargetTexture &texture, UINT width, UINT height);
+        void updateCaptureStatus();
 
         void copyTexture(const DX::RenderTargetTexture &source,
             const DX::RenderTargetTexture &dest) const;
+        // One bloom level from the top left sourceWidth x sourceHeight pixels
+        // of source; an upsample is added to the contents of dest
+        void drawBloomLevel(const DX::RenderTargetTexture &source, UINT sourceWidth, UINT sourceHeight,
+            const DX::RenderTargetTexture &dest, UINT destWidth, UINT destHeight,
+            bool prefilter, bool upsample) const;
 
         void InputUpdate(DX::StepTimer const& timer);
 